@@ -86,7 +86,8 @@ static keywords void PurgeThread(intptr_t h) {
 // we need to keep the original process alive simply to pass an int32.
 // so we unmap all memory to avoid getting a double whammy after fork.
 static keywords void sys_execve_nt_relay(intptr_t h, long b, long c, long d) {
-  uint32_t i, dwExitCode;
+  int i;
+  uint32_t dwExitCode;
   __imp_SetConsoleCtrlHandler((void *)sys_execve_nt_event, 1);
   PurgeThread(g_fds.stdin.thread);
   PurgeHandle(g_fds.stdin.reader);
@@ -94,7 +95,7 @@ static keywords void sys_execve_nt_relay(intptr_t h, long b, long c, long d) {
   PurgeHandle(g_fds.p[0].handle);
   PurgeHandle(g_fds.p[1].handle);
   PurgeHandle(g_fds.p[2].handle);
-  for (i = 0; i < _mmi.i; ++i) {
+  for (i = __first_memory(&_mmi); i != -1; i = _mmi.p[i].next) {
     __imp_UnmapViewOfFile((void *)((uintptr_t)_mmi.p[i].x << 16));
     PurgeHandle(_mmi.p[i].h);
   }
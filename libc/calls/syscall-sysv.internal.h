@@ -60,6 +60,8 @@ i32 sys_getresgid(u32 *, u32 *, u32 *);
 i32 sys_getresuid(u32 *, u32 *, u32 *);
 i32 sys_getsid(i32);
 i32 sys_gettid(void);
+i32 sys_inotify_add_watch(i32, const char *, u32);
+i32 sys_inotify_init1(i32);
 i32 sys_ioctl(i32, u64, ...);
 i32 sys_ioctl_cp(i32, u64, ...);
 i32 sys_issetugid(void);
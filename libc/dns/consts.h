@@ -9,6 +9,7 @@
 #define DNS_TYPE_PTR   12
 #define DNS_TYPE_MX    15
 #define DNS_TYPE_TXT   16
+#define DNS_TYPE_AAAA  28
 
 #define DNS_CLASS_IN 1
 
@@ -21,6 +21,7 @@
 #include "libc/dns/hoststxt.h"
 #include "libc/dns/resolvconf.h"
 #include "libc/dns/servicestxt.h"
+#include "libc/errno.h"
 #include "libc/fmt/conv.h"
 #include "libc/macros.internal.h"
 #include "libc/mem/gc.h"
@@ -106,6 +107,8 @@ int getaddrinfo(const char *name, const char *service,
     freeaddrinfo(ai);
     if (rc == 0) {
       return EAI_NONAME;
+    } else if (errno == ETIMEDOUT) {
+      return EAI_AGAIN;
     } else {
       return EAI_SYSTEM;
     }
@@ -18,6 +18,8 @@
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "libc/dns/dns.h"
 #include "libc/dns/resolvconf.h"
+#include "libc/fmt/conv.h"
+#include "libc/macros.internal.h"
 #include "libc/mem/arraylist.internal.h"
 #include "libc/mem/mem.h"
 #include "libc/runtime/runtime.h"
@@ -34,6 +36,10 @@
  *
  *     nameserver 8.8.8.8
  *     nameserver 8.8.4.4
+ *     options timeout:2 attempts:3
+ *
+ * Where the timeout is in seconds, and is how long ResolveDns() will
+ * wait for all the nameservers to answer, before asking them again.
  *
  * @param resolv points to a ResolvConf object, which should be zero
  *     initialized by the caller; or if it already contains items,
@@ -60,6 +66,14 @@ int ParseResolvConf(struct ResolvConf *resolv, struct FILE *f) {
       if ((strcmp(directive, "nameserver") == 0 &&
            inet_pton(AF_INET, value, &nameserver.sin_addr.s_addr) == 1)) {
         if (append(&resolv->nameservers, &nameserver) != -1) ++rc;
+      } else if (strcmp(directive, "options") == 0) {
+        do {
+          if (startswith(value, "timeout:")) {
+            resolv->timeout = MIN(atoi(value + 8), 30) * 1000;
+          } else if (startswith(value, "attempts:")) {
+            resolv->attempts = MIN(atoi(value + 9), 5);
+          }
+        } while ((value = strtok_r(NULL, " \t\r\n\v", &tok)));
       }
     }
   }
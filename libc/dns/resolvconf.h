@@ -12,6 +12,8 @@ struct Nameservers {
 
 struct ResolvConf {
   struct Nameservers nameservers;
+  int timeout;  /* milliseconds per attempt, or zero for default */
+  int attempts; /* number of times to ask, or zero for default */
 };
 
 const struct ResolvConf *GetResolvConf(void) returnsnonnull;
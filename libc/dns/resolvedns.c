@@ -17,97 +17,390 @@
 │ PERFORMANCE OF THIS SOFTWARE.                                                │
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "libc/calls/calls.h"
+#include "libc/calls/struct/timespec.h"
 #include "libc/dns/consts.h"
 #include "libc/dns/dns.h"
 #include "libc/dns/dnsheader.h"
 #include "libc/dns/dnsquestion.h"
 #include "libc/dns/resolvconf.h"
+#include "libc/errno.h"
 #include "libc/intrin/bits.h"
+#include "libc/macros.internal.h"
 #include "libc/mem/mem.h"
-#include "libc/runtime/runtime.h"
-#include "libc/sock/internal.h"
 #include "libc/sock/sock.h"
+#include "libc/sock/struct/pollfd.h"
 #include "libc/sock/struct/sockaddr.h"
+#include "libc/sock/struct/sockaddr6.h"
 #include "libc/stdio/rand.h"
-#include "libc/stdio/stdio.h"
 #include "libc/str/str.h"
 #include "libc/sysv/consts/af.h"
 #include "libc/sysv/consts/ipproto.h"
+#include "libc/sysv/consts/poll.h"
 #include "libc/sysv/consts/sock.h"
 #include "libc/sysv/errfuns.h"
+#include "libc/thread/thread.h"
 
-#define kMsgMax 512
+#define kMsgMax       512
+#define kDnsTimeout   5000 /* milliseconds per attempt, per resolv.conf(5) */
+#define kDnsAttempts  2
+#define kDnsCacheSize 64
+#define kDnsTtlMax    3600 /* seconds we'll remember an answer at most */
+
+struct DnsQuery {
+  uint16_t id;
+  uint16_t qtype;
+  int rc;       /* -1 if waiting, 0 if name has no address, 1 if found */
+  int size;     /* bytes in msg */
+  uint32_t ttl; /* seconds the answer may be cached */
+  uint8_t addr[16];
+  uint8_t msg[kMsgMax];
+};
+
+struct DnsCacheEntry {
+  int64_t expires; /* monotonic milliseconds */
+  uint16_t qtype;
+  uint8_t addr[16];
+  char name[DNS_NAME_MAX + 1];
+};
+
+static struct DnsCache {
+  pthread_mutex_t lock;
+  struct DnsCacheEntry p[kDnsCacheSize];
+} g_dnscache = {PTHREAD_MUTEX_INITIALIZER};
+
+static int64_t GetDnsTime(void) {
+  return timespec_tomillis(timespec_mono());
+}
+
+static bool GetDnsCache(const char *name, uint16_t qtype, uint8_t addr[16]) {
+  int i;
+  bool found;
+  int64_t now;
+  found = false;
+  now = GetDnsTime();
+  pthread_mutex_lock(&g_dnscache.lock);
+  for (i = 0; i < kDnsCacheSize; ++i) {
+    if (g_dnscache.p[i].qtype == qtype && g_dnscache.p[i].expires > now &&
+        !strcasecmp(g_dnscache.p[i].name, name)) {
+      memcpy(addr, g_dnscache.p[i].addr, 16);
+      found = true;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&g_dnscache.lock);
+  return found;
+}
+
+static void PutDnsCache(const char *name, uint16_t qtype,
+                        const uint8_t addr[16], uint32_t ttl) {
+  int i, j;
+  struct DnsCacheEntry *e;
+  if (!ttl || strlen(name) > DNS_NAME_MAX) return;
+  pthread_mutex_lock(&g_dnscache.lock);
+  for (j = i = 0; i < kDnsCacheSize; ++i) {
+    e = g_dnscache.p + i;
+    if (e->qtype == qtype && !strcasecmp(e->name, name)) {
+      j = i;
+      break;
+    }
+    if (e->expires < g_dnscache.p[j].expires) {
+      j = i;  // evict whichever entry is closest to expiring
+    }
+  }
+  e = g_dnscache.p + j;
+  e->qtype = qtype;
+  e->expires = GetDnsTime() + MIN(ttl, kDnsTtlMax) * 1000;
+  memcpy(e->addr, addr, 16);
+  strcpy(e->name, name);
+  pthread_mutex_unlock(&g_dnscache.lock);
+}
+
+static const uint8_t *SkipDnsName(const uint8_t *p, const uint8_t *pe) {
+  while (p < pe) {
+    if ((*p & 0xc0) == 0xc0) return p + 2 <= pe ? p + 2 : 0;
+    if (!*p) return p + 1;
+    p += 1 + *p;
+  }
+  return 0;
+}
+
+/**
+ * Decodes response to query.
+ *
+ * @return -1 if msg isn't a useful answer to q, 0 if q->rc was set,
+ *     or 1 if the response was truncated and should be asked over tcp
+ */
+static int ParseDnsAnswer(struct DnsQuery *q, const uint8_t *msg, size_t n) {
+  uint32_t ttl;
+  struct DnsHeader h;
+  const uint8_t *p, *pe;
+  uint16_t rtype, rclass, rdlength;
+  if (n < q->size) return -1;
+  DeserializeDnsHeader(&h, msg);
+  if (h.id != q->id) return -1;
+  if ((h.bf1 & 0xf8) != 0x80) return -1; /* QR=1 OPCODE=QUERY */
+  if (h.qdcount != 1) return -1;
+  if (memcasecmp(msg + 12, q->msg + 12, q->size - 12)) return -1;
+  if (h.bf1 & 2) return 1;           /* TC */
+  if ((h.bf2 & 15) == 3) {           /* NXDOMAIN */
+    q->rc = 0;
+    return 0;
+  }
+  if (h.bf2 & 15) return -1;         /* SERVFAIL, REFUSED, etc. */
+  ttl = -1;
+  p = msg + q->size;
+  pe = msg + n;
+  while (h.ancount--) {
+    if (!(p = SkipDnsName(p, pe)) || p + 10 > pe) break;
+    rtype = READ16BE(p);
+    rclass = READ16BE(p + 2);
+    ttl = MIN(ttl, READ32BE(p + 4)); /* cname chains expire together */
+    rdlength = READ16BE(p + 8);
+    if (p + 10 + rdlength > pe) break;
+    if (rclass == DNS_CLASS_IN && rtype == q->qtype &&
+        rdlength == (q->qtype == DNS_TYPE_A ? 4 : 16)) {
+      memcpy(q->addr, p + 10, rdlength);
+      q->ttl = ttl;
+      q->rc = 1;
+      return 0;
+    }
+    p += 10 + rdlength;
+  }
+  q->rc = 0;
+  return 0;
+}
+
+static bool WaitDns(int fd, int events, int64_t deadline) {
+  int ms;
+  struct pollfd pfd = {fd, events};
+  for (;;) {
+    if ((ms = deadline - GetDnsTime()) <= 0) return false;
+    switch (poll(&pfd, 1, ms)) {
+      case 1:
+        return true;
+      case 0:
+        return false;
+      default:
+        if (errno != EINTR) return false;
+    }
+  }
+}
+
+/**
+ * Asks nameserver again over tcp, for when the answer didn't fit.
+ */
+static int QueryDnsTcp(struct DnsQuery *q, const struct sockaddr_in *ns,
+                       int64_t deadline) {
+  ssize_t rc;
+  uint8_t *buf;
+  int fd, res = -1;
+  size_t got, want;
+  if (!(buf = malloc(2 + 65535))) return -1;
+  if ((fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                   IPPROTO_TCP)) != -1) {
+    if ((!connect(fd, (const struct sockaddr *)ns, sizeof(*ns)) ||
+         errno == EINPROGRESS) &&
+        WaitDns(fd, POLLOUT, deadline)) {
+      WRITE16BE(buf, q->size);
+      memcpy(buf + 2, q->msg, q->size);
+      if (send(fd, buf, 2 + q->size, 0) == 2 + q->size) {
+        for (got = 0, want = 2; got < want;) {
+          if (!WaitDns(fd, POLLIN, deadline)) break;
+          if ((rc = read(fd, buf + got, want - got)) > 0) {
+            if ((got += rc) == 2) want += READ16BE(buf);
+          } else if (!rc || errno != EAGAIN) {
+            break;
+          }
+        }
+        if (got == want && want > 2 &&
+            !ParseDnsAnswer(q, buf + 2, want - 2)) {
+          res = 0;
+        }
+      }
+    }
+    close(fd);
+  }
+  free(buf);
+  return res;
+}
+
+/**
+ * Returns index of answer we'd prefer, or -1 if none, or -2 if the
+ * queries which might still produce a better answer need more time.
+ */
+static int PickDnsAnswer(const struct DnsQuery *q, int n) {
+  int i;
+  for (i = 0; i < n; ++i) {
+    if (q[i].rc == 1) return i;
+    if (q[i].rc == -1) return -2;
+  }
+  return -1;
+}
+
+/**
+ * Sends queries to all nameservers at once, until the one we'd prefer
+ * is answered, while retrying on timeout.
+ */
+static int QueryDns(const struct ResolvConf *rc, struct DnsQuery *q, int n) {
+  int64_t deadline;
+  struct sockaddr_in from;
+  uint8_t msg[kMsgMax];
+  uint32_t fromlen;
+  ssize_t got;
+  int i, j, fd, sent, attempt, attempts, timeout;
+  timeout = rc->timeout > 0 ? rc->timeout : kDnsTimeout;
+  attempts = rc->attempts > 0 ? rc->attempts : kDnsAttempts;
+  if ((fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                   IPPROTO_UDP)) == -1) {
+    return -1;
+  }
+  for (attempt = 0; attempt < attempts && PickDnsAnswer(q, n) == -2;
+       ++attempt) {
+    for (sent = i = 0; i < n; ++i) {
+      if (q[i].rc != -1) continue;
+      for (j = 0; j < rc->nameservers.i; ++j) {
+        if (sendto(fd, q[i].msg, q[i].size, 0,
+                   (const struct sockaddr *)(rc->nameservers.p + j),
+                   sizeof(*rc->nameservers.p)) == q[i].size) {
+          ++sent;
+        }
+      }
+    }
+    if (!sent) break;
+    deadline = GetDnsTime() + timeout;
+    while (PickDnsAnswer(q, n) == -2 && WaitDns(fd, POLLIN, deadline)) {
+      fromlen = sizeof(from);
+      if ((got = recvfrom(fd, msg, sizeof(msg), 0, (struct sockaddr *)&from,
+                          &fromlen)) < 12) {
+        continue;
+      }
+      for (j = 0; j < rc->nameservers.i; ++j) {
+        if (from.sin_addr.s_addr == rc->nameservers.p[j].sin_addr.s_addr &&
+            from.sin_port == rc->nameservers.p[j].sin_port) {
+          break;
+        }
+      }
+      if (j == rc->nameservers.i) continue; /* not a nameserver */
+      for (i = 0; i < n; ++i) {
+        if (q[i].rc == -1 && ParseDnsAnswer(q + i, msg, got) == 1) {
+          QueryDnsTcp(q + i, rc->nameservers.p + j, deadline);
+        }
+      }
+    }
+  }
+  close(fd);
+  if (PickDnsAnswer(q, n) == -2) {
+    for (i = 0; i < n; ++i) {
+      if (q[i].rc != -1) break;
+    }
+    if (i == n) return etimedout();
+  }
+  return 0;
+}
+
+static int FillDnsAddress(uint16_t qtype, const uint8_t addr[16],
+                          struct sockaddr *sa) {
+  struct sockaddr_in *a4;
+  struct sockaddr_in6 *a6;
+  if (qtype == DNS_TYPE_A) {
+    a4 = (struct sockaddr_in *)sa;
+    a4->sin_family = AF_INET;
+    memcpy(&a4->sin_addr.s_addr, addr, 4);
+  } else {
+    a6 = (struct sockaddr_in6 *)sa;
+    a6->sin6_family = AF_INET6;
+    a6->sin6_flowinfo = 0;
+    a6->sin6_scope_id = 0;
+    memcpy(&a6->sin6_addr, addr, 16);
+  }
+  return 1;
+}
 
 /**
  * Queries Domain Name System for address associated with name.
  *
+ * Answers are cached for the time-to-live given by the nameserver, and
+ * the cache is shared by all threads. Every nameserver in resolvconf is
+ * asked at the same time and the first to answer wins. If nobody does
+ * within `options timeout:N` seconds, then the question is asked again
+ * up to `options attempts:N` times. Truncated answers are asked again
+ * over TCP. If `af` is AF_UNSPEC and `addrsize` has room for an IPv6
+ * address, then the A and AAAA records are requested at the same time
+ * and the IPv4 address is preferred.
+ *
  * @param resolvconf can be GetResolvConf()
- * @param af can be AF_INET, AF_UNSPEC
+ * @param af can be AF_INET, AF_INET6, AF_UNSPEC
  * @param name can be a local or fully-qualified hostname
- * @param addr should point to a struct sockaddr_in; if this function
- *     succeeds, its sin_family and sin_addr fields will be modified
+ * @param addr should point to a struct sockaddr_in, or sockaddr_in6 if
+ *     `af` isn't AF_INET; if this function succeeds, its family and
+ *     address fields will be modified
  * @param addrsize is the byte size of addr
  * @return number of matches found, or -1 w/ errno
- * @error EAFNOSUPPORT. ENETDOWN, ENAMETOOLONG, EBADMSG
+ * @error EAFNOSUPPORT, ENAMETOOLONG, ETIMEDOUT, EINVAL
+ * @threadsafe
  */
 int ResolveDns(const struct ResolvConf *resolvconf, int af, const char *name,
                struct sockaddr *addr, uint32_t addrsize) {
-  int rc, fd, n;
-  struct DnsQuestion q;
-  struct DnsHeader h, h2;
-  struct sockaddr_in *a4;
-  uint8_t *p, *pe, msg[512];
-  uint16_t rtype, rclass, rdlength;
-  if (addrsize < kMinSockaddr4Size) return einval();
-  if (af != AF_INET && af != AF_UNSPEC) return eafnosupport();
+  int i, n;
+  uint8_t cached[16];
+  struct DnsHeader h;
+  struct DnsQuestion dq;
+  struct DnsQuery *q, *qs;
+  uint16_t qtypes[2];
+  if (af != AF_INET && af != AF_INET6 && af != AF_UNSPEC) {
+    return eafnosupport();
+  }
+  if (addrsize < (af == AF_INET6 ? sizeof(struct sockaddr_in6)
+                                 : kMinSockaddr4Size)) {
+    return einval();
+  }
+  n = 0;
+  if (af != AF_INET6) qtypes[n++] = DNS_TYPE_A;
+  if (af != AF_INET && addrsize >= sizeof(struct sockaddr_in6)) {
+    qtypes[n++] = DNS_TYPE_AAAA;
+  }
+  for (i = 0; i < n; ++i) {
+    if (GetDnsCache(name, qtypes[i], cached)) {
+      return FillDnsAddress(qtypes[i], cached, addr);
+    }
+  }
   if (!resolvconf->nameservers.i) return 0;
-  bzero(&h, sizeof(h));
-  rc = ebadmsg();
-  h.id = _rand64();
-  h.bf1 = 1; /* recursion desired */
-  h.qdcount = 1;
-  q.qname = name;
-  q.qtype = DNS_TYPE_A;
-  q.qclass = DNS_CLASS_IN;
-  bzero(msg, sizeof(msg));
-  SerializeDnsHeader(msg, &h);
-  if ((n = SerializeDnsQuestion(msg + 12, 500, &q)) == -1) return -1;
-  if ((fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1) return -1;
-  if (sendto(fd, msg, 12 + n, 0, (struct sockaddr *)resolvconf->nameservers.p,
-             sizeof(*resolvconf->nameservers.p)) == 12 + n &&
-      (n = read(fd, msg, 512)) >= 12) {
-    DeserializeDnsHeader(&h2, msg);
-    if (h2.id == h.id) {
-      rc = 0;
-      p = msg + 12;
-      pe = msg + n;
-      while (p < pe && h2.qdcount--) {
-        p += strnlen((char *)p, pe - p) + 1 + 4;
-      }
-      while (p < pe && h2.ancount--) {
-        if ((p[0] & 0xc0) == 0xc0) { /* name pointer */
-          p += 2;
-        } else {
-          p += strnlen((char *)p, pe - p) + 1;
-        }
-        if (p + 10 <= pe) {
-          rtype = READ16BE(p);
-          rclass = READ16BE(p + 2);
-          // ttl = READ32BE(p + 4);
-          rdlength = READ16BE(p + 8);
-          if (p + 10 + rdlength <= pe && rdlength == 4 &&
-              rclass == DNS_CLASS_IN && rtype == DNS_TYPE_A) {
-            rc = 1;
-            a4 = (struct sockaddr_in *)addr;
-            a4->sin_family = AF_INET;
-            memcpy(&a4->sin_addr.s_addr, p + 10, 4);
-            break;
-          }
-          p += 10 + rdlength;
-        }
+  if (!(qs = calloc(n, sizeof(*qs)))) return -1;
+  for (i = 0; i < n; ++i) {
+    q = qs + i;
+    q->rc = -1;
+    q->id = _rand64();
+    q->qtype = qtypes[i];
+    bzero(&h, sizeof(h));
+    h.id = q->id;
+    h.bf1 = 1; /* recursion desired */
+    h.qdcount = 1;
+    dq.qname = name;
+    dq.qtype = q->qtype;
+    dq.qclass = DNS_CLASS_IN;
+    SerializeDnsHeader(q->msg, &h);
+    if ((q->size = SerializeDnsQuestion(q->msg + 12, kMsgMax - 12, &dq)) ==
+        -1) {
+      free(qs);
+      return -1;
+    }
+    q->size += 12;
+  }
+  if (QueryDns(resolvconf, qs, n) != -1) {
+    for (i = 0; i < n; ++i) {
+      if (qs[i].rc == 1) {
+        PutDnsCache(name, qs[i].qtype, qs[i].addr, qs[i].ttl);
       }
     }
+    if ((i = PickDnsAnswer(qs, n)) >= 0) {
+      FillDnsAddress(qs[i].qtype, qs[i].addr, addr);
+      n = 1;
+    } else {
+      n = 0;
+    }
+  } else {
+    n = -1;
   }
-  close(fd);
-  return rc;
+  free(qs);
+  return n;
 }
@@ -404,7 +404,7 @@ static bool __asan_is_mapped(int x) {
   __mmi_lock();
   m = _weaken(_mmi);
   i = __find_memory(m, x);
-  res = i < m->i && x >= m->p[i].x;
+  res = i != -1 && x >= m->p[i].x;
   __mmi_unlock();
   return res;
 }
@@ -897,7 +897,8 @@ dontdiscard static __asan_die_f *__asan_report(const void *addr, int size,
   p = __asan_format_section(p, _etext, _edata, ".data", addr);
   p = __asan_format_section(p, _end, _edata, ".bss", addr);
   __mmi_lock();
-  for (m = _weaken(_mmi), i = 0; i < m->i; ++i) {
+  m = _weaken(_mmi);
+  for (i = __first_memory(m); i != -1; i = m->p[i].next) {
     x = m->p[i].x;
     y = m->p[i].y;
     p = __asan_format_interval(p, x << 16, (y << 16) + (FRAMESIZE - 1));
@@ -1456,18 +1457,18 @@ static textstartup void __asan_shadow_string_list(char **list) {
 }
 
 static textstartup void __asan_shadow_mapping(struct MemoryIntervals *m,
-                                              size_t i) {
+                                              int i) {
   uintptr_t x, y;
-  if (i < m->i) {
+  if (i != -1) {
     x = m->p[i].x;
     y = m->p[i].y;
-    __asan_shadow_mapping(m, i + 1);
+    __asan_shadow_mapping(m, m->p[i].next);
     __asan_map_shadow(x << 16, (y - x + 1) << 16);
   }
 }
 
 static textstartup void __asan_shadow_existing_mappings(void) {
-  __asan_shadow_mapping(&_mmi, 0);
+  __asan_shadow_mapping(&_mmi, __first_memory(&_mmi));
   __asan_map_shadow(GetStackAddr(), GetStackSize());
   __asan_poison((void *)GetStackAddr(), getauxval(AT_PAGESZ),
                 kAsanStackOverflow);
@@ -17,20 +17,73 @@
 │ PERFORMANCE OF THIS SOFTWARE.                                                │
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "libc/assert.h"
+#include "libc/stdckdint.h"
 #include "libc/runtime/memtrack.internal.h"
 
-dontasan unsigned __find_memory(const struct MemoryIntervals *mm, int x) {
-  unsigned l, m, r;
-  l = 0;
-  r = mm->i;
-  while (l < r) {
-    m = (l & r) + ((l ^ r) >> 1);  // floor((a+b)/2)
-    if (mm->p[m].y < x) {
-      l = m + 1;
+/**
+ * Returns index of first interval that ends at or after frame `x`.
+ *
+ * @return index into `mm->p` or -1 if no interval ends after `x`
+ */
+dontasan int __find_memory(const struct MemoryIntervals *mm, int x) {
+  int t, r;
+  if (!mm->i) return -1;
+  for (r = -1, t = mm->root; t != -1;) {
+    if (mm->p[t].y < x) {
+      t = mm->p[t].right;
     } else {
-      r = m;
+      r = t;
+      t = mm->p[t].left;
     }
   }
-  unassert(l == mm->i || x <= mm->p[l].y);
-  return l;
+  unassert(r == -1 || x <= mm->p[r].y);
+  return r;
+}
+
+static dontasan bool __fits_hole(const struct MemoryIntervals *mm, int i,
+                                 int n, int align, int *res) {
+  int start, end;
+  if (!ckd_add(&start, mm->p[mm->p[i].prev].y, 1) &&
+      !ckd_add(&start, start, align - 1)) {
+    start &= -align;
+    if (!ckd_add(&end, start, n - 1)) {
+      if (end < mm->p[i].x) {
+        *res = start;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static dontasan int __search_hole(const struct MemoryIntervals *mm, int t,
+                                  int x, int n, int align, int *res) {
+  int i;
+  if (t == -1 || mm->p[t].maxhole < (unsigned)n) return -1;
+  if (mm->p[t].x > x) {
+    if ((i = __search_hole(mm, mm->p[t].left, x, n, align, res)) != -1) {
+      return i;
+    }
+    if (__fits_hole(mm, t, n, align, res)) {
+      return t;
+    }
+  }
+  return __search_hole(mm, mm->p[t].right, x, n, align, res);
+}
+
+/**
+ * Finds first gap after interval `i` that can hold `n` aligned frames.
+ *
+ * Subtrees are skipped when none of their holes are big enough, so
+ * the typical cost is logarithmic.
+ *
+ * @param align is a power of two
+ * @param res receives the first frame of the gap
+ * @return index of interval that follows the gap, or -1 if none
+ */
+dontasan int __find_hole(const struct MemoryIntervals *mm, int i, int n,
+                         int align, int *res) {
+  unassert(n > 0);
+  unassert(align > 0);
+  return __search_hole(mm, mm->root, mm->p[i].x, n, align, res);
 }
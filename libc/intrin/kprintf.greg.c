@@ -175,27 +175,31 @@ __funline bool kischarmisaligned(const char *p, signed char t) {
 }
 
 __funline bool kismemtrackhosed(void) {
-  return !((_weaken(_mmi)->i <= _weaken(_mmi)->n) &&
+  return !((_weaken(_mmi)->i <= _weaken(_mmi)->u) &&
+           (_weaken(_mmi)->u <= _weaken(_mmi)->n) &&
            (_weaken(_mmi)->p == _weaken(_mmi)->s ||
             _weaken(_mmi)->p == (struct MemoryInterval *)kMemtrackStart));
 }
 
 privileged static bool kismapped(int x) {
   // xxx: we can't lock because no reentrant locks yet
-  size_t m, r, l = 0;
+  size_t k;
+  int t, r = -1;
   if (!_weaken(_mmi)) return true;
   if (kismemtrackhosed()) return false;
-  r = _weaken(_mmi)->i;
-  while (l < r) {
-    m = (l & r) + ((l ^ r) >> 1);  // floor((a+b)/2)
-    if (_weaken(_mmi)->p[m].y < x) {
-      l = m + 1;
+  if (!_weaken(_mmi)->i) return false;
+  // descent is bounded in case the tree is being modified
+  for (k = 0, t = _weaken(_mmi)->root;
+       0 <= t && t < _weaken(_mmi)->u && k < _weaken(_mmi)->i; ++k) {
+    if (_weaken(_mmi)->p[t].y < x) {
+      t = _weaken(_mmi)->p[t].right;
     } else {
-      r = m;
+      r = t;
+      t = _weaken(_mmi)->p[t].left;
     }
   }
-  if (l < _weaken(_mmi)->i && x >= _weaken(_mmi)->p[l].x) {
-    return !!(_weaken(_mmi)->p[l].prot & PROT_READ);
+  if (r != -1 && x >= _weaken(_mmi)->p[r].x) {
+    return !!(_weaken(_mmi)->p[r].prot & PROT_READ);
   } else {
     return false;
   }
@@ -39,23 +39,160 @@ static void *__shove_memory(struct MemoryInterval *d,
                             const struct MemoryInterval *s, int n) {
   int i;
   unassert(n >= 0);
-  if (d > s) {
-    for (i = n; i--;) {
-      d[i] = s[i];
-    }
-  } else {
-    for (i = 0; i < n; ++i) {
-      d[i] = s[i];
-    }
+  for (i = 0; i < n; ++i) {
+    d[i] = s[i];
   }
   return d;
 }
 
-static void __remove_memory(struct MemoryIntervals *mm, int i, int n) {
-  unassert(i >= 0);
-  unassert(i + n <= mm->i);
-  __shove_memory(mm->p + i, mm->p + i + n, mm->i - (i + n));
-  mm->i -= n;
+static unsigned __rank_memory(int i) {
+  unsigned h = i;  // murmur3 finalizer
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+static unsigned __hole_memory(const struct MemoryInterval *p, int i) {
+  if (p[i].prev == -1) return 0;
+  return (unsigned)p[i].x - (unsigned)p[p[i].prev].y - 1;
+}
+
+static void __pull_memory(struct MemoryInterval *p, int t) {
+  unsigned h = p[t].hole;
+  if (p[t].left != -1) h = MAX(h, p[p[t].left].maxhole);
+  if (p[t].right != -1) h = MAX(h, p[p[t].right].maxhole);
+  p[t].maxhole = h;
+}
+
+// splits treap so intervals before frame x go left and the rest right
+static void __split_memory(struct MemoryInterval *p, int t, int x, int *l,
+                           int *r) {
+  if (t == -1) {
+    *l = *r = -1;
+  } else if (p[t].x < x) {
+    __split_memory(p, p[t].right, x, &p[t].right, r);
+    __pull_memory(p, t);
+    *l = t;
+  } else {
+    __split_memory(p, p[t].left, x, l, &p[t].left);
+    __pull_memory(p, t);
+    *r = t;
+  }
+}
+
+// joins treaps, where every interval in l precedes every one in r
+static int __join_memory(struct MemoryInterval *p, int l, int r) {
+  if (l == -1) return r;
+  if (r == -1) return l;
+  if (__rank_memory(l) > __rank_memory(r)) {
+    p[l].right = __join_memory(p, p[l].right, r);
+    __pull_memory(p, l);
+    return l;
+  } else {
+    p[r].left = __join_memory(p, l, p[r].left);
+    __pull_memory(p, r);
+    return r;
+  }
+}
+
+static int __insert_memory(struct MemoryInterval *p, int t, int i) {
+  if (t == -1) {
+    p[i].left = p[i].right = -1;
+    __pull_memory(p, i);
+    return i;
+  }
+  if (__rank_memory(i) > __rank_memory(t)) {
+    __split_memory(p, t, p[i].x, &p[i].left, &p[i].right);
+    __pull_memory(p, i);
+    return i;
+  }
+  if (p[i].x < p[t].x) {
+    p[t].left = __insert_memory(p, p[t].left, i);
+  } else {
+    p[t].right = __insert_memory(p, p[t].right, i);
+  }
+  __pull_memory(p, t);
+  return t;
+}
+
+static int __delete_memory(struct MemoryInterval *p, int t, int x) {
+  unassert(t != -1);
+  if (x < p[t].x) {
+    p[t].left = __delete_memory(p, p[t].left, x);
+  } else if (x > p[t].x) {
+    p[t].right = __delete_memory(p, p[t].right, x);
+  } else {
+    return __join_memory(p, p[t].left, p[t].right);
+  }
+  __pull_memory(p, t);
+  return t;
+}
+
+// recomputes subtree maximums on the path to the interval at frame x
+static void __fixup_memory(struct MemoryInterval *p, int t, int x) {
+  unassert(t != -1);
+  if (x < p[t].x) {
+    __fixup_memory(p, p[t].left, x);
+  } else if (x > p[t].x) {
+    __fixup_memory(p, p[t].right, x);
+  }
+  __pull_memory(p, t);
+}
+
+// must be called after changing the x of i or the y of its prev
+static void __refresh_memory(struct MemoryIntervals *mm, int i) {
+  if (i == -1) return;
+  mm->p[i].hole = __hole_memory(mm->p, i);
+  __fixup_memory(mm->p, mm->root, mm->p[i].x);
+}
+
+// inserts slot i into list and tree after interval j, or first if -1
+static void __link_memory(struct MemoryIntervals *mm, int i, int j) {
+  int k;
+  struct MemoryInterval *p = mm->p;
+  k = j != -1 ? p[j].next : __first_memory(mm);
+  p[i].prev = j;
+  p[i].next = k;
+  if (j != -1) {
+    p[j].next = i;
+  } else {
+    mm->head = i;
+  }
+  if (k != -1) {
+    p[k].prev = i;
+  } else {
+    mm->tail = i;
+  }
+  p[i].hole = __hole_memory(p, i);
+  mm->root = __insert_memory(p, mm->i ? mm->root : -1, i);
+  ++mm->i;
+  __refresh_memory(mm, k);
+}
+
+// removes interval i from list and tree, and puts its slot on free list
+static void __unlink_memory(struct MemoryIntervals *mm, int i) {
+  int j, k;
+  struct MemoryInterval *p = mm->p;
+  j = p[i].prev;
+  k = p[i].next;
+  mm->root = __delete_memory(p, mm->root, p[i].x);
+  if (j != -1) {
+    p[j].next = k;
+  } else {
+    mm->head = k;
+  }
+  if (k != -1) {
+    p[k].prev = j;
+  } else {
+    mm->tail = j;
+  }
+  --mm->i;
+  p[i].next = mm->free;
+  mm->free = i;
+  __refresh_memory(mm, k);
 }
 
 static bool __extend_memory(struct MemoryIntervals *mm) {
@@ -77,7 +214,7 @@ static bool __extend_memory(struct MemoryIntervals *mm) {
     }
     dm = sys_mmap(base, gran, prot, flags, -1, 0);
     if (!dm.addr) return false;
-    __shove_memory(dm.addr, mm->p, mm->i);
+    __shove_memory(dm.addr, mm->p, mm->u);
     mm->p = dm.addr;
     mm->n = gran / sizeof(*mm->p);
   } else {
@@ -95,39 +232,69 @@ static bool __extend_memory(struct MemoryIntervals *mm) {
   return true;
 }
 
-static int __mint_memory(struct MemoryIntervals *mm, int i) {
-  unassert(i >= 0);
-  unassert(i <= mm->i);
-  unassert(mm->n >= 0);
-  if (mm->i == mm->n && !__extend_memory(mm)) return enomem();
-  __shove_memory(mm->p + i + 1, mm->p + i, mm->i++ - i);
-  return 0;
+// allocates slot for new interval, which may move mm->p
+static int __mint_memory(struct MemoryIntervals *mm) {
+  int i;
+  if (mm->u > mm->i) {
+    i = mm->free;
+    mm->free = mm->p[i].next;
+  } else {
+    if (mm->u == mm->n && !__extend_memory(mm)) return enomem();
+    i = mm->u++;
+  }
+  return i;
 }
 
 static int __punch_memory(struct MemoryIntervals *mm, int x, int y, int i) {
-  if (__mint_memory(mm, i) == -1) return -1;
-  mm->p[i + 0].size -= (size_t)(mm->p[i + 0].y - (x - 1)) * FRAMESIZE;
-  mm->p[i + 0].y = x - 1;
-  mm->p[i + 1].size -= (size_t)((y + 1) - mm->p[i + 1].x) * FRAMESIZE;
-  mm->p[i + 1].x = y + 1;
+  int j;
+  struct MemoryInterval *p;
+  if ((j = __mint_memory(mm)) == -1) return -1;
+  p = mm->p;
+  p[j] = p[i];
+  p[i].size -= (size_t)(p[i].y - (x - 1)) * FRAMESIZE;
+  p[i].y = x - 1;
+  p[j].size -= (size_t)((y + 1) - p[j].x) * FRAMESIZE;
+  p[j].x = y + 1;
+  __link_memory(mm, j, i);
   return 0;
 }
 
+/**
+ * Rebuilds links of memory intervals.
+ *
+ * This is for when `mm->p[0..mm->i)` has been populated by hand, in
+ * which case the intervals must be sorted and must not overlap.
+ */
+void __relink_memory(struct MemoryIntervals *mm) {
+  int i, n;
+  n = mm->i;
+  mm->i = 0;
+  mm->u = n;
+  for (i = 0; i < n; ++i) {
+    __link_memory(mm, i, i - 1);
+  }
+}
+
 int __untrack_memory(struct MemoryIntervals *mm, int x, int y,
                      void wf(struct MemoryIntervals *, int, int)) {
-  unsigned l, r;
+  int i, l, r;
+  struct MemoryInterval *p = mm->p;
   unassert(y >= x);
   if (!mm->i) return 0;
-  // binary search for the lefthand side
+  // tree search for the lefthand side
   l = __find_memory(mm, x);
-  if (l == mm->i) return 0;
-  if (y < mm->p[l].x) return 0;
+  if (l == -1) return 0;
+  if (y < p[l].x) return 0;
 
-  // binary search for the righthand side
+  // tree search for the righthand side
   r = __find_memory(mm, y);
-  if (r == mm->i || (r > l && y < mm->p[r].x)) --r;
-  unassert(r >= l);
-  unassert(x <= mm->p[r].y);
+  if (r == -1) {
+    r = __last_memory(mm);
+  } else if (y < p[r].x) {
+    r = p[r].prev;
+  }
+  unassert(p[r].x >= p[l].x);
+  unassert(x <= p[r].y);
 
   // remove the middle of an existing map
   //
@@ -137,7 +304,7 @@ int __untrack_memory(struct MemoryIntervals *mm, int x, int y,
   //
   // this isn't possible on windows because we track each
   // 64kb segment on that platform using a separate entry
-  if (l == r && x > mm->p[l].x && y < mm->p[l].y) {
+  if (l == r && x > p[l].x && y < p[l].y) {
     return __punch_memory(mm, x, y, l);
   }
 
@@ -147,13 +314,14 @@ int __untrack_memory(struct MemoryIntervals *mm, int x, int y,
   //           xxxxx
   // ----|mmmm|----------------- after
   //
-  if (x > mm->p[l].x && x <= mm->p[l].y) {
-    unassert(y >= mm->p[l].y);
+  if (x > p[l].x && x <= p[l].y) {
+    unassert(y >= p[l].y);
     if (IsWindows()) return einval();
-    mm->p[l].size -= (size_t)(mm->p[l].y - (x - 1)) * FRAMESIZE;
-    mm->p[l].y = x - 1;
-    unassert(mm->p[l].x <= mm->p[l].y);
-    ++l;
+    p[l].size -= (size_t)(p[l].y - (x - 1)) * FRAMESIZE;
+    p[l].y = x - 1;
+    unassert(p[l].x <= p[l].y);
+    l = p[l].next;
+    __refresh_memory(mm, l);
   }
 
   // trim the left side of the righthand map
@@ -162,20 +330,25 @@ int __untrack_memory(struct MemoryIntervals *mm, int x, int y,
   //           xxxxx
   // ---------------|mm|-------- after
   //
-  if (y >= mm->p[r].x && y < mm->p[r].y) {
-    unassert(x <= mm->p[r].x);
+  if (y >= p[r].x && y < p[r].y) {
+    unassert(x <= p[r].x);
     if (IsWindows()) return einval();
-    mm->p[r].size -= (size_t)((y + 1) - mm->p[r].x) * FRAMESIZE;
-    mm->p[r].x = y + 1;
-    unassert(mm->p[r].x <= mm->p[r].y);
-    --r;
+    p[r].size -= (size_t)((y + 1) - p[r].x) * FRAMESIZE;
+    p[r].x = y + 1;
+    unassert(p[r].x <= p[r].y);
+    __refresh_memory(mm, r);
+    r = p[r].prev;
   }
 
-  if (l <= r) {
+  if (l != -1 && r != -1 && p[l].x <= p[r].x) {
     if (IsWindows() && wf) {
       wf(mm, l, r);
     }
-    __remove_memory(mm, l, r - l + 1);
+    do {
+      i = l;
+      l = p[i].next;
+      __unlink_memory(mm, i);
+    } while (i != r);
   }
   return 0;
 }
@@ -183,49 +356,54 @@ int __untrack_memory(struct MemoryIntervals *mm, int x, int y,
 int __track_memory(struct MemoryIntervals *mm, int x, int y, long h, int prot,
                    int flags, bool readonlyfile, bool iscow, long offset,
                    long size) {
-  unsigned i;
+  int i, j;
+  struct MemoryInterval *p = mm->p;
   unassert(y >= x);
   i = __find_memory(mm, x);
+  j = i != -1 ? p[i].prev : __last_memory(mm);
 
   // try to extend the righthand side of the lefthand entry
   // we can't do that if we're tracking independent handles
   // we can't do that if it's a file map with a small size!
-  if (i && x == mm->p[i - 1].y + 1 && h == mm->p[i - 1].h &&
-      prot == mm->p[i - 1].prot && flags == mm->p[i - 1].flags &&
-      mm->p[i - 1].size ==
-          (size_t)(mm->p[i - 1].y - mm->p[i - 1].x) * FRAMESIZE + FRAMESIZE) {
-    mm->p[i - 1].size += (size_t)(y - mm->p[i - 1].y) * FRAMESIZE;
-    mm->p[i - 1].y = y;
+  if (j != -1 && x == p[j].y + 1 && h == p[j].h && prot == p[j].prot &&
+      flags == p[j].flags &&
+      p[j].size == (size_t)(p[j].y - p[j].x) * FRAMESIZE + FRAMESIZE) {
+    p[j].size += (size_t)(y - p[j].y) * FRAMESIZE;
+    p[j].y = y;
     // if we filled the hole then merge the two mappings
-    if (i < mm->i && y + 1 == mm->p[i].x && h == mm->p[i].h &&
-        prot == mm->p[i].prot && flags == mm->p[i].flags) {
-      mm->p[i - 1].y = mm->p[i].y;
-      mm->p[i - 1].size += mm->p[i].size;
-      __remove_memory(mm, i, 1);
+    if (i != -1 && y + 1 == p[i].x && h == p[i].h && prot == p[i].prot &&
+        flags == p[i].flags) {
+      p[j].y = p[i].y;
+      p[j].size += p[i].size;
+      __unlink_memory(mm, i);
     }
+    __refresh_memory(mm, p[j].next);
   }
 
   // try to extend the lefthand side of the righthand entry
   // we can't do that if we're creating a smaller file map!
-  else if (i < mm->i && y + 1 == mm->p[i].x && h == mm->p[i].h &&
-           prot == mm->p[i].prot && flags == mm->p[i].flags &&
+  else if (i != -1 && y + 1 == p[i].x && h == p[i].h && prot == p[i].prot &&
+           flags == p[i].flags &&
            size == (size_t)(y - x) * FRAMESIZE + FRAMESIZE) {
-    mm->p[i].size += (size_t)(mm->p[i].x - x) * FRAMESIZE;
-    mm->p[i].x = x;
+    p[i].size += (size_t)(p[i].x - x) * FRAMESIZE;
+    p[i].x = x;
+    __refresh_memory(mm, i);
   }
 
-  // otherwise, create a new entry and memmove the items
+  // otherwise, create a new entry and link it into the tree
   else {
-    if (__mint_memory(mm, i) == -1) return -1;
-    mm->p[i].x = x;
-    mm->p[i].y = y;
-    mm->p[i].h = h;
-    mm->p[i].prot = prot;
-    mm->p[i].flags = flags;
-    mm->p[i].offset = offset;
-    mm->p[i].size = size;
-    mm->p[i].iscow = iscow;
-    mm->p[i].readonlyfile = readonlyfile;
+    if ((i = __mint_memory(mm)) == -1) return -1;
+    p = mm->p;
+    p[i].x = x;
+    p[i].y = y;
+    p[i].h = h;
+    p[i].prot = prot;
+    p[i].flags = flags;
+    p[i].offset = offset;
+    p[i].size = size;
+    p[i].iscow = iscow;
+    p[i].readonlyfile = readonlyfile;
+    __link_memory(mm, i, j);
   }
 
   return 0;
@@ -23,21 +23,22 @@
 #include "libc/macros.internal.h"
 #include "libc/runtime/memtrack.internal.h"
 
-static bool IsNoteworthyHole(unsigned i, const struct MemoryIntervals *mm) {
+static bool IsNoteworthyHole(int i, const struct MemoryIntervals *mm) {
   // gaps between shadow frames aren't interesting
   // the chasm from heap to stack ruins statistics
-  return !(
-      (IsShadowFrame(mm->p[i].y) || IsShadowFrame(mm->p[i + 1].x)) ||
-      (!IsStaticStackFrame(mm->p[i].y) && IsStaticStackFrame(mm->p[i + 1].x)));
+  int j = mm->p[i].next;
+  return !((IsShadowFrame(mm->p[i].y) || IsShadowFrame(mm->p[j].x)) ||
+           (!IsStaticStackFrame(mm->p[i].y) && IsStaticStackFrame(mm->p[j].x)));
 }
 
 void PrintMemoryIntervals(int fd, const struct MemoryIntervals *mm) {
-  long i, w, frames, maptally = 0;
+  int i;
+  long w, frames, maptally = 0;
   char mappingbuf[8], framebuf[64], sb[16];
-  for (w = i = 0; i < mm->i; ++i) {
+  for (w = 0, i = __first_memory(mm); i != -1; i = mm->p[i].next) {
     w = MAX(w, LengthInt64Thousands(mm->p[i].y + 1 - mm->p[i].x));
   }
-  for (i = 0; i < mm->i; ++i) {
+  for (i = __first_memory(mm); i != -1; i = mm->p[i].next) {
     frames = mm->p[i].y + 1 - mm->p[i].x;
     maptally += frames;
     kprintf("%08x-%08x %s %'*ldx %s", mm->p[i].x, mm->p[i].y,
@@ -47,8 +48,8 @@ void PrintMemoryIntervals(int fd, const struct MemoryIntervals *mm) {
     if (mm->p[i].readonlyfile) kprintf(" readonlyfile");
     sizefmt(sb, mm->p[i].size, 1024);
     kprintf(" %sB", sb);
-    if (i + 1 < mm->i) {
-      frames = mm->p[i + 1].x - mm->p[i].y - 1;
+    if (mm->p[i].next != -1) {
+      frames = mm->p[mm->p[i].next].x - mm->p[i].y - 1;
       if (frames && IsNoteworthyHole(i, mm)) {
         sizefmt(sb, frames * FRAMESIZE, 1024);
         kprintf(" w/ %sB hole", sb);
@@ -16,6 +16,7 @@
 │ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
 │ PERFORMANCE OF THIS SOFTWARE.                                                │
 ╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/calls/blockcancel.internal.h"
 #include "libc/calls/calls.h"
 #include "libc/calls/state.internal.h"
 #include "libc/errno.h"
@@ -25,8 +26,61 @@
 #include "libc/runtime/internal.h"
 #include "libc/thread/thread.h"
 #include "libc/thread/tls.h"
+#include "third_party/nsync/futex.internal.h"
 #include "third_party/nsync/mu.h"
 
+// tells the cpu we're in a spin loop, so it doesn't starve the lock
+// holder of its hyperthread or speculate a pipeline flush on exit
+static inline void pthread_mutex_pause(void) {
+#ifdef __x86_64__
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// acquires the lock word of a mutex that isn't managed by nsync. the
+// word is 0 if unlocked, 1 if locked, and 2 if locked with waiters. a
+// contended lock spins briefly with exponential backoff, only trying
+// to take the word once it's been seen unlocked, and then sleeps on a
+// futex, or yields if the futex implementation wasn't linked in. since
+// the futex wait is a cancellation point, while pthread_mutex_lock()
+// mustn't be one, cancellations are blocked while we sleep.
+static void pthread_mutex_lock_word(pthread_mutex_t *mutex) {
+  int c, i, j;
+  c = 0;
+  if (atomic_compare_exchange_strong_explicit(&mutex->_lock, &c, 1,
+                                              memory_order_acquire,
+                                              memory_order_relaxed)) {
+    return;
+  }
+  for (i = 0; c == 1 && i < 10; ++i) {
+    for (j = 0; j < 1 << i; ++j) {
+      pthread_mutex_pause();
+    }
+    if (!(c = atomic_load_explicit(&mutex->_lock, memory_order_relaxed)) &&
+        atomic_compare_exchange_weak_explicit(&mutex->_lock, &c, 1,
+                                              memory_order_acquire,
+                                              memory_order_relaxed)) {
+      return;
+    }
+  }
+  if (c != 2) {
+    c = atomic_exchange_explicit(&mutex->_lock, 2, memory_order_acquire);
+  }
+  if (!c) return;
+  BLOCK_CANCELLATIONS;
+  do {
+    if (_weaken(nsync_futex_wait_)) {
+      _weaken(nsync_futex_wait_)(&mutex->_lock, 2, mutex->_pshared, 0);
+    } else {
+      pthread_yield();
+    }
+    c = atomic_exchange_explicit(&mutex->_lock, 2, memory_order_acquire);
+  } while (c);
+  ALLOW_CANCELLATIONS;
+}
+
 /**
  * Locks mutex.
  *
@@ -58,6 +112,10 @@
  *     pthread_mutex_unlock(&lock);
  *     pthread_mutex_destroy(&lock);
  *
+ * Normal private mutexes are implemented using nsync. Every other kind
+ * of mutex, including ones shared between processes over `MAP_SHARED`
+ * memory, sleeps on a futex when it's contended.
+ *
  * This function does nothing in vfork() children.
  *
  * @return 0 on success, or error number on failure
@@ -80,9 +138,7 @@ int pthread_mutex_lock(pthread_mutex_t *mutex) {
   }
 
   if (mutex->_type == PTHREAD_MUTEX_NORMAL) {
-    while (atomic_exchange_explicit(&mutex->_lock, 1, memory_order_acquire)) {
-      pthread_yield();
-    }
+    pthread_mutex_lock_word(mutex);
     return 0;
   }
 
@@ -100,9 +156,7 @@ int pthread_mutex_lock(pthread_mutex_t *mutex) {
     }
   }
 
-  while (atomic_exchange_explicit(&mutex->_lock, 1, memory_order_acquire)) {
-    pthread_yield();
-  }
+  pthread_mutex_lock_word(mutex);
 
   mutex->_depth = 0;
   mutex->_owner = t;
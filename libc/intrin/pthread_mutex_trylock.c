@@ -20,10 +20,19 @@
 #include "libc/errno.h"
 #include "libc/intrin/atomic.h"
 #include "libc/intrin/weaken.h"
+#include "libc/runtime/internal.h"
 #include "libc/thread/thread.h"
 #include "libc/thread/tls.h"
 #include "third_party/nsync/mu.h"
 
+// acquires lock word if it's unlocked, without clobbering waiter bit
+static bool pthread_mutex_trylock_word(pthread_mutex_t *mutex) {
+  int c = 0;
+  return atomic_compare_exchange_strong_explicit(&mutex->_lock, &c, 1,
+                                                 memory_order_acquire,
+                                                 memory_order_relaxed);
+}
+
 /**
  * Locks mutex if it isn't locked already.
  *
@@ -49,7 +58,7 @@ errno_t pthread_mutex_trylock(pthread_mutex_t *mutex) {
   }
 
   if (mutex->_type == PTHREAD_MUTEX_NORMAL) {
-    if (!atomic_exchange_explicit(&mutex->_lock, 1, memory_order_acquire)) {
+    if (pthread_mutex_trylock_word(mutex)) {
       return 0;
     } else {
       return EBUSY;
@@ -70,9 +79,10 @@ errno_t pthread_mutex_trylock(pthread_mutex_t *mutex) {
     }
   }
 
-  if (!atomic_exchange_explicit(&mutex->_lock, 1, memory_order_acquire)) {
+  if (pthread_mutex_trylock_word(mutex)) {
     mutex->_depth = 0;
     mutex->_owner = t;
+    mutex->_pid = __pid;
     return 0;
   } else {
     return EBUSY;
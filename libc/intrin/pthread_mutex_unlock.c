@@ -25,8 +25,17 @@
 #include "libc/runtime/internal.h"
 #include "libc/thread/thread.h"
 #include "libc/thread/tls.h"
+#include "third_party/nsync/futex.internal.h"
 #include "third_party/nsync/mu.h"
 
+// releases lock word of mutex, waking a thread if any are sleeping
+static void pthread_mutex_unlock_word(pthread_mutex_t *mutex) {
+  if (atomic_exchange_explicit(&mutex->_lock, 0, memory_order_release) == 2 &&
+      _weaken(nsync_futex_wake_)) {
+    _weaken(nsync_futex_wake_)(&mutex->_lock, 1, mutex->_pshared);
+  }
+}
+
 /**
  * Releases mutex.
  *
@@ -52,7 +61,7 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex) {
   }
 
   if (mutex->_type == PTHREAD_MUTEX_NORMAL) {
-    atomic_store_explicit(&mutex->_lock, 0, memory_order_release);
+    pthread_mutex_unlock_word(mutex);
     return 0;
   }
 
@@ -71,7 +80,7 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex) {
   }
 
   mutex->_owner = 0;
-  atomic_store_explicit(&mutex->_lock, 0, memory_order_release);
+  pthread_mutex_unlock_word(mutex);
 
   return 0;
 }
@@ -32,6 +32,29 @@ static inline const char *strchr_pure(const char *s, int c) {
 
 #if defined(__x86_64__) && !defined(__chibicc__)
 typedef char xmm_t __attribute__((__vector_size__(16), __aligned__(16)));
+typedef char ymm_t __attribute__((__vector_size__(32), __aligned__(32)));
+
+dontasan static __attribute__((__target__("avx2"))) const char *strchr_avx2(
+    const ymm_t *p, unsigned char c) {
+  unsigned m;
+  ymm_t v, a, b, z = {0};
+  ymm_t n = {c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c,
+             c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c};
+  for (;; p += 2) {
+    a = p[0];
+    b = p[1];
+    // min(x^c,x) has a zero byte wherever x has either c or nul
+    v = __builtin_ia32_pminub256(__builtin_ia32_pminub256(a ^ n, a),
+                                 __builtin_ia32_pminub256(b ^ n, b));
+    if (__builtin_ia32_pmovmskb256(v == z)) break;
+  }
+  if (!(m = __builtin_ia32_pmovmskb256((a == z) | (a == n)))) {
+    m = __builtin_ia32_pmovmskb256((b == z) | (b == n));
+    ++p;
+  }
+  return (const char *)p + __builtin_ctzl(m);
+}
+
 dontasan static inline const char *strchr_sse(const char *s, unsigned char c) {
   unsigned k;
   unsigned m;
@@ -46,11 +69,17 @@ dontasan static inline const char *strchr_sse(const char *s, unsigned char c) {
   m >>= k;
   m <<= k;
   while (!m) {
-    v = *++p;
+    // short strings are quicker to finish with sse
+    if (!((uintptr_t)++p & 63) && X86_HAVE(AVX2)) {
+      s = strchr_avx2((const ymm_t *)p, c);
+      goto Found;
+    }
+    v = *p;
     m = __builtin_ia32_pmovmskb128((v == z) | (v == n));
   }
   m = __builtin_ctzl(m);
   s = (const char *)p + m;
+Found:
   if (c && !*s) s = 0;
   return s;
 }
@@ -18,9 +18,30 @@
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "libc/dce.h"
 #include "libc/intrin/asan.internal.h"
+#include "libc/nexgen32e/x86feature.h"
 #include "libc/str/str.h"
 #ifndef __aarch64__
 
+#if defined(__x86_64__) && !defined(__chibicc__)
+typedef char xmm_t __attribute__((__vector_size__(16), __aligned__(16)));
+typedef char ymm_t __attribute__((__vector_size__(32), __aligned__(32)));
+dontasan static __attribute__((__target__("avx2"))) size_t
+strlen_avx2(const char *s, const ymm_t *p) {
+  unsigned m;
+  ymm_t a, b, z = {0};
+  for (;; p += 2) {
+    a = p[0];
+    b = p[1];
+    if (__builtin_ia32_pmovmskb256(__builtin_ia32_pminub256(a, b) == z)) break;
+  }
+  if ((m = __builtin_ia32_pmovmskb256(a == z))) {
+    return (const char *)p + __builtin_ctzl(m) - s;
+  }
+  m = __builtin_ia32_pmovmskb256(b == z);
+  return (const char *)(p + 1) + __builtin_ctzl(m) - s;
+}
+#endif
+
 /**
  * Returns length of NUL-terminated string.
  *
@@ -31,12 +52,19 @@
 dontasan size_t strlen(const char *s) {
   if (IsAsan()) __asan_verify_str(s);
 #if defined(__x86_64__) && !defined(__chibicc__)
-  typedef char xmm_t __attribute__((__vector_size__(16), __aligned__(16)));
   xmm_t z = {0};
   unsigned m, k = (uintptr_t)s & 15;
   const xmm_t *p = (const xmm_t *)((uintptr_t)s & -16);
   m = __builtin_ia32_pmovmskb128(*p == z) >> k << k;
-  while (!m) m = __builtin_ia32_pmovmskb128(*++p == z);
+  if (m) return (const char *)p + __builtin_ctzl(m) - s;
+  // short strings are quicker to finish with sse
+  while ((uintptr_t)++p & 63) {
+    if ((m = __builtin_ia32_pmovmskb128(*p == z))) {
+      return (const char *)p + __builtin_ctzl(m) - s;
+    }
+  }
+  if (X86_HAVE(AVX2)) return strlen_avx2(s, (const ymm_t *)p);
+  while (!(m = __builtin_ia32_pmovmskb128(*p == z))) ++p;
   return (const char *)p + __builtin_ctzl(m) - s;
 #else
 #define ONES ((word)-1 / 255)
@@ -134,6 +134,7 @@ wontreturn textstartup void cosmo(long *sp, struct Syslib *m1) {
 
   // initialize memory manager
   _mmi.i = 0;
+  _mmi.u = 0;
   _mmi.p = _mmi.s;
   _mmi.n = ARRAYLEN(_mmi.s);
   __mmi_lock_obj._type = PTHREAD_MUTEX_RECURSIVE;
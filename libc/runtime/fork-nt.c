@@ -199,8 +199,9 @@ textwindows void WinMainForked(void) {
   uint64_t size, upsize;
   struct MemoryInterval *maps;
   char16_t fvar[21 + 1 + 21 + 1];
-  uint32_t i, varlen, oldprot, savepid;
-  long mapcount, mapcapacity, specialz;
+  uint32_t varlen, oldprot, savepid;
+  long i, j, mapcount, mapslots, mapcapacity, specialz;
+  int mapfirst;
 
   struct StdinRelay stdin;
   struct Fds *fds = __veil("r", &g_fds);
@@ -225,19 +226,22 @@ textwindows void WinMainForked(void) {
   ReadOrDie(reader, jb, sizeof(jb));
   ReadOrDie(reader, &mapcount, sizeof(_mmi.i));
   ReadOrDie(reader, &mapcapacity, sizeof(_mmi.n));
+  ReadOrDie(reader, &mapslots, sizeof(_mmi.u));
+  ReadOrDie(reader, &mapfirst, sizeof(_mmi.head));
   specialz = ROUNDUP(mapcapacity * sizeof(_mmi.p[0]), kMemtrackGran);
   ViewOrDie(MapOrDie(kNtPageReadwrite, specialz), kNtFileMapWrite, 0, specialz,
             maps);
-  ReadOrDie(reader, maps, mapcount * sizeof(_mmi.p[0]));
+  ReadOrDie(reader, maps, mapslots * sizeof(_mmi.p[0]));
   if (IsAsan()) {
     shad = (char *)(((intptr_t)maps >> 3) + 0x7fff8000);
     size = ROUNDUP(specialz >> 3, FRAMESIZE);
     ViewOrDie(MapOrDie(kNtPageReadwrite, size), kNtFileMapWrite, 0, size, maps);
-    ReadOrDie(reader, shad, (mapcount * sizeof(_mmi.p[0])) >> 3);
+    ReadOrDie(reader, shad, (mapslots * sizeof(_mmi.p[0])) >> 3);
   }
 
   // read the heap mappings from the parent process
-  for (i = 0; i < mapcount; ++i) {
+  // the slots are copied verbatim, so walk the list
+  for (j = 0, i = mapfirst; j < mapcount; ++j, i = maps[i].next) {
     addr = (char *)((uint64_t)maps[i].x << 16);
     size = maps[i].size;
     if ((maps[i].flags & MAP_TYPE) != MAP_SHARED) {
@@ -270,7 +274,7 @@ textwindows void WinMainForked(void) {
   // apply fixups and reapply memory protections
   _mmi.p = maps;
   _mmi.n = specialz / sizeof(_mmi.p[0]);
-  for (i = 0; i < mapcount; ++i) {
+  for (j = 0, i = mapfirst; j < mapcount; ++j, i = maps[i].next) {
     if (!VirtualProtect((void *)((uint64_t)maps[i].x << 16), maps[i].size,
                         __prot2nt(maps[i].prot, maps[i].iscow), &oldprot)) {
       AbortFork("VirtualProtect");
@@ -366,12 +370,14 @@ textwindows int sys_fork_nt(uint32_t dwCreationFlags) {
         ok = WriteAll(writer, jb, sizeof(jb)) &&
              WriteAll(writer, &_mmi.i, sizeof(_mmi.i)) &&
              WriteAll(writer, &_mmi.n, sizeof(_mmi.n)) &&
-             WriteAll(writer, _mmi.p, _mmi.i * sizeof(_mmi.p[0]));
+             WriteAll(writer, &_mmi.u, sizeof(_mmi.u)) &&
+             WriteAll(writer, &_mmi.head, sizeof(_mmi.head)) &&
+             WriteAll(writer, _mmi.p, _mmi.u * sizeof(_mmi.p[0]));
         if (IsAsan() && ok) {
           ok = WriteAll(writer, (char *)(((intptr_t)_mmi.p >> 3) + 0x7fff8000),
-                        (_mmi.i * sizeof(_mmi.p[0])) >> 3);
+                        (_mmi.u * sizeof(_mmi.p[0])) >> 3);
         }
-        for (i = 0; i < _mmi.i && ok; ++i) {
+        for (i = __first_memory(&_mmi); i != -1 && ok; i = _mmi.p[i].next) {
           if ((_mmi.p[i].flags & MAP_TYPE) != MAP_SHARED) {
             char *p = (char *)((uint64_t)_mmi.p[i].x << 16);
             // XXX: forking destroys thread guard pages currently
@@ -0,0 +1,66 @@
+#ifndef COSMOPOLITAN_LIBC_RUNTIME_FTRACE_INTERNAL_H_
+#define COSMOPOLITAN_LIBC_RUNTIME_FTRACE_INTERNAL_H_
+
+/**
+ * @fileoverview Binary function call logging.
+ *
+ * When a program is run with `--ftrace-binary` then each function call
+ * is appended, as a fixed-size record, to a ring buffer owned by the
+ * calling thread. Rings are written in bulk to `ftrace.out` once they
+ * fill up halfway, as well as when threads and processes exit.
+ *
+ * When a program is run with `--ftrace-sample` then a SIGPROF interval
+ * timer is used to record the call stack a thousand times per second of
+ * cpu time, which is cheap enough to leave on under production load.
+ *
+ * Both modes write the same record format, which begins with a header
+ * record. The `ftracefold` tool turns these files into folded stacks.
+ */
+
+#define FTRACE_PATH  "ftrace.out"
+#define FTRACE_MAGIC 0x0031454341525446 /* "FTRACE1" */
+
+#define kFtraceHeader 0 /* first record of file, addr is FTRACE_MAGIC */
+#define kFtraceCall   1 /* function addr was called at call depth */
+#define kFtraceSample 2 /* depth 0 is pc, and return addresses follow */
+
+#define kFtraceRings    64   /* most threads which may trace at once */
+#define kFtraceRingSize 4096 /* records per thread, must be two power */
+
+#if !(__ASSEMBLER__ + __LINKER__ + 0)
+COSMOPOLITAN_C_START_
+
+struct FtraceRecord {
+  uint64_t tsc;   /* rdtsc() at time of call or sample */
+  uint64_t addr;  /* address of function, or of instruction */
+  uint32_t tid;   /* thread which made the call */
+  uint16_t depth; /* call nesting, or frame number within sample */
+  uint16_t kind;  /* kFtraceCall, kFtraceSample, or kFtraceHeader */
+};
+
+struct FtraceRing {
+  _Atomic(int) owner;         /* tid of thread filling ring, or 0 */
+  _Atomic(int) draining;      /* nonzero while ring is being written */
+  int pid;                    /* so forked children discard parent's */
+  _Atomic(uint32_t) head;     /* records added, by owner only */
+  _Atomic(uint32_t) tail;     /* records written, by drainer only */
+  struct FtraceRecord p[kFtraceRingSize];
+};
+
+#define FTRACE_DEAD ((struct FtraceRing *)-1)
+
+extern int __ftrace_fd;
+extern long __ftrace_handle;
+extern struct FtraceRing *__ftrace_rings;
+
+int ftrace_binary_install(void);
+int ftrace_sample_install(void);
+void ftrace_flush(void);
+void ftrace_thread_exit(void);
+int __ftrace_open(void);
+void __ftrace_drain(struct FtraceRing *);
+void __ftrace_write(const void *, size_t);
+
+COSMOPOLITAN_C_END_
+#endif /* !(__ASSEMBLER__ + __LINKER__ + 0) */
+#endif /* COSMOPOLITAN_LIBC_RUNTIME_FTRACE_INTERNAL_H_ */
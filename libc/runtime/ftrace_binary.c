@@ -0,0 +1,108 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/calls/calls.h"
+#include "libc/calls/internal.h"
+#include "libc/dce.h"
+#include "libc/intrin/atomic.h"
+#include "libc/intrin/kprintf.h"
+#include "libc/nexgen32e/rdtsc.h"
+#include "libc/runtime/ftrace.internal.h"
+#include "libc/runtime/internal.h"
+#include "libc/runtime/runtime.h"
+#include "libc/sysv/consts/o.h"
+#include "libc/thread/tls.h"
+
+int __ftrace_fd = -1;
+long __ftrace_handle;
+struct FtraceRing *__ftrace_rings;
+
+/**
+ * Opens `ftrace.out` for binary logging if it isn't open already.
+ */
+int __ftrace_open(void) {
+  int fd;
+  struct FtraceRecord hdr;
+  if (__ftrace_fd != -1) return 0;
+  if ((fd = open(FTRACE_PATH, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND |
+                                  O_CLOEXEC,
+                 0644)) == -1) {
+    kprintf("error: failed to open %s: %m\n", FTRACE_PATH);
+    return -1;
+  }
+  hdr.tsc = rdtsc();
+  hdr.addr = FTRACE_MAGIC;
+  hdr.tid = __pid;
+  hdr.depth = 0;
+  hdr.kind = kFtraceHeader;
+  write(fd, &hdr, sizeof(hdr));
+  __ftrace_handle = IsWindows() ? __getfdhandleactual(fd) : fd;
+  __ftrace_fd = fd;
+  return 0;
+}
+
+/**
+ * Writes records from all threads of this process.
+ */
+void ftrace_flush(void) {
+  int i;
+  if (!__ftrace_rings) return;
+  for (i = 0; i < kFtraceRings; ++i) {
+    if (atomic_load_explicit(&__ftrace_rings[i].owner, memory_order_acquire) &&
+        __ftrace_rings[i].pid == __pid) {
+      __ftrace_drain(__ftrace_rings + i);
+    }
+  }
+}
+
+/**
+ * Writes the calling thread's records and gives its ring to others.
+ *
+ * This is called by pthread_exit(). Functions called after it are no
+ * longer logged.
+ */
+void ftrace_thread_exit(void) {
+  struct CosmoTib *tib;
+  struct FtraceRing *r;
+  if (!__tls_enabled) return;
+  tib = __get_tls();
+  r = tib->tib_ftracebuf;
+  tib->tib_ftracebuf = FTRACE_DEAD;
+  if (r && r != FTRACE_DEAD) {
+    __ftrace_drain(r);
+    atomic_store_explicit(&r->owner, 0, memory_order_release);
+  }
+}
+
+/**
+ * Enables binary function call logging to `ftrace.out`.
+ *
+ * Logging doesn't begin until ftrace_enabled() is used.
+ *
+ * @return 0 on success, or -1 on error
+ * @see libc/runtime/ftrace.internal.h
+ */
+textstartup int ftrace_binary_install(void) {
+  if (__ftrace_open() == -1) return -1;
+  if (!(__ftrace_rings = _mapanon(kFtraceRings * sizeof(*__ftrace_rings)))) {
+    kprintf("error: --ftrace-binary failed to allocate rings: %m\n");
+    return -1;
+  }
+  atexit(ftrace_flush);
+  return ftrace_install();
+}
@@ -0,0 +1,96 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/calls/calls.h"
+#include "libc/calls/struct/itimerval.h"
+#include "libc/calls/struct/sigaction.h"
+#include "libc/calls/struct/siginfo.h"
+#include "libc/calls/ucontext.h"
+#include "libc/errno.h"
+#include "libc/intrin/kprintf.h"
+#include "libc/nexgen32e/rdtsc.h"
+#include "libc/nexgen32e/stackframe.h"
+#include "libc/runtime/ftrace.internal.h"
+#include "libc/sysv/consts/itimer.h"
+#include "libc/sysv/consts/sa.h"
+#include "libc/sysv/consts/sig.h"
+
+#define kSampleHz     1000
+#define kSampleFrames 64
+
+static void ftrace_sample(int sig, siginfo_t *si, void *arg) {
+  int n, e;
+  uint64_t tsc;
+  uint32_t tid;
+  uintptr_t pc;
+  ucontext_t *ctx;
+  struct StackFrame *sf;
+  struct FtraceRecord rec[kSampleFrames];
+  e = errno;
+  ctx = arg;
+  tsc = rdtsc();
+  tid = gettid();
+#ifdef __x86_64__
+  pc = ctx->uc_mcontext.rip;
+  sf = (struct StackFrame *)ctx->uc_mcontext.rbp;
+#elif defined(__aarch64__)
+  pc = ctx->uc_mcontext.pc;
+  sf = (struct StackFrame *)ctx->uc_mcontext.regs[29];
+#endif
+  for (n = 0; n < kSampleFrames; ++n) {
+    rec[n].tsc = tsc;
+    rec[n].addr = pc;
+    rec[n].tid = tid;
+    rec[n].depth = n;
+    rec[n].kind = kFtraceSample;
+    if (!sf || ((uintptr_t)sf & 7) || kisdangerous(sf)) {
+      ++n;
+      break;
+    }
+    pc = sf->addr;
+    if (sf->next <= sf) {
+      sf = 0;  // stack grows down, so this isn't a caller
+    } else {
+      sf = sf->next;
+    }
+  }
+  __ftrace_write(rec, n * sizeof(*rec));
+  errno = e;
+}
+
+/**
+ * Enables sampling of call stacks to `ftrace.out`.
+ *
+ * The SIGPROF signal and ITIMER_PROF interval timer are used, so this
+ * only measures time that the process spends running on a cpu.
+ *
+ * @return 0 on success, or -1 on error
+ * @see libc/runtime/ftrace.internal.h
+ */
+textstartup int ftrace_sample_install(void) {
+  struct sigaction sa = {.sa_sigaction = ftrace_sample,
+                         .sa_flags = SA_SIGINFO | SA_RESTART};
+  struct itimerval it = {{0, 1000000 / kSampleHz}, {0, 1000000 / kSampleHz}};
+  if (__ftrace_open() == -1) return -1;
+  if (sigaction(SIGPROF, &sa, 0) == -1 ||
+      setitimer(ITIMER_PROF, &it, 0) == -1) {
+    kprintf("error: --ftrace-sample failed to start timer: %m\n");
+    return -1;
+  }
+  return 0;
+}
@@ -16,6 +16,7 @@
 │ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
 │ PERFORMANCE OF THIS SOFTWARE.                                                │
 ╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/runtime/ftrace.internal.h"
 #include "libc/runtime/internal.h"
 #include "libc/runtime/runtime.h"
 #include "libc/str/str.h"
@@ -33,12 +34,24 @@ __static_yoink("zipos");
  * `sed | sort | uniq -c | sort`. A compressed trace can be made by
  * appending `--ftrace 2>&1 | gzip -4 >trace.gz` to the CLI arguments.
  *
+ * The `--ftrace-binary` flag may be passed instead, to log calls more
+ * quickly to `ftrace.out` in a binary format. The `--ftrace-sample` flag
+ * samples call stacks to the same file, which adds much less overhead.
+ * Such files may be turned into flame graphs with `ftracefold`.
+ *
  * @see libc/runtime/_init.S for documentation
  */
 textstartup int ftrace_init(void) {
   if (__intercept_flag(&__argc, __argv, "--ftrace")) {
     ftrace_install();
     ftrace_enabled(+1);
+  } else if (__intercept_flag(&__argc, __argv, "--ftrace-binary")) {
+    if (ftrace_binary_install() != -1) {
+      ftrace_enabled(+1);
+    }
+  }
+  if (__intercept_flag(&__argc, __argv, "--ftrace-sample")) {
+    ftrace_sample_install();
   }
   return __argc;
 }
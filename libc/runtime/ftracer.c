@@ -17,16 +17,24 @@
 │ PERFORMANCE OF THIS SOFTWARE.                                                │
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "libc/calls/calls.h"
+#include "libc/dce.h"
 #include "libc/errno.h"
 #include "libc/fmt/itoa.h"
 #include "libc/intrin/cmpxchg.h"
 #include "libc/intrin/kprintf.h"
+#include "libc/intrin/atomic.h"
+#include "libc/intrin/likely.h"
 #include "libc/intrin/nopl.internal.h"
 #include "libc/macros.internal.h"
+#include "libc/nexgen32e/rdtsc.h"
 #include "libc/nexgen32e/stackframe.h"
+#include "libc/nt/runtime.h"
+#include "libc/nt/thunk/msabi.h"
+#include "libc/runtime/ftrace.internal.h"
 #include "libc/runtime/internal.h"
 #include "libc/runtime/runtime.h"
 #include "libc/runtime/stack.h"
+#include "libc/sysv/consts/nr.h"
 #include "libc/thread/tls.h"
 #include "libc/thread/tls2.internal.h"
 
@@ -35,7 +43,9 @@
  *
  * Able to log ~2 million function calls per second, which is mostly
  * bottlenecked by system call overhead. Log size is reasonable if piped
- * into gzip.
+ * into gzip. Binary logging doesn't have this bottleneck.
+ *
+ * @see libc/runtime/ftrace.internal.h
  */
 
 #define MAX_NESTING 512
@@ -46,7 +56,10 @@
 #define DETOUR_SKEW 8
 #endif
 
+__msabi extern typeof(WriteFile) *const __imp_WriteFile;
+
 static struct CosmoFtrace g_ftrace;
+static struct FtraceRing *g_ftracebuf;
 
 __funline int GetNestingLevelImpl(struct StackFrame *frame) {
   int nesting = -2;
@@ -65,6 +78,105 @@ __funline int GetNestingLevel(struct CosmoFtrace *ft, struct StackFrame *sf) {
   return MIN(MAX_NESTING, nesting);
 }
 
+/**
+ * Writes to `ftrace.out` without calling any functions that'd be traced.
+ */
+privileged void __ftrace_write(const void *p, size_t n) {
+#ifdef __x86_64__
+  uint32_t wrote;
+  long rax, rdi, rsi, rdx;
+  if (IsWindows()) {
+    __imp_WriteFile(__ftrace_handle, p, n, &wrote, 0);
+  } else if (!IsMetal()) {
+    asm volatile("syscall"
+                 : "=a"(rax), "=D"(rdi), "=S"(rsi), "=d"(rdx)
+                 : "0"(__NR_write), "1"(__ftrace_handle), "2"(p), "3"(n)
+                 : "rcx", "r8", "r9", "r10", "r11", "memory", "cc");
+  }
+#elif defined(__aarch64__)
+  register long r0 asm("x0") = __ftrace_handle;
+  register long r1 asm("x1") = (long)p;
+  register long r2 asm("x2") = (long)n;
+  register long r8 asm("x8") = (long)__NR_write;
+  register long r16 asm("x16") = (long)__NR_write;
+  register long res_x0 asm("x0");
+  asm volatile("svc\t0"
+               : "=r"(res_x0)
+               : "r"(r0), "r"(r1), "r"(r2), "r"(r8), "r"(r16)
+               : "memory");
+#else
+#error "unsupported architecture"
+#endif
+}
+
+/**
+ * Writes records that have been added to ring.
+ *
+ * This is called by the thread that owns the ring once it's halfway
+ * full, so that the cost of the system call is shared by thousands of
+ * function calls. Since the ring is drained while its owner continues
+ * to add records, it's only necessary to take turns with other drains.
+ */
+privileged void __ftrace_drain(struct FtraceRing *r) {
+  uint32_t head, tail, i, n;
+  if (atomic_exchange_explicit(&r->draining, 1, memory_order_acquire)) {
+    return;
+  }
+  head = atomic_load_explicit(&r->head, memory_order_acquire);
+  tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  while (tail != head) {
+    i = tail & (kFtraceRingSize - 1);
+    n = MIN(head - tail, kFtraceRingSize - i);
+    __ftrace_write(r->p + i, n * sizeof(*r->p));
+    tail += n;
+  }
+  atomic_store_explicit(&r->tail, tail, memory_order_release);
+  atomic_store_explicit(&r->draining, 0, memory_order_release);
+}
+
+privileged static struct FtraceRing *ClaimFtraceRing(int tid) {
+  int i, owner;
+  struct FtraceRing *r;
+  for (i = 0; i < kFtraceRings; ++i) {
+    r = __ftrace_rings + i;
+    owner = 0;
+    if (atomic_compare_exchange_strong_explicit(&r->owner, &owner, tid,
+                                                memory_order_acquire,
+                                                memory_order_relaxed)) {
+      r->pid = __pid;
+      return r;
+    }
+  }
+  return FTRACE_DEAD;
+}
+
+privileged static void RecordFtrace(struct FtraceRing **slot, int tid,
+                                    uintptr_t fn, int depth) {
+  uint32_t head, tail;
+  struct FtraceRing *r;
+  struct FtraceRecord *rec;
+  if (!(r = *slot)) *slot = r = ClaimFtraceRing(tid);
+  if (r == FTRACE_DEAD) return;
+  head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  if (UNLIKELY(r->pid != __pid)) {
+    // we're a forked child and the parent will write these
+    atomic_store_explicit(&r->tail, head, memory_order_relaxed);
+    r->pid = __pid;
+  }
+  tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+  if (head - tail == kFtraceRingSize) return;  // drain is behind
+  rec = r->p + (head & (kFtraceRingSize - 1));
+  rec->tsc = rdtsc();
+  rec->addr = fn;
+  rec->tid = tid;
+  rec->depth = depth;
+  rec->kind = kFtraceCall;
+  atomic_store_explicit(&r->head, ++head, memory_order_release);
+  if (head - tail >= kFtraceRingSize / 2) {
+    __ftrace_drain(r);
+  }
+}
+
 /**
  * Prints name of function being called.
  *
@@ -75,9 +187,11 @@ __funline int GetNestingLevel(struct CosmoFtrace *ft, struct StackFrame *sf) {
  * @see ftrace_install()
  */
 privileged void ftracer(void) {
+  int tid;
   uintptr_t fn;
   long stackuse;
   struct CosmoTib *tib;
+  struct FtraceRing **buf;
   struct StackFrame *sf;
   struct CosmoFtrace *ft;
   if (__ftrace <= 0) return;
@@ -85,8 +199,12 @@ privileged void ftracer(void) {
     tib = __get_tls_privileged();
     if (tib->tib_ftrace <= 0) return;
     ft = &tib->tib_ftracer;
+    buf = (struct FtraceRing **)&tib->tib_ftracebuf;
+    tid = tib->tib_tid;
   } else {
     ft = &g_ftrace;
+    buf = &g_ftracebuf;
+    tid = __pid;
   }
   if (_cmpxchg(&ft->ft_once, false, true)) {
     ft->ft_lastaddr = -1;
@@ -96,7 +214,9 @@ privileged void ftracer(void) {
     sf = __builtin_frame_address(0);
     sf = sf->next;
     fn = sf->addr + DETOUR_SKEW;
-    if (fn != ft->ft_lastaddr) {
+    if (__ftrace_rings) {
+      RecordFtrace(buf, tid, fn, GetNestingLevel(ft, sf));
+    } else if (fn != ft->ft_lastaddr) {
       stackuse = GetStackAddr() + GetStackSize() - (intptr_t)sf;
       kprintf("%rFUN %6P %'13T %'*ld %*s%t\n", ftrace_stackdigs, stackuse,
               GetNestingLevel(ft, sf) * 2, "", fn);
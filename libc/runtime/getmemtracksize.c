@@ -19,8 +19,9 @@
 #include "libc/runtime/memtrack.internal.h"
 
 dontasan size_t __get_memtrack_size(struct MemoryIntervals *mm) {
-  size_t i, n;
-  for (n = i = 0; i < mm->i; ++i) {
+  int i;
+  size_t n;
+  for (n = 0, i = __first_memory(mm); i != -1; i = mm->p[i].next) {
     n += ((size_t)(mm->p[i].y - mm->p[i].x) + 1) << 16;
   }
   return n;
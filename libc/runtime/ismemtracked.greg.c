@@ -19,14 +19,15 @@
 #include "libc/runtime/memtrack.internal.h"
 
 static inline bool IsMemtrackedImpl(int x, int y) {
-  unsigned i;
+  int i, j;
   i = __find_memory(&_mmi, x);
-  if (i == _mmi.i) return false;
+  if (i == -1) return false;
   if (x < _mmi.p[i].x) return false;
   for (;;) {
     if (y <= _mmi.p[i].y) return true;
-    if (++i == _mmi.i) return false;
-    if (_mmi.p[i].x != _mmi.p[i - 1].y + 1) return false;
+    if ((j = _mmi.p[i].next) == -1) return false;
+    if (_mmi.p[j].x != _mmi.p[i].y + 1) return false;
+    i = j;
   }
 }
 
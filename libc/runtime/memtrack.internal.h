@@ -36,12 +36,27 @@ struct MemoryInterval {
   char prot;
   bool iscow;
   bool readonlyfile;
+  int prev;         /* index of previous interval by address, or -1 */
+  int next;         /* index of next interval by address, or -1 */
+  int left;         /* treap children, or -1 */
+  int right;        /* treap children, or -1 */
+  unsigned hole;    /* frames between prev interval and this one */
+  unsigned maxhole; /* greatest hole in this subtree */
 };
 
+/*
+ * Intervals live in slots of p[0..u), which are linked in address
+ * order and indexed by a treap keyed on x, so lookups and updates
+ * take logarithmic time. Links are indices rather than pointers so
+ * p may be moved or copied. Slots are never compacted; of the u in
+ * use, i hold live intervals and the rest are on the free list.
+ */
 struct MemoryIntervals {
   size_t i, n;
   struct MemoryInterval *p;
   struct MemoryInterval s[OPEN_MAX];
+  size_t u;
+  int root, head, tail, free;
 };
 
 extern struct MemoryIntervals _mmi;
@@ -52,7 +67,8 @@ void __mmi_unlock(void);
 void __mmi_funlock(void);
 bool IsMemtracked(int, int);
 void PrintSystemMappings(int);
-unsigned __find_memory(const struct MemoryIntervals *, int) nosideeffect;
+int __find_memory(const struct MemoryIntervals *, int) nosideeffect;
+int __find_hole(const struct MemoryIntervals *, int, int, int, int *);
 bool __check_memtrack(const struct MemoryIntervals *) nosideeffect;
 void PrintMemoryIntervals(int, const struct MemoryIntervals *);
 int __track_memory(struct MemoryIntervals *, int, int, long, int, int, bool,
@@ -60,6 +76,7 @@ int __track_memory(struct MemoryIntervals *, int, int, long, int, int, bool,
 int __untrack_memory(struct MemoryIntervals *, int, int,
                      void (*)(struct MemoryIntervals *, int, int));
 void __release_memory_nt(struct MemoryIntervals *, int, int);
+void __relink_memory(struct MemoryIntervals *);
 int __untrack_memories(void *, size_t);
 size_t __get_memtrack_size(struct MemoryIntervals *);
 
@@ -71,6 +88,14 @@ size_t __get_memtrack_size(struct MemoryIntervals *);
 #define __mmi_unlock() (__threaded ? __mmi_unlock() : 0)
 #endif
 
+forceinline int __first_memory(const struct MemoryIntervals *mm) {
+  return mm->i ? mm->head : -1;
+}
+
+forceinline int __last_memory(const struct MemoryIntervals *mm) {
+  return mm->i ? mm->tail : -1;
+}
+
 #ifdef __x86_64__
 /*
  * AMD64 has 48-bit signed pointers (PML4T)
@@ -32,8 +32,9 @@ static inline dontasan void *GetFrameAddr(int f) {
 
 dontasan void __release_memory_nt(struct MemoryIntervals *mm, int l, int r) {
   int i;
-  for (i = l; i <= r; ++i) {
+  for (i = l;; i = mm->p[i].next) {
     UnmapViewOfFile(GetFrameAddr(mm->p[i].x));
     CloseHandle(mm->p[i].h);
+    if (i == r) break;
   }
 }
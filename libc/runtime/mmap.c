@@ -83,7 +83,7 @@ static dontasan inline bool __overlaps_existing_mapping(char *p, size_t n) {
   a = FRAME(p);
   b = FRAME(p + (n - 1));
   i = __find_memory(&_mmi, a);
-  if (i < _mmi.i) {
+  if (i != -1) {
     if (a <= _mmi.p[i].x && _mmi.p[i].x <= b) return true;
     if (a <= _mmi.p[i].y && _mmi.p[i].y <= b) return true;
     if (_mmi.p[i].x <= a && b <= _mmi.p[i].y) return true;
@@ -92,14 +92,13 @@ static dontasan inline bool __overlaps_existing_mapping(char *p, size_t n) {
 }
 
 static dontasan bool __choose_memory(int x, int n, int align, int *res) {
-  // TODO: improve performance
   int i, start, end;
   unassert(align > 0);
   if (_mmi.i) {
 
     // find the start of the automap memory region
     i = __find_memory(&_mmi, x);
-    if (i < _mmi.i) {
+    if (i != -1) {
 
       // check to see if there's space available before the first entry
       if (!ckd_add(&start, x, align - 1)) {
@@ -113,22 +112,14 @@ static dontasan bool __choose_memory(int x, int n, int align, int *res) {
       }
 
       // check to see if there's space available between two entries
-      while (++i < _mmi.i) {
-        if (!ckd_add(&start, _mmi.p[i - 1].y, 1) &&
-            !ckd_add(&start, start, align - 1)) {
-          start &= -align;
-          if (!ckd_add(&end, start, n - 1)) {
-            if (end < _mmi.p[i].x) {
-              *res = start;
-              return true;
-            }
-          }
-        }
+      if (__find_hole(&_mmi, i, n, align, res) != -1) {
+        return true;
       }
     }
 
     // otherwise append after the last entry if space is available
-    if (!ckd_add(&start, _mmi.p[i - 1].y, 1) &&
+    i = __last_memory(&_mmi);
+    if (!ckd_add(&start, _mmi.p[i].y, 1) &&
         !ckd_add(&start, start, align - 1)) {
       start &= -align;
       if (!ckd_add(&end, start, n - 1)) {
@@ -23,14 +23,15 @@
 
 textwindows int sys_mprotect_nt(void *addr, size_t size, int prot) {
   int rc = 0;
-  unsigned i;
+  int i;
   uint32_t op;
   char *a, *b, *x, *y, *p;
   __mmi_lock();
   size = (size + 4095) & -4096;
   p = addr;
   i = __find_memory(&_mmi, (intptr_t)p >> 16);
-  if (i == _mmi.i || (!i && p + size <= (char *)ADDR_32_TO_48(_mmi.p[0].x))) {
+  if (i == -1 || (i == __first_memory(&_mmi) &&
+                  p + size <= (char *)ADDR_32_TO_48(_mmi.p[i].x))) {
     // memory isn't in memtrack
     // let's just trust the user then
     // it's probably part of the executable
@@ -40,7 +41,7 @@ textwindows int sys_mprotect_nt(void *addr, size_t size, int prot) {
   } else {
     // memory is in memtrack, so use memtrack, to do dimensioning
     // we unfortunately must do something similar to this for cow
-    for (; i < _mmi.i; ++i) {
+    for (; i != -1; i = _mmi.p[i].next) {
       x = (char *)ADDR_32_TO_48(_mmi.p[i].x);
       y = (char *)ADDR_32_TO_48(_mmi.p[i].y) + 65536;
       if ((x <= p && p < y) || (x < p + size && p + size <= y) ||
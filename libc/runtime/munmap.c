@@ -75,7 +75,7 @@ static dontasan void __munmap_impl(char *p, size_t n) {
   l = FRAME(p);
   r = FRAME(p + n - 1);
   i = __find_memory(&_mmi, l);
-  for (; i < _mmi.i && r >= _mmi.p[i].x; ++i) {
+  for (; i != -1 && r >= _mmi.p[i].x; i = _mmi.p[i].next) {
     if (l >= _mmi.p[i].x && r <= _mmi.p[i].y) {
 
       // it's contained within the entry
@@ -68,7 +68,9 @@ $(LIBC_RUNTIME_A).pkg:					\
 o/$(MODE)/libc/runtime/cosmo2.o: private		\
 		CFLAGS += -O0
 
-o/$(MODE)/libc/runtime/ftracer.o: private		\
+o/$(MODE)/libc/runtime/ftracer.o			\
+o/$(MODE)/libc/runtime/ftrace_binary.o			\
+o/$(MODE)/libc/runtime/ftrace_sample.o: private		\
 		CFLAGS +=				\
 			-x-no-pg			\
 			-ffreestanding			\
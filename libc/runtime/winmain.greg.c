@@ -176,7 +176,10 @@ __msabi static textwindows wontreturn void WinMainNew(const char16_t *cmdline) {
   _mmi.p[0].prot = prot;
   _mmi.p[0].flags = 0x00000026;  // stack+anonymous
   _mmi.p[0].size = stacksize;
-  _mmi.i = 1;
+  _mmi.p[0].prev = _mmi.p[0].next = -1;
+  _mmi.p[0].left = _mmi.p[0].right = -1;
+  _mmi.root = _mmi.head = _mmi.tail = 0;
+  _mmi.i = _mmi.u = 1;
   wa = (struct WinArgs *)(stackaddr + (stacksize - sizeof(struct WinArgs)));
   int count = GetDosArgv(cmdline, wa->argblock, ARRAYLEN(wa->argblock),
                          wa->argv, ARRAYLEN(wa->argv));
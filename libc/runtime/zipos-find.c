@@ -36,14 +36,29 @@ ssize_t __zipos_scan(struct Zipos *zipos, struct ZiposUri *name) {
     return ZIPOS_SYNTHETIC_DIRECTORY;
   }
 
+  // use prebuilt hash table to find exact matches
+  const uint8_t *cdir = zipos->map + zipos->cdiroff;
+  if (zipos->hash) {
+    uint32_t i, x;
+    for (i = __zipos_hash(name->path, len);; ++i) {
+      if (!(x = zipos->hash[i & zipos->hashmask])) {
+        break;  // might still be a directory
+      }
+      if (ZIP_CFILE_NAMESIZE(cdir + x - 1) == len &&
+          !memcmp(ZIP_CFILE_NAME(cdir + x - 1), name->path, len)) {
+        return zipos->cdiroff + x - 1;
+      }
+    }
+  }
+
   // binary search for leftmost name in central directory
   int l = 0;
   int r = zipos->records;
   while (l < r) {
     int m = (l & r) + ((l ^ r) >> 1);  // floor((a+b)/2)
-    const char *xp = ZIP_CFILE_NAME(zipos->map + zipos->index[m]);
+    const char *xp = ZIP_CFILE_NAME(cdir + zipos->index[m]);
     const char *yp = name->path;
-    int xn = ZIP_CFILE_NAMESIZE(zipos->map + zipos->index[m]);
+    int xn = ZIP_CFILE_NAMESIZE(cdir + zipos->index[m]);
     int yn = len;
     int n = MIN(xn, yn);
     int c;
@@ -63,7 +78,7 @@ ssize_t __zipos_scan(struct Zipos *zipos, struct ZiposUri *name) {
 
   // return pointer to leftmost record if it matches
   if (l < zipos->records) {
-    size_t cfile = zipos->index[l];
+    size_t cfile = zipos->cdiroff + zipos->index[l];
     const char *zname = ZIP_CFILE_NAME(zipos->map + cfile);
     int zsize = ZIP_CFILE_NAMESIZE(zipos->map + cfile);
     if ((len == zsize || (len + 1 == zsize && zname[len] == '/')) &&
@@ -73,33 +73,38 @@ static void __zipos_dismiss(uint8_t *map, const uint8_t *cdir, long pg) {
 }
 
 static int __zipos_compare_names(const void *a, const void *b, void *c) {
-  const size_t *x = (const size_t *)a;
-  const size_t *y = (const size_t *)b;
-  struct Zipos *z = (struct Zipos *)c;
-  int xn = ZIP_CFILE_NAMESIZE(z->map + *x);
-  int yn = ZIP_CFILE_NAMESIZE(z->map + *y);
+  const uint32_t *x = (const uint32_t *)a;
+  const uint32_t *y = (const uint32_t *)b;
+  const uint8_t *cdir = (const uint8_t *)c;
+  int xn = ZIP_CFILE_NAMESIZE(cdir + *x);
+  int yn = ZIP_CFILE_NAMESIZE(cdir + *y);
   int n = MIN(xn, yn);
   if (n) {
-    int res =
-        memcmp(ZIP_CFILE_NAME(z->map + *x), ZIP_CFILE_NAME(z->map + *y), n);
+    int res = memcmp(ZIP_CFILE_NAME(cdir + *x), ZIP_CFILE_NAME(cdir + *y), n);
     if (res) return res;
   }
   return xn - yn;  // xn and yn are 16-bit
 }
 
-// creates binary searchable array of file offsets to cdir records
-static void __zipos_generate_index(struct Zipos *zipos) {
+// creates binary searchable array of cdir offsets to cdir records
+static void __zipos_generate_index(struct Zipos *zipos, size_t mapsize) {
   size_t c, i;
+  uint32_t *index;
+  // use the presorted index zipcopy appended to the archive if it's
+  // still up to date, since sorting the names takes most of the time
+  // we'd otherwise spend initializing zipos on startup
+  if (__zipos_index(zipos, mapsize)) return;
+  zipos->cdiroff = GetZipCdirOffset(zipos->cdir);
   zipos->records = GetZipCdirRecords(zipos->cdir);
-  zipos->index = kmalloc(zipos->records * sizeof(size_t));
-  for (i = 0, c = GetZipCdirOffset(zipos->cdir); i < zipos->records;
-       ++i, c += ZIP_CFILE_HDRSIZE(zipos->map + c)) {
-    zipos->index[i] = c;
+  zipos->index = index = kmalloc(zipos->records * sizeof(uint32_t));
+  for (i = c = 0; i < zipos->records;
+       ++i, c += ZIP_CFILE_HDRSIZE(zipos->map + zipos->cdiroff + c)) {
+    index[i] = c;
   }
   // smoothsort() isn't the fastest algorithm, but it guarantees
   // o(logn), won't smash the stack and doesn't depend on malloc
-  smoothsort_r(zipos->index, zipos->records, sizeof(size_t),
-               __zipos_compare_names, zipos);
+  smoothsort_r(index, zipos->records, sizeof(uint32_t), __zipos_compare_names,
+               zipos->map + zipos->cdiroff);
 }
 
 static void __zipos_init(void) {
@@ -134,7 +139,7 @@ static void __zipos_init(void) {
             __zipos.cdir = cdir;
             __zipos.dev = st.st_ino;
             __zipos.pagesz = pagesz;
-            __zipos_generate_index(&__zipos);
+            __zipos_generate_index(&__zipos, st.st_size);
             msg = kZipOk;
           } else {
             munmap(map, st.st_size);
@@ -0,0 +1,87 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/intrin/bits.h"
+#include "libc/nexgen32e/crc32.h"
+#include "libc/runtime/zipos.internal.h"
+#include "libc/str/str.h"
+#include "libc/zip.internal.h"
+
+/**
+ * Hashes zip asset name for prebuilt index.
+ */
+uint32_t __zipos_hash(const void *data, size_t size) {
+  size_t i;
+  uint32_t h;
+  const unsigned char *p = data;
+  for (h = 2166136261, i = 0; i < size; ++i) {
+    h ^= p[i];
+    h *= 16777619;
+  }
+  return h;
+}
+
+/**
+ * Uses prebuilt index of central directory, if it's fresh.
+ *
+ * @param zipos must have its `map` and `cdir` fields set
+ * @param mapsize is the number of bytes mapped
+ * @return true if `zipos` now has a sorted index and hash table,
+ *     or false if the index is missing, corrupted, or out of date
+ */
+bool __zipos_index(struct Zipos *zipos, size_t mapsize) {
+  const uint8_t *cdir, *cf, *lf, *p;
+  uint64_t lfoff, size, cdiroff, cdirsize, idx, slots;
+  size_t n = sizeof(kZiposIndexName) - 1;
+  cdiroff = GetZipCdirOffset(zipos->cdir);
+  cdirsize = GetZipCdirSize(zipos->cdir);
+  if (cdiroff > mapsize || cdirsize > mapsize - cdiroff) return false;
+  if (cdirsize < kZipCfileHdrMinSize + n) return false;
+  cdir = zipos->map + cdiroff;
+  idx = cdirsize - (kZipCfileHdrMinSize + n);
+  cf = cdir + idx;
+  if (ZIP_CFILE_MAGIC(cf) != kZipCfileHdrMagic ||
+      ZIP_CFILE_HDRSIZE(cf) != kZipCfileHdrMinSize + n ||
+      memcmp(ZIP_CFILE_NAME(cf), kZiposIndexName, n) ||
+      ZIP_CFILE_COMPRESSIONMETHOD(cf) != kZipCompressionNone) {
+    return false;
+  }
+  lfoff = GetZipCfileOffset(cf);
+  size = GetZipCfileCompressedSize(cf);
+  if (lfoff > mapsize || mapsize - lfoff < kZipLfileHdrMinSize) return false;
+  lf = zipos->map + lfoff;
+  if (ZIP_LFILE_MAGIC(lf) != kZipLfileHdrMagic) return false;
+  if (ZIP_LFILE_HDRSIZE(lf) > mapsize - lfoff) return false;
+  if (size > mapsize - lfoff - ZIP_LFILE_HDRSIZE(lf)) return false;
+  p = ZIP_LFILE_CONTENT(lf);
+  if ((uintptr_t)p & 3) return false;
+  if (size < kZiposIndexHdrSize || ZIPOS_INDEX_MAGIC(p) != kZiposIndexMagic ||
+      ZIPOS_INDEX_SIZE(p) != size ||
+      ZIPOS_INDEX_RECORDS(p) != GetZipCdirRecords(zipos->cdir) ||
+      ZIPOS_INDEX_CDIRSIZE(p) != idx ||
+      (slots = ZIPOS_INDEX_SLOTS(p)) <= ZIPOS_INDEX_RECORDS(p) ||
+      (slots & (slots - 1)) || ZIPOS_INDEX_CDIRSUM(p) != crc32c(0, cdir, idx)) {
+    return false;
+  }
+  zipos->cdiroff = cdiroff;
+  zipos->records = ZIPOS_INDEX_RECORDS(p);
+  zipos->index = ZIPOS_INDEX_SORTED(p);
+  zipos->hash = ZIPOS_INDEX_HASH(p);
+  zipos->hashmask = slots - 1;
+  return true;
+}
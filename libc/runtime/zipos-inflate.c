@@ -0,0 +1,224 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/intrin/weaken.h"
+#include "libc/macros.internal.h"
+#include "libc/runtime/internal.h"
+#include "libc/runtime/zipos.internal.h"
+#include "libc/str/str.h"
+#include "libc/sysv/errfuns.h"
+#include "libc/thread/thread.h"
+#include "libc/zip.internal.h"
+#include "third_party/zlib/zlib.h"
+
+#define ZIPOS_INFLATE_CHUNK 65536
+#define ZIPOS_INFLATE_SPAN  65536
+#define ZIPOS_INFLATE_SAVES 64
+
+// deflated zipos file that's inflated on demand as it's being read.
+// the most recently inflated chunk is kept around. once the file has
+// been seeked backward, copies of the decompressor are saved at evenly
+// spaced points, so seeking backward again only needs to inflate from
+// the nearest checkpoint rather than from the beginning of the file
+struct ZiposInflate {
+  pthread_mutex_t lock;
+  const uint8_t *end;  // end of compressed content
+  size_t out;          // uncompressed offset of decompressor
+  size_t off;          // uncompressed offset of buf[0]
+  size_t len;          // number of valid bytes in buf
+  size_t span;         // distance between checkpoints
+  size_t saves;        // number of checkpoints
+  bool seeky;          // true if file has been rewound
+  z_stream zs;
+  struct ZiposCheckpoint {
+    size_t out;
+    z_stream zs;
+  } save[ZIPOS_INFLATE_SAVES];
+  uint8_t buf[ZIPOS_INFLATE_CHUNK];
+};
+
+static bool __zipos_can_inflate(void) {
+  return _weaken(inflateInit2) &&  //
+         _weaken(inflate) &&       //
+         _weaken(inflateCopy) &&   //
+         _weaken(inflateEnd) &&    //
+         __runlevel >= RUNLEVEL_MALLOC;
+}
+
+/**
+ * Returns number of bytes needed by __zipos_inflate_init().
+ *
+ * @return 0 if file should be inflated all at once by open()
+ */
+size_t __zipos_inflate_size(size_t size) {
+  if (size >= ZIPOS_INFLATE_SPAN && __zipos_can_inflate()) {
+    return sizeof(struct ZiposInflate);
+  } else {
+    return 0;
+  }
+}
+
+/**
+ * Prepares handle whose data is deflated content for lazy inflation.
+ *
+ * @param h is handle with __zipos_inflate_size() bytes of data
+ * @param lf is local file header of deflated zip asset
+ * @return 0 on success, or -1 w/ errno
+ */
+int __zipos_inflate_init(struct ZiposHandle *h, const uint8_t *lf) {
+  struct ZiposInflate *z = (struct ZiposInflate *)h->data;
+  bzero(z, offsetof(struct ZiposInflate, buf));
+  z->zs.next_in = ZIP_LFILE_CONTENT(lf);
+  z->end = z->zs.next_in + GetZipLfileCompressedSize(lf);
+  z->span = MAX(ZIPOS_INFLATE_SPAN,
+                GetZipLfileUncompressedSize(lf) / ZIPOS_INFLATE_SAVES + 1);
+  if (_weaken(inflateInit2)(&z->zs, -MAX_WBITS) != Z_OK) {
+    return enomem();
+  }
+  if (_weaken(inflateCopy)(&z->save[0].zs, &z->zs) != Z_OK) {
+    _weaken(inflateEnd)(&z->zs);
+    return enomem();
+  }
+  z->saves = 1;
+  pthread_mutex_init(&z->lock, 0);
+  h->inflater = z;
+  return 0;
+}
+
+/**
+ * Releases decompressor memory of lazily inflated handle.
+ *
+ * This is deferred until the handle is reused, because it calls free()
+ * and close() needs to be async signal safe.
+ */
+void __zipos_inflate_free(struct ZiposHandle *h) {
+  size_t i;
+  struct ZiposInflate *z = h->inflater;
+  for (i = 0; i < z->saves; ++i) {
+    _weaken(inflateEnd)(&z->save[i].zs);
+  }
+  _weaken(inflateEnd)(&z->zs);
+  pthread_mutex_destroy(&z->lock);
+  h->inflater = 0;
+}
+
+// rewinds decompressor to the last checkpoint at or before off
+static int __zipos_inflate_rewind(struct ZiposInflate *z, size_t off) {
+  size_t i;
+  z->seeky = true;
+  for (i = z->saves; i--;) {
+    if (z->save[i].out <= off) {
+      _weaken(inflateEnd)(&z->zs);
+      if (_weaken(inflateCopy)(&z->zs, &z->save[i].zs) != Z_OK) {
+        bzero(&z->zs, sizeof(z->zs));
+        return enomem();
+      }
+      z->out = z->save[i].out;
+      z->off = z->out;
+      z->len = 0;
+      return 0;
+    }
+  }
+  return eio();
+}
+
+// saves decompressor if it's reached the next checkpoint, and returns
+// how much output may be produced before the following checkpoint
+static size_t __zipos_inflate_save(struct ZiposInflate *z) {
+  if (!z->seeky) {
+    return -1;
+  }
+  if (z->saves < ZIPOS_INFLATE_SAVES && z->out >= z->saves * z->span) {
+    if (_weaken(inflateCopy)(&z->save[z->saves].zs, &z->zs) == Z_OK) {
+      z->save[z->saves].out = z->out;
+    } else {
+      z->save[z->saves].out = -1;  // can't rewind here
+    }
+    ++z->saves;
+  }
+  if (z->saves < ZIPOS_INFLATE_SAVES) {
+    return z->saves * z->span - z->out;
+  } else {
+    return -1;
+  }
+}
+
+// inflates up to n bytes to p, and keeps the tail of it in buf
+static ssize_t __zipos_inflate_some(struct ZiposInflate *z, uint8_t *p,
+                                   size_t n) {
+  int rc;
+  size_t m;
+  n = MIN(n, __zipos_inflate_save(z));
+  if (!z->zs.avail_in) {
+    z->zs.avail_in = MIN(z->end - z->zs.next_in, 0x7ffff000);
+  }
+  z->zs.next_out = p;
+  z->zs.avail_out = MIN(n, 0x7ffff000);
+  rc = _weaken(inflate)(&z->zs, Z_NO_FLUSH);
+  m = z->zs.next_out - p;
+  if ((rc != Z_OK && rc != Z_STREAM_END) || !m) {
+    return eio();
+  }
+  z->len = MIN(m, ZIPOS_INFLATE_CHUNK);
+  z->off = z->out + m - z->len;
+  z->out += m;
+  if (p != z->buf) {
+    memcpy(z->buf, p + m - z->len, z->len);
+  }
+  return m;
+}
+
+static ssize_t __zipos_inflate_impl(struct ZiposInflate *z, uint8_t *p,
+                                    size_t n, size_t off) {
+  size_t i;
+  ssize_t m;
+  for (i = 0; i < n; i += m, off += m) {
+    if (off < z->off) {
+      if (__zipos_inflate_rewind(z, off) == -1) break;
+    }
+    if (off < z->off + z->len) {
+      m = MIN(n - i, z->off + z->len - off);
+      memcpy(p + i, z->buf + (off - z->off), m);
+    } else if (off == z->out && n - i >= ZIPOS_INFLATE_CHUNK) {
+      // big reads are inflated directly into the caller's memory
+      if ((m = __zipos_inflate_some(z, p + i, n - i)) == -1) break;
+    } else {
+      if (__zipos_inflate_some(z, z->buf, ZIPOS_INFLATE_CHUNK) == -1) break;
+      m = 0;
+    }
+  }
+  return i ? i : (ssize_t)-1;
+}
+
+/**
+ * Reads data from lazily inflated handle.
+ *
+ * The caller is responsible for ensuring `off + n` isn't past the end
+ * of the uncompressed file.
+ *
+ * @return bytes read, or -1 w/ errno
+ */
+ssize_t __zipos_inflate(struct ZiposHandle *h, void *p, size_t n,
+                        size_t off) {
+  ssize_t rc;
+  struct ZiposInflate *z = h->inflater;
+  pthread_mutex_lock(&z->lock);
+  rc = __zipos_inflate_impl(z, p, n, off);
+  pthread_mutex_unlock(&z->lock);
+  return rc;
+}
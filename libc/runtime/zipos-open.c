@@ -81,6 +81,9 @@ static void *__zipos_mmap_space(size_t mapsize) {
   return start + offset;
 }
 
+// the decompressor of a lazily inflated handle isn't released here,
+// since inflateEnd() calls free() and close() is async signal safe.
+// instead it's released by __zipos_alloc() when the handle is reused
 void __zipos_free(struct ZiposHandle *h) {
   if (IsAsan()) {
     __asan_poison((char *)h + sizeof(struct ZiposHandle),
@@ -112,6 +115,12 @@ StartOver:
     h = __zipos_mmap_space(mapsize);
   }
   __zipos_unlock();
+  if (h && h->inflater) {
+    if (IsAsan()) {
+      __asan_unpoison((char *)h, h->mapsize);
+    }
+    __zipos_inflate_free(h);
+  }
   if (IsAsan()) {
     __asan_unpoison((char *)h, sizeof(struct ZiposHandle) + size);
     __asan_poison((char *)h + sizeof(struct ZiposHandle) + size,
@@ -122,6 +131,7 @@ StartOver:
     h->size = size;
     h->zipos = zipos;
     h->mapsize = mapsize;
+    h->inflater = 0;
   }
   return h;
 }
@@ -154,6 +164,7 @@ static int __zipos_load(struct Zipos *zipos, size_t cf, int flags,
                         struct ZiposUri *name) {
   size_t lf;
   size_t size;
+  size_t lazy;
   int fd, minfd;
   struct ZiposHandle *h;
   if (cf == ZIPOS_SYNTHETIC_DIRECTORY) {
@@ -172,6 +183,16 @@ static int __zipos_load(struct Zipos *zipos, size_t cf, int flags,
         h->mem = ZIP_LFILE_CONTENT(zipos->map + lf);
         break;
       case kZipCompressionDeflate:
+        if ((lazy = __zipos_inflate_size(size))) {
+          // big files are inflated incrementally as they're read
+          if (!(h = __zipos_alloc(zipos, lazy))) return -1;
+          h->mem = 0;
+          if (__zipos_inflate_init(h, zipos->map + lf) == -1) {
+            __zipos_free(h);
+            return -1;
+          }
+          break;
+        }
         if (!(h = __zipos_alloc(zipos, size))) return -1;
         if (!__inflate(h->data, size, ZIP_LFILE_CONTENT(zipos->map + lf),
                        GetZipLfileCompressedSize(zipos->map + lf))) {
@@ -188,7 +209,7 @@ static int __zipos_load(struct Zipos *zipos, size_t cf, int flags,
   h->pos = 0;
   h->cfile = cf;
   h->size = size;
-  if (h->mem) {
+  if (h->mem || h->inflater) {
     minfd = 3;
     __fds_lock();
   TryAgain:
@@ -39,7 +39,13 @@ static ssize_t __zipos_read_impl(struct ZiposHandle *h, const struct iovec *iov,
   }
   for (i = 0; i < iovlen && y < h->size; ++i, y += b) {
     b = MIN(iov[i].iov_len, h->size - y);
-    if (b) memcpy(iov[i].iov_base, h->mem + y, b);
+    if (!b) continue;
+    if (h->mem) {
+      memcpy(iov[i].iov_base, h->mem + y, b);
+    } else if ((b = __zipos_inflate(h, iov[i].iov_base, b, y)) == -1) {
+      if (y == x) return -1;
+      break;
+    }
   }
   if (opt_offset == -1) {
     h->pos = y;
@@ -7,9 +7,42 @@ COSMOPOLITAN_C_START_
 
 #define ZIPOS_SYNTHETIC_DIRECTORY 0
 
+/**
+ * @fileoverview Prebuilt index of zip central directory.
+ *
+ * zipcopy appends a file named `.zipos` as the last record of the
+ * central directory, so __zipos_get() can map the names presorted
+ * rather than sorting them on startup. It's stored uncompressed and
+ * its cdir record has no extra field or comment, so it can be found
+ * in constant time. The records preceding it are checksummed, which
+ * means the index is ignored once the archive changes.
+ *
+ * The header is followed by the cdir offsets of every record sorted
+ * by name, and then an open addressing hash table, whose slots hold
+ * one plus the cdir offset of the leftmost record with a given name,
+ * or zero if empty. All integers are little endian, and the content
+ * is aligned on a four byte boundary so it may be used in place.
+ */
+
+#define kZiposIndexName    ".zipos"
+#define kZiposIndexMagic   0x736f707a /* "zpos" */
+#define kZiposIndexHdrSize 24
+
+#define ZIPOS_INDEX_MAGIC(P)    READ32LE(P)
+#define ZIPOS_INDEX_RECORDS(P)  READ32LE((P) + 4)  /* including itself */
+#define ZIPOS_INDEX_CDIRSIZE(P) READ32LE((P) + 8)  /* bytes of cdir indexed */
+#define ZIPOS_INDEX_CDIRSUM(P)  READ32LE((P) + 12) /* crc32c of cdir prefix */
+#define ZIPOS_INDEX_SLOTS(P)    READ32LE((P) + 16) /* two power hash table */
+#define ZIPOS_INDEX_SORTED(P)   ((const uint32_t *)((P) + kZiposIndexHdrSize))
+#define ZIPOS_INDEX_HASH(P)     (ZIPOS_INDEX_SORTED(P) + ZIPOS_INDEX_RECORDS(P))
+#define ZIPOS_INDEX_SIZE(P) \
+  (kZiposIndexHdrSize +     \
+   ((uint64_t)ZIPOS_INDEX_RECORDS(P) + ZIPOS_INDEX_SLOTS(P)) * 4)
+
 struct stat;
 struct iovec;
 struct Zipos;
+struct ZiposInflate;
 
 struct ZiposUri {
   uint32_t len;
@@ -24,6 +57,7 @@ struct ZiposHandle {
   size_t pos;
   size_t cfile;
   uint8_t *mem;
+  struct ZiposInflate *inflater;
   uint8_t data[];
 };
 
@@ -32,7 +66,10 @@ struct Zipos {
   uint8_t *map;
   uint8_t *cdir;
   uint64_t dev;
-  size_t *index;
+  size_t cdiroff;          /* map offset of first cdir record */
+  const uint32_t *index;   /* cdir offsets of records sorted by name */
+  const uint32_t *hash;    /* prebuilt hash table of names, if any */
+  uint32_t hashmask;
   size_t records;
   struct ZiposHandle *freelist;
 };
@@ -43,6 +80,8 @@ struct Zipos *__zipos_get(void) pureconst;
 size_t __zipos_normpath(char *, const char *, size_t);
 ssize_t __zipos_find(struct Zipos *, struct ZiposUri *);
 ssize_t __zipos_scan(struct Zipos *, struct ZiposUri *);
+uint32_t __zipos_hash(const void *, size_t);
+bool __zipos_index(struct Zipos *, size_t);
 ssize_t __zipos_parseuri(const char *, struct ZiposUri *);
 uint64_t __zipos_inode(struct Zipos *, int64_t, const void *, size_t);
 int __zipos_open(struct ZiposUri *, int);
@@ -55,6 +94,10 @@ ssize_t __zipos_read(struct ZiposHandle *, const struct iovec *, size_t,
 int64_t __zipos_seek(struct ZiposHandle *, int64_t, unsigned);
 int __zipos_fcntl(int, int, uintptr_t);
 int __zipos_notat(int, const char *);
+size_t __zipos_inflate_size(size_t);
+int __zipos_inflate_init(struct ZiposHandle *, const uint8_t *);
+ssize_t __zipos_inflate(struct ZiposHandle *, void *, size_t, size_t);
+void __zipos_inflate_free(struct ZiposHandle *);
 void *__zipos_mmap(void *, uint64_t, int32_t, int32_t, struct ZiposHandle *,
                    int64_t) dontasan;
 
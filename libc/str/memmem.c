@@ -19,9 +19,46 @@
 #include "libc/dce.h"
 #include "libc/intrin/asan.internal.h"
 #include "libc/intrin/likely.h"
+#include "libc/nexgen32e/x86feature.h"
 #include "libc/str/str.h"
 
 typedef char xmm_t __attribute__((__vector_size__(16), __aligned__(16)));
+typedef char ymm_t __attribute__((__vector_size__(32), __aligned__(32)));
+
+#if defined(__x86_64__) && !defined(__chibicc__)
+dontasan static __attribute__((__target__("avx2"))) void *memmem_avx2(
+    const char *p, const char *e, const char *q, size_t needlelen) {
+  char c;
+  ymm_t n;
+  const ymm_t *v;
+  unsigned i, k, m;
+  c = *q;
+  n = (ymm_t){c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c,
+              c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c};
+  k = (uintptr_t)p & 31;
+  v = (const ymm_t *)((uintptr_t)p & -32);
+  m = __builtin_ia32_pmovmskb256(*v == n);
+  m >>= k;
+  m <<= k;
+  for (;;) {
+    while (!m) {
+      ++v;
+      if ((const char *)v >= e) return 0;
+      m = __builtin_ia32_pmovmskb256(*v == n);
+    }
+    do {
+      k = __builtin_ctzl(m);
+      p = (const char *)v + k;
+      if (UNLIKELY(p + needlelen > e)) return 0;
+      for (i = 1;; ++i) {
+        if (i == needlelen) return (/*unconst*/ char *)p;
+        if (p[i] != q[i]) break;
+      }
+      m &= ~(1u << k);
+    } while (m);
+  }
+}
+#endif
 
 /**
  * Searches for fixed-length substring in memory region.
@@ -44,6 +81,10 @@ dontasan void *memmem(const void *haystack, size_t haystacklen,
   if (IsAsan()) __asan_verify(haystack, haystacklen);
   if (!needlelen) return (void *)haystack;
   if (UNLIKELY(needlelen > haystacklen)) return 0;
+  if (X86_HAVE(AVX2)) {
+    return memmem_avx2(haystack, (const char *)haystack + haystacklen, needle,
+                       needlelen);
+  }
   q = needle;
   c = *q;
   n = (xmm_t){c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c};
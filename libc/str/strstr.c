@@ -19,8 +19,43 @@
 #include "libc/str/str.h"
 #include "libc/dce.h"
 #include "libc/intrin/asan.internal.h"
+#include "libc/nexgen32e/x86feature.h"
 
 typedef char xmm_t __attribute__((__vector_size__(16), __aligned__(16)));
+typedef char ymm_t __attribute__((__vector_size__(32), __aligned__(32)));
+
+#if defined(__x86_64__) && !defined(__chibicc__)
+dontasan static __attribute__((__target__("avx2"))) char *strstr_avx2(
+    const char *haystack, const char *needle) {
+  size_t i;
+  unsigned k, m;
+  const ymm_t *p;
+  ymm_t v, n, z = {0};
+  char c = *needle;
+  n = (ymm_t){c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c,
+              c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c};
+  for (;;) {
+    k = (uintptr_t)haystack & 31;
+    p = (const ymm_t *)((uintptr_t)haystack & -32);
+    v = *p;
+    m = __builtin_ia32_pmovmskb256((v == z) | (v == n));
+    m >>= k;
+    m <<= k;
+    while (!m) {
+      v = *++p;
+      m = __builtin_ia32_pmovmskb256((v == z) | (v == n));
+    }
+    haystack = (const char *)p + __builtin_ctzl(m);
+    for (i = 0;; ++i) {
+      if (!needle[i]) return (/*unconst*/ char *)haystack;
+      if (!haystack[i]) break;
+      if (needle[i] != haystack[i]) break;
+    }
+    if (!*haystack++) break;
+  }
+  return 0;
+}
+#endif
 
 /**
  * Searches for substring.
@@ -44,6 +79,7 @@ dontasan char *strstr(const char *haystack, const char *needle) {
   if (IsAsan()) __asan_verify(needle, 1);
   if (IsAsan()) __asan_verify(haystack, 1);
   if (haystack == needle || !*needle) return (char *)haystack;
+  if (X86_HAVE(AVX2)) return strstr_avx2(haystack, needle);
   n = (xmm_t){*needle, *needle, *needle, *needle, *needle, *needle,
               *needle, *needle, *needle, *needle, *needle, *needle,
               *needle, *needle, *needle, *needle};
@@ -36,9 +36,9 @@
 #include "third_party/dlmalloc/dlmalloc.h"
 
 static dontasan dontubsan relegated uint64_t CountMappedBytes(void) {
-  size_t i;
+  int i;
   uint64_t x, y;
-  for (x = i = 0; i < _mmi.i; ++i) {
+  for (x = 0, i = __first_memory(&_mmi); i != -1; i = _mmi.p[i].next) {
     y = _mmi.p[i].y - _mmi.p[i].x;
     x += (y + 1) << 16;
   }
@@ -50,14 +50,14 @@ static char *_mktls_finish(struct CosmoTib **out_tib, char *mem,
   return mem;
 }
 
-static char *_mktls_below(struct CosmoTib **out_tib) {
+static char *_mktls_below(char *mem, struct CosmoTib **out_tib) {
   size_t siz;
-  char *mem, *tls;
+  char *tls;
   struct CosmoTib *tib;
 
   siz = ROUNDUP(I(_tls_size) + sizeof(*tib), _Alignof(struct CosmoTib));
   siz = ROUNDUP(siz, _Alignof(struct CosmoTib));
-  mem = memalign(_Alignof(struct CosmoTib), siz);
+  if (!mem && !(mem = memalign(_Alignof(struct CosmoTib), siz))) return 0;
 
   if (IsAsan()) {
     // poison the space between .tdata and .tbss
@@ -84,16 +84,15 @@ static char *_mktls_below(struct CosmoTib **out_tib) {
   return _mktls_finish(out_tib, mem, tib);
 }
 
-static char *_mktls_above(struct CosmoTib **out_tib) {
+static char *_mktls_above(char *mem, struct CosmoTib **out_tib) {
   size_t hiz, siz;
   struct CosmoTib *tib;
-  char *mem, *dtv, *tls;
+  char *dtv, *tls;
 
   // allocate memory for tdata, tbss, and tib
   hiz = ROUNDUP(sizeof(*tib) + 2 * sizeof(void *), I(_tls_align));
   siz = hiz + I(_tls_size);
-  mem = memalign(TLS_ALIGNMENT, siz);
-  if (!mem) return 0;
+  if (!mem && !(mem = memalign(TLS_ALIGNMENT, siz))) return 0;
 
   // poison memory between tdata and tbss
   if (IsAsan()) {
@@ -132,10 +131,20 @@ static char *_mktls_above(struct CosmoTib **out_tib) {
  * @return buffer that must be released with free()
  */
 char *_mktls(struct CosmoTib **out_tib) {
+  return _mktls_reuse(0, out_tib);
+}
+
+/**
+ * Reinitializes thread-local storage memory for a new thread.
+ * @param mem was returned by _mktls() for a thread that has exited,
+ *     or may be null to allocate new memory
+ * @return `mem`, or new buffer that must be released with free()
+ */
+char *_mktls_reuse(char *mem, struct CosmoTib **out_tib) {
   __require_tls();
 #ifdef __x86_64__
-  return _mktls_below(out_tib);
+  return _mktls_below(mem, out_tib);
 #else
-  return _mktls_above(out_tib);
+  return _mktls_above(mem, out_tib);
 #endif
 }
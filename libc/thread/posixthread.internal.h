@@ -94,6 +94,8 @@ int _pthread_reschedule(struct PosixThread *);
 int _pthread_setschedparam_freebsd(int, int, const struct sched_param *);
 void _pthread_zombify(struct PosixThread *);
 void _pthread_free(struct PosixThread *);
+void _pthread_decimate(void);
+void _pthread_trim_stacks(void);
 void _pthread_onfork_prepare(void);
 void _pthread_onfork_parent(void);
 void _pthread_onfork_child(void);
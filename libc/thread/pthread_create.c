@@ -53,17 +53,113 @@ __static_yoink("_pthread_atfork");
 #define MAP_ANON_OPENBSD  0x1000
 #define MAP_STACK_OPENBSD 0x4000
 
+#define STACK_CACHE_SLOTS 16
+#define STACK_CACHE_BYTES (32 * 1024 * 1024)
+
+// stacks and tls memory of threads that have exited, which are kept
+// around so creating threads doesn't need mmap() syscalls. it's LIFO
+// because the most recently used stack is most likely to be in cache
+static struct StackCache {
+  int n;
+  bool once;  // trimming at exit was registered
+  size_t bytes;
+  struct CachedStack {
+    char *addr;
+    size_t size;
+    size_t guard;
+    char *tls;
+  } p[STACK_CACHE_SLOTS];
+} _pthread_stacks;  // guarded by _pthread_lock
+
 static unsigned long roundup2pow(unsigned long x) {
   return x > 1 ? 2ul << _bsrl(x - 1) : x ? 1 : 0;
 }
 
+// gives stack and tls of exited thread to cache, if there's room
+static bool _pthread_stash(struct PosixThread *pt) {
+  bool ok = false, once = false;
+  struct StackCache *c = &_pthread_stacks;
+  if (!pt->tls) return false;
+  pthread_spin_lock(&_pthread_lock);
+  if (!c->once) {
+    once = c->once = true;
+  }
+  if (c->n < STACK_CACHE_SLOTS &&
+      c->bytes + pt->attr.__stacksize <= STACK_CACHE_BYTES) {
+    c->p[c->n].addr = pt->attr.__stackaddr;
+    c->p[c->n].size = pt->attr.__stacksize;
+    c->p[c->n].guard = pt->attr.__guardsize;
+    c->p[c->n].tls = pt->tls;
+    c->bytes += pt->attr.__stacksize;
+    c->n++;
+    ok = true;
+  }
+  pthread_spin_unlock(&_pthread_lock);
+  if (once) {
+    // release the cache at exit, so CheckForMemoryLeaks() won't
+    // mistake the tls memory of long gone threads for leaks
+    __cxa_atexit((void *)_pthread_trim_stacks, 0, 0);
+  }
+  return ok;
+}
+
+// takes stack and tls of same dimensions from cache, if possible
+static bool _pthread_unstash(struct PosixThread *pt) {
+  int i;
+  struct CachedStack cs;
+  struct StackCache *c = &_pthread_stacks;
+  pthread_spin_lock(&_pthread_lock);
+  for (i = c->n; i--;) {
+    if (c->p[i].size == pt->attr.__stacksize &&
+        c->p[i].guard == pt->attr.__guardsize) {
+      cs = c->p[i];
+      memmove(c->p + i, c->p + i + 1, (c->n - (i + 1)) * sizeof(*c->p));
+      c->bytes -= cs.size;
+      c->n--;
+      pthread_spin_unlock(&_pthread_lock);
+      pt->tls = _mktls_reuse(cs.tls, &pt->tib);
+      pt->attr.__stackaddr = cs.addr;
+      if (IsAsan()) {
+        __asan_unpoison(cs.addr + cs.guard, cs.size - cs.guard);
+      }
+      return true;
+    }
+  }
+  pthread_spin_unlock(&_pthread_lock);
+  return false;
+}
+
+/**
+ * Releases stacks that were cached for reuse by new threads.
+ */
+void _pthread_trim_stacks(void) {
+  struct CachedStack cs;
+  struct StackCache *c = &_pthread_stacks;
+  for (;;) {
+    pthread_spin_lock(&_pthread_lock);
+    if (!c->n) {
+      pthread_spin_unlock(&_pthread_lock);
+      break;
+    }
+    cs = c->p[--c->n];
+    c->bytes -= cs.size;
+    pthread_spin_unlock(&_pthread_lock);
+    free(cs.tls);
+    npassert(!munmap(cs.addr, cs.size));
+  }
+}
+
 void _pthread_free(struct PosixThread *pt) {
   if (pt->flags & PT_STATIC) return;
-  free(pt->tls);
   if ((pt->flags & PT_OWNSTACK) &&  //
       pt->attr.__stackaddr &&       //
       pt->attr.__stackaddr != MAP_FAILED) {
-    npassert(!munmap(pt->attr.__stackaddr, pt->attr.__stacksize));
+    if (!_pthread_stash(pt)) {
+      free(pt->tls);
+      npassert(!munmap(pt->attr.__stackaddr, pt->attr.__stacksize));
+    }
+  } else {
+    free(pt->tls);
   }
   if (pt->altstack) {
     free(pt->altstack);
@@ -165,13 +261,6 @@ static errno_t pthread_create_impl(pthread_t *thread,
   pt->start = start_routine;
   pt->arg = arg;
 
-  // create thread local storage memory
-  if (!(pt->tls = _mktls(&pt->tib))) {
-    free(pt);
-    errno = e;
-    return EAGAIN;
-  }
-
   // setup attributes
   if (attr) {
     pt->attr = *attr;
@@ -190,6 +279,11 @@ static errno_t pthread_create_impl(pthread_t *thread,
         return rc;
       }
     }
+    if (!(pt->tls = _mktls(&pt->tib))) {
+      _pthread_free(pt);
+      errno = e;
+      return EAGAIN;
+    }
   } else {
     // cosmo is managing the stack
     // 1. in mono repo optimize for tiniest stack possible
@@ -204,7 +298,13 @@ static errno_t pthread_create_impl(pthread_t *thread,
       _pthread_free(pt);
       return EINVAL;
     }
-    if (pt->attr.__guardsize == default_guardsize) {
+    if (_pthread_unstash(pt)) {
+      // reusing the stack and tls of a thread that exited earlier
+    } else if (!(pt->tls = _mktls(&pt->tib))) {
+      _pthread_free(pt);
+      errno = e;
+      return EAGAIN;
+    } else if (pt->attr.__guardsize == default_guardsize) {
       // user is wisely using smaller stacks with default guard size
       pt->attr.__stackaddr =
           mmap(0, pt->attr.__stacksize, PROT_READ | PROT_WRITE,
@@ -349,7 +449,7 @@ errno_t pthread_create(pthread_t *thread, const pthread_attr_t *attr,
                        void *(*start_routine)(void *), void *arg) {
   errno_t rc;
   __require_tls();
-  pthread_decimate_np();
+  _pthread_decimate();
   BLOCK_SIGNALS;
   rc = pthread_create_impl(thread, attr, start_routine, arg, _SigMask);
   ALLOW_SIGNALS;
@@ -23,10 +23,7 @@
 #include "libc/thread/thread.h"
 #include "libc/thread/tls.h"
 
-/**
- * Releases memory of detached threads that have terminated.
- */
-void pthread_decimate_np(void) {
+void _pthread_decimate(void) {
   struct Dll *e;
   struct PosixThread *pt;
   enum PosixThreadStatus status;
@@ -46,3 +43,14 @@ StartOver:
   }
   pthread_spin_unlock(&_pthread_lock);
 }
+
+/**
+ * Releases memory of detached threads that have terminated.
+ *
+ * This also releases the stacks of exited threads, which are otherwise
+ * cached so they can be reused by pthread_create().
+ */
+void pthread_decimate_np(void) {
+  _pthread_decimate();
+  _pthread_trim_stacks();
+}
@@ -61,6 +61,6 @@ errno_t pthread_detach(pthread_t thread) {
   if (transition == kPosixThreadZombie) {
     _pthread_zombify(pt);
   }
-  pthread_decimate_np();
+  _pthread_decimate();
   return 0;
 }
@@ -24,10 +24,12 @@
 #include "libc/intrin/weaken.h"
 #include "libc/limits.h"
 #include "libc/mem/gc.h"
+#include "libc/runtime/ftrace.internal.h"
 #include "libc/runtime/runtime.h"
 #include "libc/thread/posixthread.internal.h"
 #include "libc/thread/thread.h"
 #include "libc/thread/tls.h"
+#include "third_party/dlmalloc/dlmalloc.h"
 #include "third_party/nsync/futex.internal.h"
 
 static void CleanupThread(struct PosixThread *pt) {
@@ -110,7 +112,13 @@ wontreturn void pthread_exit(void *rc) {
   CleanupThread(pt);
   DestroyTlsKeys(tib);
   _pthread_ungarbage();
-  pthread_decimate_np();
+  _pthread_decimate();
+  if (_weaken(dlmalloc_thread_exit)) {
+    _weaken(dlmalloc_thread_exit)();
+  }
+  if (_weaken(ftrace_thread_exit)) {
+    _weaken(ftrace_thread_exit)();
+  }
 
   // transition the thread to a terminated state
   status = atomic_load_explicit(&pt->status, memory_order_acquire);
@@ -67,7 +67,7 @@ errno_t pthread_timedjoin_np(pthread_t thread, void **value_ptr,
       *value_ptr = pt->rc;
     }
     _pthread_free(pt);
-    pthread_decimate_np();
+    _pthread_decimate();
   }
   return 0;
 }
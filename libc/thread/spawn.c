@@ -20,6 +20,7 @@
 #include "libc/assert.h"
 #include "libc/calls/calls.h"
 #include "libc/errno.h"
+#include "libc/intrin/weaken.h"
 #include "libc/macros.internal.h"
 #include "libc/mem/mem.h"
 #include "libc/runtime/internal.h"
@@ -34,6 +35,7 @@
 #include "libc/thread/posixthread.internal.h"
 #include "libc/thread/tls.h"
 #include "libc/thread/wait0.internal.h"
+#include "third_party/dlmalloc/dlmalloc.h"
 
 /**
  * @fileoverview Simple threading API
@@ -69,6 +71,9 @@ static int Spawner(void *arg, int tid) {
   rc = spawner->fun(spawner->arg, tid);
   _pthread_ungarbage();
   free(spawner);
+  if (_weaken(dlmalloc_thread_exit)) {
+    _weaken(dlmalloc_thread_exit)();
+  }
   return rc;
 }
 
@@ -14,6 +14,7 @@ struct spawn {
 int _spawn(int (*)(void *, int), void *, struct spawn *);
 int _join(struct spawn *);
 char *_mktls(struct CosmoTib **);
+char *_mktls_reuse(char *, struct CosmoTib **);
 
 COSMOPOLITAN_C_END_
 #endif /* !(__ASSEMBLER__ + __LINKER__ + 0) */
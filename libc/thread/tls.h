@@ -31,8 +31,8 @@ struct CosmoTib {
   int tib_ftrace;       /* inherited */
   int tib_strace;       /* inherited */
   uint64_t tib_sigmask; /* inherited */
-  void *tib_reserved4;
-  void *tib_reserved5;
+  void *tib_tcache;
+  void *tib_ftracebuf;
   void *tib_reserved6;
   void *tib_reserved7;
   void *tib_keys[128];
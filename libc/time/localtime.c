@@ -4,6 +4,7 @@
 #define LOCALTIME_IMPLEMENTATION
 #include "libc/calls/blockcancel.internal.h"
 #include "libc/calls/calls.h"
+#include "libc/intrin/atomic.h"
 #include "libc/intrin/bits.h"
 #include "libc/intrin/nopl.internal.h"
 #include "libc/mem/gc.h"
@@ -210,6 +211,37 @@ static struct state *	gmtptr;
 static char		lcl_TZname[TZ_STRLEN_MAX + 1];
 static int		lcl_is_set;
 
+/*
+** Whenever TZ changes, the rules are loaded into a zone, which is never
+** modified once published, so localtime_r() and tzset() can use it
+** without holding the lock. Zones are remembered by TZ value, so that
+** switching back to an earlier TZ reuses its zone, which bounds memory
+** by the number of distinct TZ values seen. Zones live until exit.
+*/
+
+struct localzone {
+	struct localzone *next;
+	int		lcl;	/* -1 if TZ is unset */
+	struct state	st;
+	char		name[];
+};
+
+static _Atomic(struct localzone *) lclzone;
+static struct localzone *lclzones;	/* guarded by localtime_lock() */
+static atomic_bool	gmt_is_set;
+
+/*
+** Each thread remembers the last transition window it looked up, so
+** consecutive conversions of nearby times needn't search the table.
+*/
+
+static _Thread_local struct {
+	struct state const *	sp;
+	time_t			lo;	/* inclusive */
+	time_t			hi;	/* exclusive */
+	int			type;
+} lcl_window;
+
 /*
 ** Section 4.12.3 of X3.159-1989 requires that
 **	Except for the strftime function, these functions [asctime,
@@ -1406,52 +1438,80 @@ zoneinit(struct state *sp, char const *name)
 
 static void
 FreeLocaltime(void *p) {
-	free(p);
+	struct localzone *zp;
+	while ((zp = lclzones)) {
+		lclzones = zp->next;
+		free(zp);
+	}
+}
+
+/* Returns zone for TZ value, loading it if it hasn't been seen. */
+static struct localzone *
+localtime_tzfind(char const *name)
+{
+	struct localzone *zp;
+	for (zp = lclzones; zp; zp = zp->next)
+		if (name
+		    ? 0 <= zp->lcl && strcmp(zp->name, name) == 0
+		    : zp->lcl < 0)
+			return zp;
+	if (!(zp = malloc(sizeof *zp + (name ? strlen(name) : 0) + 1)))
+		return NULL;
+	if (!lclzones)
+		__cxa_atexit(FreeLocaltime, 0, 0);
+	if (zoneinit(&zp->st, name) != 0)
+		zoneinit(&zp->st, "");
+	zp->lcl = name ? 1 : -1;
+	strcpy(zp->name, name ? name : "");
+	zp->next = lclzones;
+	lclzones = zp;
+	return zp;
 }
 
 static void
 localtime_tzset_unlocked(void)
 {
 	char const *name = getenv("TZ");
-	struct state *sp = lclptr;
+	struct localzone *zp;
 	int lcl = name ? strlen(name) < sizeof lcl_TZname : -1;
 	if (lcl < 0
 	    ? lcl_is_set < 0
 	    : 0 < lcl_is_set && strcmp(lcl_TZname, name) == 0)
 		return;
-	if (!sp) {
-		lclptr = sp = malloc(sizeof *lclptr);
-		__cxa_atexit(FreeLocaltime, sp, 0);
-	}
-	if (sp) {
-		if (zoneinit(sp, name) != 0)
-			zoneinit(sp, "");
-		if (0 < lcl)
-			strcpy(lcl_TZname, name);
-	}
+	if ((zp = localtime_tzfind(name)))
+		lclptr = &zp->st;
+	else
+		lclptr = NULL;
+	if (0 < lcl)
+		strcpy(lcl_TZname, name);
 	settzname();
 	lcl_is_set = lcl;
+	atomic_store_explicit(&lclzone, zp, memory_order_release);
 }
 
-void
-tzset(void)
+/* Returns published zone if it's still what TZ says, without locking. */
+static struct localzone *
+localtime_tzfresh(void)
 {
-	localtime_lock();
-	localtime_tzset_unlocked();
-	localtime_unlock();
+	char const *name;
+	struct localzone *zp;
+	if (!(zp = atomic_load_explicit(&lclzone, memory_order_acquire)))
+		return NULL;
+	name = getenv("TZ");
+	if (!name)
+		return zp->lcl < 0 ? zp : NULL;
+	if (0 <= zp->lcl && strcmp(zp->name, name) == 0)
+		return zp;
+	return NULL;
 }
 
-static void
-gmtcheck(void)
+void
+tzset(void)
 {
-	static bool gmt_is_set;
+	if (localtime_tzfresh())
+		return;
 	localtime_lock();
-	if (! gmt_is_set) {
-		gmtptr = malloc(sizeof *gmtptr);
-		if (gmtptr)
-			gmtload(gmtptr);
-		gmt_is_set = true;
-	}
+	localtime_tzset_unlocked();
 	localtime_unlock();
 }
 
@@ -1463,14 +1523,15 @@ FreeGmt(void *p) {
 static void
 localtime_gmtcheck(void)
 {
-	static bool gmt_is_set;
+	if (atomic_load_explicit(&gmt_is_set, memory_order_acquire))
+		return;
 	localtime_lock();
 	if (! gmt_is_set) {
 		gmtptr = malloc(sizeof *gmtptr);
 		__cxa_atexit(FreeGmt, gmtptr, 0);
 		if (gmtptr)
 			gmtload(gmtptr);
-		gmt_is_set = true;
+		atomic_store_explicit(&gmt_is_set, true, memory_order_release);
 	}
 	localtime_unlock();
 }
@@ -1503,7 +1564,9 @@ localsub(struct state const *sp, time_t const *timep, int_fast32_t setname,
 	  /* Don't bother to set tzname etc.; tzset has already done it.  */
 	  return gmtsub(gmtptr, timep, 0, tmp);
 	}
-	if ((sp->goback && t < sp->ats[0]) ||
+	if (lcl_window.sp == sp && lcl_window.lo <= t && t < lcl_window.hi) {
+		i = lcl_window.type;
+	} else if ((sp->goback && t < sp->ats[0]) ||
 		(sp->goahead && t > sp->ats[sp->timecnt - 1])) {
 			time_t newt;
 			register time_t		seconds;
@@ -1540,8 +1603,7 @@ localsub(struct state const *sp, time_t const *timep, int_fast32_t setname,
 				result->tm_year = newy;
 			}
 			return result;
-	}
-	if (sp->timecnt == 0 || t < sp->ats[0]) {
+	} else if (sp->timecnt == 0 || t < sp->ats[0]) {
 		i = sp->defaulttype;
 	} else {
 		register int	lo = 1;
@@ -1555,6 +1617,12 @@ localsub(struct state const *sp, time_t const *timep, int_fast32_t setname,
 			else	lo = mid + 1;
 		}
 		i = sp->types[lo - 1];
+		if (lo < sp->timecnt) {
+			lcl_window.sp = sp;
+			lcl_window.lo = sp->ats[lo - 1];
+			lcl_window.hi = sp->ats[lo];
+			lcl_window.type = i;
+		}
 	}
 	ttisp = &sp->ttis[i];
 	/*
@@ -1576,6 +1644,10 @@ localsub(struct state const *sp, time_t const *timep, int_fast32_t setname,
 static struct tm *
 localtime_tzset(time_t const *timep, struct tm *tmp, bool setname)
 {
+	struct localzone *zp;
+	if (!setname &&
+	    (zp = atomic_load_explicit(&lclzone, memory_order_acquire)))
+		return localsub(&zp->st, timep, 0, tmp);
 	localtime_lock();
 	if (setname || !lcl_is_set)
 		localtime_tzset_unlocked();
@@ -2213,7 +2285,7 @@ timeoff(struct tm *tmp, long offset)
 {
 	if (tmp)
 		tmp->tm_isdst = 0;
-	gmtcheck();
+	localtime_gmtcheck();
 	return localtime_time1(tmp, gmtsub, gmtptr, offset);
 }
 
@@ -20,6 +20,7 @@
 #include "libc/inttypes.h"
 #include "libc/stdio/stdio.h"
 #include "libc/str/locale.h"
+#include "libc/str/str.h"
 #include "libc/time/time.h"
 #include "libc/time/tz.internal.h"
 // clang-format off
@@ -557,6 +558,83 @@ label:
 	return pt;
 }
 
+static char *
+strftime_2(int n, char *pt)
+{
+	pt[0] = '0' + n / 10;
+	pt[1] = '0' + n % 10;
+	return pt + 2;
+}
+
+/*
+** Formats the ISO8601 and HTTP date formats, which servers and
+** loggers use for every request, without interpreting them.
+** Returns NULL if the format or time isn't one we can handle.
+*/
+
+static char *
+strftime_fast(char *s, size_t maxsize, const char *format,
+	      const struct tm *t)
+{
+	int		y;
+	char *		p;
+	bool		http;
+	const char *	zulu = "";
+	if (!strncmp(format, "%Y-%m-%dT%H:%M:%S", 17) &&
+	    (!format[17] || !strcmp(format + 17, "Z"))) {
+		http = false;
+		zulu = format + 17;
+	} else if (!strcmp(format, "%a, %d %b %Y %H:%M:%S GMT")) {
+		http = true;
+	} else {
+		return NULL;
+	}
+	if (maxsize < (http ? 30 : 20 + !!*zulu) ||
+	    !(-TM_YEAR_BASE <= t->tm_year &&
+	      t->tm_year <= 9999 - TM_YEAR_BASE) ||
+	    !(0 <= t->tm_mon && t->tm_mon < MONSPERYEAR) ||
+	    !(1 <= t->tm_mday && t->tm_mday <= 31) ||
+	    !(0 <= t->tm_hour && t->tm_hour < HOURSPERDAY) ||
+	    !(0 <= t->tm_min && t->tm_min < MINSPERHOUR) ||
+	    !(0 <= t->tm_sec && t->tm_sec <= SECSPERMIN) ||
+	    (http && !(0 <= t->tm_wday && t->tm_wday < DAYSPERWEEK)))
+		return NULL;
+	y = t->tm_year + TM_YEAR_BASE;
+	p = s;
+	if (http) {
+		memcpy(p, Locale->wday[t->tm_wday], 3);
+		p[3] = ',';
+		p[4] = ' ';
+		p = strftime_2(t->tm_mday, p + 5);
+		*p++ = ' ';
+		memcpy(p, Locale->mon[t->tm_mon], 3);
+		p[3] = ' ';
+		p += 4;
+	}
+	p = strftime_2(y / 100, p);
+	p = strftime_2(y % 100, p);
+	if (!http) {
+		*p++ = '-';
+		p = strftime_2(t->tm_mon + 1, p);
+		*p++ = '-';
+		p = strftime_2(t->tm_mday, p);
+	}
+	*p++ = http ? ' ' : 'T';
+	p = strftime_2(t->tm_hour, p);
+	*p++ = ':';
+	p = strftime_2(t->tm_min, p);
+	*p++ = ':';
+	p = strftime_2(t->tm_sec, p);
+	if (http) {
+		memcpy(p, " GMT", 4);
+		p += 4;
+	} else if (*zulu) {
+		*p++ = 'Z';
+	}
+	*p = '\0';
+	return p;
+}
+
 /**
  * Converts time to string, e.g.
  *
@@ -578,6 +656,8 @@ strftime(char *s, size_t maxsize, const char *format, const struct tm *t)
 	int saved_errno = errno;
 	enum warn warn = IN_NONE;
 
+	if ((p = strftime_fast(s, maxsize, format, t)))
+		return p - s;
 	tzset();
 	p = strftime_fmt(format, t, s, s + maxsize, &warn);
 	if (!p) {
@@ -0,0 +1,102 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/str/str.h"
+#include "net/http/http2.h"
+
+/*
+ * RFC7541 § B. Huffman Code
+ *
+ * The code is canonical, i.e. the codes of each length are consecutive
+ * integers assigned in symbol order, so it can be described by the
+ * first code and symbol index of each bit length. EOS is the last
+ * symbol, whose 30-bit code is all ones.
+ */
+
+static const uint32_t kHuffmanFirst[31] = {
+    0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+    0x14, 0x5c, 0xf8, 0x0, 0x3f8, 0x7fa,
+    0xffa, 0x1ff8, 0x3ffc, 0x7ffc, 0x0, 0x0,
+    0x0, 0x7fff0, 0xfffe6, 0x1fffdc, 0x3fffd2, 0x7fffd8,
+    0xffffea, 0x1ffffec, 0x3ffffe0, 0x7ffffde, 0xfffffe2, 0x0,
+    0x3ffffffc,
+};
+
+static const uint16_t kHuffmanIndex[31] = {
+    0, 0, 0, 0, 0, 0, 10, 36, 68, 0, 74, 79,
+    82, 84, 90, 92, 0, 0, 0, 95, 98, 106, 119, 145,
+    174, 186, 190, 205, 224, 0, 253,
+};
+
+static const uint8_t kHuffmanCount[31] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3,
+    2, 6, 2, 3, 0, 0, 0, 3, 8, 13, 26, 29,
+    12, 4, 15, 19, 29, 0, 4,
+};
+
+static const uint8_t kHuffmanSymbol[256] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37,
+    45, 46, 47, 51, 52, 53, 54, 55, 56, 57, 61, 65,
+    95, 98, 100, 102, 103, 104, 108, 109, 110, 112, 114, 117,
+    58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89,
+    106, 107, 113, 118, 119, 120, 121, 122, 38, 42, 44, 59,
+    88, 90, 33, 34, 40, 41, 63, 39, 43, 124, 35, 62,
+    0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161,
+    167, 172, 176, 177, 179, 209, 216, 217, 227, 229, 230, 129,
+    132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169, 170,
+    173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150,
+    151, 152, 155, 157, 158, 165, 166, 168, 174, 175, 180, 182,
+    183, 188, 191, 197, 231, 239, 9, 142, 144, 145, 148, 159,
+    171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243,
+    255, 203, 204, 211, 212, 214, 221, 222, 223, 241, 244, 245,
+    246, 247, 248, 250, 251, 252, 253, 254, 2, 3, 4, 5,
+    6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220,
+    249, 10, 13, 22,
+};
+
+/**
+ * Decodes HPACK Huffman string.
+ *
+ * @param p receives decoded bytes, and must be able to hold 8n/5 bytes
+ * @return number of bytes decoded, or -1 if the string is malformed,
+ *     which includes containing EOS or having improper padding
+ * @see RFC7541 § 5.2
+ */
+ssize_t DecodeHpackHuffman(char *p, const char *s, size_t n) {
+  int i, k;
+  char *q = p;
+  uint32_t c, d;
+  for (c = k = 0; n--; ++s) {
+    for (i = 7; i >= 0; --i) {
+      c = c << 1 | ((*s >> i) & 1);
+      if (++k > 30) return -1;
+      if ((d = c - kHuffmanFirst[k]) < kHuffmanCount[k]) {
+        if ((d += kHuffmanIndex[k]) == 256) return -1;
+        *q++ = kHuffmanSymbol[d];
+        c = k = 0;
+      }
+    }
+  }
+  if (k > 7 || c != (1u << k) - 1) return -1;
+  return q - p;
+}
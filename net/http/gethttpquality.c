@@ -0,0 +1,97 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/str/str.h"
+#include "net/http/http.h"
+
+static bool IsSpace(int c) {
+  return c == ' ' || c == '\t';
+}
+
+static bool IsDelimiter(int c) {
+  return c == ',' || c == ';' || c == '=' || IsSpace(c);
+}
+
+static int ParseQvalue(const char *p, size_t n) {
+  int q, d;
+  size_t i;
+  if (!n || (*p != '0' && *p != '1')) return -1;
+  q = (*p - '0') * 1000;
+  if (n == 1) return q;
+  if (p[1] != '.' || n > 5) return -1;
+  for (d = 100, i = 2; i < n; ++i, d /= 10) {
+    if (!('0' <= p[i] && p[i] <= '9')) return -1;
+    q += (p[i] - '0') * d;
+  }
+  return q <= 1000 ? q : -1;
+}
+
+/**
+ * Returns quality value client assigned to token in HTTP header list.
+ *
+ * This may be used for headers like Accept-Encoding, for example:
+ *
+ *     GetHttpQuality("gzip;q=0.8, zstd", -1, "zstd", -1) → 1000
+ *     GetHttpQuality("gzip;q=0.8, zstd", -1, "gzip", -1) → 800
+ *     GetHttpQuality("gzip;q=0.8, zstd", -1, "br", -1)   → -1
+ *
+ * Tokens are compared case-insensitively. Wildcards aren't expanded,
+ * so callers wanting RFC9110 semantics should also ask for `"*"` if a
+ * token isn't listed. List elements whose qvalue is malformed will be
+ * ignored, as will parameters other than `q`.
+ *
+ * @param p is header value, which may be repeated header values that
+ *     were joined by commas
+ * @param n is byte length of p where -1 implies strlen
+ * @param s is token to search for, e.g. "gzip"
+ * @param m is byte length of s where -1 implies strlen
+ * @return quality in thousandths from 0 to 1000, or -1 if not listed
+ */
+int GetHttpQuality(const char *p, size_t n, const char *s, size_t m) {
+  int q;
+  size_t i, a, b, k, l, v;
+  if (n == -1) n = p ? strlen(p) : 0;
+  if (m == -1) m = s ? strlen(s) : 0;
+  for (i = 0; i < n;) {
+    while (i < n && (p[i] == ',' || IsSpace(p[i]))) ++i;
+    for (a = i; i < n && !IsDelimiter(p[i]); ++i) donothing;
+    b = i;
+    q = 1000;
+    for (;;) {
+      while (i < n && IsSpace(p[i])) ++i;
+      if (i == n || p[i] != ';') break;
+      for (++i; i < n && IsSpace(p[i]); ++i) donothing;
+      for (k = i; i < n && !IsDelimiter(p[i]); ++i) donothing;
+      l = i - k;
+      if (i < n && p[i] == '=') {
+        for (v = ++i; i < n && !IsDelimiter(p[i]); ++i) donothing;
+        if (l == 1 && (p[k] | 32) == 'q') {
+          q = ParseQvalue(p + v, i - v);
+        }
+      }
+    }
+    while (i < n && p[i] != ',') {
+      q = -1;  // junk after element
+      ++i;
+    }
+    if (q != -1 && b - a == m && m && !strncasecmp(p + a, s, m)) {
+      return q;
+    }
+  }
+  return -1;
+}
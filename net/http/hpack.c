@@ -0,0 +1,343 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/mem/mem.h"
+#include "libc/str/str.h"
+#include "net/http/http2.h"
+
+/**
+ * HPACK static table, per RFC7541 § A.
+ */
+const char kHpackStatic[62][2][28] = {
+    {"", ""},
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+/**
+ * Initializes HPACK decoder.
+ *
+ * @param most is the header table size we advertised to our peer
+ */
+void InitHpack(struct Hpack *h, size_t most) {
+  bzero(h, sizeof(*h));
+  h->limit = h->most = most;
+}
+
+/**
+ * Destroys HPACK decoder.
+ */
+void DestroyHpack(struct Hpack *h) {
+  size_t i;
+  for (i = 0; i < h->n; ++i) {
+    free(h->p[i].k);
+    free(h->p[i].v);
+  }
+  free(h->p);
+  h->p = 0;
+  h->n = h->c = h->size = 0;
+}
+
+static void EvictHpack(struct Hpack *h, size_t want) {
+  size_t i;
+  for (i = 0; i < h->n && h->size + want > h->limit; ++i) {
+    h->size -= h->p[i].kn + h->p[i].vn + 32;
+    free(h->p[i].k);
+    free(h->p[i].v);
+  }
+  memmove(h->p, h->p + i, (h->n - i) * sizeof(*h->p));
+  h->n -= i;
+}
+
+// adds copied entry to dynamic table, returning 0 if it's too big
+static int InsertHpack(struct Hpack *h, struct HpackEntry *e) {
+  struct HpackEntry *p2;
+  size_t size = e->kn + e->vn + 32;
+  if (size > h->limit) {
+    EvictHpack(h, h->limit + 1);
+    return 0;
+  }
+  EvictHpack(h, size);
+  if (h->n == h->c) {
+    if (!(p2 = realloc(h->p, (h->c + 8) * sizeof(*h->p)))) {
+      return -1;
+    }
+    h->p = p2;
+    h->c += 8;
+  }
+  h->p[h->n++] = *e;
+  h->size += size;
+  return 1;
+}
+
+static bool LookupHpack(struct Hpack *h, uint64_t i, const char **k,
+                        size_t *kn, const char **v, size_t *vn) {
+  struct HpackEntry *e;
+  if (!i) return false;
+  if (i < 62) {
+    *k = kHpackStatic[i][0];
+    *v = kHpackStatic[i][1];
+    *kn = strlen(*k);
+    *vn = strlen(*v);
+    return true;
+  }
+  if ((i -= 62) >= h->n) return false;
+  e = h->p + h->n - 1 - i;
+  *k = e->k;
+  *v = e->v;
+  *kn = e->kn;
+  *vn = e->vn;
+  return true;
+}
+
+static bool DecodeInt(const char **pp, const char *e, int bits, uint64_t *x) {
+  int s;
+  unsigned char c;
+  const char *p = *pp;
+  if (p == e) return false;
+  *x = *p++ & ((1 << bits) - 1);
+  if (*x == (1 << bits) - 1) {
+    s = 0;
+    do {
+      if (p == e || s > 28) return false;
+      c = *p++;
+      *x += (uint64_t)(c & 127) << s;
+      s += 7;
+    } while (c & 128);
+  }
+  *pp = p;
+  return true;
+}
+
+static bool DecodeString(const char **pp, const char *e, char **b,
+                         const char **s, size_t *n) {
+  ssize_t rc;
+  uint64_t m;
+  bool huffman;
+  const char *p = *pp;
+  if (p == e) return false;
+  huffman = *p & 128;
+  if (!DecodeInt(&p, e, 7, &m) || m > e - p) return false;
+  if (huffman) {
+    if ((rc = DecodeHpackHuffman(*b, p, m)) == -1) return false;
+    *s = *b;
+    *n = rc;
+    *b += rc;
+  } else {
+    *s = p;
+    *n = m;
+  }
+  *pp = p + m;
+  return true;
+}
+
+/**
+ * Decodes HPACK header block.
+ *
+ * The callback is invoked for each field in order, with strings that
+ * are only valid until it returns. Since the dynamic table changes as
+ * fields are decoded, every header block received on a connection has
+ * to be decoded in order, including those of streams that were reset.
+ *
+ * @param p is the concatenated payload of HEADERS and CONTINUATION
+ * @return 0 on success, -1 on compression error, or nonzero result
+ *     returned by callback, which stops decoding
+ * @see RFC7541
+ */
+int DecodeHpack(struct Hpack *h, const char *p, size_t n, hpack_f f,
+                void *ctx) {
+  uint64_t i;
+  bool any, index;
+  int rc, bits, added;
+  size_t kn, vn;
+  char *buf, *b;
+  struct HpackEntry x;
+  const char *k, *v, *e;
+  if (!(buf = malloc(n * 8 / 5 + 1))) return -1;
+  for (rc = 0, any = false, e = p + n; !rc && p < e;) {
+    b = buf;
+    if (*p & 128) {  // § 6.1 indexed header field
+      if (!DecodeInt(&p, e, 7, &i) || !LookupHpack(h, i, &k, &kn, &v, &vn)) {
+        rc = -1;
+        break;
+      }
+    } else if ((*p & 0xe0) == 0x20) {  // § 6.3 dynamic table size update
+      if (any || !DecodeInt(&p, e, 5, &i) || i > h->most) {
+        rc = -1;
+        break;
+      }
+      h->limit = i;
+      EvictHpack(h, 0);
+      continue;
+    } else {  // § 6.2 literal header field
+      index = (*p & 0xc0) == 0x40;
+      bits = index ? 6 : 4;
+      if (!DecodeInt(&p, e, bits, &i)) {
+        rc = -1;
+        break;
+      }
+      if (i) {
+        if (!LookupHpack(h, i, &k, &kn, &v, &vn)) {
+          rc = -1;
+          break;
+        }
+      } else if (!DecodeString(&p, e, &b, &k, &kn)) {
+        rc = -1;
+        break;
+      }
+      if (!DecodeString(&p, e, &b, &v, &vn)) {
+        rc = -1;
+        break;
+      }
+      if (index) {
+        // copy first, since k may point into an entry we'll evict
+        if (!(x.k = malloc(kn + 1)) || !(x.v = malloc(vn + 1))) {
+          free(x.k);
+          rc = -1;
+          break;
+        }
+        x.kn = kn;
+        x.vn = vn;
+        k = memcpy(x.k, k, kn);
+        v = memcpy(x.v, v, vn);
+        if ((added = InsertHpack(h, &x)) != 1) {
+          rc = added ? -1 : f(ctx, k, kn, v, vn);
+          any = true;
+          free(x.k);
+          free(x.v);
+          continue;
+        }
+      }
+    }
+    any = true;
+    rc = f(ctx, k, kn, v, vn);
+  }
+  free(buf);
+  return rc;
+}
+
+/**
+ * Encodes HPACK integer with n-bit prefix.
+ *
+ * @param m is high bits of first byte, e.g. 0x80 for indexed field
+ * @see RFC7541 § 5.1
+ */
+char *EncodeHpackInt(char *p, uint64_t x, int n, int m) {
+  if (x < (1 << n) - 1) {
+    *p++ = m | x;
+  } else {
+    *p++ = m | ((1 << n) - 1);
+    for (x -= (1 << n) - 1; x >= 128; x >>= 7) {
+      *p++ = 128 | (x & 127);
+    }
+    *p++ = x;
+  }
+  return p;
+}
+
+/**
+ * Encodes HPACK header field.
+ *
+ * Fields are encoded without indexing, so the encoder is stateless
+ * and the peer needn't give us any dynamic table space. The static
+ * table is used for names, and whole fields, wherever possible.
+ *
+ * @param p needs at least kn + vn + 16 bytes of space
+ * @param k is name, which must be lowercase
+ * @see RFC7541 § 6.2.2
+ */
+char *EncodeHpack(char *p, const char *k, size_t kn, const char *v,
+                  size_t vn) {
+  int i, j;
+  for (j = 0, i = 1; i < 62; ++i) {
+    if (strlen(kHpackStatic[i][0]) == kn &&
+        !memcmp(kHpackStatic[i][0], k, kn)) {
+      if (strlen(kHpackStatic[i][1]) == vn &&
+          !memcmp(kHpackStatic[i][1], v, vn)) {
+        return EncodeHpackInt(p, i, 7, 0x80);
+      }
+      if (!j) j = i;
+    }
+  }
+  p = EncodeHpackInt(p, j, 4, 0);
+  if (!j) {
+    p = EncodeHpackInt(p, kn, 7, 0);
+    p = mempcpy(p, k, kn);
+  }
+  p = EncodeHpackInt(p, vn, 7, 0);
+  return mempcpy(p, v, vn);
+}
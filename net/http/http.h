@@ -202,6 +202,7 @@ bool HeaderHas(struct HttpMessage *, const char *, int, const char *, size_t);
 int64_t ParseContentLength(const char *, size_t);
 char *FormatHttpDateTime(char[hasatleast 30], struct tm *);
 bool ParseHttpRange(const char *, size_t, long, long *, long *);
+int GetHttpQuality(const char *, size_t, const char *, size_t);
 int64_t ParseHttpDateTime(const char *, size_t);
 bool IsValidHttpToken(const char *, size_t);
 bool IsValidCookieValue(const char *, size_t);
@@ -0,0 +1,87 @@
+#ifndef COSMOPOLITAN_NET_HTTP_HTTP2_H_
+#define COSMOPOLITAN_NET_HTTP_HTTP2_H_
+
+#define kHttp2Preface     "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define kHttp2PrefaceSize 24
+#define kHttp2FrameHeader 9
+#define kHttp2MaxFrame    16384
+#define kHttp2Window      65535
+
+#define kHttp2Data         0
+#define kHttp2Headers      1
+#define kHttp2Priority     2
+#define kHttp2RstStream    3
+#define kHttp2Settings     4
+#define kHttp2PushPromise  5
+#define kHttp2Ping         6
+#define kHttp2Goaway       7
+#define kHttp2WindowUpdate 8
+#define kHttp2Continuation 9
+
+#define kHttp2FlagAck        0x01
+#define kHttp2FlagEndStream  0x01
+#define kHttp2FlagEndHeaders 0x04
+#define kHttp2FlagPadded     0x08
+#define kHttp2FlagPriority   0x20
+
+#define kHttp2SettingsHeaderTableSize      1
+#define kHttp2SettingsEnablePush           2
+#define kHttp2SettingsMaxConcurrentStreams 3
+#define kHttp2SettingsInitialWindowSize    4
+#define kHttp2SettingsMaxFrameSize         5
+#define kHttp2SettingsMaxHeaderListSize    6
+
+#define kHttp2NoError            0
+#define kHttp2ProtocolError      1
+#define kHttp2InternalError      2
+#define kHttp2FlowControlError   3
+#define kHttp2SettingsTimeout    4
+#define kHttp2StreamClosed       5
+#define kHttp2FrameSizeError     6
+#define kHttp2RefusedStream      7
+#define kHttp2Cancel             8
+#define kHttp2CompressionError   9
+#define kHttp2ConnectError       10
+#define kHttp2EnhanceYourCalm    11
+#define kHttp2InadequateSecurity 12
+#define kHttp2Http11Required     13
+
+#define kHpackTableSize 4096
+
+#if !(__ASSEMBLER__ + __LINKER__ + 0)
+COSMOPOLITAN_C_START_
+
+struct Http2Frame {
+  uint32_t size;
+  uint8_t type;
+  uint8_t flags;
+  uint32_t stream;
+};
+
+struct Hpack {
+  size_t size;   /* sum of entry sizes, per rfc7541 § 4.1 */
+  size_t limit;  /* current maximum size */
+  size_t most;   /* ceiling for limit, from our settings */
+  size_t n, c;
+  struct HpackEntry {
+    char *k, *v;
+    uint32_t kn, vn;
+  } * p;         /* oldest first */
+};
+
+typedef int (*hpack_f)(void *, const char *, size_t, const char *, size_t);
+
+extern const char kHpackStatic[62][2][28];
+
+void ParseHttp2Frame(struct Http2Frame *, const char[hasatleast 9]);
+char *AppendHttp2Frame(char *, uint32_t, int, int, uint32_t);
+void InitHpack(struct Hpack *, size_t);
+void DestroyHpack(struct Hpack *);
+int DecodeHpack(struct Hpack *, const char *, size_t, hpack_f, void *);
+char *EncodeHpack(char *, const char *, size_t, const char *, size_t);
+char *EncodeHpackInt(char *, uint64_t, int, int);
+ssize_t DecodeHpackHuffman(char *, const char *, size_t);
+
+COSMOPOLITAN_C_END_
+#endif /* !(__ASSEMBLER__ + __LINKER__ + 0) */
+#endif /* COSMOPOLITAN_NET_HTTP_HTTP2_H_ */
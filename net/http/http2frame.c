@@ -0,0 +1,49 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/intrin/bits.h"
+#include "net/http/http2.h"
+
+/**
+ * Parses HTTP/2 frame header.
+ *
+ * @param p points to the 9 bytes that precede each frame payload
+ * @see RFC9113 § 4.1
+ */
+void ParseHttp2Frame(struct Http2Frame *f, const char p[hasatleast 9]) {
+  f->size = READ32BE(p) >> 8;
+  f->type = p[3];
+  f->flags = p[4];
+  f->stream = READ32BE(p + 5) & 0x7fffffff;
+}
+
+/**
+ * Appends HTTP/2 frame header.
+ *
+ * @return p + 9, where the payload should be copied
+ */
+char *AppendHttp2Frame(char *p, uint32_t size, int type, int flags,
+                       uint32_t stream) {
+  p[0] = size >> 16;
+  p[1] = size >> 8;
+  p[2] = size;
+  p[3] = type;
+  p[4] = flags;
+  WRITE32BE(p + 5, stream & 0x7fffffff);
+  return p + 9;
+}
@@ -23,6 +23,7 @@
 #include "libc/mem/alg.h"
 #include "libc/mem/arraylist.internal.h"
 #include "libc/mem/mem.h"
+#include "libc/nexgen32e/x86feature.h"
 #include "libc/stdio/stdio.h"
 #include "libc/str/str.h"
 #include "libc/sysv/errfuns.h"
@@ -31,6 +32,60 @@
 
 #define LIMIT (SHRT_MAX - 2)
 
+#if defined(__x86_64__) && !defined(__chibicc__)
+typedef char xmm_t __attribute__((__vector_size__(16), __aligned__(1)));
+typedef char ymm_t __attribute__((__vector_size__(32), __aligned__(1)));
+typedef unsigned char xmmu_t __attribute__((__vector_size__(16), __aligned__(1)));
+typedef unsigned char ymmu_t __attribute__((__vector_size__(32), __aligned__(1)));
+
+static __attribute__((__target__("avx2"))) size_t SkipHttpTextAvx2(
+    const char *p, size_t i, size_t n, unsigned char d) {
+  unsigned m;
+  ymmu_t v;
+  for (; i + 32 <= n; i += 32) {
+    v = *(const ymmu_t *)(p + i);
+    if ((m = __builtin_ia32_pmovmskb256(
+             (ymm_t)((v < 0x20) | (v - 0x7F < 0x21) | (v == d))))) {
+      return i + __builtin_ctz(m);
+    }
+  }
+  return i;
+}
+
+static size_t SkipHttpTextSse(const char *p, size_t i, size_t n,
+                              unsigned char d) {
+  unsigned m;
+  xmmu_t v;
+  for (; i + 16 <= n; i += 16) {
+    v = *(const xmmu_t *)(p + i);
+    if ((m = __builtin_ia32_pmovmskb128(
+             (xmm_t)((v < 0x20) | (v - 0x7F < 0x21) | (v == d))))) {
+      return i + __builtin_ctz(m);
+    }
+  }
+  return i;
+}
+#endif
+
+/**
+ * Skips over field text that can't end or invalidate the field.
+ *
+ * Bytes that are C0 or C1 control codes, or equal to d, will stop the
+ * scan. Since the returned index may also be anywhere in the last few
+ * bytes, the caller still needs to inspect p[i] the normal way, which
+ * is what keeps our error behavior exactly the same.
+ */
+static inline size_t SkipHttpText(const char *p, size_t i, size_t n,
+                                  unsigned char d) {
+#if defined(__x86_64__) && !defined(__chibicc__)
+  if (i + 16 <= n) {
+    if (X86_HAVE(AVX2)) i = SkipHttpTextAvx2(p, i, n, d);
+    i = SkipHttpTextSse(p, i, n, d);
+  }
+#endif
+  return i;
+}
+
 /**
  * Initializes HTTP message parser.
  */
@@ -78,7 +133,8 @@ void DestroyHttpMessage(struct HttpMessage *r) {
  *
  * This parser takes about 400 nanoseconds to parse a 403 byte Chrome
  * HTTP request under MODE=rel on a Core i9 which is about three cycles
- * per byte or a gigabyte per second of throughput per core.
+ * per byte or a gigabyte per second of throughput per core. The bodies
+ * of long fields, e.g. cookies, are scanned 16 or 32 bytes at a time.
  *
  * @note we assume p points to a buffer that has >=SHRT_MAX bytes
  * @see HTTP/1.1 RFC2616 RFC2068
@@ -107,8 +163,8 @@ int ParseHttpMessage(struct HttpMessage *r, const char *p, size_t n) {
           } else if (!kHttpToken[c]) {
             return ebadmsg();
           }
-          if (++r->i == n) break;
-          c = p[r->i] & 0xff;
+          if (r->i + 1 == n) break;
+          c = p[++r->i] & 0xff;
         }
         break;
       case kHttpStateUri:
@@ -128,8 +184,9 @@ int ParseHttpMessage(struct HttpMessage *r, const char *p, size_t n) {
           } else if (c < 0x20 || (0x7F <= c && c < 0xA0)) {
             return ebadmsg();
           }
-          if (++r->i == n) break;
-          c = p[r->i] & 0xff;
+          r->i = SkipHttpText(p, r->i + 1, n, ' ') - 1;
+          if (r->i + 1 == n) break;
+          c = p[++r->i] & 0xff;
         }
         break;
       case kHttpStateVersion:
@@ -166,8 +223,8 @@ int ParseHttpMessage(struct HttpMessage *r, const char *p, size_t n) {
           } else {
             return ebadmsg();
           }
-          if (++r->i == n) break;
-          c = p[r->i] & 0xff;
+          if (r->i + 1 == n) break;
+          c = p[++r->i] & 0xff;
         }
         break;
       case kHttpStateMessage:
@@ -180,8 +237,9 @@ int ParseHttpMessage(struct HttpMessage *r, const char *p, size_t n) {
           } else if (c < 0x20 || (0x7F <= c && c < 0xA0)) {
             return ebadmsg();
           }
-          if (++r->i == n) break;
-          c = p[r->i] & 0xff;
+          r->i = SkipHttpText(p, r->i + 1, n, 0) - 1;
+          if (r->i + 1 == n) break;
+          c = p[++r->i] & 0xff;
         }
         break;
       case kHttpStateCr:
@@ -213,8 +271,8 @@ int ParseHttpMessage(struct HttpMessage *r, const char *p, size_t n) {
           } else if (!kHttpToken[c]) {
             return ebadmsg();
           }
-          if (++r->i == n) break;
-          c = p[r->i] & 0xff;
+          if (r->i + 1 == n) break;
+          c = p[++r->i] & 0xff;
         }
         break;
       case kHttpStateColon:
@@ -260,8 +318,9 @@ int ParseHttpMessage(struct HttpMessage *r, const char *p, size_t n) {
           } else if ((c < 0x20 && c != '\t') || (0x7F <= c && c < 0xA0)) {
             return ebadmsg();
           }
-          if (++r->i == n) break;
-          c = p[r->i] & 0xff;
+          r->i = SkipHttpText(p, r->i + 1, n, 0) - 1;
+          if (r->i + 1 == n) break;
+          c = p[++r->i] & 0xff;
         }
         break;
       case kHttpStateLf2:
@@ -6,3 +6,19 @@ CREATE TABLE land (
 
 CREATE INDEX land_by_name ON land (nick);
 CREATE INDEX land_by_created ON land (created DESC) WHERE created NOT NULL;
+
+-- leaderboard counts maintained by ClaimWorker(), where secs is the
+-- board window, or -1 for all time; turfwar creates these if needed
+CREATE TABLE score (
+    secs INTEGER NOT NULL,
+    nick TEXT NOT NULL,
+    block INTEGER NOT NULL,
+    count INTEGER NOT NULL,
+    PRIMARY KEY (secs, nick, block)
+) WITHOUT ROWID;
+
+-- windowed boards count land that was created >= since
+CREATE TABLE board (
+    secs INTEGER PRIMARY KEY,
+    since INTEGER NOT NULL
+);
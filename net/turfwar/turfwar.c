@@ -64,6 +64,7 @@
 #include "libc/sysv/consts/prot.h"
 #include "libc/sysv/consts/rusage.h"
 #include "libc/sysv/consts/sig.h"
+#include "libc/sysv/consts/shut.h"
 #include "libc/sysv/consts/so.h"
 #include "libc/sysv/consts/sock.h"
 #include "libc/sysv/consts/sol.h"
@@ -96,7 +97,7 @@
  */
 
 #define PORT               8080    // default server listening port
-#define CPUS               64      // number of cpus to actually use
+#define CPUS               64      // max number of listening sockets
 #define XN                 64      // plot width in pixels
 #define YN                 64      // plot height in pixels
 #define WORKERS            500     // size of http client thread pool
@@ -109,17 +110,17 @@
 #define SCORE_M_UPDATE_MS  100000  // how often to regenerate /score/month
 #define SCORE_UPDATE_MS    210000  // how often to regenerate /score
 #define PLOTS_UPDATE_MS    999000  // how often to regenerate /plot/xxx
-#define ACCEPT_DEADLINE_MS 100     // how long accept() can take to find worker
 #define CLAIM_DEADLINE_MS  100     // how long /claim may block if queue is full
-#define CONCERN_LOAD       .75     // avoid keepalive, upon this connection load
-#define PANIC_LOAD         .85     // meltdown if this percent of pool connected
+#define CONCERN_LOAD       .75     // avoid keepalive, upon this group load
+#define PANIC_LOAD         .85     // meltdown if this percent of group connected
 #define PANIC_MSGS         10      // msgs per conn can't exceed it in meltdown
 #define QUEUE_MAX          800     // maximum pending claim items in queue
 #define BATCH_MAX          64      // max claims to insert per transaction
+#define BOARDS             5       // all time, hour, day, week, month scores
 #define NICK_MAX           40      // max length of user nickname string
 #define TB_INTERVAL        1000    // millis between token replenishes
 #define TB_CIDR            24      // token bucket cidr specificity
-#define SOCK_MAX           100     // max length of socket queue
+#define SOCK_MAX           100     // max length of each listener's backlog
 #define MSG_BUF            512     // small response lookaside
 
 #define INBUF_SIZE  FRAMESIZE
@@ -128,13 +129,14 @@
 #define TB_BYTES (1u << TB_CIDR)
 #define TB_WORDS (TB_BYTES / 8)
 
-#define GETOPTS "idvp:w:k:W:"
+#define GETOPTS "idvbp:w:k:W:"
 #define USAGE \
   "\
 Usage: turfwar.com [-dv] ARGS...\n\
   -i          integrity check and vacuum at startup\n\
   -d          daemonize\n\
   -v          verbosity\n\
+  -b          benchmark asset reads and exit\n\
   -W IP       whitelist\n\
   -p INT      port\n\
   -w INT      workers\n\
@@ -233,15 +235,17 @@ struct Data {
   size_t n;
 };
 
+// asset version, which is immutable once published
 struct Asset {
   int cash;
-  char *path;
-  nsync_mu lock;
+  const char *path;
   const char *type;
   struct Data data;
   struct Data gzip;
   struct timespec mtim;
   char lastmodified[32];
+  long retired;        // g_epoch when it was replaced
+  struct Asset *next;  // g_retired list
 };
 
 struct Blackhole {
@@ -255,13 +259,13 @@ struct Blackhole {
 // cli flags
 bool g_integrity;
 bool g_daemonize;
+bool g_benchmark;
 int g_port = PORT;
 int g_workers = WORKERS;
 int g_keepalive = KEEPALIVE_MS;
 struct SortedInts g_whitelisted;
 
 // lifecycle vars
-pthread_t g_listener;
 nsync_time g_started;
 nsync_counter g_ready;
 atomic_int g_connections;
@@ -276,7 +280,6 @@ atomic_long g_proxied;
 atomic_long g_messages;
 atomic_long g_memfails;
 atomic_long g_sysfails;
-atomic_long g_rejected;
 atomic_long g_unproxied;
 atomic_long g_readfails;
 atomic_long g_notfounds;
@@ -310,9 +313,27 @@ struct Worker {
   atomic_int msgcount;
   atomic_int shutdown;
   atomic_int connected;
+  atomic_long epoch;  // g_epoch when asset pinned, otherwise 0
   struct timespec startread;
 } * g_worker;
 
+// SO_REUSEPORT sockets, each one shared by a group of http workers,
+// so the kernel load balances connections without a userspace queue
+struct Listener {
+  int fd;
+  int workers;          // size of group accept()'ing on this socket
+  atomic_int busy;      // workers in group serving a connection
+  atomic_long accepts;  // connections accepted by this group
+} * g_listener;
+int g_listeners;
+
+// connection accepted by http worker
+struct Client {
+  int sock;
+  uint32_t size;
+  struct sockaddr_in addr;
+};
+
 // recentworker wakeup
 struct Recent {
   nsync_mu mu;
@@ -327,33 +348,28 @@ struct Nowish {
 } g_nowish;
 
 // static assets
+// readers pin the current version without locking
+// writers publish a new version and retire the old
 struct Assets {
-  struct Asset index;
-  struct Asset about;
-  struct Asset user;
-  struct Asset score;
-  struct Asset score_hour;
-  struct Asset score_day;
-  struct Asset score_week;
-  struct Asset score_month;
-  struct Asset recent;
-  struct Asset favicon;
-  struct Asset plot[256];
+  _Atomic(struct Asset *) index;
+  _Atomic(struct Asset *) about;
+  _Atomic(struct Asset *) user;
+  _Atomic(struct Asset *) score;
+  _Atomic(struct Asset *) score_hour;
+  _Atomic(struct Asset *) score_day;
+  _Atomic(struct Asset *) score_week;
+  _Atomic(struct Asset *) score_month;
+  _Atomic(struct Asset *) recent;
+  _Atomic(struct Asset *) favicon;
+  _Atomic(struct Asset *) plot[256];
 } g_asset;
 
-// queues ListenWorker() to HttpWorker()
-struct Clients {
-  int pos;
-  int count;
+// asset versions that have been replaced but may still be read
+atomic_long g_epoch = 1;
+struct Retired {
   nsync_mu mu;
-  nsync_cv non_full;
-  nsync_cv non_empty;
-  struct Client {
-    int sock;
-    uint32_t size;
-    struct sockaddr_in addr;
-  } data[SOCK_MAX];
-} g_clients;
+  struct Asset *list;
+} g_retired;
 
 // queues /claim to ClaimWorker()
 struct Claims {
@@ -369,6 +385,41 @@ struct Claims {
   } data[QUEUE_MAX];
 } g_claims;
 
+// adds delta to a persisted leaderboard count
+const char kSaveScore[] = "INSERT INTO score (secs, nick, block, count)\n"
+                          "VALUES (?1, ?2, ?3, ?4)\n"
+                          "ON CONFLICT (secs, nick, block) DO\n"
+                          "UPDATE SET count = count + ?4";
+
+// window of each leaderboard in seconds, or -1 for all time
+const long kBoardSecs[BOARDS] = {
+    -1,                  // /score
+    60L * 60,            // /score/hour
+    60L * 60 * 24,       // /score/day
+    60L * 60 * 24 * 7,   // /score/week
+    60L * 60 * 24 * 30,  // /score/month
+};
+
+// land counted per nick and /8 block, for each leaderboard, which is
+// updated by ClaimWorker() as it commits claims, and persisted in the
+// score table, so that json can be generated without any GROUP BY
+struct Scores {
+  nsync_mu mu;
+  bool loaded;         // false if memory may disagree with database
+  long since[BOARDS];  // windowed boards count land created >= since
+  int n, c;
+  struct Score {
+    unsigned fresh;      // bitset of boards whose json is up to date
+    char *json[BOARDS];  // cached json fragment for each board
+    int n, c;
+    struct Cell {
+      int block;
+      long count[BOARDS];
+    } * p;  // sorted by block
+    char nick[NICK_MAX + 1];
+  } * *p;  // sorted by nick
+} g_scores;
+
 long GetTotalRam(void) {
   struct sysinfo si;
   si.totalram = 256 * 1024 * 1024;
@@ -521,57 +572,6 @@ char *FormatDate(char *p) {
   return p;
 }
 
-bool AddClient(struct Clients *q, const struct Client *v, nsync_time dead) {
-  bool wake = false;
-  bool added = false;
-  nsync_mu_lock(&q->mu);
-  while (q->count == ARRAYLEN(q->data)) {
-    if (nsync_cv_wait_with_deadline(&q->non_full, &q->mu, dead,
-                                    g_shutdown[0])) {
-      break;  // must be ETIMEDOUT or ECANCELED
-    }
-  }
-  if (q->count != ARRAYLEN(q->data)) {
-    int i = q->pos + q->count;
-    if (ARRAYLEN(q->data) <= i) i -= ARRAYLEN(q->data);
-    memcpy(q->data + i, v, sizeof(*v));
-    if (!q->count) wake = true;
-    q->count++;
-    added = true;
-  }
-  nsync_mu_unlock(&q->mu);
-  if (wake) {
-    nsync_cv_broadcast(&q->non_empty);
-  }
-  return added;
-}
-
-int GetClient(struct Clients *q, struct Client *out) {
-  int got = 0;
-  int len = 1;
-  nsync_mu_lock(&q->mu);
-  while (!q->count) {
-    if (nsync_cv_wait_with_deadline(&q->non_empty, &q->mu,
-                                    nsync_time_no_deadline, g_shutdown[1])) {
-      break;  // must be ECANCELED
-    }
-  }
-  while (got < len && q->count) {
-    memcpy(out + got, q->data + q->pos, sizeof(*out));
-    if (q->count == ARRAYLEN(q->data)) {
-      nsync_cv_broadcast(&q->non_full);
-    }
-    ++got;
-    q->pos++;
-    q->count--;
-    if (q->pos == ARRAYLEN(q->data)) {
-      q->pos = 0;
-    }
-  }
-  nsync_mu_unlock(&q->mu);
-  return got;
-}
-
 // inserts ip:name claim into blocking message queue
 // may be interrupted by absolute deadline
 // may be cancelled by server shutdown
@@ -694,11 +694,34 @@ char *Statusz(char *p, const char *s, long x) {
   return p;
 }
 
+// returns number of connections waiting to be accept()'d by group,
+// which linux reports in tcpi_unacked for listening sockets
+long GetBacklog(struct Listener *l) {
+  struct {  // prefix of linux struct tcp_info
+    uint8_t state, ca_state, retransmits, probes, backoff, options;
+    uint8_t wscale, flags;
+    uint32_t rto, ato, snd_mss, rcv_mss;
+    uint32_t unacked;  // accept queue length if listening
+    uint32_t sacked;   // listen() backlog if listening
+  } ti;
+  uint32_t n = sizeof(ti);
+  if (!IsLinux() || getsockopt(l->fd, SOL_TCP, TCP_INFO, &ti, &n) == -1 ||
+      n < sizeof(ti)) {
+    return 0;
+  }
+  return ti.unacked;
+}
+
 // public /statusz endpoint for monitoring server internals
 void ServeStatusz(int client, char *outbuf) {
-  char *p;
+  int i;
+  char *p, *q, key[32];
   struct rusage ru;
   struct timespec now;
+  long backlog[CPUS], backlogs = 0;
+  for (i = 0; i < g_listeners; ++i) {
+    backlogs += (backlog[i] = GetBacklog(g_listener + i));
+  }
   now = timespec_real();
   p = outbuf;
   p = stpcpy(outbuf, "HTTP/1.1 200 OK\r\n"
@@ -719,7 +742,6 @@ void ServeStatusz(int client, char *outbuf) {
   p = Statusz(p, "proxied", g_proxied);
   p = Statusz(p, "memfails", g_memfails);
   p = Statusz(p, "sysfails", g_sysfails);
-  p = Statusz(p, "rejected", g_rejected);
   p = Statusz(p, "unproxied", g_unproxied);
   p = Statusz(p, "readfails", g_readfails);
   p = Statusz(p, "notfounds", g_notfounds);
@@ -729,6 +751,7 @@ void ServeStatusz(int client, char *outbuf) {
   p = Statusz(p, "queuefulls", g_queuefulls);
   p = Statusz(p, "htmlclaims", g_htmlclaims);
   p = Statusz(p, "ratelimits", g_ratelimits);
+  p = Statusz(p, "backlog", backlogs);
   p = Statusz(p, "emptyclaims", g_emptyclaims);
   p = Statusz(p, "acceptfails", g_acceptfails);
   p = Statusz(p, "badversions", g_badversions);
@@ -741,6 +764,15 @@ void ServeStatusz(int client, char *outbuf) {
   p = Statusz(p, "claimsenqueued", g_claimsenqueued);
   p = Statusz(p, "claimsprocessed", g_claimsprocessed);
   p = Statusz(p, "statuszrequests", g_statuszrequests);
+  for (i = 0; i < g_listeners; ++i) {
+    q = FormatInt32(stpcpy(key, "listener"), i);
+    stpcpy(q, ".accepts");
+    p = Statusz(p, key, g_listener[i].accepts);
+    stpcpy(q, ".busy");
+    p = Statusz(p, key, g_listener[i].busy);
+    stpcpy(q, ".backlog");
+    p = Statusz(p, key, backlog[i]);
+  }
   if (!getrusage(RUSAGE_SELF, &ru)) {
     p = Statusz(p, "ru_utime.tv_sec", ru.ru_utime.tv_sec);
     p = Statusz(p, "ru_utime.tv_usec", ru.ru_utime.tv_usec);
@@ -764,49 +796,94 @@ void ServeStatusz(int client, char *outbuf) {
   write(client, outbuf, p - outbuf);
 }
 
-void *ListenWorker(void *arg) {
-  int server;
+// creates one of the sockets that http workers accept() upon
+// every listener binds the same port and the kernel picks one
+void Listen(struct Listener *l) {
   int no = 0;
   int yes = 1;
   int fastopen = 5;
-  struct Client client;
   struct timeval timeo = {g_keepalive / 1000, g_keepalive % 1000};
   struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(g_port)};
-  AllowSigusr1();
-  pthread_setname_np(pthread_self(), "Listener");
-  CHECK_NE(-1, (server = socket(AF_INET, SOCK_STREAM, 0)));
-  setsockopt(server, SOL_SOCKET, SO_RCVTIMEO, &timeo, sizeof(timeo));
-  setsockopt(server, SOL_SOCKET, SO_SNDTIMEO, &timeo, sizeof(timeo));
-  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
-  setsockopt(server, SOL_TCP, TCP_FASTOPEN, &fastopen, sizeof(fastopen));
-  setsockopt(server, SOL_TCP, TCP_QUICKACK, &no, sizeof(no));
-  setsockopt(server, SOL_TCP, TCP_CORK, &no, sizeof(no));
-  setsockopt(server, SOL_TCP, TCP_NODELAY, &yes, sizeof(yes));
-  bind(server, (struct sockaddr *)&addr, sizeof(addr));
-  CHECK_NE(-1, listen(server, 1));
-  while (!nsync_note_is_notified(g_shutdown[0])) {
-    client.size = sizeof(client.addr);
-    client.sock = accept(server, (struct sockaddr *)&client.addr, &client.size);
-    if (client.sock == -1) {
-      if (errno != EAGAIN) {  // spinning on SO_RCVTIMEO
-        ++g_acceptfails;
-      }
-      continue;
+  CHECK_NE(-1, (l->fd = socket(AF_INET, SOCK_STREAM, 0)));
+  setsockopt(l->fd, SOL_SOCKET, SO_RCVTIMEO, &timeo, sizeof(timeo));
+  setsockopt(l->fd, SOL_SOCKET, SO_SNDTIMEO, &timeo, sizeof(timeo));
+  setsockopt(l->fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  if (g_listeners > 1) {
+    CHECK_NE(-1,
+             setsockopt(l->fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)));
+  }
+  setsockopt(l->fd, SOL_TCP, TCP_FASTOPEN, &fastopen, sizeof(fastopen));
+  setsockopt(l->fd, SOL_TCP, TCP_QUICKACK, &no, sizeof(no));
+  setsockopt(l->fd, SOL_TCP, TCP_CORK, &no, sizeof(no));
+  setsockopt(l->fd, SOL_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  CHECK_NE(-1, bind(l->fd, (struct sockaddr *)&addr, sizeof(addr)));
+  CHECK_NE(-1, listen(l->fd, SOCK_MAX));
+}
+
+void FreeAsset(struct Asset *a) {
+  if (!a) return;
+  free(a->data.p);
+  free(a->gzip.p);
+  free(a);
+}
+
+// releases asset pinned by http worker
+void UnpinAsset(int id) {
+  atomic_store_explicit(&g_worker[id].epoch, 0, memory_order_release);
+}
+
+// returns current version of asset, which won't be freed until the
+// http worker calls UnpinAsset(), or null if it's not generated yet
+struct Asset *PinAsset(int id, _Atomic(struct Asset *) *slot) {
+  struct Asset *a;
+  atomic_store(&g_worker[id].epoch, atomic_load(&g_epoch));
+  if (!(a = atomic_load(slot))) UnpinAsset(id);
+  return a;
+}
+
+// frees retired assets that no http worker could still have pinned,
+// i.e. no worker has stayed pinned since before they were replaced
+void Reclaim(void) {
+  long e, min;
+  struct Asset *a, **p, *dead = 0;
+  //!//!//!//!//!//!//!//!//!//!//!//!//!/
+  nsync_mu_lock(&g_retired.mu);
+  min = LONG_MAX;
+  for (int i = 0; i < g_workers; ++i) {
+    if ((e = atomic_load(&g_worker[i].epoch)) && e < min) {
+      min = e;
     }
-    if (!AddClient(&g_clients, &client, WaitFor(ACCEPT_DEADLINE_MS))) {
-      ++g_rejected;
-      LOG("503 Accept Queue Full\n");
-      Write(client.sock, "HTTP/1.1 503 Accept Queue Full\r\n"
-                         "Content-Type: text/plain\r\n"
-                         "Connection: close\r\n"
-                         "\r\n"
-                         "Accept Queue Full\n");
-      close(client.sock);
+  }
+  for (p = &g_retired.list; (a = *p);) {
+    if (a->retired < min) {
+      *p = a->next;
+      a->next = dead;
+      dead = a;
+    } else {
+      p = &a->next;
     }
   }
-  close(server);
-  nsync_note_notify(g_shutdown[1]);
-  return 0;
+  nsync_mu_unlock(&g_retired.mu);
+  //!//!//!//!//!//!//!//!//!//!//!//!//!/
+  while ((a = dead)) {
+    dead = a->next;
+    FreeAsset(a);
+  }
+}
+
+// atomically swaps out asset with newer version
+void Publish(_Atomic(struct Asset *) *slot, struct Asset *a) {
+  struct Asset *old;
+  if ((old = atomic_exchange(slot, a))) {
+    old->retired = atomic_fetch_add(&g_epoch, 1);
+    //!//!//!//!//!//!//!//!//!//!//!//!//!/
+    nsync_mu_lock(&g_retired.mu);
+    old->next = g_retired.list;
+    g_retired.list = old;
+    nsync_mu_unlock(&g_retired.mu);
+    //!//!//!//!//!//!//!//!//!//!//!//!//!/
+  }
+  Reclaim();
 }
 
 // make thousands of http client handler threads
@@ -815,6 +892,7 @@ void *ListenWorker(void *arg) {
 void *HttpWorker(void *arg) {
   struct Client client;
   int id = (intptr_t)arg;
+  struct Listener *l = g_listener + id % g_listeners;
   char *msgbuf = _gc(xmalloc(MSG_BUF));
   char *inbuf = NewSafeBuffer(INBUF_SIZE);
   char *outbuf = NewSafeBuffer(OUTBUF_SIZE);
@@ -824,13 +902,33 @@ void *HttpWorker(void *arg) {
   pthread_setname_np(pthread_self(), _gc(xasprintf("HTTP%d", id)));
 
   // connection loop
-  while (GetClient(&g_clients, &client)) {
+  while (!nsync_note_is_notified(g_shutdown[1])) {
     struct Data d;
     ssize_t got, sent;
     uint32_t ip, clientip;
     int tok, inmsglen, outmsglen;
     char ipbuf[32], *p, *q, cashbuf[64];
 
+    // wait for connection
+    // this may be cancelled by sigusr1
+    AllowSigusr1();
+    client.size = sizeof(client.addr);
+    client.sock = accept(l->fd, (struct sockaddr *)&client.addr, &client.size);
+    BlockSignals();
+    if (client.sock == -1) {
+      if (errno != EAGAIN &&  // spinning on SO_RCVTIMEO
+          errno != EINTR &&   // sigusr1 from main thread
+          errno != EINVAL) {  // listener was shutdown()
+        ++g_acceptfails;
+      }
+      continue;
+    }
+
+    // once every worker in our group is busy, new connections wait
+    // in the kernel backlog of this listener until one of us is free
+    ++l->busy;
+    ++l->accepts;
+
     clientip = ntohl(client.addr.sin_addr.s_addr);
     g_worker[id].connected = true;
     g_worker[id].msgcount = 0;
@@ -846,6 +944,7 @@ void *HttpWorker(void *arg) {
     do {
       struct Asset *a;
       bool comp, ipv6;
+      _Atomic(struct Asset *) *slot;
 
       // wait for http message
       // this may be cancelled by sigusr1
@@ -952,25 +1051,25 @@ void *HttpWorker(void *arg) {
 
       // asset routing
       if (UrlEqual("/") || UrlStartsWith("/index.html")) {
-        a = &g_asset.index;
+        slot = &g_asset.index;
       } else if (UrlStartsWith("/favicon.ico")) {
-        a = &g_asset.favicon;
+        slot = &g_asset.favicon;
       } else if (UrlStartsWith("/about.html")) {
-        a = &g_asset.about;
+        slot = &g_asset.about;
       } else if (UrlStartsWith("/user.html")) {
-        a = &g_asset.user;
+        slot = &g_asset.user;
       } else if (UrlStartsWith("/score/hour")) {
-        a = &g_asset.score_hour;
+        slot = &g_asset.score_hour;
       } else if (UrlStartsWith("/score/day")) {
-        a = &g_asset.score_day;
+        slot = &g_asset.score_day;
       } else if (UrlStartsWith("/score/week")) {
-        a = &g_asset.score_week;
+        slot = &g_asset.score_week;
       } else if (UrlStartsWith("/score/month")) {
-        a = &g_asset.score_month;
+        slot = &g_asset.score_month;
       } else if (UrlStartsWith("/score")) {
-        a = &g_asset.score;
+        slot = &g_asset.score;
       } else if (UrlStartsWith("/recent")) {
-        a = &g_asset.recent;
+        slot = &g_asset.recent;
       } else if (UrlStartsWith("/plot/")) {
         int i, block = 0;
         for (i = msg->uri.a + 6; i < msg->uri.b && isdigit(inbuf[i]); ++i) {
@@ -978,19 +1077,18 @@ void *HttpWorker(void *arg) {
           block += inbuf[i] - '0';
           block &= 255;
         }
-        a = g_asset.plot + block;
+        slot = g_asset.plot + block;
       } else {
-        a = 0;
+        slot = 0;
       }
 
       // assert serving
-      if (a) {
+      if (slot && (a = PinAsset(id, slot))) {
         struct iovec iov[2];
         ++g_assetrequests;
+        ////////////////////////////////////////
         comp = a->gzip.n < a->data.n &&
                HeaderHas(msg, inbuf, kHttpAcceptEncoding, "gzip", 4);
-        ////////////////////////////////////////
-        nsync_mu_rlock(&a->lock);
         if (HasHeader(kHttpIfModifiedSince) &&
             a->mtim.tv_sec <=
                 ParseHttpDateTime(HeaderData(kHttpIfModifiedSince),
@@ -1036,7 +1134,7 @@ void *HttpWorker(void *arg) {
           outmsglen = iov[0].iov_len + iov[1].iov_len;
           sent = writev(client.sock, iov, 2);
         }
-        nsync_mu_runlock(&a->lock);
+        UnpinAsset(id);
         ////////////////////////////////////////
 
       } else if (UrlStartsWith("/ip")) {
@@ -1225,12 +1323,13 @@ void *HttpWorker(void *arg) {
              !HeaderEqualCase(kHttpConnection, "close") &&     //
              (msg->method == kHttpGet ||                       //
               msg->method == kHttpHead) &&                     //
-             1. / g_workers * g_connections < CONCERN_LOAD &&  //
+             1. / l->workers * l->busy < CONCERN_LOAD &&       //
              !nsync_note_is_notified(g_shutdown[1]));
     DestroyHttpMessage(msg);
     close(client.sock);
     g_worker[id].connected = false;
     --g_connections;
+    --l->busy;
   }
 
   LOG("HttpWorker #%d exiting", id);
@@ -1277,66 +1376,54 @@ struct Data Gzip(struct Data data) {
 }
 
 // slurps asset off disk once during startup
-struct Asset LoadAsset(const char *path, const char *type, int cash) {
+struct Asset *LoadAsset(const char *path, const char *type, int cash) {
   struct stat st;
-  struct Asset a = {0};
+  struct Asset *a;
+  CHECK_NOTNULL((a = calloc(1, sizeof(*a))));
   CHECK_EQ(0, stat(path, &st));
-  CHECK_NOTNULL((a.data.p = xslurp(path, &a.data.n)));
-  a.type = type;
-  a.cash = cash;
-  CHECK_NOTNULL((a.path = strdup(path)));
-  a.mtim = st.st_mtim;
-  CHECK_NOTNULL((a.gzip = Gzip(a.data)).p);
-  FormatUnixHttpDateTime(a.lastmodified, a.mtim.tv_sec);
+  CHECK_NOTNULL((a->data.p = xslurp(path, &a->data.n)));
+  a->type = type;
+  a->cash = cash;
+  a->path = path;
+  a->mtim = st.st_mtim;
+  CHECK_NOTNULL((a->gzip = Gzip(a->data)).p);
+  FormatUnixHttpDateTime(a->lastmodified, a->mtim.tv_sec);
   return a;
 }
 
 // reslurps asset off disk if its mtim changed
-bool ReloadAsset(struct Asset *a) {
+// this is only called by the supervisor thread, which is the sole
+// publisher of these assets, so it needn't pin the current version
+bool ReloadAsset(_Atomic(struct Asset *) *slot) {
   int fd;
-  void *f[2];
   ssize_t rc;
   struct stat st;
-  char lastmodified[32];
-  struct Data data = {0};
-  struct Data gzip = {0};
+  struct Asset *a, *b = 0;
+  a = atomic_load(slot);
   CHECK_SYS((fd = open(a->path, O_RDONLY)));
   CHECK_SYS(fstat(fd, &st));
   if (timespec_cmp(st.st_mtim, a->mtim) > 0) {
-    FormatUnixHttpDateTime(lastmodified, st.st_mtim.tv_sec);
-    CHECK_MEM((data.p = malloc(st.st_size)));
-    CHECK_SYS((rc = read(fd, data.p, st.st_size)));
-    data.n = st.st_size;
+    CHECK_MEM((b = calloc(1, sizeof(*b))));
+    b->path = a->path;
+    b->type = a->type;
+    b->cash = a->cash;
+    b->mtim = st.st_mtim;
+    FormatUnixHttpDateTime(b->lastmodified, st.st_mtim.tv_sec);
+    CHECK_MEM((b->data.p = malloc(st.st_size)));
+    CHECK_SYS((rc = read(fd, b->data.p, st.st_size)));
+    b->data.n = st.st_size;
     if (rc != st.st_size) goto OnError;
-    CHECK_MEM((gzip = Gzip(data)).p);
-    //!//!//!//!//!//!//!//!//!//!//!//!//!/
-    nsync_mu_lock(&a->lock);
-    f[0] = a->data.p;
-    f[1] = a->gzip.p;
-    a->data = data;
-    a->gzip = gzip;
-    a->mtim = st.st_mtim;
-    memcpy(a->lastmodified, lastmodified, 32);
-    nsync_mu_unlock(&a->lock);
-    //!//!//!//!//!//!//!//!//!//!//!//!//!/
-    free(f[0]);
-    free(f[1]);
+    CHECK_MEM((b->gzip = Gzip(b->data)).p);
+    Publish(slot, b);
   }
   close(fd);
   return true;
 OnError:
-  free(data.p);
-  free(gzip.p);
+  FreeAsset(b);
   close(fd);
   return false;
 }
 
-void FreeAsset(struct Asset *a) {
-  free(a->path);
-  free(a->data.p);
-  free(a->gzip.p);
-}
-
 void IgnoreSignal(int sig) {
   // so worker i/o routines may eintr safely
 }
@@ -1354,7 +1441,6 @@ void OnCtrlC(int sig) {
     // so if a user smashes that ctrl-c then we tkill the workers more
     LOG("Received %s again so sending another volley...\n", strsignal(sig));
     for (int i = 0; i < g_workers; ++i) {
-      pthread_kill(g_listener, SIGUSR1);
       if (!g_worker[i].shutdown) {
         pthread_kill(g_worker[i].th, SIGUSR1);
       }
@@ -1386,6 +1472,9 @@ void GetOpts(int argc, char *argv[]) {
       case 'v':
         ++__log_level;
         break;
+      case 'b':
+        g_benchmark = true;
+        break;
       case 'W':
         if ((ip = ParseIp(optarg, -1)) != -1) {
           if (InsertInt(&g_whitelisted, ip, true)) {
@@ -1406,41 +1495,308 @@ void GetOpts(int argc, char *argv[]) {
   }
 }
 
-// atomically swaps out asset with newer version
-void Update(struct Asset *a, bool gen(struct Asset *, long, long), long x,
-            long y) {
-  void *f[2];
-  struct Asset t;
+// generates new version of asset and publishes it
+void Update(_Atomic(struct Asset *) *slot,
+            bool gen(struct Asset *, long, long), long x, long y) {
+  struct Asset t, *a;
   if (gen(&t, x, y)) {
-    //!//!//!//!//!//!//!//!//!//!//!//!//!/
-    nsync_mu_lock(&a->lock);
-    f[0] = a->data.p;
-    f[1] = a->gzip.p;
-    a->data = t.data;
-    a->gzip = t.gzip;
-    a->mtim = t.mtim;
-    a->type = t.type;
-    a->cash = t.cash;
-    memcpy(a->lastmodified, t.lastmodified, 32);
-    nsync_mu_unlock(&a->lock);
-    //!//!//!//!//!//!//!//!//!//!//!//!//!/
-    free(f[0]);
-    free(f[1]);
+    if ((a = malloc(sizeof(*a)))) {
+      *a = t;
+      Publish(slot, a);
+    } else {
+      ++g_memfails;
+      free(t.data.p);
+      free(t.gzip.p);
+    }
   }
 }
 
-// generator function for the big board
-bool GenerateScore(struct Asset *out, long secs, long cash) {
+// runs sql statement that binds integers to ?1 and possibly ?2
+int DbRun(sqlite3 *db, const char *sql, long x, long y) {
+  int rc;
+  sqlite3_stmt *stmt;
+  if ((rc = DbPrepare(db, &stmt, sql))) return rc;
+  if (!(rc = sqlite3_bind_int64(stmt, 1, x)) &&
+      sqlite3_bind_parameter_count(stmt) > 1) {
+    rc = sqlite3_bind_int64(stmt, 2, y);
+  }
+  if (!rc && (rc = DbStep(stmt)) == SQLITE_DONE) rc = SQLITE_OK;
+  sqlite3_finalize(stmt);
+  return rc;
+}
+
+// returns leaderboard index for window in seconds, or -1 if unknown
+int GetBoard(long secs) {
+  for (int b = 0; b < BOARDS; ++b) {
+    if (kBoardSecs[b] == secs) {
+      return b;
+    }
+  }
+  return -1;
+}
+
+// returns true if land claimed at created counts on board b
+bool IsScored(int b, long created) {
+  return kBoardSecs[b] == -1 || created >= g_scores.since[b];
+}
+
+// returns leaderboard entry for nick, creating it if needed
+struct Score *GetScore(const char *nick) {
+  int c, l, m, r;
+  struct Score *s, **p;
+  l = 0;
+  r = g_scores.n - 1;
+  while (l <= r) {
+    m = (l & r) + ((l ^ r) >> 1);  // floor((a+b)/2)
+    if ((c = strcmp(g_scores.p[m]->nick, nick)) < 0) {
+      l = m + 1;
+    } else if (c > 0) {
+      r = m - 1;
+    } else {
+      return g_scores.p[m];
+    }
+  }
+  if (g_scores.n == g_scores.c) {
+    c = g_scores.c + (g_scores.c >> 1) + 16;
+    if (!(p = realloc(g_scores.p, c * sizeof(*p)))) return 0;
+    g_scores.p = p;
+    g_scores.c = c;
+  }
+  if (!(s = calloc(1, sizeof(*s)))) return 0;
+  strlcpy(s->nick, nick, sizeof(s->nick));
+  memmove(g_scores.p + l + 1, g_scores.p + l,
+          (g_scores.n - l) * sizeof(*g_scores.p));
+  g_scores.p[l] = s;
+  ++g_scores.n;
+  return s;
+}
+
+// returns counters for nick's land in /8 block, creating if needed
+struct Cell *GetCell(struct Score *s, int block) {
+  int c, l, m, r;
+  struct Cell *p;
+  l = 0;
+  r = s->n;
+  while (l < r) {
+    m = (l & r) + ((l ^ r) >> 1);  // floor((a+b)/2)
+    if (s->p[m].block < block) {
+      l = m + 1;
+    } else {
+      r = m;
+    }
+  }
+  if (l < s->n && s->p[l].block == block) {
+    return s->p + l;
+  }
+  if (s->n == s->c) {
+    c = s->c + (s->c >> 1) + 4;
+    if (!(p = realloc(s->p, c * sizeof(*p)))) return 0;
+    s->p = p;
+    s->c = c;
+  }
+  memmove(s->p + l + 1, s->p + l, (s->n - l) * sizeof(*s->p));
+  bzero(s->p + l, sizeof(*s->p));
+  s->p[l].block = block;
+  ++s->n;
+  return s->p + l;
+}
+
+// adjusts count of nick's land in /8 block on board b by delta
+// if stmt is non-null then it's used to persist the delta too
+// this must be called with g_scores.mu held
+int ChangeScore(sqlite3_stmt *stmt, int b, const char *nick, int block,
+                long delta) {
   int rc;
+  struct Cell *c;
+  struct Score *s;
+  if (!(s = GetScore(nick)) || !(c = GetCell(s, block))) {
+    return SQLITE_NOMEM;
+  }
+  c->count[b] += delta;
+  s->fresh &= ~(1u << b);
+  if (!stmt) return SQLITE_OK;
+  if ((rc = sqlite3_bind_int64(stmt, 1, kBoardSecs[b])) ||
+      (rc = sqlite3_bind_text(stmt, 2, nick, -1, SQLITE_TRANSIENT)) ||
+      (rc = sqlite3_bind_int(stmt, 3, block)) ||
+      (rc = sqlite3_bind_int64(stmt, 4, delta))) {
+    return rc;
+  }
+  rc = DbStep(stmt);
+  sqlite3_reset(stmt);
+  return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+void FreeScores(void) {
+  int i, b;
+  for (i = 0; i < g_scores.n; ++i) {
+    for (b = 0; b < BOARDS; ++b) {
+      free(g_scores.p[i]->json[b]);
+    }
+    free(g_scores.p[i]->p);
+    free(g_scores.p[i]);
+  }
+  free(g_scores.p);
+  g_scores.p = 0;
+  g_scores.n = 0;
+  g_scores.c = 0;
+}
+
+// reads leaderboards from database into memory
+// boards that aren't in the database get counted from scratch
+// this must be called with g_scores.mu held
+bool LoadScores(sqlite3 *db) {
+  int b, rc;
+  long now;
+  unsigned found;
+  sqlite3_stmt *stmt = 0;
+  FreeScores();
+  g_scores.loaded = false;
+  now = timespec_real().tv_sec;
+  CHECK_SQL(sqlite3_exec(db,
+                         "CREATE TABLE IF NOT EXISTS score (\n"
+                         "    secs INTEGER NOT NULL,\n"
+                         "    nick TEXT NOT NULL,\n"
+                         "    block INTEGER NOT NULL,\n"
+                         "    count INTEGER NOT NULL,\n"
+                         "    PRIMARY KEY (secs, nick, block)\n"
+                         ") WITHOUT ROWID;\n"
+                         "CREATE TABLE IF NOT EXISTS board (\n"
+                         "    secs INTEGER PRIMARY KEY,\n"
+                         "    since INTEGER NOT NULL\n"
+                         ")",
+                         0, 0, 0));
+  CHECK_SQL(sqlite3_exec(db, "BEGIN TRANSACTION", 0, 0, 0));
+  found = 0;
+  CHECK_DB(DbPrepare(db, &stmt, "SELECT secs, since FROM board"));
+  while ((rc = DbStep(stmt)) != SQLITE_DONE) {
+    if (rc != SQLITE_ROW) CHECK_DB(rc);
+    if ((b = GetBoard(sqlite3_column_int64(stmt, 0))) != -1) {
+      g_scores.since[b] = sqlite3_column_int64(stmt, 1);
+      found |= 1u << b;
+    }
+  }
+  CHECK_DB(sqlite3_finalize(stmt));
+  stmt = 0;
+  for (b = 0; b < BOARDS; ++b) {
+    if (found & 1u << b) continue;
+    LOG("Counting %ld second leaderboard...\n", kBoardSecs[b]);
+    g_scores.since[b] = kBoardSecs[b] == -1 ? 0 : now - kBoardSecs[b];
+    CHECK_DB(DbRun(db, "DELETE FROM score WHERE secs = ?1", kBoardSecs[b], 0));
+    CHECK_DB(DbRun(db,
+                   "INSERT INTO score (secs, nick, block, count)\n"
+                   "SELECT ?1, nick, (ip >> 24), COUNT(*)\n"
+                   "  FROM land\n"
+                   " WHERE ?1 = -1\n"
+                   "    OR created >= ?2\n"
+                   " GROUP BY nick, (ip >> 24)",
+                   kBoardSecs[b], g_scores.since[b]));
+    CHECK_DB(DbRun(db,
+                   "INSERT OR REPLACE INTO board (secs, since)\n"
+                   "VALUES (?1, ?2)",
+                   kBoardSecs[b], g_scores.since[b]));
+  }
+  CHECK_DB(DbPrepare(db, &stmt,
+                     "SELECT secs, nick, block, count\n"
+                     "  FROM score\n"
+                     " WHERE count != 0"));
+  while ((rc = DbStep(stmt)) != SQLITE_DONE) {
+    if (rc != SQLITE_ROW) CHECK_DB(rc);
+    if ((b = GetBoard(sqlite3_column_int64(stmt, 0))) != -1) {
+      CHECK_DB(ChangeScore(0, b, (void *)sqlite3_column_text(stmt, 1),
+                           sqlite3_column_int(stmt, 2),
+                           sqlite3_column_int64(stmt, 3)));
+    }
+  }
+  CHECK_DB(sqlite3_finalize(stmt));
+  stmt = 0;
+  CHECK_SQL(sqlite3_exec(db, "COMMIT TRANSACTION", 0, 0, 0));
+  g_scores.loaded = true;
+  return true;
+OnError:
+  sqlite3_finalize(stmt);
+  sqlite3_exec(db, "ROLLBACK TRANSACTION", 0, 0, 0);
+  return false;
+}
+
+// subtracts land that aged out of windowed board b since last time
+// which only needs to visit claims made during the elapsed interval
+// this must be called with g_scores.mu held
+bool ExpireScores(sqlite3 *db, int b, long now) {
+  int rc;
+  long since;
+  sqlite3_stmt *stmt = 0;
+  sqlite3_stmt *save = 0;
+  if (kBoardSecs[b] == -1) return true;
+  if ((since = now - kBoardSecs[b]) <= g_scores.since[b]) return true;
+  CHECK_SQL(sqlite3_exec(db, "BEGIN TRANSACTION", 0, 0, 0));
+  CHECK_DB(DbPrepare(db, &save, kSaveScore));
+  CHECK_DB(DbPrepare(db, &stmt,
+                     "SELECT nick, (ip >> 24)\n"
+                     "  FROM land\n"
+                     " WHERE created >= ?1\n"
+                     "   AND created < ?2"));
+  CHECK_DB(sqlite3_bind_int64(stmt, 1, g_scores.since[b]));
+  CHECK_DB(sqlite3_bind_int64(stmt, 2, since));
+  while ((rc = DbStep(stmt)) != SQLITE_DONE) {
+    if (rc != SQLITE_ROW) CHECK_DB(rc);
+    CHECK_DB(ChangeScore(save, b, (void *)sqlite3_column_text(stmt, 0),
+                         sqlite3_column_int(stmt, 1), -1));
+  }
+  CHECK_DB(DbRun(db, "UPDATE board SET since = ?2 WHERE secs = ?1",
+                 kBoardSecs[b], since));
+  CHECK_SQL(sqlite3_exec(db, "COMMIT TRANSACTION", 0, 0, 0));
+  CHECK_DB(sqlite3_finalize(stmt));
+  CHECK_DB(sqlite3_finalize(save));
+  g_scores.since[b] = since;
+  return true;
+OnError:
+  sqlite3_finalize(stmt);
+  sqlite3_finalize(save);
+  sqlite3_exec(db, "ROLLBACK TRANSACTION", 0, 0, 0);
+  g_scores.loaded = false;
+  return false;
+}
+
+// formats json for nick's land on board b unless it's cached
+// this must be called with g_scores.mu held
+bool FormatScore(struct Score *s, int b, char **sb, size_t *sblen) {
+  int i;
+  if (s->fresh & 1u << b) return true;
+  free(s->json[b]);
+  s->json[b] = 0;
+  if (IsValidNick(s->nick, -1)) {
+    for (i = 0; i < s->n; ++i) {
+      if (!s->p[i].count[b]) continue;
+      if (!s->json[b]) {
+        CHECK_SYS(appendf(
+            &s->json[b], "\"%s\":[\n",
+            EscapeJsStringLiteral(sb, sblen, s->nick, -1, 0)));
+      } else {
+        CHECK_SYS(appends(&s->json[b], ",\n"));
+      }
+      CHECK_SYS(appendf(&s->json[b], "  [%d,%ld]", s->p[i].block,
+                        s->p[i].count[b]));
+    }
+  }
+  s->fresh |= 1u << b;
+  return true;
+OnError:
+  free(s->json[b]);
+  s->json[b] = 0;
+  return false;
+}
+
+// generator function for the big board
+bool GenerateScore(struct Asset *out, long b, long cash) {
+  int i;
   char *sb = 0;
   sqlite3 *db = 0;
   size_t sblen = 0;
+  struct Score *s;
   struct Asset a = {0};
-  sqlite3_stmt *stmt = 0;
   bool namestate = false;
-  char name1[NICK_MAX + 1] = {0};
-  char name2[NICK_MAX + 1];
-  DEBUG("GenerateScore %ld\n", secs);
+  bool locked = false;
+  DEBUG("GenerateScore %ld\n", kBoardSecs[b]);
   a.type = "application/json";
   a.cash = cash;
   a.mtim = timespec_real();
@@ -1450,53 +1806,33 @@ bool GenerateScore(struct Asset *out, long secs, long cash) {
                     a.mtim.tv_nsec));
   CHECK_SYS(appends(&a.data.p, "\"score\":{\n"));
   CHECK_SQL(DbOpen("db.sqlite3", &db));
-  if (secs == -1) {
-    CHECK_DB(DbPrepare(db, &stmt,
-                       "SELECT nick, (ip >> 24), COUNT(*)\n"
-                       "FROM land\n"
-                       "GROUP BY nick, (ip >> 24)"));
-  } else {
-    CHECK_DB(DbPrepare(db, &stmt,
-                       "SELECT nick, (ip >> 24), COUNT(*)\n"
-                       " FROM land\n"
-                       "WHERE created NOT NULL\n"
-                       "  AND created >= ?1\n"
-                       "GROUP BY nick, (ip >> 24)"));
-    CHECK_DB(sqlite3_bind_int64(stmt, 1, a.mtim.tv_sec - secs));
-  }
-  // be sure to always use transactions with sqlite as in always
-  // otherwise.. you can use --strace to see the fcntl bloodbath
-  CHECK_SQL(sqlite3_exec(db, "BEGIN TRANSACTION", 0, 0, 0));
-  while ((rc = DbStep(stmt)) != SQLITE_DONE) {
-    if (rc != SQLITE_ROW) CHECK_DB(rc);
-    strlcpy(name2, (void *)sqlite3_column_text(stmt, 0), sizeof(name2));
-    if (!IsValidNick(name2, -1)) continue;
-    if (strcmp(name1, name2)) {
-      // name changed
-      if (namestate) CHECK_SYS(appends(&a.data.p, "],\n"));
-      namestate = true;
-      CHECK_SYS(appendf(
-          &a.data.p, "\"%s\":[\n",
-          EscapeJsStringLiteral(&sb, &sblen, strcpy(name1, name2), -1, 0)));
-    } else {
-      // name repeated
-      CHECK_SYS(appends(&a.data.p, ",\n"));
-    }
-    CHECK_SYS(appendf(&a.data.p, "  [%ld,%ld]", sqlite3_column_int64(stmt, 1),
-                      sqlite3_column_int64(stmt, 2)));
+  //!//!//!//!//!//!//!//!//!//!//!//!//!/
+  nsync_mu_lock(&g_scores.mu);
+  locked = true;
+  if (!g_scores.loaded && !LoadScores(db)) goto OnError;
+  if (!ExpireScores(db, b, a.mtim.tv_sec)) goto OnError;
+  for (i = 0; i < g_scores.n; ++i) {
+    s = g_scores.p[i];
+    if (!FormatScore(s, b, &sb, &sblen)) goto OnError;
+    if (!s->json[b]) continue;
+    if (namestate) CHECK_SYS(appends(&a.data.p, "],\n"));
+    CHECK_SYS(appendd(&a.data.p, s->json[b], appendz(s->json[b]).i));
+    namestate = true;
   }
-  CHECK_SQL(sqlite3_exec(db, "END TRANSACTION", 0, 0, 0));
+  nsync_mu_unlock(&g_scores.mu);
+  locked = false;
+  //!//!//!//!//!//!//!//!//!//!//!//!//!/
+  CHECK_SQL(sqlite3_close(db));
+  db = 0;
   if (namestate) CHECK_SYS(appends(&a.data.p, "]\n"));
   CHECK_SYS(appends(&a.data.p, "}}\n"));
-  CHECK_DB(sqlite3_finalize(stmt));
-  CHECK_SQL(sqlite3_close(db));
   a.data.n = appendz(a.data.p).i;
   a.gzip = Gzip(a.data);
   free(sb);
   *out = a;
   return true;
 OnError:
-  sqlite3_finalize(stmt);
+  if (locked) nsync_mu_unlock(&g_scores.mu);
   sqlite3_close(db);
   free(a.data.p);
   free(sb);
@@ -1571,10 +1907,10 @@ void *ScoreWorker(void *arg) {
   pthread_setname_np(pthread_self(), "ScoreAll");
   LOG("%P Score started\n");
   long wait = SCORE_UPDATE_MS;
-  Update(&g_asset.score, GenerateScore, -1, MS2CASH(wait));
+  Update(&g_asset.score, GenerateScore, 0, MS2CASH(wait));
   nsync_counter_add(g_ready, -1);  // #1
   do {
-    Update(&g_asset.score, GenerateScore, -1, MS2CASH(wait));
+    Update(&g_asset.score, GenerateScore, 0, MS2CASH(wait));
   } while (!nsync_note_wait(g_shutdown[1], WaitFor(wait)));
   LOG("Score exiting\n");
   return 0;
@@ -1585,12 +1921,11 @@ void *ScoreHourWorker(void *arg) {
   BlockSignals();
   pthread_setname_np(pthread_self(), "ScoreHour");
   LOG("%P ScoreHour started\n");
-  long secs = 60L * 60;
   long wait = SCORE_H_UPDATE_MS;
-  Update(&g_asset.score_hour, GenerateScore, secs, MS2CASH(wait));
+  Update(&g_asset.score_hour, GenerateScore, 1, MS2CASH(wait));
   nsync_counter_add(g_ready, -1);  // #2
   do {
-    Update(&g_asset.score_hour, GenerateScore, secs, MS2CASH(wait));
+    Update(&g_asset.score_hour, GenerateScore, 1, MS2CASH(wait));
   } while (!nsync_note_wait(g_shutdown[1], WaitFor(wait)));
   LOG("ScoreHour exiting\n");
   return 0;
@@ -1601,12 +1936,11 @@ void *ScoreDayWorker(void *arg) {
   BlockSignals();
   pthread_setname_np(pthread_self(), "ScoreDay");
   LOG("%P ScoreDay started\n");
-  long secs = 60L * 60 * 24;
   long wait = SCORE_D_UPDATE_MS;
-  Update(&g_asset.score_day, GenerateScore, secs, MS2CASH(wait));
+  Update(&g_asset.score_day, GenerateScore, 2, MS2CASH(wait));
   nsync_counter_add(g_ready, -1);  // #3
   do {
-    Update(&g_asset.score_day, GenerateScore, secs, MS2CASH(wait));
+    Update(&g_asset.score_day, GenerateScore, 2, MS2CASH(wait));
   } while (!nsync_note_wait(g_shutdown[1], WaitFor(wait)));
   LOG("ScoreDay exiting\n");
   return 0;
@@ -1617,12 +1951,11 @@ void *ScoreWeekWorker(void *arg) {
   BlockSignals();
   pthread_setname_np(pthread_self(), "ScoreWeek");
   LOG("%P ScoreWeek started\n");
-  long secs = 60L * 60 * 24 * 7;
   long wait = SCORE_W_UPDATE_MS;
-  Update(&g_asset.score_week, GenerateScore, secs, MS2CASH(wait));
+  Update(&g_asset.score_week, GenerateScore, 3, MS2CASH(wait));
   nsync_counter_add(g_ready, -1);  // #4
   do {
-    Update(&g_asset.score_week, GenerateScore, secs, MS2CASH(wait));
+    Update(&g_asset.score_week, GenerateScore, 3, MS2CASH(wait));
   } while (!nsync_note_wait(g_shutdown[1], WaitFor(wait)));
   LOG("ScoreWeek exiting\n");
   return 0;
@@ -1633,12 +1966,11 @@ void *ScoreMonthWorker(void *arg) {
   BlockSignals();
   pthread_setname_np(pthread_self(), "ScoreMonth");
   LOG("%P ScoreMonth started\n");
-  long secs = 60L * 60 * 24 * 30;
   long wait = SCORE_M_UPDATE_MS;
-  Update(&g_asset.score_month, GenerateScore, secs, MS2CASH(wait));
+  Update(&g_asset.score_month, GenerateScore, 4, MS2CASH(wait));
   nsync_counter_add(g_ready, -1);  // #5
   do {
-    Update(&g_asset.score_month, GenerateScore, secs, MS2CASH(wait));
+    Update(&g_asset.score_month, GenerateScore, 4, MS2CASH(wait));
   } while (!nsync_note_wait(g_shutdown[1], WaitFor(wait)));
   LOG("ScoreMonth exiting\n");
   return 0;
@@ -1667,7 +1999,6 @@ void *PlotWorker(void *arg) {
 // thread for realtime json generation of recent successful claims
 void *RecentWorker(void *arg) {
   bool once;
-  void *f[2];
   int rc, err;
   sqlite3 *db;
   char *sb = 0;
@@ -1713,22 +2044,12 @@ StartOver:
     t.data.n = appendz(t.data.p).i;
     CHECK_MEM((t.gzip = Gzip(t.data)).p);
     // deploy json
-    a = &g_asset.recent;
-    //!//!//!//!//!//!//!//!//!//!//!//!//!/
-    nsync_mu_lock(&a->lock);
-    f[0] = a->data.p;
-    f[1] = a->gzip.p;
-    a->data = t.data;
-    a->gzip = t.gzip;
-    a->mtim = t.mtim;
-    a->type = "application/json";
-    a->cash = 0;
-    memcpy(a->lastmodified, t.lastmodified, 32);
-    nsync_mu_unlock(&a->lock);
-    //!//!//!//!//!//!//!//!//!//!//!//!//!/
+    t.type = "application/json";
+    t.cash = 0;
+    CHECK_MEM((a = malloc(sizeof(*a))));
+    *a = t;
+    Publish(&g_asset.recent, a);
     bzero(&t, sizeof(t));
-    free(f[0]);
-    free(f[1]);
     // handle startup condition
     if (!warmedup) {
       nsync_counter_add(g_ready, -1);  // #7
@@ -1757,9 +2078,11 @@ OnError:
 // this helps us avoid over 9000 threads having fcntl bloodbath
 void *ClaimWorker(void *arg) {
   sqlite3 *db;
-  int i, n, rc;
-  long processed;
-  sqlite3_stmt *stmt;
+  int b, i, n, rc;
+  long processed, created;
+  bool locked, existed;
+  char nick[NICK_MAX + 1];
+  sqlite3_stmt *stmt, *prev, *save;
   bool warmedup = false;
   struct Claim *v = _gc(xcalloc(BATCH_MAX, sizeof(struct Claim)));
   BlockSignals();
@@ -1768,7 +2091,19 @@ void *ClaimWorker(void *arg) {
 StartOver:
   db = 0;
   stmt = 0;
+  prev = 0;
+  save = 0;
+  locked = false;
   CHECK_SQL(DbOpen("db.sqlite3", &db));
+  nsync_mu_lock(&g_scores.mu);
+  locked = true;
+  if (!g_scores.loaded && !LoadScores(db)) goto OnError;  // creates tables
+  nsync_mu_unlock(&g_scores.mu);
+  locked = false;
+  CHECK_DB(DbPrepare(db, &prev,
+                     "SELECT nick, created\n"
+                     "  FROM land\n"
+                     " WHERE ip = ?1"));
   CHECK_DB(DbPrepare(db, &stmt,
                      "INSERT INTO land (ip, nick, created)\n"
                      "VALUES (?1, ?2, ?3)\n"
@@ -1777,23 +2112,53 @@ StartOver:
                      " WHERE nick != ?2\n"
                      "    OR created IS NULL\n"
                      "    OR ?3 - created > 3600"));
+  CHECK_DB(DbPrepare(db, &save, kSaveScore));
   if (!warmedup) {
     nsync_counter_add(g_ready, -1);  // #8
     warmedup = true;
   }
   while ((n = GetClaims(&g_claims, v, BATCH_MAX))) {
     processed = 0;
+    //!//!//!//!//!//!//!//!//!//!//!//!//!/
+    nsync_mu_lock(&g_scores.mu);
+    locked = true;
+    if (!g_scores.loaded && !LoadScores(db)) goto OnError;
     CHECK_SQL(sqlite3_exec(db, "BEGIN TRANSACTION", 0, 0, 0));
     for (i = 0; i < n; ++i) {
+      // find out who owned this land previously
+      CHECK_DB(sqlite3_bind_int64(prev, 1, v[i].ip));
+      if ((rc = DbStep(prev)) == SQLITE_ROW) {
+        strlcpy(nick, (void *)sqlite3_column_text(prev, 0), sizeof(nick));
+        created = sqlite3_column_int64(prev, 1);
+        existed = true;
+      } else {
+        CHECK_DB(rc == SQLITE_DONE ? SQLITE_OK : rc);
+        existed = false;
+      }
+      CHECK_DB(sqlite3_reset(prev));
       CHECK_DB(sqlite3_bind_int64(stmt, 1, v[i].ip));
       CHECK_DB(sqlite3_bind_text(stmt, 2, v[i].name, -1, SQLITE_TRANSIENT));
       CHECK_DB(sqlite3_bind_int64(stmt, 3, v[i].created));
       CHECK_DB(sqlite3_bind_int64(stmt, 3, v[i].created));
       CHECK_DB((rc = DbStep(stmt)) == SQLITE_DONE ? SQLITE_OK : rc);
       CHECK_DB(sqlite3_reset(stmt));
+      // move land between leaderboard counts if claim took effect
+      if (sqlite3_changes(db)) {
+        for (b = 0; b < BOARDS; ++b) {
+          if (existed && IsScored(b, created)) {
+            CHECK_DB(ChangeScore(save, b, nick, v[i].ip >> 24, -1));
+          }
+          if (IsScored(b, v[i].created)) {
+            CHECK_DB(ChangeScore(save, b, v[i].name, v[i].ip >> 24, +1));
+          }
+        }
+      }
       ++processed;
     }
     CHECK_SQL(sqlite3_exec(db, "COMMIT TRANSACTION", 0, 0, 0));
+    nsync_mu_unlock(&g_scores.mu);
+    locked = false;
+    //!//!//!//!//!//!//!//!//!//!//!//!//!/
     atomic_fetch_add(&g_claimsprocessed, processed);
     DEBUG("Committed %d claims\n", n);
     // wake up RecentWorker()
@@ -1801,11 +2166,20 @@ StartOver:
     nsync_cv_signal(&g_recent.cv);
     nsync_mu_unlock(&g_recent.mu);
   }
+  CHECK_DB(sqlite3_finalize(save));
+  CHECK_DB(sqlite3_finalize(prev));
   CHECK_DB(sqlite3_finalize(stmt));
   CHECK_SQL(sqlite3_close(db));
   LOG("ClaimWorker exiting\n");
   return 0;
 OnError:
+  if (locked) {
+    // rolled back deltas may have been applied to memory already
+    g_scores.loaded = false;
+    nsync_mu_unlock(&g_scores.mu);
+  }
+  sqlite3_finalize(save);
+  sqlite3_finalize(prev);
   sqlite3_finalize(stmt);
   sqlite3_close(db);
   goto StartOver;
@@ -1851,14 +2225,16 @@ void *ReplenishWorker(void *arg) {
 // moment worker resources start becoming scarce. when that happens
 // we'll (1) cancel read operations that have not sent us a message
 // in a while; (2) cancel clients who are sending lots of messages.
-void Meltdown(void) {
+// it's done per listener group, since a group can't borrow workers
+// from the others, so it's only the group's own load which matters
+void Meltdown(struct Listener *l) {
   int i, marks;
   struct timespec now;
   ++g_meltdowns;
-  LOG("Panicking because %d out of %d workers is connected\n", g_connections,
-      g_workers);
+  LOG("Panicking because %d out of %d workers in group %d is connected\n",
+      l->busy, l->workers, (int)(l - g_listener));
   now = timespec_real();
-  for (marks = i = 0; i < g_workers; ++i) {
+  for (marks = 0, i = l - g_listener; i < g_workers; i += g_listeners) {
     if (g_worker[i].connected &&
         (g_worker[i].msgcount > PANIC_MSGS ||
          timespec_cmp(timespec_sub(now, g_worker[i].startread),
@@ -1874,13 +2250,17 @@ void Meltdown(void) {
 void *Supervisor(void *arg) {
   for (;;) {
     if (!nsync_note_wait(g_shutdown[0], WaitFor(SUPERVISE_MS))) {
-      if (g_workers > 1 && 1. / g_workers * g_connections > PANIC_LOAD) {
-        Meltdown();
+      for (int i = 0; i < g_listeners; ++i) {
+        if (g_listener[i].workers > 1 &&
+            1. / g_listener[i].workers * g_listener[i].busy > PANIC_LOAD) {
+          Meltdown(g_listener + i);
+        }
       }
       ReloadAsset(&g_asset.index);
       ReloadAsset(&g_asset.about);
       ReloadAsset(&g_asset.user);
       ReloadAsset(&g_asset.favicon);
+      Reclaim();
     } else {
       break;
     }
@@ -1894,6 +2274,8 @@ void CheckDatabase(void) {
     CHECK_SQL(DbOpen("db.sqlite3", &db));
     LOG("Checking database integrity...\n");
     CHECK_SQL(sqlite3_exec(db, "PRAGMA integrity_check", 0, 0, 0));
+    LOG("Forgetting leaderboards so they'll be recounted...\n");
+    CHECK_SQL(sqlite3_exec(db, "DROP TABLE IF EXISTS board", 0, 0, 0));
     LOG("Vacuuming database...\n");
     CHECK_SQL(sqlite3_exec(db, "VACUUM", 0, 0, 0));
     CHECK_SQL(sqlite3_close(db));
@@ -1903,6 +2285,120 @@ OnError:
   exit(1);
 }
 
+// state shared by benchmark threads
+struct Bench {
+  bool locked;
+  atomic_int go;
+  atomic_int stop;
+  atomic_long reads;
+  atomic_long writes;
+  nsync_mu mu;
+  struct Asset *asset;
+  _Atomic(struct Asset *) slot;
+} g_bench;
+
+struct Asset *NewBenchAsset(void) {
+  struct Asset *a;
+  a = xcalloc(1, sizeof(*a));
+  a->data.n = 512;
+  a->data.p = xmalloc(a->data.n);
+  memset(a->data.p, 'x', a->data.n);
+  a->type = "text/plain";
+  a->mtim = timespec_real();
+  return a;
+}
+
+// reads asset in a loop, using either a lock or a pinned snapshot
+void *BenchReader(void *arg) {
+  long n, sum;
+  struct Asset *a;
+  int id = (intptr_t)arg;
+  while (!g_bench.go) sched_yield();
+  for (sum = n = 0; !g_bench.stop; ++n) {
+    if (g_bench.locked) {
+      nsync_mu_rlock(&g_bench.mu);
+      a = g_bench.asset;
+      sum += a->data.n + a->data.p[n & 511] + a->mtim.tv_nsec;
+      nsync_mu_runlock(&g_bench.mu);
+    } else {
+      a = PinAsset(id, &g_bench.slot);
+      sum += a->data.n + a->data.p[n & 511] + a->mtim.tv_nsec;
+      UnpinAsset(id);
+    }
+  }
+  g_bench.reads += n;
+  return (void *)sum;
+}
+
+// replaces asset every millisecond while readers are running
+void *BenchWriter(void *arg) {
+  struct Asset *a, *old;
+  while (!g_bench.go) sched_yield();
+  while (!g_bench.stop) {
+    a = NewBenchAsset();
+    if (g_bench.locked) {
+      nsync_mu_lock(&g_bench.mu);
+      old = g_bench.asset;
+      g_bench.asset = a;
+      nsync_mu_unlock(&g_bench.mu);
+      FreeAsset(old);
+    } else {
+      Publish(&g_bench.slot, a);
+    }
+    ++g_bench.writes;
+    usleep(1000);
+  }
+  return 0;
+}
+
+// measures how asset reads scale as http workers are added, comparing
+// the reader lock that assets used to have against pinned snapshots
+void Benchmark(void) {
+  long ns;
+  pthread_t w, *th;
+  struct timespec t1, t2;
+  static const int kReaders[] = {1, 10, 100, 1000};
+  g_workers = kReaders[ARRAYLEN(kReaders) - 1];
+  g_worker = xcalloc(g_workers, sizeof(*g_worker));
+  th = xcalloc(g_workers, sizeof(*th));
+  g_bench.asset = NewBenchAsset();
+  g_bench.slot = NewBenchAsset();
+  kprintf("%-8s %8s %12s %10s %8s\n", "mode", "readers", "reads/sec",
+          "ns/read", "writes");
+  for (int m = 0; m < 2; ++m) {
+    for (int k = 0; k < ARRAYLEN(kReaders); ++k) {
+      g_bench.locked = !m;
+      g_bench.go = false;
+      g_bench.stop = false;
+      g_bench.reads = 0;
+      g_bench.writes = 0;
+      for (intptr_t i = 0; i < kReaders[k]; ++i) {
+        CHECK_EQ(0, pthread_create(th + i, 0, BenchReader, (void *)i));
+      }
+      CHECK_EQ(0, pthread_create(&w, 0, BenchWriter, 0));
+      t1 = timespec_real();
+      g_bench.go = true;
+      usleep(500000);
+      g_bench.stop = true;
+      t2 = timespec_real();
+      CHECK_EQ(0, pthread_join(w, 0));
+      for (int i = 0; i < kReaders[k]; ++i) {
+        CHECK_EQ(0, pthread_join(th[i], 0));
+      }
+      ns = timespec_tonanos(timespec_sub(t2, t1));
+      kprintf("%-8s %8d %12ld %10ld %8ld\n", m ? "snapshot" : "rwlock",
+              kReaders[k], g_bench.reads * 1000000000 / ns,
+              ns / MAX(1, g_bench.reads), g_bench.writes);
+    }
+  }
+  Reclaim();
+  CHECK_EQ(NULL, g_retired.list);
+  FreeAsset(g_bench.slot);
+  FreeAsset(g_bench.asset);
+  free(th);
+  free(g_worker);
+}
+
 int main(int argc, char *argv[]) {
   // ShowCrashReports();
 
@@ -1919,6 +2415,10 @@ int main(int argc, char *argv[]) {
 
   // user interface
   GetOpts(argc, argv);
+  if (g_benchmark) {
+    Benchmark();
+    return 0;
+  }
   kprintf("\
  |               _|                    \n\
  __| |   |  __| | \\ \\  \\   / _` |  __|\n\
@@ -1978,6 +2478,9 @@ int main(int argc, char *argv[]) {
   g_asset.user = LoadAsset("user.html", "text/html; charset=utf-8", 900);
   g_asset.favicon = LoadAsset("favicon.ico", "image/vnd.microsoft.icon", 86400);
 
+  // helpers publishing assets need to see which ones workers pinned
+  g_worker = xcalloc(g_workers, sizeof(*g_worker));
+
   // sandbox ourselves
   __pledge_mode = PLEDGE_PENALTY_RETURN_EPERM;
   CHECK_EQ(0, unveil("/opt/turfwar", "rwc"));
@@ -2018,12 +2521,19 @@ int main(int argc, char *argv[]) {
     nsync_counter_wait(g_ready, nsync_time_no_deadline);
   }
 
-  // create one thread to listen
-  CHECK_EQ(0, pthread_create(&g_listener, 0, ListenWorker, 0));
+  // create listening sockets, one per group of workers
+  // only linux load balances connections across reuseport sockets
+  g_listeners = IsLinux() ? MIN(CPUS, __get_cpu_count()) : 1;
+  g_listeners = MAX(1, MIN(g_listeners, g_workers));
+  g_listener = xcalloc(g_listeners, sizeof(*g_listener));
+  for (int i = 0; i < g_listeners; ++i) {
+    g_listener[i].workers = g_workers / g_listeners;
+    g_listener[i].workers += i < g_workers % g_listeners;
+    Listen(g_listener + i);
+  }
 
   // create lots of http workers to serve those assets
   LOG("Online\n");
-  g_worker = xcalloc(g_workers, sizeof(*g_worker));
   for (intptr_t i = 0; i < g_workers; ++i) {
     CHECK_EQ(0, pthread_create(&g_worker[i].th, 0, HttpWorker, (void *)i));
   }
@@ -2032,10 +2542,12 @@ int main(int argc, char *argv[]) {
   LOG("Ready\n");
   Supervisor(0);
 
-  // cancel listen() so we stop accepting new clients
+  // cancel accept() so we stop accepting new clients
   LOG("Interrupting listen...\n");
-  pthread_kill(g_listener, SIGUSR1);
-  pthread_join(g_listener, 0);
+  nsync_note_notify(g_shutdown[1]);
+  for (int i = 0; i < g_listeners; ++i) {
+    shutdown(g_listener[i].fd, SHUT_RD);
+  }
 
   // cancel read() so that keepalive clients finish faster
   LOG("Interrupting workers...\n");
@@ -2048,6 +2560,9 @@ int main(int argc, char *argv[]) {
   for (int i = 0; i < g_workers; ++i) {
     CHECK_EQ(0, pthread_join(g_worker[i].th, 0));
   }
+  for (int i = 0; i < g_listeners; ++i) {
+    close(g_listener[i].fd);
+  }
   LOG("Waiting for helpers to finish...\n");
   CHECK_EQ(0, pthread_join(nower, 0));
   CHECK_EQ(0, pthread_join(scorer, 0));
@@ -2072,21 +2587,28 @@ int main(int argc, char *argv[]) {
 
   // free memory
   LOG("Freeing memory...\n");
-  FreeAsset(&g_asset.user);
-  FreeAsset(&g_asset.about);
-  FreeAsset(&g_asset.index);
-  FreeAsset(&g_asset.score);
-  FreeAsset(&g_asset.score_hour);
-  FreeAsset(&g_asset.score_day);
-  FreeAsset(&g_asset.score_week);
-  FreeAsset(&g_asset.score_month);
-  FreeAsset(&g_asset.recent);
-  FreeAsset(&g_asset.favicon);
+  Reclaim();
+  CHECK_EQ(NULL, g_retired.list);
+  FreeAsset(g_asset.user);
+  FreeAsset(g_asset.about);
+  FreeAsset(g_asset.index);
+  FreeAsset(g_asset.score);
+  FreeAsset(g_asset.score_hour);
+  FreeAsset(g_asset.score_day);
+  FreeAsset(g_asset.score_week);
+  FreeAsset(g_asset.score_month);
+  FreeAsset(g_asset.recent);
+  FreeAsset(g_asset.favicon);
+  for (int i = 0; i < ARRAYLEN(g_asset.plot); ++i) {
+    FreeAsset(g_asset.plot[i]);
+  }
   for (int i = 0; i < ARRAYLEN(g_shutdown); ++i) {
     nsync_note_free(g_shutdown[i]);
   }
   nsync_counter_free(g_ready);
   free(g_worker);
+  free(g_listener);
+  FreeScores();
   free(g_tok.b);
 
   LOG("Goodbye\n");
@@ -68,3 +68,15 @@ TEST(ParseResolvConf, testMulticastDnsThing_getsIgnored) {
   FreeResolvConf(&rv);
   fclose(f);
 }
+
+TEST(ParseResolvConf, testOptions) {
+  const char kInput[] = "nameserver 203.0.113.2\n"
+                        "options ndots:2 timeout:1 attempts:3\n";
+  struct ResolvConf *rv = calloc(1, sizeof(struct ResolvConf));
+  FILE *f = fmemopen((void *)kInput, strlen(kInput), "r+");
+  ASSERT_EQ(1, ParseResolvConf(rv, f));
+  EXPECT_EQ(1000, rv->timeout);
+  EXPECT_EQ(3, rv->attempts);
+  FreeResolvConf(&rv);
+  fclose(f);
+}
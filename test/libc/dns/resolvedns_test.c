@@ -0,0 +1,270 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/atomic.h"
+#include "libc/calls/calls.h"
+#include "libc/calls/struct/timespec.h"
+#include "libc/dns/consts.h"
+#include "libc/dns/dns.h"
+#include "libc/dns/resolvconf.h"
+#include "libc/errno.h"
+#include "libc/intrin/bits.h"
+#include "libc/sock/sock.h"
+#include "libc/sock/struct/pollfd.h"
+#include "libc/sock/struct/sockaddr.h"
+#include "libc/sock/struct/sockaddr6.h"
+#include "libc/str/str.h"
+#include "libc/sysv/consts/af.h"
+#include "libc/sysv/consts/inaddr.h"
+#include "libc/sysv/consts/ipproto.h"
+#include "libc/sysv/consts/poll.h"
+#include "libc/sysv/consts/sock.h"
+#include "libc/testlib/testlib.h"
+#include "libc/thread/thread.h"
+
+// local stand-in for a recursive nameserver, which answers any A or
+// AAAA question with a cname record followed by the address
+struct Standin {
+  int udp, tcp;
+  pthread_t th;
+  uint32_t ttl;
+  bool truncate;
+  bool nxdomain;
+  atomic_int drop;  // udp queries to ignore, or -1 for all
+  atomic_int queries;
+  atomic_int tcpqueries;
+  atomic_bool stop;
+  struct sockaddr_in addr;
+};
+
+const uint8_t kAddr4[4] = {127, 0, 0, 7};
+const uint8_t kAddr6[16] = {0x20, 0x01, 0x0d, 0xb8, [15] = 7};
+
+int Respond(struct Standin *s, const uint8_t *q, int n, uint8_t *r, bool tc) {
+  int i, m, rdlen;
+  uint16_t qtype;
+  for (i = 12; i < n && q[i]; i += 1 + q[i]) donothing;
+  if ((m = i + 5) > n) return -1;
+  qtype = READ16BE(q + i + 1);
+  memcpy(r, q, m);
+  r[2] = 0x80 | (tc ? 2 : 0) | (q[2] & 1);
+  r[3] = 0x80 | (s->nxdomain ? 3 : 0);
+  WRITE16BE(r + 6, 0);
+  WRITE16BE(r + 8, 0);
+  WRITE16BE(r + 10, 0);
+  if (tc || s->nxdomain) return m;
+  WRITE16BE(r + 6, 2);
+  memcpy(r + m, "\xc0\x0c\0\5\0\1", 6);  // cname
+  WRITE32BE(r + m + 6, s->ttl + 100);
+  memcpy(r + m + 10, "\0\4\1x\xc0\x0c", 6);
+  m += 16;
+  rdlen = qtype == DNS_TYPE_AAAA ? 16 : 4;
+  memcpy(r + m, "\xc0\x0c", 2);
+  WRITE16BE(r + m + 2, qtype);
+  WRITE16BE(r + m + 4, DNS_CLASS_IN);
+  WRITE32BE(r + m + 6, s->ttl);
+  WRITE16BE(r + m + 10, rdlen);
+  memcpy(r + m + 12, rdlen == 4 ? kAddr4 : kAddr6, rdlen);
+  return m + 12 + rdlen;
+}
+
+void ServeTcp(struct Standin *s) {
+  int c, n;
+  uint8_t q[514], r[514];
+  if ((c = accept(s->tcp, 0, 0)) == -1) return;
+  if (read(c, q, 2) == 2 && (n = READ16BE(q)) <= 512 && read(c, q, n) == n) {
+    ++s->tcpqueries;
+    if ((n = Respond(s, q, n, r + 2, false)) != -1) {
+      WRITE16BE(r, n);
+      write(c, r, 2 + n);
+    }
+  }
+  close(c);
+}
+
+void ServeUdp(struct Standin *s) {
+  int n;
+  uint32_t fromlen;
+  uint8_t q[512], r[512];
+  struct sockaddr_in from;
+  fromlen = sizeof(from);
+  if ((n = recvfrom(s->udp, q, 512, 0, (struct sockaddr *)&from,
+                    &fromlen)) == -1) {
+    return;
+  }
+  ++s->queries;
+  if (s->drop) {
+    if (s->drop > 0) --s->drop;
+    return;
+  }
+  if ((n = Respond(s, q, n, r, s->truncate)) != -1) {
+    sendto(s->udp, r, n, 0, (struct sockaddr *)&from, fromlen);
+  }
+}
+
+void *Serve(void *arg) {
+  struct Standin *s = arg;
+  struct pollfd p[2] = {{s->udp, POLLIN}, {s->tcp, POLLIN}};
+  while (!s->stop) {
+    if (poll(p, 2, 10) > 0) {
+      if (p[0].revents) ServeUdp(s);
+      if (p[1].revents) ServeTcp(s);
+    }
+  }
+  return 0;
+}
+
+void Start(struct Standin *s) {
+  uint32_t addrsize;
+  s->addr.sin_family = AF_INET;
+  s->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  do {
+    s->addr.sin_port = 0;
+    addrsize = sizeof(s->addr);
+    ASSERT_NE(-1, (s->udp = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)));
+    ASSERT_EQ(0, bind(s->udp, (struct sockaddr *)&s->addr, addrsize));
+    ASSERT_EQ(0, getsockname(s->udp, (struct sockaddr *)&s->addr,
+                                 &addrsize));
+    ASSERT_NE(-1, (s->tcp = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)));
+    if (!bind(s->tcp, (struct sockaddr *)&s->addr, addrsize)) break;
+    close(s->tcp);
+    close(s->udp);
+  } while (errno == EADDRINUSE);
+  ASSERT_EQ(0, listen(s->tcp, 10));
+  ASSERT_EQ(0, pthread_create(&s->th, 0, Serve, s));
+}
+
+void Stop(struct Standin *s) {
+  s->stop = true;
+  ASSERT_EQ(0, pthread_join(s->th, 0));
+  ASSERT_EQ(0, close(s->tcp));
+  ASSERT_EQ(0, close(s->udp));
+}
+
+struct Standin s1, s2;
+struct sockaddr_in ns[2];
+struct ResolvConf rv;
+
+void SetUp(void) {
+  bzero(&s1, sizeof(s1));
+  bzero(&s2, sizeof(s2));
+  s1.ttl = s2.ttl = 60;
+  Start(&s1);
+  Start(&s2);
+  ns[0] = s1.addr;
+  ns[1] = s2.addr;
+  bzero(&rv, sizeof(rv));
+  rv.nameservers.i = rv.nameservers.n = 1;
+  rv.nameservers.p = ns;
+  rv.timeout = 100;
+}
+
+void TearDown(void) {
+  Stop(&s2);
+  Stop(&s1);
+  pthread_decimate_np();
+}
+
+TEST(ResolveDns, a) {
+  struct sockaddr_in a = {0};
+  ASSERT_EQ(1, ResolveDns(&rv, AF_INET, "a.test", (void *)&a, sizeof(a)));
+  EXPECT_EQ(AF_INET, a.sin_family);
+  EXPECT_EQ(0, memcmp(kAddr4, &a.sin_addr, 4));
+  EXPECT_EQ(1, s1.queries);
+}
+
+TEST(ResolveDns, aaaa) {
+  struct sockaddr_in6 a = {0};
+  ASSERT_EQ(1, ResolveDns(&rv, AF_INET6, "aaaa.test", (void *)&a, sizeof(a)));
+  EXPECT_EQ(AF_INET6, a.sin6_family);
+  EXPECT_EQ(0, memcmp(kAddr6, &a.sin6_addr, 16));
+}
+
+TEST(ResolveDns, unspec_asksForBothAtOnce_prefersIpv4) {
+  int i;
+  struct sockaddr_in6 a = {0};
+  ASSERT_EQ(1, ResolveDns(&rv, AF_UNSPEC, "both.test", (void *)&a, sizeof(a)));
+  EXPECT_EQ(AF_INET, a.sin6_family);
+  EXPECT_EQ(0, memcmp(kAddr4, &((struct sockaddr_in *)&a)->sin_addr, 4));
+  for (i = 0; i < 100 && s1.queries < 2; ++i) usleep(1000);
+  EXPECT_EQ(2, s1.queries);
+}
+
+TEST(ResolveDns, answer_isCached) {
+  struct sockaddr_in a = {0};
+  ASSERT_EQ(1, ResolveDns(&rv, AF_INET, "cache.test", (void *)&a, sizeof(a)));
+  bzero(&a, sizeof(a));
+  ASSERT_EQ(1, ResolveDns(&rv, AF_INET, "CACHE.test", (void *)&a, sizeof(a)));
+  EXPECT_EQ(0, memcmp(kAddr4, &a.sin_addr, 4));
+  EXPECT_EQ(1, s1.queries);
+}
+
+TEST(ResolveDns, zeroTtl_isNotCached) {
+  struct sockaddr_in a = {0};
+  s1.ttl = 0;
+  ASSERT_EQ(1, ResolveDns(&rv, AF_INET, "ttl0.test", (void *)&a, sizeof(a)));
+  ASSERT_EQ(1, ResolveDns(&rv, AF_INET, "ttl0.test", (void *)&a, sizeof(a)));
+  EXPECT_EQ(2, s1.queries);
+}
+
+TEST(ResolveDns, nxdomain_returnsZero) {
+  struct sockaddr_in a = {0};
+  s1.nxdomain = true;
+  ASSERT_EQ(0, ResolveDns(&rv, AF_INET, "nx.test", (void *)&a, sizeof(a)));
+  EXPECT_EQ(1, s1.queries);
+}
+
+TEST(ResolveDns, lostPacket_isAskedAgain) {
+  struct sockaddr_in a = {0};
+  s1.drop = 1;
+  ASSERT_EQ(1, ResolveDns(&rv, AF_INET, "lost.test", (void *)&a, sizeof(a)));
+  EXPECT_EQ(0, memcmp(kAddr4, &a.sin_addr, 4));
+  EXPECT_EQ(2, s1.queries);
+}
+
+TEST(ResolveDns, noAnswer_timesOut) {
+  struct sockaddr_in a = {0};
+  s1.drop = -1;
+  rv.timeout = 10;
+  rv.attempts = 3;
+  ASSERT_SYS(ETIMEDOUT, -1,
+             ResolveDns(&rv, AF_INET, "mute.test", (void *)&a, sizeof(a)));
+  EXPECT_EQ(3, s1.queries);
+}
+
+TEST(ResolveDns, truncated_fallsBackToTcp) {
+  struct sockaddr_in a = {0};
+  s1.truncate = true;
+  ASSERT_EQ(1, ResolveDns(&rv, AF_INET, "tc.test", (void *)&a, sizeof(a)));
+  EXPECT_EQ(0, memcmp(kAddr4, &a.sin_addr, 4));
+  EXPECT_EQ(1, s1.queries);
+  EXPECT_EQ(1, s1.tcpqueries);
+}
+
+TEST(ResolveDns, deadNameserver_othersAreAskedAtOnce) {
+  struct timespec t;
+  struct sockaddr_in a = {0};
+  s1.drop = -1;
+  rv.nameservers.i = 2;
+  rv.timeout = 5000;
+  t = timespec_mono();
+  ASSERT_EQ(1, ResolveDns(&rv, AF_INET, "dead.test", (void *)&a, sizeof(a)));
+  EXPECT_LT(timespec_tomillis(timespec_sub(timespec_mono(), t)), 1000);
+  EXPECT_EQ(1, s1.queries);
+  EXPECT_EQ(1, s2.queries);
+}
@@ -36,6 +36,7 @@ TEST_LIBC_DNS_DIRECTDEPS =				\
 	LIBC_STR					\
 	LIBC_SYSV					\
 	LIBC_TESTLIB					\
+	LIBC_THREAD					\
 	LIBC_X
 
 TEST_LIBC_DNS_DEPS :=					\
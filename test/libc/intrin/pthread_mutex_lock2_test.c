@@ -23,6 +23,9 @@
 #include "libc/intrin/atomic.h"
 #include "libc/mem/gc.internal.h"
 #include "libc/mem/mem.h"
+#include "libc/runtime/runtime.h"
+#include "libc/sysv/consts/map.h"
+#include "libc/sysv/consts/prot.h"
 #include "libc/testlib/ezbench.h"
 #include "libc/testlib/testlib.h"
 #include "libc/thread/posixthread.internal.h"
@@ -98,6 +101,44 @@ TEST(pthread_mutex_lock, contention) {
   EXPECT_EQ(0, pthread_mutex_destroy(&lock));
 }
 
+TEST(pthread_mutex_lock, pshared) {
+  int i, j, ws;
+  struct Shared {
+    pthread_mutex_t lock;
+    int count;
+  } *s;
+  s = mmap(0, sizeof(*s), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+           -1, 0);
+  ASSERT_NE(MAP_FAILED, s);
+  ASSERT_EQ(0, pthread_mutexattr_init(&attr));
+  ASSERT_EQ(0, pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE));
+  ASSERT_EQ(0, pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED));
+  ASSERT_EQ(0, pthread_mutex_init(&s->lock, &attr));
+  ASSERT_EQ(0, pthread_mutexattr_destroy(&attr));
+  for (i = 0; i < 4; ++i) {
+    ASSERT_NE(-1, (ws = fork()));
+    if (!ws) {
+      for (j = 0; j < ITERATIONS; ++j) {
+        if (pthread_mutex_lock(&s->lock)) _Exit(1);
+        if (pthread_mutex_lock(&s->lock)) _Exit(2);
+        ++s->count;
+        sched_yield();
+        if (pthread_mutex_unlock(&s->lock)) _Exit(3);
+        if (pthread_mutex_unlock(&s->lock)) _Exit(4);
+      }
+      _Exit(0);
+    }
+  }
+  for (i = 0; i < 4; ++i) {
+    ASSERT_NE(-1, wait(&ws));
+    EXPECT_TRUE(WIFEXITED(ws));
+    EXPECT_EQ(0, WEXITSTATUS(ws));
+  }
+  EXPECT_EQ(4 * ITERATIONS, s->count);
+  EXPECT_EQ(0, pthread_mutex_destroy(&s->lock));
+  ASSERT_SYS(0, 0, munmap(s, sizeof(*s)));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // BENCHMARKS
 
@@ -111,6 +152,14 @@ void BenchLockUnlock(pthread_mutex_t *m) {
   pthread_mutex_unlock(m);
 }
 
+// this is how non-nsync mutexes used to wait, for comparison
+void BenchLockUnlockYield(atomic_int *x) {
+  while (atomic_exchange_explicit(x, 1, memory_order_acquire)) {
+    pthread_yield();
+  }
+  atomic_store_explicit(x, 0, memory_order_release);
+}
+
 void BenchLockUnlockNsync(nsync_mu *m) {
   nsync_mu_lock(m);
   nsync_mu_unlock(m);
@@ -183,6 +232,21 @@ int MutexContentionWorker(void *arg, int tid) {
   return 0;
 }
 
+struct YieldContentionArgs {
+  atomic_int *lock;
+  atomic_char done;
+  atomic_char ready;
+};
+
+int YieldContentionWorker(void *arg, int tid) {
+  struct YieldContentionArgs *a = arg;
+  while (!atomic_load_explicit(&a->done, memory_order_relaxed)) {
+    BenchLockUnlockYield(a->lock);
+    atomic_store_explicit(&a->ready, 1, memory_order_relaxed);
+  }
+  return 0;
+}
+
 struct NsyncContentionArgs {
   nsync_mu *nsync;
   atomic_char done;
@@ -210,6 +274,15 @@ BENCH(pthread_mutex_lock, bench_contended) {
     a.done = true;
     _join(&t);
   }
+  {
+    atomic_int x = 0;
+    struct YieldContentionArgs a = {&x};
+    _spawn(YieldContentionWorker, &a, &t);
+    while (!a.ready) sched_yield();
+    EZBENCH2("yield 2x", donothing, BenchLockUnlockYield(&x));
+    a.done = true;
+    _join(&t);
+  }
   {
     nsync_mu m = {0};
     struct NsyncContentionArgs a = {&m};
@@ -258,4 +331,18 @@ BENCH(pthread_mutex_lock, bench_contended) {
     a.done = true;
     _join(&t);
   }
+  {
+    pthread_mutex_t m;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_NORMAL);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&m, &attr);
+    struct MutexContentionArgs a = {&m};
+    _spawn(MutexContentionWorker, &a, &t);
+    while (!a.ready) sched_yield();
+    EZBENCH2("pshared 2x", donothing, BenchLockUnlock(&m));
+    a.done = true;
+    _join(&t);
+  }
 }
@@ -21,6 +21,7 @@
 #include "libc/calls/calls.h"
 #include "libc/calls/state.internal.h"
 #include "libc/errno.h"
+#include "libc/intrin/atomic.h"
 #include "libc/intrin/strace.internal.h"
 #include "libc/log/check.h"
 #include "libc/macros.internal.h"
@@ -187,6 +188,38 @@ TEST(pthread_mutex_lock, econtention) {
   EXPECT_EQ(0, pthread_mutex_destroy(&mylock));
 }
 
+void *CancelWorker(void *arg) {
+  pthread_mutex_lock(&mylock);
+  ++finished;  // pthread_mutex_lock() isn't a cancellation point
+  pthread_mutex_unlock(&mylock);
+  pthread_testcancel();
+  return 0;
+}
+
+TEST(pthread_mutex_lock, contended_isntCancellationPoint) {
+  void *rc;
+  pthread_t t;
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&mylock, &attr);
+  pthread_mutexattr_destroy(&attr);
+  finished = 0;
+  ASSERT_EQ(0, pthread_mutex_lock(&mylock));
+  ASSERT_EQ(0, pthread_create(&t, 0, CancelWorker, 0));
+  while (atomic_load_explicit(&mylock._lock, memory_order_relaxed) != 2) {
+    pthread_yield();  // wait for worker to sleep on futex
+  }
+  ASSERT_EQ(0, pthread_cancel(t));
+  usleep(10000);
+  EXPECT_EQ(0, finished);
+  ASSERT_EQ(0, pthread_mutex_unlock(&mylock));
+  ASSERT_EQ(0, pthread_join(t, &rc));
+  EXPECT_EQ(PTHREAD_CANCELED, rc);
+  EXPECT_EQ(1, finished);
+  EXPECT_EQ(0, pthread_mutex_destroy(&mylock));
+}
+
 int SpinlockWorker(void *p, int tid) {
   int i;
   ++started;
@@ -17,8 +17,10 @@
 │ PERFORMANCE OF THIS SOFTWARE.                                                │
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "libc/intrin/bits.h"
+#include "libc/macros.internal.h"
 #include "libc/mem/mem.h"
 #include "libc/stdio/rand.h"
+#include "libc/stdio/stdio.h"
 #include "libc/str/str.h"
 #include "libc/testlib/ezbench.h"
 #include "libc/testlib/hyperion.h"
@@ -91,6 +93,26 @@ TEST(strchr, fuzz) {
   free(p);
 }
 
+TEST(strchr, longStrings) {
+  char *p;
+  int i, j;
+  p = memalign(64, 512);
+  for (i = 0; i < 64; ++i) {
+    for (j = 0; j < 400; j += 7) {
+      memset(p, 'x', 511);
+      p[511] = 0;
+      p[i + j] = 'y';
+      ASSERT_EQ(p + i + j, strchr(p + i, 'y'));
+      ASSERT_EQ(NULL, strchr(p + i, 'z'));
+      p[i + j] = 0;
+      ASSERT_EQ(NULL, strchr(p + i, 'y'));
+      ASSERT_EQ(p + i + j, strchr(p + i, 0));
+      ASSERT_EQ(j, strlen(p + i));
+    }
+  }
+  free(p);
+}
+
 BENCH(strchr, bench) {
   EZBENCH2("strchr 0", donothing, __expropriate(strchr(__veil("r", ""), 0)));
   EZBENCH2("strchr 5", donothing,
@@ -200,3 +222,23 @@ BENCH(strchr, bench2) {
   EZBENCH2("strchrnul z", donothing, strchrnul_(kHyperion, 'z'));
   EZBENCH2("strchrnul Z", donothing, strchrnul_(kHyperion, 'Z'));
 }
+
+BENCH(strchr, throughput) {
+  char name[32];
+  unsigned i, j, n, a;
+  static const unsigned kLens[] = {15, 64, 1000, 65536};
+  static const unsigned kAligns[] = {0, 1, 33};
+  char *b = memalign(64, 65536 + 64);
+  for (i = 0; i < ARRAYLEN(kLens); ++i) {
+    for (j = 0; j < ARRAYLEN(kAligns); ++j) {
+      n = kLens[i];
+      a = kAligns[j];
+      memset(b + a, 'x', n);
+      b[a + n - 1] = 'y';
+      b[a + n] = 0;
+      snprintf(name, sizeof(name), "strchr %u+%u", n, a);
+      EZBENCH_N(name, n, __expropriate(strchr(__veil("r", b + a), 'y')));
+    }
+  }
+  free(b);
+}
@@ -182,3 +182,22 @@ BENCH(strlen, bench) {
   EZBENCH2("strlen      2048", donothing, strlen_(b));
   EZBENCH2("strlen_pure 2048", donothing, strlen_pure_(b));
 }
+
+BENCH(strlen, throughput) {
+  char name[32];
+  unsigned i, j, n, a;
+  static const unsigned kLens[] = {15, 64, 1000, 65536};
+  static const unsigned kAligns[] = {0, 1, 33};
+  char *b = memalign(64, 65536 + 64);
+  for (i = 0; i < ARRAYLEN(kLens); ++i) {
+    for (j = 0; j < ARRAYLEN(kAligns); ++j) {
+      n = kLens[i];
+      a = kAligns[j];
+      memset(b + a, 'x', n);
+      b[a + n] = 0;
+      snprintf(name, sizeof(name), "strlen %u+%u", n, a);
+      EZBENCH_N(name, n, __expropriate(strlen(__veil("r", b + a))));
+    }
+  }
+  free(b);
+}
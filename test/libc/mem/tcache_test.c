@@ -0,0 +1,241 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/atomic.h"
+#include "libc/calls/calls.h"
+#include "libc/calls/struct/timespec.h"
+#include "libc/dce.h"
+#include "libc/intrin/asan.internal.h"
+#include "libc/intrin/atomic.h"
+#include "libc/mem/gc.h"
+#include "libc/mem/mem.h"
+#include "libc/runtime/internal.h"
+#include "libc/runtime/runtime.h"
+#include "libc/runtime/sysconf.h"
+#include "libc/stdio/rand.h"
+#include "libc/stdio/stdio.h"
+#include "libc/str/str.h"
+#include "libc/testlib/subprocess.h"
+#include "libc/testlib/testlib.h"
+#include "libc/thread/spawn.h"
+#include "libc/thread/thread.h"
+#include "libc/time/time.h"
+#include "third_party/dlmalloc/dlmalloc.h"
+
+/**
+ * @fileoverview Thread Cache Tests
+ *
+ * The benchmark can be run as follows:
+ *
+ *     make o//test/libc/mem/tcache_test.com.runs V=5 TESTARGS=-b
+ *
+ * Each worker thread allocates and frees batches of small objects,
+ * which mostly get served by its own cache, without touching the
+ * global malloc() lock.
+ *
+ * These tests call dlmalloc() directly, so that under asan they see
+ * chunks being reused rather than sitting in the asan quarantine.
+ */
+
+#define N     1000
+#define SIZE  184 /* unusual size so nothing else allocates it */
+#define BATCH 64
+
+void *p[N];
+
+void SetUp(void) {
+  __enable_threads();
+}
+
+void CountChunk(void *start, void *end, size_t used, void *arg) {
+  if (used == SIZE) {
+    ++*(int *)arg;
+  }
+}
+
+int CountChunks(void) {
+  int n = 0;
+  malloc_inspect_all(CountChunk, &n);
+  return n;
+}
+
+void *Churn(void *arg) {
+  int i;
+  for (i = 0; i < N; ++i) {
+    ASSERT_NE(NULL, (p[i] = dlmalloc(SIZE)));
+    memset(p[i], i, SIZE);
+  }
+  for (i = 0; i < N; ++i) {
+    dlfree(p[i]);
+  }
+  return 0;
+}
+
+void *Produce(void *arg) {
+  int i;
+  for (i = 0; i < N; ++i) {
+    ASSERT_NE(NULL, (p[i] = dlmalloc(SIZE)));
+    memset(p[i], i, SIZE);
+  }
+  return 0;
+}
+
+TEST(tcache, freeThenMalloc_reusesChunk) {
+  char *a, *b;
+  ASSERT_NE(NULL, (a = dlmalloc(SIZE)));
+  dlfree(a);
+  ASSERT_NE(NULL, (b = dlmalloc(SIZE)));
+  EXPECT_EQ(a, b);
+  dlfree(b);
+}
+
+TEST(tcache, asan_poisonsCachedChunksUntilHandedOut) {
+  char *a, *b;
+  ASSERT_NE(NULL, (a = dlmalloc(SIZE)));
+  if (IsAsan()) ASSERT_TRUE(__asan_is_valid(a, SIZE));
+  dlfree(a);
+  if (IsAsan()) ASSERT_FALSE(__asan_is_valid(a, 1));
+  if (IsAsan()) ASSERT_FALSE(__asan_is_valid(a + SIZE - 1, 1));
+  ASSERT_NE(NULL, (b = dlmalloc(SIZE)));
+  ASSERT_EQ(a, b);
+  if (IsAsan()) ASSERT_TRUE(__asan_is_valid(b, SIZE));
+  memset(b, 0, SIZE);
+  dlfree(b);
+}
+
+TEST(tcache, mallinfo_reportsCachedChunksAsFree) {
+  size_t before;
+  dlfree(dlmalloc(SIZE));
+  before = mallinfo().uordblks;
+  Churn(0);
+  EXPECT_EQ(before, mallinfo().uordblks);
+}
+
+TEST(tcache, malloc_inspect_all_flushesCallingThread) {
+  int before = CountChunks();
+  Churn(0);
+  EXPECT_EQ(before, CountChunks());
+}
+
+atomic_int phase;
+
+void WaitFor(int x) {
+  while (atomic_load(&phase) != x) {
+    sched_yield();
+  }
+}
+
+void *ChurnAndWait(void *arg) {
+  Churn(0);
+  atomic_store(&phase, 1);
+  WaitFor(2);  // main thread called malloc_trim()
+  dlfree(dlmalloc(16));
+  atomic_store(&phase, 3);
+  WaitFor(4);  // main thread counted chunks
+  return 0;
+}
+
+TEST(tcache, malloc_trim_flushesOtherThreadsOnTheirNextCall) {
+  pthread_t t;
+  int before = CountChunks();
+  phase = 0;
+  ASSERT_EQ(0, pthread_create(&t, 0, ChurnAndWait, 0));
+  WaitFor(1);
+  EXPECT_LT(before, CountChunks());
+  malloc_trim(0);
+  atomic_store(&phase, 2);
+  WaitFor(3);
+  EXPECT_EQ(before, CountChunks());
+  atomic_store(&phase, 4);
+  ASSERT_EQ(0, pthread_join(t, 0));
+}
+
+TEST(tcache, pthread_exit_flushesThreadCache) {
+  pthread_t t;
+  int before = CountChunks();
+  ASSERT_EQ(0, pthread_create(&t, 0, Churn, 0));
+  ASSERT_EQ(0, pthread_join(t, 0));
+  EXPECT_EQ(before, CountChunks());
+}
+
+int SpawnChurn(void *arg, int tid) {
+  Churn(arg);
+  return 0;
+}
+
+TEST(tcache, _spawn_flushesThreadCache) {
+  struct spawn th;
+  int before = CountChunks();
+  ASSERT_EQ(0, _spawn(SpawnChurn, 0, &th));
+  ASSERT_EQ(0, _join(&th));
+  EXPECT_EQ(before, CountChunks());
+}
+
+TEST(tcache, freeingAnotherThreadsMemory) {
+  int i, j;
+  pthread_t t;
+  int before = CountChunks();
+  ASSERT_EQ(0, pthread_create(&t, 0, Produce, 0));
+  ASSERT_EQ(0, pthread_join(t, 0));
+  EXPECT_EQ(before + N, CountChunks());
+  for (i = 0; i < N; ++i) {
+    for (j = 0; j < SIZE; ++j) {
+      ASSERT_EQ((char)i, ((char *)p[i])[j]);
+    }
+    dlfree(p[i]);
+  }
+  EXPECT_EQ(before, CountChunks());
+}
+
+#define ITERATIONS 20000
+
+void *Worker(void *arg) {
+  int i, j;
+  char *v[BATCH];
+  for (i = 0; i < ITERATIONS; ++i) {
+    for (j = 0; j < BATCH; ++j) {
+      ASSERT_NE(NULL, (v[j] = malloc(16 + lemur64() % 256)));
+      *v[j] = j;
+    }
+    for (j = 0; j < BATCH; ++j) {
+      free(v[j]);
+    }
+  }
+  return 0;
+}
+
+BENCH(tcache, scalability) {
+  int i, n = __get_cpu_count() * 2;
+  pthread_t *t = _gc(malloc(sizeof(pthread_t) * n));
+  if (!n) return;
+  printf("\nmalloc scalability w/ %d threads and %d x %d allocations\n", n,
+         ITERATIONS, BATCH);
+  SPAWN(fork);
+  struct timespec t1 = timespec_real();
+  for (i = 0; i < n; ++i) {
+    ASSERT_EQ(0, pthread_create(t + i, 0, Worker, 0));
+  }
+  for (i = 0; i < n; ++i) {
+    ASSERT_EQ(0, pthread_join(t[i], 0));
+  }
+  struct timespec t2 = timespec_real();
+  printf("consumed %g wall and %g cpu seconds\n",
+         timespec_tomicros(timespec_sub(t2, t1)) * 1e-6,
+         (double)clock() / CLOCKS_PER_SEC);
+  EXITS(0);
+}
@@ -17,6 +17,7 @@
 │ PERFORMANCE OF THIS SOFTWARE.                                                │
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "libc/calls/calls.h"
+#include "libc/calls/struct/timespec.h"
 #include "libc/intrin/kprintf.h"
 #include "libc/intrin/strace.internal.h"
 #include "libc/limits.h"
@@ -24,22 +25,35 @@
 #include "libc/mem/mem.h"
 #include "libc/runtime/memtrack.internal.h"
 #include "libc/runtime/runtime.h"
+#include "libc/stdio/rand.h"
 #include "libc/stdio/stdio.h"
 #include "libc/str/str.h"
+#include "libc/sysv/consts/map.h"
+#include "libc/sysv/consts/prot.h"
+#include "libc/testlib/subprocess.h"
 #include "libc/testlib/testlib.h"
 
 #define I(x, y) \
   { x, y, 0, (y - x) * FRAMESIZE + FRAMESIZE }
 
+// frames that nothing maps, for tracking fake intervals in _mmi
+#define B (int)(0x500000000000 >> 16)
+#define W 256
+
 void SetUpOnce(void) {
-  ASSERT_SYS(0, 0, pledge("stdio rpath", 0));
+  ASSERT_SYS(0, 0, pledge("stdio rpath wpath proc", 0));
 }
 
 bool AreMemoryIntervalsOk(const struct MemoryIntervals *mm) {
   /* asan runtime depends on this function */
-  int i;
-  size_t wantsize;
-  for (i = 0; i < mm->i; ++i) {
+  int i, j;
+  size_t n, wantsize;
+  for (n = 0, j = -1, i = __first_memory(mm); i != -1;
+       j = i, i = mm->p[i].next, ++n) {
+    if (n == mm->i || mm->p[i].prev != j) {
+      STRACE("AreMemoryIntervalsOk() list is corrupt!");
+      return false;
+    }
     if (mm->p[i].y < mm->p[i].x) {
       STRACE("AreMemoryIntervalsOk() y should be >= x!");
       return false;
@@ -52,33 +66,72 @@ bool AreMemoryIntervalsOk(const struct MemoryIntervals *mm) {
              wantsize + FRAMESIZE);
       return false;
     }
-    if (i) {
-      if (mm->p[i].h != -1 || mm->p[i - 1].h != -1) {
-        if (mm->p[i].x <= mm->p[i - 1].y) {
+    if (j != -1) {
+      if (mm->p[i].h != -1 || mm->p[j].h != -1) {
+        if (mm->p[i].x <= mm->p[j].y) {
           return false;
         }
       } else {
-        if (!(mm->p[i - 1].y + 1 <= mm->p[i].x)) {
+        if (!(mm->p[j].y + 1 <= mm->p[i].x)) {
           STRACE("AreMemoryIntervalsOk() out of order or overlap!");
           return false;
         }
       }
     }
   }
+  if (n != mm->i || (n && mm->tail != j)) {
+    STRACE("AreMemoryIntervalsOk() count is wrong!");
+    return false;
+  }
+  return true;
+}
+
+// checks treap is ordered by x and maxhole is up to date
+static bool IsMemoryTreeOk(const struct MemoryIntervals *mm, int t, int lo,
+                           int hi, size_t *n) {
+  unsigned h;
+  if (t == -1) return true;
+  if (!(lo <= mm->p[t].x && mm->p[t].x <= hi)) return false;
+  if (!IsMemoryTreeOk(mm, mm->p[t].left, lo, mm->p[t].x - 1, n)) return false;
+  if (!IsMemoryTreeOk(mm, mm->p[t].right, mm->p[t].x + 1, hi, n)) return false;
+  h = mm->p[t].prev == -1 ? 0 : mm->p[t].x - mm->p[mm->p[t].prev].y - 1;
+  if (mm->p[t].hole != h) return false;
+  if (mm->p[t].left != -1) h = MAX(h, mm->p[mm->p[t].left].maxhole);
+  if (mm->p[t].right != -1) h = MAX(h, mm->p[mm->p[t].right].maxhole);
+  if (mm->p[t].maxhole != h) return false;
+  ++*n;
   return true;
 }
 
+static bool AreMemoryIntervalsIndexed(const struct MemoryIntervals *mm) {
+  size_t n = 0;
+  if (!mm->i) return true;
+  return IsMemoryTreeOk(mm, mm->root, INT_MIN, INT_MAX, &n) && n == mm->i;
+}
+
 static bool AreMemoryIntervalsEqual(const struct MemoryIntervals *mm1,
                                     const struct MemoryIntervals *mm2) {
+  int i, j;
+  const struct MemoryInterval *a, *b;
   if (mm1->i != mm2->i) return false;
-  if (memcmp(mm1->p, mm2->p, mm1->i * sizeof(*mm2->p)) != 0) return false;
-  return true;
+  for (i = __first_memory(mm1), j = __first_memory(mm2); i != -1 && j != -1;
+       i = a->next, j = b->next) {
+    a = mm1->p + i;
+    b = mm2->p + j;
+    if (a->x != b->x || a->y != b->y || a->h != b->h || a->size != b->size ||
+        a->offset != b->offset || a->flags != b->flags ||
+        a->prot != b->prot || a->iscow != b->iscow ||
+        a->readonlyfile != b->readonlyfile) {
+      return false;
+    }
+  }
+  return i == -1 && j == -1;
 }
 
 static void PrintMemoryInterval(const struct MemoryIntervals *mm) {
   int i;
-  for (i = 0; i < mm->i; ++i) {
-    if (i) fprintf(stderr, ",");
+  for (i = __first_memory(mm); i != -1; i = mm->p[i].next) {
+    if (i != __first_memory(mm)) fprintf(stderr, ",");
     fprintf(stderr, "{%d,%d}", mm->p[i].x, mm->p[i].y);
   }
   fprintf(stderr, "\n");
@@ -97,7 +150,7 @@ static void CheckMemoryIntervalsEqual(const struct MemoryIntervals *mm1,
 }
 
 static void CheckMemoryIntervalsAreOk(const struct MemoryIntervals *mm) {
-  if (!AreMemoryIntervalsOk(mm)) {
+  if (!AreMemoryIntervalsOk(mm) || !AreMemoryIntervalsIndexed(mm)) {
     PrintMemoryInterval(mm);
     CHECK(!"memory intervals not ok");
     exit(1);
@@ -108,6 +161,9 @@ static void RunTrackMemoryIntervalTest(const struct MemoryIntervals t[2], int x,
                                        int y, long h) {
   struct MemoryIntervals *mm;
   mm = memcpy(memalign(64, sizeof(*t)), t, sizeof(*t));
+  mm->p = mm->s;
+  __relink_memory(mm);
+  __relink_memory((struct MemoryIntervals *)t + 1);
   CheckMemoryIntervalsAreOk(mm);
   CHECK_NE(-1, __track_memory(mm, x, y, h, 0, 0, 0, 0, 0,
                               (y - x) * FRAMESIZE + FRAMESIZE));
@@ -121,6 +177,9 @@ static int RunReleaseMemoryIntervalsTest(const struct MemoryIntervals t[2],
   int rc;
   struct MemoryIntervals *mm;
   mm = memcpy(memalign(64, sizeof(*t)), t, sizeof(*t));
+  mm->p = mm->s;
+  __relink_memory(mm);
+  __relink_memory((struct MemoryIntervals *)t + 1);
   CheckMemoryIntervalsAreOk(mm);
   if ((rc = __untrack_memory(mm, x, y, NULL)) != -1) {
     CheckMemoryIntervalsAreOk(mm);
@@ -249,6 +308,7 @@ TEST(__find_memory, Test) {
       },
   };
   mm[0].p = mm[0].s;
+  __relink_memory(mm);
   EXPECT_EQ(0, __find_memory(mm, 0));
   EXPECT_EQ(0, __find_memory(mm, 1));
   EXPECT_EQ(1, __find_memory(mm, 2));
@@ -258,7 +318,7 @@ TEST(__find_memory, Test) {
   EXPECT_EQ(3, __find_memory(mm, 6));
   EXPECT_EQ(3, __find_memory(mm, 7));
   EXPECT_EQ(3, __find_memory(mm, 8));
-  EXPECT_EQ(4, __find_memory(mm, 9));
+  EXPECT_EQ(-1, __find_memory(mm, 9));
 }
 
 TEST(__untrack_memory, TestEmpty) {
@@ -384,3 +444,80 @@ TEST(__untrack_memory, TestWeirdGap) {
   mm[1].p = mm[1].s;
   EXPECT_NE(-1, RunReleaseMemoryIntervalsTest(mm, 15, 25));
 }
+
+TEST(__track_memory, fuzz) {
+  int i, j, x, y;
+  bool want[W], got[W];
+  if (IsWindows()) return;  // can't trim windows mappings
+  SPAWN(fork);
+  bzero(want, sizeof(want));
+  for (i = 0; i < 5000; ++i) {
+    x = lemur64() % W;
+    y = x + lemur64() % 8;
+    y = MIN(W - 1, y);
+    ASSERT_NE(-1, __untrack_memory(&_mmi, B + x, B + y, 0));
+    if (lemur64() & 1) {
+      ASSERT_NE(-1, __track_memory(&_mmi, B + x, B + y, lemur64() & 1 ? -1 : i,
+                                   0, 0, 0, 0, 0,
+                                   (y - x) * FRAMESIZE + FRAMESIZE));
+      memset(want + x, true, y - x + 1);
+    } else {
+      memset(want + x, false, y - x + 1);
+    }
+    bzero(got, sizeof(got));
+    for (j = __find_memory(&_mmi, B); j != -1 && _mmi.p[j].x < B + W;
+         j = _mmi.p[j].next) {
+      memset(got + _mmi.p[j].x - B, true, _mmi.p[j].y - _mmi.p[j].x + 1);
+    }
+    ASSERT_EQ(0, memcmp(want, got, W));
+    CheckMemoryIntervalsAreOk(&_mmi);
+  }
+  EXITS(0);
+}
+
+// shows mmap() and friends don't slow down as the table grows. linux
+// won't let a process have a million real mappings, so the table is
+// padded out with intervals that don't exist and real maps are added
+// and removed among them
+BENCH(__track_memory, bench) {
+  int i, j, k, n;
+  void *p[100];
+  volatile int sink;
+  struct timespec t1, t2, t3, t4;
+  if (IsWindows()) return;
+  SPAWN(fork);
+  for (n = 0, k = 1000; k <= 1000000; k *= 10) {
+    for (; n < k; ++n) {
+      ASSERT_NE(-1, __track_memory(&_mmi, B + n * 2, B + n * 2, -1, 0, 0, 0, 0,
+                                   0, FRAMESIZE));
+    }
+    t1 = timespec_real();
+    for (i = 0; i < 10000; ++i) {
+      j = B + lemur64() % n * 2;
+      ASSERT_NE(-1, __untrack_memory(&_mmi, j, j, 0));
+      ASSERT_NE(-1, __track_memory(&_mmi, j, j, -1, 0, 0, 0, 0, 0, FRAMESIZE));
+    }
+    t2 = timespec_real();
+    for (i = 0; i < 10000; ++i) {
+      sink = __find_memory(&_mmi, B + lemur64() % n * 2);
+    }
+    t3 = timespec_real();
+    for (i = 0; i < 10000 / ARRAYLEN(p); ++i) {
+      for (j = 0; j < ARRAYLEN(p); ++j) {
+        p[j] = mmap(0, FRAMESIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        ASSERT_NE(MAP_FAILED, p[j]);
+      }
+      for (j = 0; j < ARRAYLEN(p); ++j) {
+        ASSERT_SYS(0, 0, munmap(p[j], FRAMESIZE));
+      }
+    }
+    t4 = timespec_real();
+    printf("%'8d intervals %6ld ns untrack+track %6ld ns find %6ld ns "
+           "mmap+munmap\n",
+           n, timespec_tonanos(timespec_sub(t2, t1)) / 10000,
+           timespec_tonanos(timespec_sub(t3, t2)) / 10000,
+           timespec_tonanos(timespec_sub(t4, t3)) / 10000);
+  }
+  EXITS(0);
+}
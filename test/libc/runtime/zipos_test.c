@@ -17,6 +17,7 @@
 │ PERFORMANCE OF THIS SOFTWARE.                                                │
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "libc/calls/calls.h"
+#include "libc/calls/internal.h"
 #include "libc/calls/struct/stat.h"
 #include "libc/errno.h"
 #include "libc/limits.h"
@@ -24,17 +25,24 @@
 #include "libc/mem/mem.h"
 #include "libc/runtime/runtime.h"
 #include "libc/runtime/zipos.internal.h"
+#include "libc/stdio/rand.h"
 #include "libc/str/str.h"
+#include "libc/sysv/consts/map.h"
 #include "libc/sysv/consts/o.h"
+#include "libc/sysv/consts/prot.h"
+#include "libc/testlib/ezbench.h"
 #include "libc/testlib/hyperion.h"
 #include "libc/testlib/testlib.h"
 #include "libc/thread/spawn.h"
+#include "libc/zip.internal.h"
+#include "third_party/zlib/zlib.h"
 
 __static_yoink("zipos");
 __static_yoink("libc/testlib/hyperion.txt");
 __static_yoink("_Cz_inflate");
 __static_yoink("_Cz_inflateInit2");
 __static_yoink("_Cz_inflateEnd");
+__static_yoink("_Cz_inflateCopy");
 
 int Worker(void *arg, int tid) {
   int i, fd;
@@ -106,3 +114,83 @@ TEST(zipos, lseek) {
   EXPECT_EQ(0, memcmp(b1, b2, 512));
   EXPECT_SYS(0, 0, close(3));
 }
+
+TEST(zipos, smallDeflatedFile_isInflatedOnOpen) {
+  struct ZiposHandle *h;
+  ASSERT_SYS(0, 3, open("/zip/libc/testlib/hyperion.txt", O_RDONLY));
+  h = (struct ZiposHandle *)g_fds.p[3].handle;
+  EXPECT_EQ(NULL, h->inflater);
+  EXPECT_SYS(0, 0, close(3));
+}
+
+TEST(zipos, bigDeflatedFile_isInflatedLazily) {
+  char *a, *b, *m;
+  struct stat st;
+  struct ZiposHandle *h;
+  size_t i, n, off, len;
+  ASSERT_SYS(0, 3, open("/zip/ftraceasm.txt", O_RDONLY));
+  ASSERT_SYS(0, 0, fstat(3, &st));
+  n = st.st_size;
+  h = (struct ZiposHandle *)g_fds.p[3].handle;
+  ASSERT_NE(NULL, h->inflater);
+  a = _gc(malloc(n));
+  b = _gc(malloc(n));
+  ASSERT_SYS(0, n, read(3, a, n));
+  ASSERT_SYS(0, 0, read(3, b, 1));
+  EXPECT_EQ(ZIP_CFILE_CRC32(h->zipos->map + h->cfile), crc32_z(0, a, n));
+  for (i = 0; i < 300; ++i) {
+    off = lemur64() % n;
+    len = lemur64() % 100000;
+    len = MIN(len, n - off);
+    ASSERT_SYS(0, len, pread(3, b, len, off));
+    ASSERT_EQ(0, memcmp(a + off, b, len));
+  }
+  ASSERT_SYS(0, 1000, lseek(3, 1000, SEEK_SET));
+  ASSERT_SYS(0, 100, read(3, b, 100));
+  ASSERT_EQ(0, memcmp(a + 1000, b, 100));
+  ASSERT_NE(MAP_FAILED, (m = mmap(0, n, PROT_READ, MAP_PRIVATE, 3, 0)));
+  EXPECT_EQ(0, memcmp(a, m, n));
+  EXPECT_SYS(0, 0, munmap(m, n));
+  EXPECT_SYS(0, 0, close(3));
+}
+
+TEST(zipos, closedInflater_isReleasedWhenHandleIsReused) {
+  char a[100], b[100];
+  struct ZiposHandle *h;
+  ASSERT_SYS(0, 3, open("/zip/ftraceasm.txt", O_RDONLY));
+  ASSERT_SYS(0, 100, pread(3, a, 100, 70000));
+  h = (struct ZiposHandle *)g_fds.p[3].handle;
+  EXPECT_SYS(0, 0, close(3));
+  ASSERT_NE(NULL, h->inflater);  // close() mustn't call free()
+  ASSERT_SYS(0, 3, open("/zip/ftraceasm.txt", O_RDONLY));
+  ASSERT_EQ(h, (struct ZiposHandle *)g_fds.p[3].handle);
+  ASSERT_SYS(0, 100, pread(3, b, 100, 70000));
+  EXPECT_EQ(0, memcmp(a, b, 100));
+  EXPECT_SYS(0, 0, close(3));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BENCHMARKS
+
+static void ReadHeader(const char *path) {
+  char buf[64];
+  int fd = open(path, O_RDONLY);
+  read(fd, buf, sizeof(buf));
+  close(fd);
+}
+
+static void ReadWhole(const char *path) {
+  char buf[4096];
+  int fd = open(path, O_RDONLY);
+  while (read(fd, buf, sizeof(buf)) > 0) donothing;
+  close(fd);
+}
+
+BENCH(zipos, bench) {
+  EZBENCH2("open+read 64 hyperion", donothing,
+           ReadHeader("/zip/libc/testlib/hyperion.txt"));
+  EZBENCH2("open+read 64 ftraceasm", donothing,
+           ReadHeader("/zip/ftraceasm.txt"));
+  EZBENCH2("open+read all ftraceasm", donothing,
+           ReadWhole("/zip/ftraceasm.txt"));
+}
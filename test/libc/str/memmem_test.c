@@ -19,8 +19,10 @@
 #include "libc/mem/mem.h"
 #include "libc/intrin/bits.h"
 #include "libc/intrin/likely.h"
+#include "libc/macros.internal.h"
 #include "libc/mem/alg.h"
 #include "libc/stdio/rand.h"
+#include "libc/stdio/stdio.h"
 #include "libc/str/str.h"
 #include "libc/testlib/ezbench.h"
 #include "libc/testlib/hyperion.h"
@@ -201,3 +203,23 @@ BENCH(memmem, bench) {
                "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab",
                62, "aaaaaab", 7)));
 }
+
+BENCH(memmem, throughput) {
+  char name[32];
+  unsigned i, j, n, a;
+  static const unsigned kLens[] = {15, 64, 1000, 65536};
+  static const unsigned kAligns[] = {0, 1, 33};
+  char *b = memalign(64, 65536 + 64);
+  for (i = 0; i < ARRAYLEN(kLens); ++i) {
+    for (j = 0; j < ARRAYLEN(kAligns); ++j) {
+      n = kLens[i];
+      a = kAligns[j];
+      memset(b + a, 'x', n);
+      memcpy(b + a + n - 3, "END", 3);
+      snprintf(name, sizeof(name), "memmem %u+%u", n, a);
+      EZBENCH_N(name, n,
+                __expropriate(memmem(__veil("r", b + a), n, "END", 3)));
+    }
+  }
+  free(b);
+}
@@ -19,10 +19,12 @@
 #include "libc/str/str.h"
 #include "libc/dce.h"
 #include "libc/intrin/bits.h"
+#include "libc/macros.internal.h"
 #include "libc/mem/alg.h"
 #include "libc/mem/gc.internal.h"
 #include "libc/mem/mem.h"
 #include "libc/nexgen32e/x86feature.h"
+#include "libc/stdio/stdio.h"
 #include "libc/testlib/ezbench.h"
 #include "libc/testlib/hyperion.h"
 #include "libc/testlib/testlib.h"
@@ -167,3 +169,22 @@ BENCH(strstr, bench) {
                "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab",
                "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab")));
 }
+
+BENCH(strstr, throughput) {
+  char name[32];
+  unsigned i, j, n, a;
+  static const unsigned kLens[] = {15, 64, 1000, 65536};
+  static const unsigned kAligns[] = {0, 1, 33};
+  char *b = memalign(64, 65536 + 64);
+  for (i = 0; i < ARRAYLEN(kLens); ++i) {
+    for (j = 0; j < ARRAYLEN(kAligns); ++j) {
+      n = kLens[i];
+      a = kAligns[j];
+      memset(b + a, 'x', n);
+      memcpy(b + a + n - 3, "END", 4);
+      snprintf(name, sizeof(name), "strstr %u+%u", n, a);
+      EZBENCH_N(name, n, __expropriate(strstr(__veil("r", b + a), "END")));
+    }
+  }
+  free(b);
+}
@@ -165,6 +165,33 @@ TEST(pthread_create, testCustomStack_withReallySmallSize) {
   free(stk);
 }
 
+static void *GetStack(void *arg) {
+  void *addr;
+  size_t size;
+  pthread_attr_t attr;
+  ASSERT_EQ(0, pthread_getattr_np(pthread_self(), &attr));
+  ASSERT_EQ(0, pthread_attr_getstack(&attr, &addr, &size));
+  ASSERT_EQ(0, pthread_attr_destroy(&attr));
+  return addr;
+}
+
+TEST(pthread_create, joinedThreadStack_isReused) {
+  pthread_t id;
+  void *a, *b, *c;
+  pthread_attr_t attr;
+  ASSERT_EQ(0, pthread_create(&id, 0, GetStack, 0));
+  ASSERT_EQ(0, pthread_join(id, &a));
+  ASSERT_EQ(0, pthread_create(&id, 0, GetStack, 0));
+  ASSERT_EQ(0, pthread_join(id, &b));
+  EXPECT_EQ(a, b);
+  ASSERT_EQ(0, pthread_attr_init(&attr));
+  ASSERT_EQ(0, pthread_attr_setguardsize(&attr, 32768));
+  ASSERT_EQ(0, pthread_create(&id, &attr, GetStack, 0));
+  ASSERT_EQ(0, pthread_attr_destroy(&attr));
+  ASSERT_EQ(0, pthread_join(id, &c));
+  EXPECT_NE(a, c);
+}
+
 void *JoinMainWorker(void *arg) {
   void *rc;
   pthread_t main_thread = (pthread_t)arg;
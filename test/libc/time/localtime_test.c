@@ -0,0 +1,223 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/calls/struct/timespec.h"
+#include "libc/macros.internal.h"
+#include "libc/mem/gc.h"
+#include "libc/mem/mem.h"
+#include "libc/runtime/runtime.h"
+#include "libc/runtime/sysconf.h"
+#include "libc/stdio/stdio.h"
+#include "libc/str/str.h"
+#include "libc/testlib/ezbench.h"
+#include "libc/testlib/testlib.h"
+#include "libc/thread/thread.h"
+#include "libc/time/struct/tm.h"
+#include "libc/time/time.h"
+
+/**
+ * @fileoverview Local Time Tests
+ *
+ * The benchmark can be run as follows:
+ *
+ *     make o//test/libc/time/localtime_test.com.runs V=5 TESTARGS=-b
+ */
+
+#define DST2023 1678611600 /* 2023-03-12 02:00 MST in Boulder */
+#define N       1000
+#define STEP    3607
+
+struct tm want[N];
+
+void SetUp(void) {
+  setenv("TZ", "Boulder", true);
+  tzset();
+}
+
+void TearDown(void) {
+  pthread_decimate_np();
+}
+
+TEST(localtime_r, dstTransition) {
+  struct tm tm;
+  int64_t t = DST2023 - 1;
+  ASSERT_NE(NULL, localtime_r(&t, &tm));
+  EXPECT_EQ(1, tm.tm_hour);
+  EXPECT_EQ(0, tm.tm_isdst);
+  EXPECT_EQ(-7 * 3600, tm.tm_gmtoff);
+  EXPECT_STREQ("MST", tm.tm_zone);
+  t = DST2023;
+  ASSERT_NE(NULL, localtime_r(&t, &tm));
+  EXPECT_EQ(3, tm.tm_hour);
+  EXPECT_EQ(1, tm.tm_isdst);
+  EXPECT_EQ(-6 * 3600, tm.tm_gmtoff);
+  EXPECT_STREQ("MDT", tm.tm_zone);
+  t = DST2023 - 1;
+  ASSERT_NE(NULL, localtime_r(&t, &tm));
+  EXPECT_EQ(0, tm.tm_isdst);
+}
+
+TEST(localtime_r, changingTz_takesEffectAfterTzset) {
+  struct tm tm;
+  int64_t t = DST2023;
+  ASSERT_NE(NULL, localtime_r(&t, &tm));
+  EXPECT_EQ(-6 * 3600, tm.tm_gmtoff);
+  setenv("TZ", "Japan", true);
+  tzset();
+  ASSERT_NE(NULL, localtime_r(&t, &tm));
+  EXPECT_EQ(9 * 3600, tm.tm_gmtoff);
+  EXPECT_EQ(18, tm.tm_hour);
+  ASSERT_NE(NULL, localtime(&t));
+  setenv("TZ", "Boulder", true);
+  ASSERT_NE(NULL, localtime(&t));
+  EXPECT_EQ(-6 * 3600, localtime(&t)->tm_gmtoff);
+}
+
+TEST(localtime_r, switchingBackToEarlierTz_reusesZone) {
+  size_t before;
+  int64_t t = DST2023;
+  struct tm tm;
+  setenv("TZ", "Japan", true);
+  tzset();
+  setenv("TZ", "Boulder", true);
+  tzset();
+  before = mallinfo().uordblks;
+  for (int i = 0; i < 100; ++i) {
+    setenv("TZ", i & 1 ? "Boulder" : "Japan", true);
+    ASSERT_NE(NULL, localtime(&t));
+    ASSERT_NE(NULL, localtime_r(&t, &tm));
+    EXPECT_EQ(i & 1 ? -6 * 3600 : 9 * 3600, tm.tm_gmtoff);
+  }
+  setenv("TZ", "Boulder", true);
+  tzset();
+  EXPECT_EQ(before, mallinfo().uordblks);
+}
+
+TEST(localtime_r, roundTripsThroughMktime) {
+  int i;
+  struct tm tm;
+  int64_t t;
+  for (i = 0; i < N; ++i) {
+    t = DST2023 - N / 2 * STEP + i * STEP;
+    ASSERT_NE(NULL, localtime_r(&t, &tm));
+    EXPECT_EQ(t, mktime(&tm));
+  }
+}
+
+void *Convert(void *arg) {
+  int i, j;
+  struct tm tm;
+  int64_t t;
+  for (j = 0; j < 20; ++j) {
+    for (i = 0; i < N; ++i) {
+      t = DST2023 - N / 2 * STEP + i * STEP;
+      ASSERT_NE(NULL, localtime_r(&t, &tm));
+      ASSERT_EQ(want[i].tm_hour, tm.tm_hour);
+      ASSERT_EQ(want[i].tm_mday, tm.tm_mday);
+      ASSERT_EQ(want[i].tm_gmtoff, tm.tm_gmtoff);
+    }
+  }
+  return 0;
+}
+
+TEST(localtime_r, threads_agreeWithEachOther) {
+  int i;
+  int64_t t;
+  pthread_t th[8];
+  for (i = 0; i < N; ++i) {
+    t = DST2023 - N / 2 * STEP + i * STEP;
+    ASSERT_NE(NULL, localtime_r(&t, want + i));
+  }
+  for (i = 0; i < ARRAYLEN(th); ++i) {
+    ASSERT_EQ(0, pthread_create(th + i, 0, Convert, 0));
+  }
+  for (i = 0; i < ARRAYLEN(th); ++i) {
+    ASSERT_EQ(0, pthread_join(th[i], 0));
+  }
+}
+
+TEST(strftime, fastFormats_matchGeneralFormatter) {
+  char a[64], b[64];
+  struct tm tm;
+  int64_t t = DST2023;
+  gmtime_r(&t, &tm);
+  ASSERT_EQ(19, strftime(a, sizeof(a), "%Y-%m-%dT%H:%M:%S", &tm));
+  EXPECT_STREQ("2023-03-12T09:00:00", a);
+  ASSERT_EQ(19, strftime(b, sizeof(b), "%FT%T", &tm));
+  EXPECT_STREQ(a, b);
+  ASSERT_EQ(29, strftime(a, sizeof(a), "%a, %d %b %Y %H:%M:%S GMT", &tm));
+  EXPECT_STREQ("Sun, 12 Mar 2023 09:00:00 GMT", a);
+  ASSERT_EQ(29, strftime(b, sizeof(b), "%a, %d %b %Y %T GMT", &tm));
+  EXPECT_STREQ(a, b);
+}
+
+TEST(strftime, fastFormats_fallBackWhenOutOfRange) {
+  char buf[64];
+  struct tm tm;
+  int64_t t = DST2023;
+  gmtime_r(&t, &tm);
+  tm.tm_year = 10000 - 1900;
+  ASSERT_EQ(20, strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm));
+  EXPECT_STREQ("10000-03-12T09:00:00", buf);
+  EXPECT_EQ(0, strftime(buf, 19, "%Y-%m-%dT%H:%M:%S", &tm));
+  EXPECT_EQ(0, strftime(buf, 29, "%a, %d %b %Y %H:%M:%S GMT", &tm));
+}
+
+void *Bench(void *arg) {
+  int i;
+  char buf[32];
+  struct tm tm;
+  int64_t t = DST2023;
+  for (i = 0; i < 1000000; ++i, ++t) {
+    localtime_r(&t, &tm);
+    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  }
+  return 0;
+}
+
+BENCH(localtime_r, bench) {
+  char buf[32];
+  struct tm tm;
+  int64_t t = DST2023;
+  localtime_r(&t, &tm);
+  EZBENCH2("localtime_r", donothing, localtime_r(&t, &tm));
+  EZBENCH2("gmtime_r", donothing, gmtime_r(&t, &tm));
+  EZBENCH2("strftime iso8601", donothing,
+           strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm));
+  EZBENCH2("strftime http", donothing,
+           strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm));
+  EZBENCH2("strftime general", donothing,
+           strftime(buf, sizeof(buf), "%FT%T", &tm));
+}
+
+BENCH(localtime_r, scalability) {
+  int i, n = __get_cpu_count();
+  pthread_t *th = _gc(malloc(sizeof(pthread_t) * n));
+  if (n <= 0) return;
+  printf("\nlocaltime_r+strftime w/ %d threads x 1000000 conversions\n", n);
+  struct timespec t1 = timespec_real();
+  for (i = 0; i < n; ++i) {
+    ASSERT_EQ(0, pthread_create(th + i, 0, Bench, 0));
+  }
+  for (i = 0; i < n; ++i) {
+    ASSERT_EQ(0, pthread_join(th[i], 0));
+  }
+  struct timespec t2 = timespec_real();
+  printf("consumed %g wall seconds\n",
+         timespec_tomicros(timespec_sub(t2, t1)) * 1e-6);
+}
@@ -24,8 +24,11 @@ TEST_LIBC_TIME_DIRECTDEPS =				\
 	LIBC_MEM					\
 	LIBC_NEXGEN32E					\
 	LIBC_RUNTIME					\
+	LIBC_STDIO					\
+	LIBC_STR					\
 	LIBC_SYSV					\
 	LIBC_TESTLIB					\
+	LIBC_THREAD					\
 	LIBC_TIME					\
 	LIBC_X
 
@@ -0,0 +1,74 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/testlib/testlib.h"
+#include "net/http/http.h"
+
+TEST(GetHttpQuality, testEmpty_notListed) {
+  EXPECT_EQ(-1, GetHttpQuality("", -1, "gzip", -1));
+  EXPECT_EQ(-1, GetHttpQuality(0, 0, "gzip", -1));
+  EXPECT_EQ(-1, GetHttpQuality("gzip", -1, "", -1));
+}
+
+TEST(GetHttpQuality, testBareToken_defaultsToOne) {
+  EXPECT_EQ(1000, GetHttpQuality("gzip", -1, "gzip", -1));
+  EXPECT_EQ(1000, GetHttpQuality("deflate, gzip", -1, "gzip", -1));
+  EXPECT_EQ(1000, GetHttpQuality("  deflate ,gzip  ", -1, "gzip", -1));
+}
+
+TEST(GetHttpQuality, testSubstring_isntMatch) {
+  EXPECT_EQ(-1, GetHttpQuality("x-gzip", -1, "gzip", -1));
+  EXPECT_EQ(-1, GetHttpQuality("gzipper", -1, "gzip", -1));
+  EXPECT_EQ(-1, GetHttpQuality("deflate;gzip=1", -1, "gzip", -1));
+}
+
+TEST(GetHttpQuality, testCase_isInsensitive) {
+  EXPECT_EQ(500, GetHttpQuality("GZip;Q=0.5", -1, "gzip", -1));
+}
+
+TEST(GetHttpQuality, testQvalues) {
+  const char *s = "gzip;q=0.8, zstd, br;q=0, deflate ; q=0.125, *;q=0.1";
+  EXPECT_EQ(800, GetHttpQuality(s, -1, "gzip", -1));
+  EXPECT_EQ(1000, GetHttpQuality(s, -1, "zstd", -1));
+  EXPECT_EQ(0, GetHttpQuality(s, -1, "br", -1));
+  EXPECT_EQ(125, GetHttpQuality(s, -1, "deflate", -1));
+  EXPECT_EQ(100, GetHttpQuality(s, -1, "*", -1));
+  EXPECT_EQ(-1, GetHttpQuality(s, -1, "identity", -1));
+  EXPECT_EQ(1000, GetHttpQuality("gzip;q=1.000", -1, "gzip", -1));
+  EXPECT_EQ(0, GetHttpQuality("gzip;q=0.", -1, "gzip", -1));
+}
+
+TEST(GetHttpQuality, testOtherParams_areIgnored) {
+  EXPECT_EQ(300, GetHttpQuality("gzip;level=9;q=0.3", -1, "gzip", -1));
+  EXPECT_EQ(1000, GetHttpQuality("gzip;foo", -1, "gzip", -1));
+}
+
+TEST(GetHttpQuality, testMalformed_isIgnored) {
+  EXPECT_EQ(-1, GetHttpQuality("gzip;q=2", -1, "gzip", -1));
+  EXPECT_EQ(-1, GetHttpQuality("gzip;q=1.5", -1, "gzip", -1));
+  EXPECT_EQ(-1, GetHttpQuality("gzip;q=0.1234", -1, "gzip", -1));
+  EXPECT_EQ(-1, GetHttpQuality("gzip;q=.5", -1, "gzip", -1));
+  EXPECT_EQ(-1, GetHttpQuality("gzip;q=", -1, "gzip", -1));
+  EXPECT_EQ(-1, GetHttpQuality("gzip junk", -1, "gzip", -1));
+  EXPECT_EQ(700, GetHttpQuality("gzip;q=x, gzip;q=0.7", -1, "gzip", -1));
+}
+
+TEST(GetHttpQuality, testLength_isRespected) {
+  EXPECT_EQ(-1, GetHttpQuality("br, gzip", 3, "gzip", -1));
+  EXPECT_EQ(1000, GetHttpQuality("br, gzip", -1, "gzipped", 4));
+}
@@ -0,0 +1,235 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "net/http/http2.h"
+#include "libc/mem/gc.h"
+#include "libc/mem/mem.h"
+#include "libc/str/str.h"
+#include "libc/str/tab.internal.h"
+#include "libc/testlib/ezbench.h"
+#include "libc/testlib/testlib.h"
+#include "libc/x/x.h"
+#include "libc/x/xasprintf.h"
+
+char buf[512];
+struct Hpack h[1];
+char *fields;
+
+void TearDown(void) {
+  DestroyHpack(h);
+  free(fields);
+  fields = 0;
+}
+
+// unhexes test vector into buf
+const char *U(const char *s, size_t *n) {
+  size_t i;
+  *n = strlen(s) / 2;
+  for (i = 0; i < *n; ++i) {
+    buf[i] = kHexToInt[s[i * 2] & 255] << 4 | kHexToInt[s[i * 2 + 1] & 255];
+  }
+  return buf;
+}
+
+int Collect(void *ctx, const char *k, size_t kn, const char *v, size_t vn) {
+  fields = xasprintf("%s%.*s: %.*s\n", fields ? _gc(fields) : "", kn, k, vn, v);
+  return 0;
+}
+
+int Decode(const char *hex) {
+  size_t n;
+  const char *p = U(hex, &n);
+  free(fields);
+  fields = 0;
+  return DecodeHpack(h, p, n, Collect, 0);
+}
+
+TEST(DecodeHpackHuffman, rfc7541) {
+  size_t n;
+  char out[32];
+  const char *p = U("f1e3c2e5f23a6ba0ab90f4ff", &n);
+  ASSERT_EQ(15, DecodeHpackHuffman(out, p, n));
+  EXPECT_EQ(0, memcmp("www.example.com", out, 15));
+  p = U("a8eb10649cbf", &n);
+  ASSERT_EQ(8, DecodeHpackHuffman(out, p, n));
+  EXPECT_EQ(0, memcmp("no-cache", out, 8));
+}
+
+TEST(DecodeHpackHuffman, badPadding_isError) {
+  char out[8];
+  EXPECT_EQ(-1, DecodeHpackHuffman(out, "\x00", 1));
+  EXPECT_EQ(-1, DecodeHpackHuffman(out, "\xff\xff", 2));
+  EXPECT_EQ(0, DecodeHpackHuffman(out, "", 0));
+}
+
+TEST(DecodeHpackHuffman, eos_isError) {
+  char out[8];
+  EXPECT_EQ(-1, DecodeHpackHuffman(out, "\xff\xff\xff\xff", 4));
+}
+
+TEST(DecodeHpack, requestsWithHuffman_rfc7541_c4) {
+  InitHpack(h, kHpackTableSize);
+  ASSERT_EQ(0, Decode("828684418cf1e3c2e5f23a6ba0ab90f4ff"));
+  EXPECT_STREQ(":method: GET\n"
+               ":scheme: http\n"
+               ":path: /\n"
+               ":authority: www.example.com\n",
+               fields);
+  EXPECT_EQ(57, h->size);
+  ASSERT_EQ(0, Decode("828684be5886a8eb10649cbf"));
+  EXPECT_STREQ(":method: GET\n"
+               ":scheme: http\n"
+               ":path: /\n"
+               ":authority: www.example.com\n"
+               "cache-control: no-cache\n",
+               fields);
+  EXPECT_EQ(110, h->size);
+  ASSERT_EQ(0, Decode("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"));
+  EXPECT_STREQ(":method: GET\n"
+               ":scheme: https\n"
+               ":path: /index.html\n"
+               ":authority: www.example.com\n"
+               "custom-key: custom-value\n",
+               fields);
+  EXPECT_EQ(164, h->size);
+  EXPECT_EQ(3, h->n);
+}
+
+TEST(DecodeHpack, responsesWithEviction_rfc7541_c6) {
+  InitHpack(h, 256);
+  ASSERT_EQ(0, Decode("3fe1014e8264025885aec3771a4b6196d07abe941054d444a820"
+                      "0595040b8166e082a62d1bff6e919d29ad171863c78f0b97c8e9"
+                      "ae82ae43d3"));
+  EXPECT_STREQ(":status: 302\n"
+               "cache-control: private\n"
+               "date: Mon, 21 Oct 2013 20:13:21 GMT\n"
+               "location: https://www.example.com\n",
+               fields);
+  EXPECT_EQ(222, h->size);
+  ASSERT_EQ(0, Decode("4e03333037c1c0bf"));
+  EXPECT_STREQ(":status: 307\n"
+               "cache-control: private\n"
+               "date: Mon, 21 Oct 2013 20:13:21 GMT\n"
+               "location: https://www.example.com\n",
+               fields);
+  EXPECT_EQ(222, h->size);
+  ASSERT_EQ(0, Decode("88c16196d07abe941054d444a8200595040b8166e084a62d1bffc0"
+                      "5a839bd9ab77ad94e7821dd7f2e6c7b335dfdfcd5b3960d5af2708"
+                      "7f3672c1ab270fb5291f9587316065c003ed4ee5b1063d5007"));
+  EXPECT_STREQ(":status: 200\n"
+               "cache-control: private\n"
+               "date: Mon, 21 Oct 2013 20:13:22 GMT\n"
+               "location: https://www.example.com\n"
+               "content-encoding: gzip\n"
+               "set-cookie: foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; "
+               "version=1\n",
+               fields);
+  EXPECT_EQ(215, h->size);
+  EXPECT_EQ(3, h->n);
+}
+
+TEST(DecodeHpack, hugeEntry_clearsTable) {
+  InitHpack(h, 64);
+  ASSERT_EQ(0, Decode("4001610162"));
+  EXPECT_EQ(1, h->n);
+  ASSERT_EQ(0, Decode("40016122"
+                      "3030303030303030303030303030303030"
+                      "3030303030303030303030303030303030"));
+  EXPECT_EQ(0, h->n);
+  EXPECT_EQ(0, h->size);
+}
+
+TEST(DecodeHpack, errors) {
+  InitHpack(h, 256);
+  EXPECT_EQ(-1, Decode("80"));            // index zero
+  EXPECT_EQ(-1, Decode("be"));            // index past end of table
+  EXPECT_EQ(-1, Decode("4003616263"));    // truncated value
+  EXPECT_EQ(-1, Decode("3fe201"));        // size update above settings
+  EXPECT_EQ(-1, Decode("823fe101"));      // size update after field
+  EXPECT_EQ(-1, Decode("1f8080808080"));  // integer overflow
+  EXPECT_EQ(-1, Decode("00810000"));      // huffman padding
+}
+
+int Stop(void *ctx, const char *k, size_t kn, const char *v, size_t vn) {
+  ++*(int *)ctx;
+  return 7;
+}
+
+TEST(DecodeHpack, callbackResult_stopsDecoding) {
+  int calls = 0;
+  InitHpack(h, 256);
+  EXPECT_EQ(7, DecodeHpack(h, "\x82\x86", 2, Stop, &calls));
+  EXPECT_EQ(1, calls);
+}
+
+TEST(EncodeHpackInt, rfc7541_c1) {
+  char b[8];
+  EXPECT_EQ(1, EncodeHpackInt(b, 10, 5, 0) - b);
+  EXPECT_EQ(10, b[0]);
+  EXPECT_EQ(3, EncodeHpackInt(b, 1337, 5, 0) - b);
+  EXPECT_EQ(0, memcmp("\x1f\x9a\x0a", b, 3));
+  EXPECT_EQ(1, EncodeHpackInt(b, 42, 8, 0) - b);
+  EXPECT_EQ(42, b[0]);
+}
+
+TEST(EncodeHpack, roundTrip) {
+  char b[256], *p = b;
+  p = EncodeHpack(p, ":status", 7, "200", 3);
+  EXPECT_EQ(1, p - b);
+  p = EncodeHpack(p, ":status", 7, "302", 3);
+  p = EncodeHpack(p, "content-type", 12, "text/html", 9);
+  p = EncodeHpack(p, "x-foo", 5, "bar", 3);
+  InitHpack(h, kHpackTableSize);
+  ASSERT_EQ(0, DecodeHpack(h, b, p - b, Collect, 0));
+  EXPECT_STREQ(":status: 200\n"
+               ":status: 302\n"
+               "content-type: text/html\n"
+               "x-foo: bar\n",
+               fields);
+  EXPECT_EQ(0, h->n);
+}
+
+TEST(AppendHttp2Frame, roundTrip) {
+  char b[9];
+  struct Http2Frame f;
+  EXPECT_EQ(b + 9, AppendHttp2Frame(b, 0x123456, kHttp2Headers,
+                                    kHttp2FlagEndHeaders, 0x80000003));
+  ParseHttp2Frame(&f, b);
+  EXPECT_EQ(0x123456, f.size);
+  EXPECT_EQ(kHttp2Headers, f.type);
+  EXPECT_EQ(kHttp2FlagEndHeaders, f.flags);
+  EXPECT_EQ(3, f.stream);
+}
+
+int Ignore(void *ctx, const char *k, size_t kn, const char *v, size_t vn) {
+  return 0;
+}
+
+BENCH(DecodeHpack, bench) {
+  size_t n;
+  const char *p;
+  InitHpack(h, kHpackTableSize);
+  Decode("828684418cf1e3c2e5f23a6ba0ab90f4ff");
+  p = U("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf", &n);
+  EZBENCH2("DecodeHpack", donothing, DecodeHpack(h, p, n, Ignore, 0));
+  EZBENCH2("DecodeHpackHuffman", donothing, ({
+             char out[32];
+             DecodeHpackHuffman(out, "\xf1\xe3\xc2\xe5\xf2\x3a\x6b\xa0\xab"
+                                     "\x90\xf4\xff", 12);
+           }));
+}
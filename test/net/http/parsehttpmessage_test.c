@@ -19,8 +19,10 @@
 #include "libc/errno.h"
 #include "libc/intrin/bits.h"
 #include "libc/log/check.h"
+#include "libc/macros.internal.h"
 #include "libc/mem/gc.internal.h"
 #include "libc/mem/mem.h"
+#include "libc/stdio/rand.h"
 #include "libc/str/str.h"
 #include "libc/testlib/ezbench.h"
 #include "libc/testlib/testlib.h"
@@ -420,6 +422,112 @@ TEST(ParseHttpResponse, testHttp100) {
   EXPECT_EQ(10, req->version);
 }
 
+// appends random field text, which is occasionally invalid
+static char *RandomText(char *p, int n, int bad) {
+  int c;
+  while (n--) {
+    c = lemur64() % 100;
+    if (c < bad) {
+      c = lemur64() % 2 ? lemur64() % 0x20 : 0x7F + lemur64() % 0x21;
+    } else if (c < 5) {
+      c = "\t \xa0\xff"[lemur64() % 4];
+    } else {
+      c = ' ' + 1 + lemur64() % 94;
+    }
+    *p++ = c;
+  }
+  return p;
+}
+
+// creates random message, which is occasionally invalid
+static size_t RandomHttpMessage(char *m, int type) {
+  char *p = m;
+  int i, n, bad;
+  static const char *const kNames[] = {
+      "Host", "Cookie", "Accept", "User-Agent", "Set-Cookie", "X-Foo",
+      "Authorization", "Content-Length", "Accept-Encoding", "Via",
+  };
+  bad = lemur64() % 3 ? 0 : 1;
+  if (type == kHttpRequest) {
+    p = stpcpy(p, lemur64() % 2 ? "GET " : "POST ");
+    *p++ = '/';
+    p = RandomText(p, lemur64() % 200, bad);
+    p = stpcpy(p, " HTTP/1.1");
+  } else {
+    p = stpcpy(p, "HTTP/1.1 200 ");
+    p = RandomText(p, lemur64() % 100, bad);
+  }
+  p = stpcpy(p, lemur64() % 8 ? "\r\n" : "\n");
+  for (n = lemur64() % 16, i = 0; i < n; ++i) {
+    p = stpcpy(p, kNames[lemur64() % ARRAYLEN(kNames)]);
+    p = stpcpy(p, lemur64() % 8 ? ": " : ":\t ");
+    p = RandomText(p, lemur64() % 2 ? lemur64() % 20 : lemur64() % 700, bad);
+    p = stpcpy(p, lemur64() % 8 ? "\r\n" : "\n");
+  }
+  p = stpcpy(p, "\r\n");
+  return p - m;
+}
+
+static void ExpectSameSlice(struct HttpSlice a, struct HttpSlice b) {
+  ASSERT_EQ(a.a, b.a);
+  ASSERT_EQ(a.b, b.b);
+}
+
+static void ExpectSameMessage(struct HttpMessage *a, struct HttpMessage *b) {
+  int i;
+  ASSERT_EQ(a->method, b->method);
+  ASSERT_EQ(a->version, b->version);
+  ASSERT_EQ(a->status, b->status);
+  ExpectSameSlice(a->uri, b->uri);
+  ExpectSameSlice(a->message, b->message);
+  for (i = 0; i < kHttpHeadersMax; ++i) {
+    ExpectSameSlice(a->headers[i], b->headers[i]);
+  }
+  ASSERT_EQ(a->xheaders.n, b->xheaders.n);
+  for (i = 0; i < a->xheaders.n; ++i) {
+    ExpectSameSlice(a->xheaders.p[i].k, b->xheaders.p[i].k);
+    ExpectSameSlice(a->xheaders.p[i].v, b->xheaders.p[i].v);
+  }
+}
+
+TEST(ParseHttpMessage, fuzz_vectorScanAgreesWithByteAtATime) {
+  char *m;
+  size_t n, j;
+  int i, k, rc1, rc2, type;
+  struct HttpMessage slow[1];
+  m = _gc(xmalloc(32768));
+  for (i = 0; i < 3000; ++i) {
+    type = i & 1 ? kHttpResponse : kHttpRequest;
+    n = RandomHttpMessage(m, type);
+    InitHttpMessage(req, type);
+    rc1 = ParseHttpMessage(req, m, n);
+    // fragments shorter than a vector get parsed one byte at a time
+    InitHttpMessage(slow, type);
+    for (rc2 = 0, j = 0; !rc2 && j < n;) {
+      j = MIN(n, j + 1 + lemur64() % 15);
+      rc2 = ParseHttpMessage(slow, m, j);
+    }
+    ASSERT_EQ(rc1, rc2, "%#.*s", n, m);
+    if (rc1 > 0) ExpectSameMessage(req, slow);
+    DestroyHttpMessage(slow);
+    DestroyHttpMessage(req);
+  }
+}
+
+TEST(ParseHttpMessage, longValues_controlCodeAtEveryPosition) {
+  char m[300];
+  int i, n;
+  for (i = 0; i < 200; ++i) {
+    n = stpcpy(m, "GET / HTTP/1.1\r\nCookie: ") - m;
+    memset(m + n, 'x', 200);
+    m[n + i] = i & 1 ? '\1' : '\x85';
+    strcpy(m + n + 200, "\r\n\r\n");
+    InitHttpMessage(req, kHttpRequest);
+    ASSERT_EQ(-1, ParseHttpMessage(req, m, strlen(m)));
+    DestroyHttpMessage(req);
+  }
+}
+
 void DoTiniestHttpRequest(void) {
   static const char m[] = "\
 GET /\r\n\
@@ -473,6 +581,22 @@ X-Accept-Language: en-US,en;q=0.9\r\n\
   DestroyHttpMessage(req);
 }
 
+void DoCookieHeavyRequest(void) {
+  static char m[4096];
+  if (!*m) {
+    strcpy(m, "GET / HTTP/1.1\r\n"
+              "Host: 10.10.10.124:8080\r\n"
+              "Authorization: Bearer ");
+    memset(m + strlen(m), 'a', 1000);
+    strcat(m, "\r\nCookie: ");
+    memset(m + strlen(m), 'c', 2000);
+    strcat(m, "\r\n\r\n");
+  }
+  InitHttpMessage(req, kHttpRequest);
+  CHECK_EQ(strlen(m), ParseHttpMessage(req, m, strlen(m)));
+  DestroyHttpMessage(req);
+}
+
 void DoTiniestHttpResponse(void) {
   static const char m[] = "\
 HTTP/1.0 200\r\n\
@@ -546,6 +670,7 @@ BENCH(ParseHttpMessage, bench) {
   EZBENCH2("DoTinyHttpRequest", donothing, DoTinyHttpRequest());
   EZBENCH2("DoStandardChromeRequest", donothing, DoStandardChromeRequest());
   EZBENCH2("DoUnstandardChromeRequest", donothing, DoUnstandardChromeRequest());
+  EZBENCH2("DoCookieHeavyRequest", donothing, DoCookieHeavyRequest());
   EZBENCH2("DoTiniestHttpResponse", donothing, DoTiniestHttpResponse());
   EZBENCH2("DoTinyHttpResponse", donothing, DoTinyHttpResponse());
   EZBENCH2("DoStandardHttpResponse", donothing, DoStandardHttpResponse());
@@ -0,0 +1,115 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "tool/build/lib/ftracefold.h"
+#include "libc/macros.internal.h"
+#include "libc/mem/gc.h"
+#include "libc/testlib/testlib.h"
+
+int Alpha(int x) {
+  return x * 3 + 1;
+}
+
+int Beta(int x) {
+  return x * 5 + 2;
+}
+
+int Gamma(int x) {
+  return x * 7 + 3;
+}
+
+struct FtraceFold f;
+
+void SetUp(void) {
+  f.st = GetSymbolTable();
+}
+
+void TearDown(void) {
+  FreeFtraceFold(&f);
+}
+
+TEST(FoldFtrace, calls_areWeightedByTicksUntilNextCall) {
+  struct FtraceRecord r[] = {
+      {100, (uintptr_t)Alpha, 1, 0, kFtraceCall},
+      {110, (uintptr_t)Beta, 1, 1, kFtraceCall},
+      {130, (uintptr_t)Gamma, 1, 2, kFtraceCall},
+      {160, (uintptr_t)Beta, 1, 1, kFtraceCall},
+      {200, (uintptr_t)Alpha, 1, 0, kFtraceCall},
+  };
+  ASSERT_NE(NULL, f.st);
+  FoldFtrace(&f, r, ARRAYLEN(r));
+  EXPECT_STREQ("Alpha 10\n"
+               "Alpha;Beta 60\n"
+               "Alpha;Beta;Gamma 30\n",
+               _gc(FormatFtraceFold(&f)));
+}
+
+TEST(FoldFtrace, calls_mayBeSplitAcrossBuffers) {
+  struct FtraceRecord r[] = {
+      {100, (uintptr_t)Alpha, 1, 0, kFtraceCall},
+      {110, (uintptr_t)Beta, 1, 1, kFtraceCall},
+      {130, (uintptr_t)Gamma, 1, 2, kFtraceCall},
+  };
+  FoldFtrace(&f, r, 2);
+  FoldFtrace(&f, r + 2, 1);
+  EXPECT_STREQ("Alpha 10\n"
+               "Alpha;Beta 20\n",
+               _gc(FormatFtraceFold(&f)));
+}
+
+TEST(FoldFtrace, threads_areKeptApart) {
+  struct FtraceRecord r[] = {
+      {100, (uintptr_t)Alpha, 1, 0, kFtraceCall},
+      {101, (uintptr_t)Gamma, 2, 0, kFtraceCall},
+      {110, (uintptr_t)Beta, 1, 1, kFtraceCall},
+      {121, (uintptr_t)Gamma, 2, 0, kFtraceCall},
+  };
+  FoldFtrace(&f, r, ARRAYLEN(r));
+  EXPECT_STREQ("Alpha 10\n"
+               "Gamma 20\n",
+               _gc(FormatFtraceFold(&f)));
+}
+
+TEST(FoldFtrace, untracedCallers_areSkipped) {
+  struct FtraceRecord r[] = {
+      {100, (uintptr_t)Alpha, 1, 0, kFtraceCall},
+      {110, (uintptr_t)Gamma, 1, 3, kFtraceCall},
+      {130, (uintptr_t)Alpha, 1, 0, kFtraceCall},
+  };
+  FoldFtrace(&f, r, ARRAYLEN(r));
+  EXPECT_STREQ("Alpha 10\n"
+               "Alpha;Gamma 20\n",
+               _gc(FormatFtraceFold(&f)));
+}
+
+TEST(FoldFtrace, samples_countOncePerStack) {
+  struct FtraceRecord r[] = {
+      {100, (uintptr_t)Gamma + 1, 1, 0, kFtraceSample},
+      {100, (uintptr_t)Beta + 1, 1, 1, kFtraceSample},
+      {100, (uintptr_t)Alpha + 1, 1, 2, kFtraceSample},
+      {200, (uintptr_t)Gamma + 1, 1, 0, kFtraceSample},
+      {200, (uintptr_t)Beta + 1, 1, 1, kFtraceSample},
+      {200, (uintptr_t)Alpha + 1, 1, 2, kFtraceSample},
+      {300, (uintptr_t)Beta + 1, 2, 0, kFtraceSample},
+      {300, 0x31337, 2, 1, kFtraceSample},
+  };
+  FoldFtrace(&f, r, ARRAYLEN(r));
+  EXPECT_STREQ("0x31336;Beta 1\n"
+               "Alpha;Beta;Gamma 2\n",
+               _gc(FormatFtraceFold(&f)));
+}
@@ -0,0 +1,203 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "tool/build/lib/zipindex.h"
+#include "libc/intrin/bits.h"
+#include "libc/mem/mem.h"
+#include "libc/stdio/stdio.h"
+#include "libc/str/str.h"
+#include "libc/testlib/ezbench.h"
+#include "libc/testlib/testlib.h"
+#include "libc/x/x.h"
+#include "libc/x/xasprintf.h"
+#include "libc/zip.internal.h"
+
+#define N 1000
+
+char *names[N];
+uint8_t *zip, *eocd;
+size_t zipsize;
+
+// creates archive of stored files whose content is their name, where
+// the last file may be a zip index
+void MakeZip(char **v, int n, const void *idx, size_t idxsize) {
+  int i;
+  const char *name;
+  uint8_t *p, *c, *cdir;
+  size_t namesize, size, lf;
+  free(zip);
+  zip = p = xcalloc(1, (n + 1) * 256 + idxsize * 2);
+  c = cdir = xcalloc(1, (n + 1) * 128);
+  for (i = 0; i < n + !!idx; ++i) {
+    name = i < n ? v[i] : kZipIndexName;
+    namesize = strlen(name);
+    size = i < n ? namesize : idxsize;
+    lf = p - zip;
+    WRITE32LE(p, kZipLfileHdrMagic);
+    p[4] = kZipEra1993;
+    WRITE16LE(p + 12, (2020 - 1980) << 9 | 1 << 5 | 1);
+    WRITE32LE(p + 18, size);
+    WRITE32LE(p + 22, size);
+    WRITE16LE(p + 26, namesize);
+    memcpy(p + 30, name, namesize);
+    memcpy(p + 30 + namesize, i < n ? name : idx, size);
+    p += 30 + namesize + size;
+    WRITE32LE(c, kZipCfileHdrMagic);
+    c[4] = kZipEra1993;
+    c[5] = kZipOsUnix;
+    c[6] = kZipEra1993;
+    WRITE16LE(c + 14, (2020 - 1980) << 9 | 1 << 5 | 1);
+    WRITE32LE(c + 20, size);
+    WRITE32LE(c + 24, size);
+    WRITE16LE(c + 28, namesize);
+    WRITE16LE(c + 36, i & 1 ? kZipIattrText : kZipIattrBinary);
+    WRITE32LE(c + 42, lf);
+    memcpy(c + 46, name, namesize);
+    c += 46 + namesize;
+  }
+  memcpy(p, cdir, c - cdir);
+  eocd = p + (c - cdir);
+  WRITE32LE(eocd, kZipCdirHdrMagic);
+  WRITE16LE(eocd + kZipCdirRecordsOnDiskOffset, i);
+  WRITE16LE(eocd + kZipCdirRecordsOffset, i);
+  WRITE32LE(eocd + kZipCdirSizeOffset, c - cdir);
+  WRITE32LE(eocd + kZipCdirOffsetOffset, p - zip);
+  zipsize = eocd + kZipCdirHdrMinSize - zip;
+  free(cdir);
+}
+
+// makes archive of names with an up to date index
+const uint8_t *MakeIndexedZip(char **v, int n) {
+  void *idx;
+  size_t idxsize;
+  MakeZip(v, n, 0, 0);
+  ASSERT_NE(NULL, (idx = CreateZipIndex(zip, zipsize, eocd, 0, &idxsize)));
+  MakeZip(v, n, idx, idxsize);
+  free(idx);
+  return GetZipIndex(zip, zipsize, eocd, 0);
+}
+
+const char *GetSlotName(const uint8_t *idx, int64_t i, size_t *n) {
+  const uint8_t *cf;
+  cf = zip + GetZipCdirOffset(eocd) +
+       ZIP_INDEX_SLOT_CFILE(ZIP_INDEX_SLOT(idx, i));
+  *n = ZIP_CFILE_NAMESIZE(cf);
+  return ZIP_CFILE_NAME(cf);
+}
+
+void SetUp(void) {
+  int i;
+  for (i = 0; i < N; ++i) {
+    names[i] = xasprintf("assets/%d/file%d.html", i % 7, i);
+  }
+}
+
+void TearDown(void) {
+  int i;
+  for (i = 0; i < N; ++i) {
+    free(names[i]);
+  }
+  free(zip);
+  zip = 0;
+}
+
+TEST(CreateZipIndex, findsEveryName) {
+  int i;
+  size_t n;
+  int64_t s;
+  const char *name;
+  const uint8_t *idx;
+  ASSERT_NE(NULL, (idx = MakeIndexedZip(names, N)));
+  EXPECT_EQ(N, ZIP_INDEX_SLOTS(idx));
+  for (i = 0; i < N; ++i) {
+    ASSERT_NE(-1, (s = FindZipIndexSlot(idx, names[i], strlen(names[i]))));
+    name = GetSlotName(idx, s, &n);
+    ASSERT_EQ(strlen(names[i]), n);
+    ASSERT_EQ(0, memcmp(names[i], name, n));
+    EXPECT_EQ(i & 1, ZIP_INDEX_SLOT_FLAGS(ZIP_INDEX_SLOT(idx, s)) &
+                         kZipIndexFlagText);
+    EXPECT_STREQ("Wed, 01 Jan 2020 00:00:00 GMT",
+                 ZIP_INDEX_SLOT_DATE(ZIP_INDEX_SLOT(idx, s)));
+  }
+}
+
+TEST(CreateZipIndex, unknownNames_neverMatch) {
+  int i;
+  size_t n;
+  int64_t s;
+  char buf[64];
+  const char *name;
+  const uint8_t *idx;
+  ASSERT_NE(NULL, (idx = MakeIndexedZip(names, N)));
+  for (i = 0; i < N; ++i) {
+    snprintf(buf, sizeof(buf), "assets/%d/nope%d.html", i % 7, i);
+    if ((s = FindZipIndexSlot(idx, buf, strlen(buf))) != -1) {
+      name = GetSlotName(idx, s, &n);
+      ASSERT_FALSE(n == strlen(buf) && !memcmp(buf, name, n));
+    }
+  }
+}
+
+TEST(CreateZipIndex, duplicateName_firstOneWins) {
+  int64_t s;
+  const uint8_t *idx;
+  char *v[] = {"a.txt", "b.txt", "a.txt"};
+  ASSERT_NE(NULL, (idx = MakeIndexedZip(v, 3)));
+  EXPECT_EQ(2, ZIP_INDEX_SLOTS(idx));
+  ASSERT_NE(-1, (s = FindZipIndexSlot(idx, "a.txt", 5)));
+  EXPECT_EQ(0, ZIP_INDEX_SLOT_CFILE(ZIP_INDEX_SLOT(idx, s)));
+}
+
+TEST(CreateZipIndex, emptyArchive) {
+  const uint8_t *idx;
+  ASSERT_NE(NULL, (idx = MakeIndexedZip(0, 0)));
+  EXPECT_EQ(0, ZIP_INDEX_SLOTS(idx));
+  EXPECT_EQ(-1, FindZipIndexSlot(idx, "a.txt", 5));
+}
+
+TEST(GetZipIndex, reindexing_ignoresOldIndex) {
+  void *idx;
+  size_t idxsize;
+  ASSERT_NE(NULL, MakeIndexedZip(names, N));
+  ASSERT_NE(NULL, (idx = CreateZipIndex(zip, zipsize, eocd, 0, &idxsize)));
+  EXPECT_EQ(0, memcmp(idx, GetZipIndex(zip, zipsize, eocd, 0), idxsize));
+  free(idx);
+}
+
+TEST(GetZipIndex, missing) {
+  MakeZip(names, N, 0, 0);
+  EXPECT_EQ(NULL, GetZipIndex(zip, zipsize, eocd, 0));
+}
+
+TEST(GetZipIndex, differentTimezone_isStale) {
+  ASSERT_NE(NULL, MakeIndexedZip(names, N));
+  EXPECT_EQ(NULL, GetZipIndex(zip, zipsize, eocd, 3600));
+}
+
+TEST(GetZipIndex, modifiedCentralDirectory_isStale) {
+  ASSERT_NE(NULL, MakeIndexedZip(names, N));
+  ++*(zip + GetZipCdirOffset(eocd) + 46);
+  EXPECT_EQ(NULL, GetZipIndex(zip, zipsize, eocd, 0));
+}
+
+BENCH(ZipIndex, bench) {
+  const uint8_t *idx;
+  ASSERT_NE(NULL, (idx = MakeIndexedZip(names, N)));
+  EZBENCH2("FindZipIndexSlot", donothing,
+           FindZipIndexSlot(idx, names[N / 2], strlen(names[N / 2])));
+}
@@ -0,0 +1,195 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "tool/build/lib/ziposindex.h"
+#include "libc/intrin/bits.h"
+#include "libc/macros.internal.h"
+#include "libc/mem/mem.h"
+#include "libc/runtime/zipos.internal.h"
+#include "libc/stdio/stdio.h"
+#include "libc/str/str.h"
+#include "libc/testlib/ezbench.h"
+#include "libc/testlib/testlib.h"
+#include "libc/x/x.h"
+#include "libc/x/xasprintf.h"
+#include "libc/zip.internal.h"
+
+#define N 1000
+
+char *names[N];
+uint8_t *zip, *eocd;
+size_t zipsize;
+struct Zipos zipos;
+
+// creates archive of stored files whose content is their name, with
+// a zipos index appended the same way zipcopy does it
+void MakeZip(char **v, int n) {
+  int i;
+  void *idx;
+  const char *name;
+  uint8_t *p, *c, *cdir;
+  size_t namesize, lf, idxsize, idxlfsize;
+  free(zip);
+  zip = p = xcalloc(1, (n + 1) * 256 + n * 16 + 4096);
+  c = cdir = xcalloc(1, (n + 1) * 128);
+  for (i = 0; i < n; ++i) {
+    name = v[i];
+    namesize = strlen(name);
+    lf = p - zip;
+    WRITE32LE(p, kZipLfileHdrMagic);
+    p[4] = kZipEra1993;
+    WRITE32LE(p + 18, namesize);
+    WRITE32LE(p + 22, namesize);
+    WRITE16LE(p + 26, namesize);
+    memcpy(p + 30, name, namesize);
+    memcpy(p + 30 + namesize, name, namesize);
+    p += 30 + namesize * 2;
+    WRITE32LE(c, kZipCfileHdrMagic);
+    c[4] = kZipEra1993;
+    c[5] = kZipOsUnix;
+    c[6] = kZipEra1993;
+    WRITE32LE(c + 20, namesize);
+    WRITE32LE(c + 24, namesize);
+    WRITE16LE(c + 28, namesize);
+    WRITE32LE(c + 42, lf);
+    memcpy(c + 46, name, namesize);
+    c += 46 + namesize;
+  }
+  ASSERT_NE(NULL, (idx = CreateZiposIndex(cdir, c - cdir, n, p - zip,
+                                          &idxlfsize, &idxsize)));
+  memcpy(p, idx, idxlfsize);
+  p += idxlfsize;
+  memcpy(c, (char *)idx + idxlfsize, idxsize - idxlfsize);
+  c += idxsize - idxlfsize;
+  free(idx);
+  memcpy(p, cdir, c - cdir);
+  eocd = p + (c - cdir);
+  WRITE32LE(eocd, kZipCdirHdrMagic);
+  WRITE16LE(eocd + kZipCdirRecordsOnDiskOffset, n + 1);
+  WRITE16LE(eocd + kZipCdirRecordsOffset, n + 1);
+  WRITE32LE(eocd + kZipCdirSizeOffset, c - cdir);
+  WRITE32LE(eocd + kZipCdirOffsetOffset, p - zip);
+  zipsize = eocd + kZipCdirHdrMinSize - zip;
+  free(cdir);
+  bzero(&zipos, sizeof(zipos));
+  zipos.map = zip;
+  zipos.cdir = eocd;
+}
+
+ssize_t Scan(const char *s) {
+  struct ZiposUri name;
+  name.len = strlen(s);
+  memcpy(name.path, s, name.len + 1);
+  return __zipos_scan(&zipos, &name);
+}
+
+const char *GetName(ssize_t cf, size_t *n) {
+  *n = ZIP_CFILE_NAMESIZE(zip + cf);
+  return ZIP_CFILE_NAME(zip + cf);
+}
+
+void SetUp(void) {
+  int i;
+  for (i = 0; i < N; ++i) {
+    names[i] = xasprintf("assets/%d/file%d.html", i % 7, i);
+  }
+}
+
+void TearDown(void) {
+  int i;
+  for (i = 0; i < N; ++i) {
+    free(names[i]);
+  }
+  free(zip);
+  zip = 0;
+}
+
+TEST(CreateZiposIndex, findsEveryName) {
+  int i;
+  size_t n;
+  ssize_t cf;
+  const char *name;
+  MakeZip(names, N);
+  ASSERT_TRUE(__zipos_index(&zipos, zipsize));
+  EXPECT_EQ(N + 1, zipos.records);
+  EXPECT_NE(NULL, zipos.hash);
+  for (i = 0; i < N; ++i) {
+    ASSERT_GT((cf = Scan(names[i])), 0);
+    name = GetName(cf, &n);
+    ASSERT_EQ(strlen(names[i]), n);
+    ASSERT_EQ(0, memcmp(names[i], name, n));
+  }
+  ASSERT_GT((cf = Scan(kZiposIndexName)), 0);
+  name = GetName(cf, &n);
+  ASSERT_EQ(0, memcmp(kZiposIndexName, name, n));
+}
+
+TEST(CreateZiposIndex, namesAreSorted) {
+  int i;
+  size_t xn, yn;
+  const char *x, *y;
+  MakeZip(names, N);
+  ASSERT_TRUE(__zipos_index(&zipos, zipsize));
+  for (i = 1; i < zipos.records; ++i) {
+    x = GetName(zipos.cdiroff + zipos.index[i - 1], &xn);
+    y = GetName(zipos.cdiroff + zipos.index[i], &yn);
+    ASSERT_LE(memcmp(x, y, MIN(xn, yn)), 0);
+  }
+}
+
+TEST(CreateZiposIndex, directories_stillWork) {
+  MakeZip(names, N);
+  ASSERT_TRUE(__zipos_index(&zipos, zipsize));
+  EXPECT_EQ(ZIPOS_SYNTHETIC_DIRECTORY, Scan("assets"));
+  EXPECT_EQ(ZIPOS_SYNTHETIC_DIRECTORY, Scan("assets/3/"));
+  EXPECT_EQ(-1, Scan("assets/7"));
+  EXPECT_EQ(-1, Scan("assets/3/file3.htm"));
+}
+
+TEST(CreateZiposIndex, duplicateName_firstOneWins) {
+  char *v[] = {"a.txt", "b.txt", "a.txt"};
+  MakeZip(v, 3);
+  ASSERT_TRUE(__zipos_index(&zipos, zipsize));
+  EXPECT_EQ(zipos.cdiroff, Scan("a.txt"));
+}
+
+TEST(CreateZiposIndex, emptyArchive) {
+  MakeZip(0, 0);
+  ASSERT_TRUE(__zipos_index(&zipos, zipsize));
+  EXPECT_EQ(1, zipos.records);
+  EXPECT_EQ(-1, Scan("a.txt"));
+}
+
+TEST(__zipos_index, modifiedCentralDirectory_isStale) {
+  MakeZip(names, N);
+  ++*(zip + GetZipCdirOffset(eocd) + 46);
+  EXPECT_FALSE(__zipos_index(&zipos, zipsize));
+}
+
+TEST(__zipos_index, truncatedArchive_isIgnored) {
+  MakeZip(names, N);
+  EXPECT_FALSE(__zipos_index(&zipos, GetZipCdirOffset(eocd)));
+}
+
+BENCH(__zipos_scan, bench) {
+  MakeZip(names, N);
+  ASSERT_TRUE(__zipos_index(&zipos, zipsize));
+  EZBENCH2("__zipos_scan hash", donothing, Scan(names[N / 2]));
+  zipos.hash = 0;
+  EZBENCH2("__zipos_scan bsearch", donothing, Scan(names[N / 2]));
+}
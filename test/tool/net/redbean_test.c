@@ -20,11 +20,14 @@
 #include "libc/calls/struct/sigset.h"
 #include "libc/dce.h"
 #include "libc/fmt/conv.h"
+#include "libc/intrin/bits.h"
+#include "libc/macros.internal.h"
 #include "libc/mem/gc.internal.h"
 #include "libc/runtime/runtime.h"
 #include "libc/sock/goodsocket.internal.h"
 #include "libc/sock/sock.h"
 #include "libc/sock/struct/sockaddr.h"
+#include "libc/stdio/append.h"
 #include "libc/stdio/stdio.h"
 #include "libc/str/str.h"
 #include "libc/sysv/consts/af.h"
@@ -38,6 +41,7 @@
 #include "libc/sysv/consts/tcp.h"
 #include "libc/testlib/testlib.h"
 #include "libc/x/x.h"
+#include "net/http/http2.h"
 #include "third_party/regex/regex.h"
 #ifdef __x86_64__
 
@@ -189,6 +193,140 @@ TEST(redbean, testPipeline) {
   EXPECT_NE(-1, sigprocmask(SIG_SETMASK, &savemask, 0));
 }
 
+TEST(redbean, testWorkerPool) {
+  if (IsWindows()) return;
+  char portbuf[16];
+  int pid, pipefds[2];
+  sigset_t chldmask, savemask;
+  sigaddset(&chldmask, SIGCHLD);
+  EXPECT_NE(-1, sigprocmask(SIG_BLOCK, &chldmask, &savemask));
+  ASSERT_NE(-1, pipe(pipefds));
+  ASSERT_NE(-1, (pid = fork()));
+  if (!pid) {
+    setpgrp();
+    close(0);
+    open("/dev/null", O_RDWR);
+    close(pipefds[0]);
+    dup2(pipefds[1], 1);
+    sigprocmask(SIG_SETMASK, &savemask, NULL);
+    execv("bin/redbean-tester.com",
+          (char *const[]){"bin/redbean-tester.com", "-vvszXp0", "-l127.0.0.1",
+                          "-n2,2", __strace > 0 ? "--strace" : 0, 0});
+    _exit(127);
+  }
+  EXPECT_NE(-1, close(pipefds[1]));
+  EXPECT_NE(-1, read(pipefds[0], portbuf, sizeof(portbuf)));
+  port = atoi(portbuf);
+  // more connections than workers * recycle count to exercise respawning
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(Matches("HTTP/1\\.1 200 OK\r\n"
+                        "Accept: \\*/\\*\r\n"
+                        "Accept-Charset: utf-8,ISO-8859-1;"
+                        "q=0\\.7,\\*;q=0\\.5\r\n"
+                        "Allow: GET, HEAD, POST, PUT, DELETE, OPTIONS\r\n"
+                        "Date: .*\r\n"
+                        "Server: redbean/.*\r\n"
+                        "Content-Length: 0\r\n"
+                        "\r\n",
+                        gc(SendHttpRequest("OPTIONS * HTTP/1.1\n\n"))));
+  }
+  EXPECT_EQ(0, close(pipefds[0]));
+  EXPECT_NE(-1, kill(pid, SIGTERM));
+  EXPECT_NE(-1, wait(0));
+  EXPECT_NE(-1, sigprocmask(SIG_SETMASK, &savemask, 0));
+}
+
+TEST(redbean, testWorkerPool_sumsCountersAcrossWorkers) {
+  if (IsWindows()) return;
+  char portbuf[16], *status;
+  int pid, pipefds[2];
+  sigset_t chldmask, savemask;
+  sigaddset(&chldmask, SIGCHLD);
+  EXPECT_NE(-1, sigprocmask(SIG_BLOCK, &chldmask, &savemask));
+  ASSERT_NE(-1, pipe(pipefds));
+  ASSERT_NE(-1, (pid = fork()));
+  if (!pid) {
+    setpgrp();
+    close(0);
+    open("/dev/null", O_RDWR);
+    close(pipefds[0]);
+    dup2(pipefds[1], 1);
+    sigprocmask(SIG_SETMASK, &savemask, NULL);
+    execv("bin/redbean-tester.com",
+          (char *const[]){"bin/redbean-tester.com", "-vvszXp0", "-l127.0.0.1",
+                          "-n2,2", __strace > 0 ? "--strace" : 0, 0});
+    _exit(127);
+  }
+  EXPECT_NE(-1, close(pipefds[1]));
+  EXPECT_NE(-1, read(pipefds[0], portbuf, sizeof(portbuf)));
+  port = atoi(portbuf);
+  // each message lands in the shard of whichever worker served it,
+  // including workers that have since been recycled
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(Matches("HTTP/1\\.1 200 OK\r\n.*",
+                        gc(SendHttpRequest("OPTIONS * HTTP/1.1\n\n"))));
+  }
+  status = gc(SendHttpRequest("GET /statusz HTTP/1.1\n\n"));
+  EXPECT_TRUE(Matches("HTTP/1\\.1 200 OK\r\n.*", status));
+  // a message is counted once its response is sent, so not this one
+  EXPECT_NE(NULL, strstr(status, "\r\nmessageshandled: 8\r\n"));
+  EXPECT_NE(NULL, strstr(status, "\r\nstatuszrequests: 1\r\n"));
+  EXPECT_EQ(0, close(pipefds[0]));
+  EXPECT_NE(-1, kill(pid, SIGTERM));
+  EXPECT_NE(-1, wait(0));
+  EXPECT_NE(-1, sigprocmask(SIG_SETMASK, &savemask, 0));
+}
+
+TEST(redbean, testIdleConnections_dontPinPoolWorker) {
+  if (IsWindows()) return;
+  if (!IsLinux()) return;  // needs epoll
+  char portbuf[16], buf[512];
+  int fd, pid, pipefds[2];
+  sigset_t chldmask, savemask;
+  sigaddset(&chldmask, SIGCHLD);
+  EXPECT_NE(-1, sigprocmask(SIG_BLOCK, &chldmask, &savemask));
+  ASSERT_NE(-1, pipe(pipefds));
+  ASSERT_NE(-1, (pid = fork()));
+  if (!pid) {
+    setpgrp();
+    close(0);
+    open("/dev/null", O_RDWR);
+    close(pipefds[0]);
+    dup2(pipefds[1], 1);
+    sigprocmask(SIG_SETMASK, &savemask, NULL);
+    execv("bin/redbean-tester.com",
+          (char *const[]){"bin/redbean-tester.com", "-vvszXp0", "-l127.0.0.1",
+                          "-n1", "-I16", __strace > 0 ? "--strace" : 0, 0});
+    _exit(127);
+  }
+  EXPECT_NE(-1, close(pipefds[1]));
+  EXPECT_NE(-1, read(pipefds[0], portbuf, sizeof(portbuf)));
+  port = atoi(portbuf);
+  // leave a keep-alive connection open on the only worker
+  struct sockaddr_in addr = {AF_INET, htons(port), {htonl(INADDR_LOOPBACK)}};
+  ASSERT_NE(-1, (fd = Socket()));
+  ASSERT_NE(-1, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQ(20, write(fd, "OPTIONS * HTTP/1.1\n\n", 20));
+  ASSERT_LT(0, read(fd, buf, sizeof(buf)));
+  ASSERT_TRUE(startswith(buf, "HTTP/1.1 200 OK\r\n"));
+  // which must not stop the worker from serving other clients
+  EXPECT_TRUE(Matches("HTTP/1\\.1 200 OK\r\n.*",
+                      gc(SendHttpRequest("OPTIONS * HTTP/1.1\n\n"))));
+  // even if it's trickling in its next message
+  ASSERT_EQ(10, write(fd, "OPTIONS * ", 10));
+  EXPECT_TRUE(Matches("HTTP/1\\.1 200 OK\r\n.*",
+                      gc(SendHttpRequest("OPTIONS * HTTP/1.1\n\n"))));
+  // and the parked client can still keep talking
+  ASSERT_EQ(10, write(fd, "HTTP/1.1\n\n", 10));
+  ASSERT_LT(0, read(fd, buf, sizeof(buf)));
+  ASSERT_TRUE(startswith(buf, "HTTP/1.1 200 OK\r\n"));
+  EXPECT_NE(-1, close(fd));
+  EXPECT_EQ(0, close(pipefds[0]));
+  EXPECT_NE(-1, kill(pid, SIGTERM));
+  EXPECT_NE(-1, wait(0));
+  EXPECT_NE(-1, sigprocmask(SIG_SETMASK, &savemask, 0));
+}
+
 TEST(redbean, testContentRange) {
   if (IsWindows()) return;
   char portbuf[16];
@@ -287,4 +425,267 @@ Z\n",
   EXPECT_NE(-1, sigprocmask(SIG_SETMASK, &savemask, 0));
 }
 
+void SendHttp2Frame(int fd, int type, int flags, int id, const void *p,
+                    size_t n) {
+  char *b = gc(xmalloc(kHttp2FrameHeader + n));
+  memcpy(AppendHttp2Frame(b, n, type, flags, id), p, n);
+  ASSERT_EQ(kHttp2FrameHeader + n, write(fd, b, kHttp2FrameHeader + n));
+}
+
+void SendHttp2Request(int fd, int id, const char *path, const char *k,
+                      const char *v) {
+  char b[256], *p = b;
+  p = EncodeHpack(p, ":method", 7, "GET", 3);
+  p = EncodeHpack(p, ":scheme", 7, "http", 4);
+  p = EncodeHpack(p, ":authority", 10, "127.0.0.1", 9);
+  p = EncodeHpack(p, ":path", 5, path, strlen(path));
+  if (k) p = EncodeHpack(p, k, strlen(k), v, strlen(v));
+  SendHttp2Frame(fd, kHttp2Headers, kHttp2FlagEndHeaders | kHttp2FlagEndStream,
+                 id, b, p - b);
+}
+
+// reads whole frame, returning its payload
+char *ReadHttp2Frame(int fd, struct Http2Frame *f) {
+  size_t i;
+  ssize_t rc;
+  char hdr[kHttp2FrameHeader];
+  static char p[kHttp2MaxFrame + 1];
+  for (i = 0; i < sizeof(hdr); i += rc) {
+    ASSERT_LT(0, (rc = read(fd, hdr + i, sizeof(hdr) - i)));
+  }
+  ParseHttp2Frame(f, hdr);
+  ASSERT_LE(f->size, kHttp2MaxFrame);
+  for (i = 0; i < f->size; i += rc) {
+    ASSERT_LT(0, (rc = read(fd, p + i, f->size - i)));
+  }
+  p[f->size] = 0;
+  return p;
+}
+
+int AppendField(void *arg, const char *k, size_t kn, const char *v,
+                size_t vn) {
+  appendf(arg, "%.*s: %.*s\n", kn, k, vn, v);
+  return 0;
+}
+
+TEST(redbean, testHttp2) {
+  if (IsWindows()) return;
+  struct Hpack h;
+  struct Http2Frame f;
+  int fd, id, pid, done, pipefds[2];
+  char *p, portbuf[16], *head[4] = {0}, *body[4] = {0};
+  bool gotsettings = false, gotack = false, gotping = false, gotrst = false;
+  sigset_t chldmask, savemask;
+  sigaddset(&chldmask, SIGCHLD);
+  EXPECT_NE(-1, sigprocmask(SIG_BLOCK, &chldmask, &savemask));
+  ASSERT_NE(-1, pipe(pipefds));
+  ASSERT_NE(-1, (pid = fork()));
+  if (!pid) {
+    setpgrp();
+    close(0);
+    open("/dev/null", O_RDWR);
+    close(pipefds[0]);
+    dup2(pipefds[1], 1);
+    sigprocmask(SIG_SETMASK, &savemask, NULL);
+    execv("bin/redbean-tester.com",
+          (char *const[]){"bin/redbean-tester.com", "-vvszXp0", "-l127.0.0.1",
+                          __strace > 0 ? "--strace" : 0, 0});
+    _exit(127);
+  }
+  EXPECT_NE(-1, close(pipefds[1]));
+  EXPECT_NE(-1, read(pipefds[0], portbuf, sizeof(portbuf)));
+  port = atoi(portbuf);
+  struct sockaddr_in addr = {AF_INET, htons(port), {htonl(INADDR_LOOPBACK)}};
+  ASSERT_NE(-1, (fd = Socket()));
+  ASSERT_NE(-1, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQ(24, write(fd, kHttp2Preface, 24));
+  SendHttp2Frame(fd, kHttp2Settings, 0, 0, 0, 0);
+  SendHttp2Request(fd, 1, "/seekable.txt", 0, 0);
+  SendHttp2Request(fd, 3, "/seekable.txt", "range", "bytes=18-21");
+  SendHttp2Request(fd, 5, "/seekable.txt", "X-Uppercase", "is malformed");
+  SendHttp2Frame(fd, kHttp2Ping, 0, 0, "abcdefgh", 8);
+  InitHpack(&h, kHpackTableSize);
+  for (done = 0; done < 2;) {
+    p = ReadHttp2Frame(fd, &f);
+    id = f.stream / 2 & 3;
+    switch (f.type) {
+      case kHttp2Settings:
+        if (f.flags & kHttp2FlagAck) {
+          gotack = true;
+        } else {
+          gotsettings = true;
+          SendHttp2Frame(fd, kHttp2Settings, kHttp2FlagAck, 0, 0, 0);
+        }
+        break;
+      case kHttp2Ping:
+        EXPECT_EQ(kHttp2FlagAck, f.flags);
+        EXPECT_STREQ("abcdefgh", p);
+        gotping = true;
+        break;
+      case kHttp2RstStream:
+        EXPECT_EQ(5, f.stream);
+        EXPECT_EQ(kHttp2ProtocolError, READ32BE(p));
+        gotrst = true;
+        break;
+      case kHttp2Headers:
+        ASSERT_NE(0, f.flags & kHttp2FlagEndHeaders);
+        ASSERT_EQ(0, DecodeHpack(&h, p, f.size, AppendField, head + id));
+        break;
+      case kHttp2Data:
+        appendd(body + id, p, f.size);
+        break;
+      default:
+        break;
+    }
+    if ((f.type == kHttp2Headers || f.type == kHttp2Data) &&
+        (f.flags & kHttp2FlagEndStream)) {
+      ++done;
+    }
+  }
+  DestroyHpack(&h);
+  EXPECT_TRUE(gotsettings);
+  EXPECT_TRUE(gotack);
+  EXPECT_TRUE(gotping);
+  EXPECT_TRUE(gotrst);
+  EXPECT_TRUE(Matches("^:status: 200\n"
+                      "content-type: text/plain; charset=utf-8\n"
+                      ".*"
+                      "content-length: 52\n$",
+                      head[0]));
+  EXPECT_STREQ("A\nB\nC\nD\nE\nF\nG\nH\nI\nJ\nK\nL\nM\n"
+               "N\nO\nP\nQ\nR\nS\nT\nU\nV\nW\nX\nY\nZ\n",
+               body[0]);
+  EXPECT_TRUE(Matches("^:status: 206\n"
+                      "content-range: bytes 18-21/52\n"
+                      ".*"
+                      "content-length: 4\n$",
+                      head[1]));
+  EXPECT_STREQ("J\nK\n", body[1]);
+  for (id = 0; id < 4; ++id) {
+    free(head[id]);
+    free(body[id]);
+  }
+  EXPECT_NE(-1, close(fd));
+  EXPECT_EQ(0, close(pipefds[0]));
+  EXPECT_NE(-1, kill(pid, SIGTERM));
+  EXPECT_NE(-1, wait(0));
+  EXPECT_NE(-1, sigprocmask(SIG_SETMASK, &savemask, 0));
+}
+
+// reads frames until one of type is received, returning its payload
+char *ReadHttp2FrameOfType(int fd, int type, struct Http2Frame *f) {
+  char *p;
+  do {
+    p = ReadHttp2Frame(fd, f);
+  } while (f->type != type);
+  return p;
+}
+
+TEST(redbean, testHttp2_limitsHeaderList) {
+  if (IsWindows()) return;
+  size_t n;
+  struct Hpack h;
+  int i, fd, pid, pipefds[2];
+  char *p, *b, *e, *v, *head = 0, portbuf[16], big[4000];
+  struct Http2Frame f;
+  sigset_t chldmask, savemask;
+  sigaddset(&chldmask, SIGCHLD);
+  EXPECT_NE(-1, sigprocmask(SIG_BLOCK, &chldmask, &savemask));
+  ASSERT_NE(-1, pipe(pipefds));
+  ASSERT_NE(-1, (pid = fork()));
+  if (!pid) {
+    setpgrp();
+    close(0);
+    open("/dev/null", O_RDWR);
+    close(pipefds[0]);
+    dup2(pipefds[1], 1);
+    sigprocmask(SIG_SETMASK, &savemask, NULL);
+    execv("bin/redbean-tester.com",
+          (char *const[]){"bin/redbean-tester.com", "-vvszXp0", "-l127.0.0.1",
+                          __strace > 0 ? "--strace" : 0, 0});
+    _exit(127);
+  }
+  EXPECT_NE(-1, close(pipefds[1]));
+  EXPECT_NE(-1, read(pipefds[0], portbuf, sizeof(portbuf)));
+  port = atoi(portbuf);
+  struct sockaddr_in addr = {AF_INET, htons(port), {htonl(INADDR_LOOPBACK)}};
+  // a few hundred bytes of hpack can decode to megabytes of fields
+  // by indexing one big field and then referencing it over and over
+  memset(big, 'a', sizeof(big));
+  p = b = gc(xmalloc(sizeof(big) + 1024));
+  p = EncodeHpack(p, ":method", 7, "GET", 3);
+  p = EncodeHpack(p, ":path", 5, "/", 1);
+  p = EncodeHpackInt(p, 0, 6, 0x40);  // literal with incremental indexing
+  p = EncodeHpackInt(p, 5, 7, 0);
+  p = mempcpy(p, "x-big", 5);
+  p = EncodeHpackInt(p, sizeof(big), 7, 0);
+  p = mempcpy(p, big, sizeof(big));
+  for (i = 0; i < 500; ++i) {
+    p = EncodeHpackInt(p, 62, 7, 0x80);
+  }
+  e = p;
+  ASSERT_NE(-1, (fd = Socket()));
+  ASSERT_NE(-1, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQ(24, write(fd, kHttp2Preface, 24));
+  SendHttp2Frame(fd, kHttp2Settings, 0, 0, 0, 0);
+  p = ReadHttp2FrameOfType(fd, kHttp2Settings, &f);
+  for (i = 0; i < f.size; i += 6) {
+    if (READ16BE(p + i) == kHttp2SettingsMaxHeaderListSize) break;
+  }
+  ASSERT_LT(i, f.size);
+  SendHttp2Frame(fd, kHttp2Headers, kHttp2FlagEndHeaders | kHttp2FlagEndStream,
+                 1, b, e - b);
+  p = ReadHttp2FrameOfType(fd, kHttp2RstStream, &f);
+  EXPECT_EQ(1, f.stream);
+  EXPECT_EQ(kHttp2EnhanceYourCalm, READ32BE(p));
+  EXPECT_NE(-1, close(fd));
+  // header block fragments can't be empty forever
+  ASSERT_NE(-1, (fd = Socket()));
+  ASSERT_NE(-1, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQ(24, write(fd, kHttp2Preface, 24));
+  SendHttp2Frame(fd, kHttp2Settings, 0, 0, 0, 0);
+  p = EncodeHpack(b, ":method", 7, "GET", 3);
+  SendHttp2Frame(fd, kHttp2Headers, 0, 1, b, p - b);
+  for (i = 0; i < 64; ++i) {
+    SendHttp2Frame(fd, kHttp2Continuation, 0, 1, 0, 0);
+  }
+  p = ReadHttp2FrameOfType(fd, kHttp2Goaway, &f);
+  EXPECT_EQ(kHttp2EnhanceYourCalm, READ32BE(p + 4));
+  EXPECT_NE(-1, close(fd));
+  // fields and body that only fit separately get 413, rather than a
+  // REFUSED_STREAM which would invite the client to try them again
+  v = gc(xmalloc(25000));
+  memset(v, 'a', 25000);
+  p = b = gc(xmalloc(25000 + 1024));
+  p = EncodeHpack(p, ":method", 7, "POST", 4);
+  p = EncodeHpack(p, ":scheme", 7, "http", 4);
+  p = EncodeHpack(p, ":path", 5, "/", 1);
+  p = EncodeHpack(p, "x-big", 5, v, 25000);
+  ASSERT_NE(-1, (fd = Socket()));
+  ASSERT_NE(-1, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+  ASSERT_EQ(24, write(fd, kHttp2Preface, 24));
+  SendHttp2Frame(fd, kHttp2Settings, 0, 0, 0, 0);
+  for (e = b; e < p; e += n) {
+    n = MIN(p - e, kHttp2MaxFrame);
+    SendHttp2Frame(fd, e == b ? kHttp2Headers : kHttp2Continuation,
+                   e + n == p ? kHttp2FlagEndHeaders : 0, 1, e, n);
+  }
+  for (i = 0; i < 3; ++i) {
+    SendHttp2Frame(fd, kHttp2Data, i == 2 ? kHttp2FlagEndStream : 0, 1, v,
+                   15000);
+  }
+  p = ReadHttp2FrameOfType(fd, kHttp2Headers, &f);
+  EXPECT_EQ(1, f.stream);
+  InitHpack(&h, kHpackTableSize);
+  ASSERT_EQ(0, DecodeHpack(&h, p, f.size, AppendField, &head));
+  DestroyHpack(&h);
+  EXPECT_TRUE(startswith(head, ":status: 413\n"));
+  free(head);
+  EXPECT_NE(-1, close(fd));
+  EXPECT_EQ(0, close(pipefds[0]));
+  EXPECT_NE(-1, kill(pid, SIGTERM));
+  EXPECT_NE(-1, wait(0));
+  EXPECT_NE(-1, sigprocmask(SIG_SETMASK, &savemask, 0));
+}
+
 #endif /* __x86_64__ */
@@ -43,6 +43,7 @@ TEST_TOOL_NET_DIRECTDEPS =					\
 	LIBC_TESTLIB						\
 	LIBC_THREAD						\
 	LIBC_X							\
+	NET_HTTP						\
 	THIRD_PARTY_MBEDTLS					\
 	THIRD_PARTY_REGEX					\
 	THIRD_PARTY_SQLITE3
@@ -3,6 +3,9 @@
 #include "libc/calls/calls.h"
 #include "libc/dce.h"
 #include "libc/errno.h"
+#include "libc/intrin/asan.internal.h"
+#include "libc/intrin/asancodes.h"
+#include "libc/intrin/atomic.h"
 #include "libc/intrin/bsr.h"
 #include "libc/intrin/likely.h"
 #include "libc/intrin/weaken.h"
@@ -19,6 +22,7 @@
 #include "libc/sysv/consts/map.h"
 #include "libc/sysv/consts/prot.h"
 #include "libc/thread/thread.h"
+#include "libc/thread/tls.h"
 #include "third_party/dlmalloc/vespene.internal.h"
 // clang-format off
 
@@ -576,7 +580,7 @@ static void* tmalloc_small(mstate m, size_t nb) {
 
 #if !ONLY_MSPACES
 
-void* dlmalloc(size_t bytes) {
+static void* dlmalloc_single(size_t bytes) {
   /*
      Basic algorithm:
      If a small request (< 256 bytes minus per-chunk overhead):
@@ -719,7 +723,7 @@ void* dlmalloc(size_t bytes) {
 
 /* ---------------------------- free --------------------------- */
 
-void dlfree(void* mem) {
+static void dlfree_single(void* mem) {
   /*
      Consolidate freed chunks with preceeding or succeeding bordering
      free chunks, if they exist, and then place in a bin.  Intermixed
@@ -1214,6 +1218,8 @@ static void internal_inspect_all(mstate m,
 
 #if !ONLY_MSPACES
 
+#include "third_party/dlmalloc/tcache.inc"
+
 void* dlrealloc(void* oldmem, size_t bytes) {
   void* mem = 0;
   if (oldmem == 0) {
@@ -1326,6 +1332,7 @@ void dlmalloc_inspect_all(void(*handler)(void *start,
                                          void* callback_arg),
                           void* arg) {
   ensure_initialization();
+  tcache_release();
   if (!PREACTION(gm)) {
     internal_inspect_all(gm, handler, arg);
     POSTACTION(gm);
@@ -1336,6 +1343,7 @@ void dlmalloc_inspect_all(void(*handler)(void *start,
 int dlmalloc_trim(size_t pad) {
   int result = 0;
   ensure_initialization();
+  tcache_release();
   if (!PREACTION(gm)) {
     result = sys_trim(gm, pad);
     POSTACTION(gm);
@@ -1369,7 +1377,13 @@ size_t dlmalloc_set_footprint_limit(size_t bytes) {
 
 #if !NO_MALLINFO
 struct mallinfo dlmallinfo(void) {
-  return internal_mallinfo(gm);
+  struct mallinfo mi;
+  size_t cached;
+  mi = internal_mallinfo(gm);
+  cached = tcache_bytes();
+  mi.uordblks -= cached;
+  mi.fordblks += cached;
+  return mi;
 }
 #endif /* NO_MALLINFO */
 
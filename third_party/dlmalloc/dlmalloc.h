@@ -16,6 +16,7 @@
 #define dlmalloc_max_footprint       __dlmalloc_max_footprint
 #define dlmalloc_set_footprint_limit __dlmalloc_set_footprint_limit
 #define dlmalloc_stats               __dlmalloc_stats
+#define dlmalloc_thread_exit         __dlmalloc_thread_exit
 #define dlmalloc_trim                __dlmalloc_trim
 #define dlmalloc_usable_size         __dlmalloc_usable_size
 #define dlmallopt                    __dlmallopt
@@ -376,6 +377,9 @@ size_t dlbulk_free(void**, size_t n_elements);
   to re-obtain memory from the system.
 
   Malloc_trim returns 1 if it actually released any memory, else 0.
+
+  Small chunks held by the caller's thread cache are released first,
+  and every other thread will flush its cache on its next call.
 */
 int dlmalloc_trim(size_t);
 
@@ -508,6 +512,7 @@ void mspace_inspect_all(mspace msp,
 
 void dlmalloc_atfork(void);
 void dlmalloc_abort(void);
+void dlmalloc_thread_exit(void);
 
 COSMOPOLITAN_C_END_
 #endif /* !(__ASSEMBLER__ + __LINKER__ + 0) */
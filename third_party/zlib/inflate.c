@@ -1557,7 +1557,8 @@ z_streamp source;
     window = Z_NULL;
     if (state->window != Z_NULL) {
         window = (unsigned char FAR *)
-                 ZALLOC(source, 1U << state->wbits, sizeof(unsigned char));
+                 ZALLOC(source, (1U << state->wbits) + CHUNKCOPY_CHUNK_SIZE,
+                        sizeof(unsigned char));
         if (window == Z_NULL) {
             ZFREE(source, copy);
             return Z_MEM_ERROR;
@@ -1576,7 +1577,7 @@ z_streamp source;
     copy->next = copy->codes + (state->next - state->codes);
     if (window != Z_NULL) {
         wsize = 1U << state->wbits;
-        zmemcpy(window, state->window, wsize);
+        zmemcpy(window, state->window, wsize + CHUNKCOPY_CHUNK_SIZE);
     }
     copy->window = window;
     dest->state = (struct internal_state FAR *)copy;
@@ -0,0 +1,142 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/calls/calls.h"
+#include "libc/errno.h"
+#include "libc/fmt/magnumstrs.internal.h"
+#include "libc/log/log.h"
+#include "libc/mem/mem.h"
+#include "libc/runtime/ftrace.internal.h"
+#include "libc/runtime/runtime.h"
+#include "libc/runtime/symbols.internal.h"
+#include "libc/stdio/stdio.h"
+#include "libc/sysv/consts/map.h"
+#include "libc/sysv/consts/o.h"
+#include "libc/sysv/consts/prot.h"
+#include "third_party/getopt/getopt.internal.h"
+#include "tool/build/lib/ftracefold.h"
+
+static const char *prog;
+static const char *dbgpath;
+static const char *inpath;
+
+static wontreturn void Die(const char *path, const char *reason) {
+  tinyprint(2, path, ": ", reason, "\n", NULL);
+  exit(1);
+}
+
+static wontreturn void SysDie(const char *path, const char *func) {
+  const char *errstr;
+  if (!(errstr = _strerdoc(errno))) errstr = "EUNKNOWN";
+  tinyprint(2, path, ": ", func, " failed with ", errstr, "\n", NULL);
+  exit(1);
+}
+
+static wontreturn void PrintUsage(int fd, int exitcode) {
+  tinyprint(fd, "\
+NAME\n\
+\n\
+  Cosmopolitan Ftrace Folder\n\
+\n\
+SYNOPSIS\n\
+\n\
+  ",
+            prog, " [FLAGS] PROG.com.dbg [FTRACE]\n\
+\n\
+DESCRIPTION\n\
+\n\
+  This tool reads the ftrace.out file that's written when a\n\
+  program is run with --ftrace-binary or --ftrace-sample and\n\
+  prints its call stacks in the folded format, one per line,\n\
+  followed by its weight. Calls are weighted by timestamp\n\
+  counter ticks and samples are weighted by one each.\n\
+\n\
+FLAGS\n\
+\n\
+  -h            show this help\n\
+\n\
+EXAMPLE\n\
+\n\
+  o//examples/hello.com --ftrace-sample\n\
+  ftracefold o//examples/hello.com.dbg | flamegraph.pl >hello.svg\n\
+\n\
+",
+            NULL);
+  exit(exitcode);
+}
+
+static void GetOpts(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "h")) != -1) {
+    switch (opt) {
+      case 'h':
+        PrintUsage(1, 0);
+      default:
+        PrintUsage(2, 1);
+    }
+  }
+  if (optind + 1 != argc && optind + 2 != argc) {
+    PrintUsage(2, 1);
+  }
+  dbgpath = argv[optind];
+  inpath = optind + 1 < argc ? argv[optind + 1] : FTRACE_PATH;
+}
+
+int main(int argc, char *argv[]) {
+  int fd;
+  char *out;
+  ssize_t size;
+  struct FtraceFold f = {0};
+  const struct FtraceRecord *map;
+#ifndef NDEBUG
+  ShowCrashReports();
+#endif
+  prog = argv[0];
+  if (!prog) prog = "ftracefold";
+  GetOpts(argc, argv);
+  if (!(f.st = OpenSymbolTable(dbgpath))) {
+    SysDie(dbgpath, "OpenSymbolTable");
+  }
+  if ((fd = open(inpath, O_RDONLY)) == -1) {
+    SysDie(inpath, "open");
+  }
+  if ((size = lseek(fd, 0, SEEK_END)) == -1) {
+    SysDie(inpath, "lseek");
+  }
+  if (size < sizeof(*map)) {
+    Die(inpath, "file is empty");
+  }
+  if ((map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+    SysDie(inpath, "mmap");
+  }
+  if (map->kind != kFtraceHeader || map->addr != FTRACE_MAGIC) {
+    Die(inpath, "not a binary ftrace file");
+  }
+  FoldFtrace(&f, map + 1, size / sizeof(*map) - 1);
+  out = FormatFtraceFold(&f);
+  fputs(out, stdout);
+  free(out);
+  FreeFtraceFold(&f);
+  if (munmap((void *)map, size)) {
+    SysDie(inpath, "munmap");
+  }
+  if (close(fd)) {
+    SysDie(inpath, "close");
+  }
+  return 0;
+}
@@ -0,0 +1,203 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "tool/build/lib/ftracefold.h"
+#include "libc/intrin/kprintf.h"
+#include "libc/macros.internal.h"
+#include "libc/mem/alg.h"
+#include "libc/mem/mem.h"
+#include "libc/stdio/append.h"
+#include "libc/str/str.h"
+#include "libc/x/x.h"
+
+/**
+ * @fileoverview Binary ftrace to folded stacks converter.
+ *
+ * Call records are weighted by the number of timestamp counter ticks
+ * until the next call made by the same thread, which are attributed to
+ * the call stack at that point. Since returns aren't recorded, any time
+ * a function spends after its last callee returns is counted towards
+ * that callee. Samples are weighted by one each.
+ */
+
+static uint64_t HashFtraceStack(const char *s) {
+  uint64_t h = 0xcbf29ce484222325;
+  while (*s) h = (h ^ (*s++ & 255)) * 0x100000001b3;
+  return h;
+}
+
+static void RehashFtraceFold(struct FtraceFold *f, size_t mask) {
+  size_t i, j;
+  struct FtraceFoldStack *p;
+  p = xcalloc(mask + 1, sizeof(*p));
+  for (i = 0; i <= f->mask && f->stacks; ++i) {
+    if (f->stacks[i].name) {
+      j = HashFtraceStack(f->stacks[i].name) & mask;
+      while (p[j].name) j = (j + 1) & mask;
+      p[j] = f->stacks[i];
+    }
+  }
+  free(f->stacks);
+  f->stacks = p;
+  f->mask = mask;
+}
+
+static void AddFtraceStack(struct FtraceFold *f, const char *name,
+                           uint64_t weight) {
+  size_t i;
+  if (f->count * 2 >= f->mask) {
+    RehashFtraceFold(f, f->mask ? f->mask << 1 | 1 : 255);
+  }
+  for (i = HashFtraceStack(name) & f->mask; f->stacks[i].name;
+       i = (i + 1) & f->mask) {
+    if (!strcmp(f->stacks[i].name, name)) {
+      f->stacks[i].weight += weight;
+      return;
+    }
+  }
+  f->stacks[i].name = strdup(name);
+  f->stacks[i].weight = weight;
+  ++f->count;
+}
+
+struct FtraceFoldName {
+  char *p;
+  size_t i, n;
+};
+
+static void AppendFtraceSymbol(struct FtraceFold *f, struct FtraceFoldName *b,
+                               uint64_t addr) {
+  int i;
+  size_t m;
+  char hex[24];
+  const char *s;
+  if (f->st && (i = __get_symbol(f->st, addr)) != -1) {
+    s = __get_symbol_name(f->st, i);
+  } else {
+    ksnprintf(hex, sizeof(hex), "%#lx", addr);
+    s = hex;
+  }
+  m = strlen(s);
+  if (b->i + m + 2 > b->n) {
+    b->n = MAX(b->i + m + 2, b->n * 2);
+    b->p = xrealloc(b->p, b->n);
+  }
+  if (b->i) b->p[b->i++] = ';';
+  memcpy(b->p + b->i, s, m + 1);
+  b->i += m;
+}
+
+static struct FtraceFoldThread *GetFtraceThread(struct FtraceFold *f,
+                                                uint32_t tid) {
+  size_t i;
+  struct FtraceFoldThread *t;
+  for (i = 0; i < f->threadcount; ++i) {
+    if (f->threads[i]->tid == tid) {
+      return f->threads[i];
+    }
+  }
+  t = xcalloc(1, sizeof(*t));
+  t->tid = tid;
+  t->depth = -1;
+  f->threads = xrealloc(f->threads, (f->threadcount + 1) * sizeof(*f->threads));
+  f->threads[f->threadcount++] = t;
+  return t;
+}
+
+/**
+ * Adds records from binary ftrace file.
+ *
+ * Calls may be split across invocations, but samples mustn't be.
+ *
+ * @param f should be zero initialized and may have a symbol table
+ */
+void FoldFtrace(struct FtraceFold *f, const struct FtraceRecord *p, size_t n) {
+  int i, j, k;
+  struct FtraceFoldThread *t;
+  struct FtraceFoldName b = {0};
+  for (i = 0; i < n; i = j) {
+    j = i + 1;
+    b.i = 0;
+    if (p[i].kind == kFtraceCall && p[i].depth < kFtraceFoldDepth) {
+      t = GetFtraceThread(f, p[i].tid);
+      if (t->depth != -1 && p[i].tsc > t->tsc) {
+        for (k = 0; k <= t->depth; ++k) {
+          if (t->stack[k]) {
+            AppendFtraceSymbol(f, &b, t->stack[k]);
+          }
+        }
+        if (b.i) AddFtraceStack(f, b.p, p[i].tsc - t->tsc);
+      }
+      for (k = t->depth + 1; k < p[i].depth; ++k) {
+        t->stack[k] = 0;  // caller wasn't traced
+      }
+      t->stack[p[i].depth] = p[i].addr;
+      t->depth = p[i].depth;
+      t->tsc = p[i].tsc;
+    } else if (p[i].kind == kFtraceSample && !p[i].depth) {
+      while (j < n && p[j].kind == kFtraceSample && p[j].depth &&
+             p[j].tid == p[i].tid && p[j].tsc == p[i].tsc) {
+        ++j;
+      }
+      for (k = j; k-- > i;) {
+        // return addresses point to the instruction after the call
+        AppendFtraceSymbol(f, &b, p[k].addr - (k > i));
+      }
+      AddFtraceStack(f, b.p, 1);
+    }
+  }
+  free(b.p);
+}
+
+static int CompareFtraceStacks(const void *a, const void *b) {
+  const struct FtraceFoldStack *x = a, *y = b;
+  if (!x->name || !y->name) return !x->name - !y->name;
+  return strcmp(x->name, y->name);
+}
+
+/**
+ * Returns folded stacks sorted by name, e.g. "main;foo;bar 123\n".
+ *
+ * This is the input format of Brendan Gregg's flamegraph.pl script.
+ */
+char *FormatFtraceFold(struct FtraceFold *f) {
+  size_t i;
+  char *b = 0;
+  appendr(&b, 0);
+  if (f->count) {
+    qsort(f->stacks, f->mask + 1, sizeof(*f->stacks), CompareFtraceStacks);
+    for (i = 0; i < f->count; ++i) {
+      appendf(&b, "%s %lu\n", f->stacks[i].name, f->stacks[i].weight);
+    }
+    RehashFtraceFold(f, f->mask);
+  }
+  return b;
+}
+
+void FreeFtraceFold(struct FtraceFold *f) {
+  size_t i;
+  for (i = 0; i <= f->mask && f->stacks; ++i) {
+    free(f->stacks[i].name);
+  }
+  for (i = 0; i < f->threadcount; ++i) {
+    free(f->threads[i]);
+  }
+  free(f->stacks);
+  free(f->threads);
+  bzero(f, sizeof(*f));
+}
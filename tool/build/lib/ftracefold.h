@@ -0,0 +1,36 @@
+#ifndef COSMOPOLITAN_TOOL_BUILD_LIB_FTRACEFOLD_H_
+#define COSMOPOLITAN_TOOL_BUILD_LIB_FTRACEFOLD_H_
+#include "libc/runtime/ftrace.internal.h"
+#include "libc/runtime/symbols.internal.h"
+#if !(__ASSEMBLER__ + __LINKER__ + 0)
+COSMOPOLITAN_C_START_
+
+#define kFtraceFoldDepth 513
+
+struct FtraceFoldStack {
+  char *name; /* e.g. "main;foo;bar" */
+  uint64_t weight;
+};
+
+struct FtraceFoldThread {
+  uint32_t tid;
+  int depth; /* of last call, or -1 if none */
+  uint64_t tsc;
+  uint64_t stack[kFtraceFoldDepth];
+};
+
+struct FtraceFold {
+  struct SymbolTable *st;
+  size_t count, mask;
+  struct FtraceFoldStack *stacks;
+  size_t threadcount;
+  struct FtraceFoldThread **threads;
+};
+
+void FoldFtrace(struct FtraceFold *, const struct FtraceRecord *, size_t);
+char *FormatFtraceFold(struct FtraceFold *);
+void FreeFtraceFold(struct FtraceFold *);
+
+COSMOPOLITAN_C_END_
+#endif /* !(__ASSEMBLER__ + __LINKER__ + 0) */
+#endif /* COSMOPOLITAN_TOOL_BUILD_LIB_FTRACEFOLD_H_ */
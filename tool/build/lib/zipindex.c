@@ -0,0 +1,387 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "tool/build/lib/zipindex.h"
+#include "libc/errno.h"
+#include "libc/intrin/bits.h"
+#include "libc/macros.internal.h"
+#include "libc/mem/alg.h"
+#include "libc/mem/mem.h"
+#include "libc/nexgen32e/crc32.h"
+#include "libc/str/str.h"
+#include "libc/sysv/errfuns.h"
+#include "libc/time/struct/tm.h"
+#include "libc/time/time.h"
+#include "libc/zip.internal.h"
+#include "net/http/http.h"
+
+#define kZipIndexMaxDisp   0x1000000
+#define kZipIndexMaxBucket 64
+#define kZipIndexMaxSeeds  32
+
+struct ZipIndexKey {
+  uint64_t hash;
+  uint64_t cf;
+  uint32_t bucket;
+  uint32_t slot;
+};
+
+struct ZipIndexBucket {
+  uint32_t id;
+  uint32_t size;
+  uint32_t start;
+};
+
+static uint64_t ZipIndexMix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccd;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53;
+  x ^= x >> 33;
+  return x;
+}
+
+static uint32_t ZipIndexBucket(uint64_t h, uint32_t buckets) {
+  return (h >> 32) * buckets >> 32;
+}
+
+static uint32_t ZipIndexPlace(uint64_t h, uint32_t d, uint32_t slots) {
+  return (uint32_t)ZipIndexMix(h + d * 0x9e3779b97f4a7c15) * (uint64_t)slots >>
+         32;
+}
+
+static bool IsZipIndexCompressionMethod(int method) {
+  return method == kZipCompressionNone || method == kZipCompressionDeflate;
+}
+
+/**
+ * Hashes zip asset name, eight bytes at a time.
+ */
+uint64_t ZipIndexHash(const void *data, size_t size, uint32_t seed) {
+  size_t i;
+  uint64_t h, w;
+  const unsigned char *p = data;
+  h = ZipIndexMix(seed ^ size * 0x9e3779b97f4a7c15);
+  for (; size >= 8; p += 8, size -= 8) {
+    h = ZipIndexMix(h ^ READ64LE(p));
+  }
+  for (w = i = 0; i < size; ++i) {
+    w |= (uint64_t)p[i] << (i * 8);
+  }
+  return ZipIndexMix(h ^ w);
+}
+
+/**
+ * Returns offset of trailing `.zipindex` record within central
+ * directory, or -1 if the last record isn't one.
+ */
+static int64_t FindZipIndexRecord(const uint8_t *cdir, uint64_t cdirsize) {
+  int64_t i, lo;
+  size_t n = strlen(kZipIndexName);
+  if (cdirsize < kZipCfileHdrMinSize + n) return -1;
+  lo = cdirsize - (kZipCfileHdrMinSize + n + 0xffff * 2);
+  for (i = cdirsize - (kZipCfileHdrMinSize + n); i >= MAX(0, lo); --i) {
+    if (ZIP_CFILE_MAGIC(cdir + i) == kZipCfileHdrMagic &&
+        i + ZIP_CFILE_HDRSIZE(cdir + i) == cdirsize &&
+        ZIP_CFILE_NAMESIZE(cdir + i) == n &&
+        !memcmp(ZIP_CFILE_NAME(cdir + i), kZipIndexName, n)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int CompareZipIndexKeys(const void *a, const void *b) {
+  const struct ZipIndexKey *x = a, *y = b;
+  if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+  if (x->cf != y->cf) return x->cf < y->cf ? -1 : 1;
+  return 0;
+}
+
+static int CompareZipIndexBuckets(const void *a, const void *b) {
+  const struct ZipIndexBucket *x = a, *y = b;
+  if (x->size != y->size) return x->size > y->size ? -1 : 1;
+  return x->id < y->id ? -1 : x->id > y->id;
+}
+
+// hashes names with seed and removes duplicate names, keeping the one
+// that comes first in the central directory, same as a linear search
+static bool HashZipIndexKeys(const uint8_t *cdir, struct ZipIndexKey *k,
+                             size_t *n, uint32_t seed) {
+  size_t i, j;
+  for (i = 0; i < *n; ++i) {
+    k[i].hash = ZipIndexHash(ZIP_CFILE_NAME(cdir + k[i].cf),
+                             ZIP_CFILE_NAMESIZE(cdir + k[i].cf), seed);
+  }
+  qsort(k, *n, sizeof(*k), CompareZipIndexKeys);
+  for (i = j = 0; i < *n; ++i) {
+    if (j && k[j - 1].hash == k[i].hash) {
+      if (ZIP_CFILE_NAMESIZE(cdir + k[j - 1].cf) !=
+              ZIP_CFILE_NAMESIZE(cdir + k[i].cf) ||
+          memcmp(ZIP_CFILE_NAME(cdir + k[j - 1].cf),
+                 ZIP_CFILE_NAME(cdir + k[i].cf),
+                 ZIP_CFILE_NAMESIZE(cdir + k[i].cf))) {
+        return false;  // collision, try another seed
+      }
+      continue;
+    }
+    k[j++] = k[i];
+  }
+  *n = j;
+  return true;
+}
+
+// finds displacement for each bucket so its keys land in free slots,
+// going from biggest to smallest bucket while there's still room
+static bool PlaceZipIndexKeys(struct ZipIndexKey *k, size_t n,
+                              uint32_t buckets, uint32_t slots, uint32_t *disp,
+                              uint8_t *used, struct ZipIndexBucket *b,
+                              uint32_t *order) {
+  uint32_t d, s[kZipIndexMaxBucket];
+  size_t i, j, l, start, size, bucket;
+  bzero(b, buckets * sizeof(*b));
+  bzero(disp, buckets * sizeof(*disp));
+  bzero(used, slots);
+  for (i = 0; i < n; ++i) {
+    k[i].bucket = ZipIndexBucket(k[i].hash, buckets);
+    if (++b[k[i].bucket].size > kZipIndexMaxBucket) return false;
+  }
+  for (j = i = 0; i < buckets; ++i) {
+    b[i].id = i;
+    b[i].start = j;
+    j += b[i].size;
+    b[i].size = 0;
+  }
+  for (i = 0; i < n; ++i) {
+    order[b[k[i].bucket].start + b[k[i].bucket].size++] = i;
+  }
+  qsort(b, buckets, sizeof(*b), CompareZipIndexBuckets);
+  for (i = 0; i < buckets && b[i].size; ++i) {
+    bucket = b[i].id;
+    start = b[i].start;
+    size = b[i].size;
+    for (d = 0;; ++d) {
+      if (d == kZipIndexMaxDisp) return false;
+      for (j = 0; j < size; ++j) {
+        s[j] = ZipIndexPlace(k[order[start + j]].hash, d, slots);
+        if (used[s[j]]) break;
+        for (l = 0; l < j; ++l) {
+          if (s[l] == s[j]) break;
+        }
+        if (l < j) break;
+      }
+      if (j == size) break;
+    }
+    disp[bucket] = d;
+    for (j = 0; j < size; ++j) {
+      used[s[j]] = 1;
+      k[order[start + j]].slot = s[j];
+    }
+  }
+  return true;
+}
+
+static void *SerializeZipIndex(const uint8_t *cdir, uint64_t cdirsize,
+                               uint64_t records, const struct ZipIndexKey *k,
+                               size_t n, uint32_t buckets, uint32_t slots,
+                               const uint32_t *disp, uint32_t seed, int gmtoff,
+                               size_t *out_size) {
+  size_t i;
+  struct tm tm;
+  uint8_t *p, *q;
+  struct timespec lm;
+  *out_size = kZipIndexHdrSize + buckets * 4 + slots * kZipIndexSlotSize;
+  if (!(p = calloc(1, *out_size))) return 0;
+  WRITE32LE(p, kZipIndexMagic);
+  WRITE32LE(p + 4, slots);
+  WRITE32LE(p + 8, buckets);
+  WRITE32LE(p + 12, crc32c(0, cdir, cdirsize));
+  WRITE64LE(p + 16, cdirsize);
+  WRITE64LE(p + 24, records);
+  WRITE32LE(p + 32, seed);
+  WRITE32LE(p + 36, gmtoff);
+  for (i = 0; i < buckets; ++i) {
+    WRITE32LE(p + kZipIndexHdrSize + i * 4, disp[i]);
+  }
+  for (i = 0; i < n; ++i) {
+    q = (uint8_t *)ZIP_INDEX_SLOT(p, k[i].slot);
+    GetZipCfileTimestamps(cdir + k[i].cf, &lm, 0, 0, gmtoff);
+    WRITE64LE(q, k[i].cf);
+    WRITE64LE(q + 8, GetZipCfileOffset(cdir + k[i].cf));
+    WRITE64LE(q + 16, lm.tv_sec);
+    WRITE32LE(q + 24, MAX(1, (uint32_t)k[i].hash));
+    WRITE32LE(q + 28, ZIP_CFILE_INTERNALATTRIBUTES(cdir + k[i].cf) &
+                              kZipIattrText
+                          ? kZipIndexFlagText
+                          : 0);
+    gmtime_r(&lm.tv_sec, &tm);
+    FormatHttpDateTime((char *)q + 32, &tm);
+  }
+  return p;
+}
+
+/**
+ * Creates perfect hash index of zip central directory.
+ *
+ * A trailing `.zipindex` record is left out, so an archive can be
+ * reindexed after it's been modified.
+ *
+ * @param zip is the memory mapped archive
+ * @param eocd points to end of central directory record
+ * @param gmtoff is timezone offset used for msdos timestamps
+ * @param out_size receives byte length of index
+ * @return malloc'd index, or NULL w/ errno
+ * @raise EINVAL if central directory is corrupt
+ * @raise EDEADLK if a perfect hash couldn't be found
+ */
+void *CreateZipIndex(const uint8_t *zip, size_t zipsize, const uint8_t *eocd,
+                     int gmtoff, size_t *out_size) {
+  void *res;
+  int64_t idx;
+  uint8_t *used;
+  const uint8_t *cdir;
+  struct ZipIndexBucket *b;
+  struct ZipIndexKey *k, *t;
+  size_t i, n, m, records;
+  uint64_t cf, cdiroff, cdirsize;
+  uint32_t seed, slots, buckets, *disp, *order;
+  cdiroff = GetZipCdirOffset(eocd);
+  cdirsize = GetZipCdirSize(eocd);
+  records = GetZipCdirRecords(eocd);
+  if (cdiroff > zipsize || cdirsize > zipsize - cdiroff) {
+    einval();
+    return 0;
+  }
+  cdir = zip + cdiroff;
+  if ((idx = FindZipIndexRecord(cdir, cdirsize)) != -1) {
+    cdirsize = idx;
+    --records;
+  }
+  if (records > 0xffffffff / 2) {
+    einval();
+    return 0;
+  }
+  if (!(k = calloc(MAX(1, records), sizeof(*k)))) return 0;
+  for (n = i = cf = 0; i < records; ++i, cf += ZIP_CFILE_HDRSIZE(cdir + cf)) {
+    if (cf + kZipCfileHdrMinSize > cdirsize ||
+        ZIP_CFILE_MAGIC(cdir + cf) != kZipCfileHdrMagic ||
+        cf + ZIP_CFILE_HDRSIZE(cdir + cf) > cdirsize) {
+      free(k);
+      einval();
+      return 0;
+    }
+    if (IsZipIndexCompressionMethod(ZIP_CFILE_COMPRESSIONMETHOD(cdir + cf))) {
+      k[n++].cf = cf;
+    }
+  }
+  if (cf != cdirsize) {
+    free(k);
+    einval();
+    return 0;
+  }
+  res = 0;
+  buckets = MAX(1, n / 4);
+  t = malloc(MAX(1, n) * sizeof(*t));
+  b = malloc(buckets * sizeof(*b));
+  disp = malloc(buckets * sizeof(*disp));
+  order = malloc(MAX(1, n) * sizeof(*order));
+  used = malloc(MAX(1, n + n / 16 + 1));
+  if (t && b && disp && order && used) {
+    for (seed = 0; seed < kZipIndexMaxSeeds; ++seed) {
+      m = n;
+      memcpy(t, k, n * sizeof(*t));
+      if (!HashZipIndexKeys(cdir, t, &m, seed)) continue;
+      // use minimal table, unless we're having bad luck
+      slots = m + (seed >= kZipIndexMaxSeeds / 2 ? m / 16 + 1 : 0);
+      buckets = MAX(1, m / 4);
+      if (PlaceZipIndexKeys(t, m, buckets, slots, disp, used, b, order)) {
+        res = SerializeZipIndex(cdir, cdirsize, records, t, m, buckets, slots,
+                                disp, seed, gmtoff, out_size);
+        break;
+      }
+    }
+    if (seed == kZipIndexMaxSeeds) errno = EDEADLK;
+  }
+  free(used);
+  free(order);
+  free(disp);
+  free(b);
+  free(t);
+  free(k);
+  return res;
+}
+
+/**
+ * Returns prebuilt index of memory mapped zip archive.
+ *
+ * @param zip is the memory mapped archive
+ * @param eocd points to end of central directory record
+ * @param gmtoff is timezone offset used for msdos timestamps
+ * @return pointer to index content inside `zip`, or NULL if it's
+ *     missing, compressed, or no longer matches central directory
+ */
+const uint8_t *GetZipIndex(const uint8_t *zip, size_t zipsize,
+                           const uint8_t *eocd, int gmtoff) {
+  int64_t idx;
+  const uint8_t *cdir, *cf, *lf, *p;
+  uint64_t lfoff, size, cdiroff, cdirsize;
+  cdiroff = GetZipCdirOffset(eocd);
+  cdirsize = GetZipCdirSize(eocd);
+  if (cdiroff > zipsize || cdirsize > zipsize - cdiroff) return 0;
+  cdir = zip + cdiroff;
+  if ((idx = FindZipIndexRecord(cdir, cdirsize)) == -1) return 0;
+  cf = cdir + idx;
+  if (ZIP_CFILE_COMPRESSIONMETHOD(cf) != kZipCompressionNone) return 0;
+  lfoff = GetZipCfileOffset(cf);
+  size = GetZipCfileCompressedSize(cf);
+  if (lfoff > zipsize || zipsize - lfoff < kZipLfileHdrMinSize) return 0;
+  lf = zip + lfoff;
+  if (ZIP_LFILE_MAGIC(lf) != kZipLfileHdrMagic) return 0;
+  if (ZIP_LFILE_HDRSIZE(lf) > zipsize - lfoff) return 0;
+  if (size > zipsize - lfoff - ZIP_LFILE_HDRSIZE(lf)) return 0;
+  p = ZIP_LFILE_CONTENT(lf);
+  if (size < kZipIndexHdrSize || ZIP_INDEX_MAGIC(p) != kZipIndexMagic ||
+      ZIP_INDEX_SIZE(p) != size || ZIP_INDEX_CDIRSIZE(p) != idx ||
+      ZIP_INDEX_RECORDS(p) + 1 != GetZipCdirRecords(eocd) ||
+      ZIP_INDEX_GMTOFF(p) != gmtoff || !ZIP_INDEX_BUCKETS(p) ||
+      ZIP_INDEX_CDIRSUM(p) != crc32c(0, cdir, idx)) {
+    return 0;
+  }
+  return p;
+}
+
+/**
+ * Returns slot of zip index that could hold `name`.
+ *
+ * The caller must check that the central directory record referenced
+ * by the slot has the same name.
+ *
+ * @return slot number, or -1 if name definitely isn't indexed
+ */
+int64_t FindZipIndexSlot(const uint8_t *idx, const void *name, size_t size) {
+  uint64_t h;
+  uint32_t i, slots;
+  if (!(slots = ZIP_INDEX_SLOTS(idx))) return -1;
+  h = ZipIndexHash(name, size, ZIP_INDEX_SEED(idx));
+  i = ZipIndexPlace(
+      h, ZIP_INDEX_DISP(idx, ZipIndexBucket(h, ZIP_INDEX_BUCKETS(idx))), slots);
+  if (ZIP_INDEX_SLOT_HASH(ZIP_INDEX_SLOT(idx, i)) != MAX(1, (uint32_t)h)) {
+    return -1;
+  }
+  return i;
+}
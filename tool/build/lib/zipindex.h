@@ -0,0 +1,60 @@
+#ifndef COSMOPOLITAN_TOOL_BUILD_LIB_ZIPINDEX_H_
+#define COSMOPOLITAN_TOOL_BUILD_LIB_ZIPINDEX_H_
+
+/**
+ * @fileoverview Prebuilt perfect hash index of zip central directory.
+ *
+ * The index is stored uncompressed as the last entry of the archive,
+ * named `.zipindex`, so a server can map it instead of hashing every
+ * central directory record on startup. It only describes the records
+ * preceding it, which are checksummed, so it goes stale the moment a
+ * file is added, replaced, or removed, in which case it's ignored.
+ *
+ * All integers are little endian. Records are found using CHD, i.e.
+ * a name hashes to a bucket whose displacement picks the final slot.
+ * Lookups always need to compare the name, since any string will map
+ * to some slot.
+ */
+
+#define kZipIndexName      ".zipindex"
+#define kZipIndexMagic     0x7864697a /* "zidx" */
+#define kZipIndexHdrSize   40
+#define kZipIndexSlotSize  64
+#define kZipIndexFlagText  1
+
+#if !(__ASSEMBLER__ + __LINKER__ + 0)
+COSMOPOLITAN_C_START_
+
+/* index header */
+#define ZIP_INDEX_MAGIC(P)    READ32LE(P)
+#define ZIP_INDEX_SLOTS(P)    READ32LE((P) + 4)  /* number of records */
+#define ZIP_INDEX_BUCKETS(P)  READ32LE((P) + 8)  /* displacement table */
+#define ZIP_INDEX_CDIRSUM(P)  READ32LE((P) + 12) /* crc32c of cdir prefix */
+#define ZIP_INDEX_CDIRSIZE(P) READ64LE((P) + 16) /* bytes of cdir indexed */
+#define ZIP_INDEX_RECORDS(P)  READ64LE((P) + 24) /* cdir records indexed */
+#define ZIP_INDEX_SEED(P)     READ32LE((P) + 32) /* for ZipIndexHash() */
+#define ZIP_INDEX_GMTOFF(P)   ((int32_t)READ32LE((P) + 36))
+#define ZIP_INDEX_DISP(P, I)  READ32LE((P) + kZipIndexHdrSize + (I)*4)
+#define ZIP_INDEX_SLOT(P, I)                           \
+  ((P) + kZipIndexHdrSize + ZIP_INDEX_BUCKETS(P) * 4 + \
+   (uint64_t)(I)*kZipIndexSlotSize)
+#define ZIP_INDEX_SIZE(P)                            \
+  (kZipIndexHdrSize + ZIP_INDEX_BUCKETS(P) * 4 + \
+   ZIP_INDEX_SLOTS(P) * (uint64_t)kZipIndexSlotSize)
+
+/* index slot */
+#define ZIP_INDEX_SLOT_CFILE(P)        READ64LE(P) /* relative to cdir */
+#define ZIP_INDEX_SLOT_LFILE(P)        READ64LE((P) + 8)
+#define ZIP_INDEX_SLOT_LASTMODIFIED(P) ((int64_t)READ64LE((P) + 16))
+#define ZIP_INDEX_SLOT_HASH(P)         READ32LE((P) + 24) /* never zero */
+#define ZIP_INDEX_SLOT_FLAGS(P)        READ32LE((P) + 28)
+#define ZIP_INDEX_SLOT_DATE(P)         ((const char *)((P) + 32)) /* nul */
+
+uint64_t ZipIndexHash(const void *, size_t, uint32_t);
+void *CreateZipIndex(const uint8_t *, size_t, const uint8_t *, int, size_t *);
+const uint8_t *GetZipIndex(const uint8_t *, size_t, const uint8_t *, int);
+int64_t FindZipIndexSlot(const uint8_t *, const void *, size_t);
+
+COSMOPOLITAN_C_END_
+#endif /* !(__ASSEMBLER__ + __LINKER__ + 0) */
+#endif /* COSMOPOLITAN_TOOL_BUILD_LIB_ZIPINDEX_H_ */
@@ -0,0 +1,151 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "tool/build/lib/ziposindex.h"
+#include "libc/dos.internal.h"
+#include "libc/intrin/bits.h"
+#include "libc/macros.internal.h"
+#include "libc/mem/alg.h"
+#include "libc/mem/mem.h"
+#include "libc/nexgen32e/crc32.h"
+#include "libc/runtime/zipos.internal.h"
+#include "libc/str/str.h"
+#include "libc/sysv/consts/s.h"
+#include "libc/zip.internal.h"
+#include "third_party/zlib/zlib.h"
+
+#define kZipExtraPadding 0xd935 /* same as android zipalign */
+
+static int CompareZiposNames(const void *a, const void *b, void *c) {
+  const uint8_t *x = (const uint8_t *)c + *(const uint32_t *)a;
+  const uint8_t *y = (const uint8_t *)c + *(const uint32_t *)b;
+  int xn = ZIP_CFILE_NAMESIZE(x);
+  int yn = ZIP_CFILE_NAMESIZE(y);
+  int n = MIN(xn, yn);
+  if (n) {
+    int res = memcmp(ZIP_CFILE_NAME(x), ZIP_CFILE_NAME(y), n);
+    if (res) return res;
+  }
+  if (xn != yn) return xn - yn;
+  return *(const uint32_t *)a < *(const uint32_t *)b ? -1 : 1;
+}
+
+/**
+ * Creates prebuilt index of zip central directory for zipos.
+ *
+ * The index describes `cdir` as well as its own record, which must be
+ * appended to it, and local file offsets in `cdir` need to be final.
+ *
+ * @param cdir is the central directory which will precede the index
+ * @param cdirsize is the byte length of `cdir`
+ * @param records is the number of records in `cdir`
+ * @param lfoff is the file offset at which the local file is written
+ * @param out_lfsize receives byte length of local file record
+ * @param out_size receives byte length of result
+ * @return local file record followed by central directory record,
+ *     which should be freed, or NULL w/ errno
+ */
+void *CreateZiposIndex(const uint8_t *cdir, size_t cdirsize, size_t records,
+                       size_t lfoff, size_t *out_lfsize, size_t *out_size) {
+  uint32_t *index;
+  uint8_t *res, *lf, *cf, *tmp, *p;
+  size_t i, j, c, n, pad, slots, size, lfsize, cfsize;
+  n = strlen(kZiposIndexName);
+  for (slots = 1; slots < (records + 1) * 2;) slots <<= 1;
+  size = kZiposIndexHdrSize + (records + 1 + slots) * 4;
+  if ((pad = -(lfoff + kZipLfileHdrMinSize + n) & 3)) pad += kZipExtraHdrSize;
+  lfsize = kZipLfileHdrMinSize + n + pad + size;
+  cfsize = kZipCfileHdrMinSize + n;
+  if (!(res = calloc(1, lfsize + cfsize))) return 0;
+  tmp = malloc(cdirsize + cfsize);
+  index = calloc(records + 1 + slots, sizeof(uint32_t));
+  if (!tmp || !index) {
+    free(index);
+    free(tmp);
+    free(res);
+    return 0;
+  }
+  lf = res;
+  cf = res + lfsize;
+  p = lf + kZipLfileHdrMinSize + n + pad;
+
+  // make index content, sorting names of its own record too
+  memcpy(ZIP_CFILE_NAME(cf), kZiposIndexName, n);
+  WRITE16LE(cf + kZipCfileOffsetNamesize, n);
+  memcpy(tmp, cdir, cdirsize);
+  memcpy(tmp + cdirsize, cf, cfsize);
+  for (c = i = 0; i < records + 1; ++i, c += ZIP_CFILE_HDRSIZE(tmp + c)) {
+    index[i] = c;
+  }
+  qsort_r(index, records + 1, sizeof(uint32_t), CompareZiposNames, tmp);
+  for (i = 0; i < records + 1; ++i) {
+    c = index[i];
+    for (j = __zipos_hash(ZIP_CFILE_NAME(tmp + c), ZIP_CFILE_NAMESIZE(tmp + c));
+         ; ++j) {
+      uint32_t *slot = index + records + 1 + (j & (slots - 1));
+      if (!*slot) {
+        *slot = c + 1;
+        break;
+      }
+      if (ZIP_CFILE_NAMESIZE(tmp + *slot - 1) == ZIP_CFILE_NAMESIZE(tmp + c) &&
+          !memcmp(ZIP_CFILE_NAME(tmp + *slot - 1), ZIP_CFILE_NAME(tmp + c),
+                  ZIP_CFILE_NAMESIZE(tmp + c))) {
+        break;  // leftmost duplicate wins
+      }
+    }
+  }
+  memcpy(p + kZiposIndexHdrSize, index, (records + 1 + slots) * 4);
+  WRITE32LE(p, kZiposIndexMagic);
+  WRITE32LE(p + 4, records + 1);
+  WRITE32LE(p + 8, cdirsize);
+  WRITE32LE(p + 12, crc32c(0, cdir, cdirsize));
+  WRITE32LE(p + 16, slots);
+  free(index);
+  free(tmp);
+
+  // make local file record
+  WRITE32LE(lf, kZipLfileHdrMagic);
+  lf[4] = kZipEra1993;
+  WRITE16LE(lf + kZipLfileOffsetLastmodifieddate, DOS_DATE(1980, 1, 1));
+  WRITE32LE(lf + kZipLfileOffsetCrc32, crc32_z(0, p, size));
+  WRITE32LE(lf + kZipLfileOffsetCompressedsize, size);
+  WRITE32LE(lf + kZipLfileOffsetUncompressedsize, size);
+  WRITE16LE(lf + kZipLfileOffsetNamesize, n);
+  WRITE16LE(lf + 28, pad);
+  memcpy(lf + kZipLfileHdrMinSize, kZiposIndexName, n);
+  if (pad) {
+    WRITE16LE(lf + kZipLfileHdrMinSize + n, kZipExtraPadding);
+    WRITE16LE(lf + kZipLfileHdrMinSize + n + 2, pad - kZipExtraHdrSize);
+  }
+
+  // make central directory record
+  WRITE32LE(cf, kZipCfileHdrMagic);
+  cf[4] = kZipEra1993;
+  cf[5] = kZipOsUnix;
+  cf[6] = kZipEra1993;
+  WRITE16LE(cf + kZipCfileOffsetLastmodifieddate, DOS_DATE(1980, 1, 1));
+  WRITE32LE(cf + kZipCfileOffsetCrc32, crc32_z(0, p, size));
+  WRITE32LE(cf + kZipCfileOffsetCompressedsize, size);
+  WRITE32LE(cf + kZipCfileOffsetUncompressedsize, size);
+  WRITE32LE(cf + kZipCfileOffsetExternalattributes, (S_IFREG | 0444) << 16);
+  WRITE32LE(cf + kZipCfileOffsetOffset, lfoff);
+
+  *out_lfsize = lfsize;
+  *out_size = lfsize + cfsize;
+  return res;
+}
@@ -0,0 +1,11 @@
+#ifndef COSMOPOLITAN_TOOL_BUILD_LIB_ZIPOSINDEX_H_
+#define COSMOPOLITAN_TOOL_BUILD_LIB_ZIPOSINDEX_H_
+#if !(__ASSEMBLER__ + __LINKER__ + 0)
+COSMOPOLITAN_C_START_
+
+void *CreateZiposIndex(const uint8_t *, size_t, size_t, size_t, size_t *,
+                       size_t *);
+
+COSMOPOLITAN_C_END_
+#endif /* !(__ASSEMBLER__ + __LINKER__ + 0) */
+#endif /* COSMOPOLITAN_TOOL_BUILD_LIB_ZIPOSINDEX_H_ */
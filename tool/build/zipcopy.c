@@ -24,7 +24,9 @@
 #include "libc/errno.h"
 #include "libc/fmt/magnumstrs.internal.h"
 #include "libc/limits.h"
+#include "libc/mem/mem.h"
 #include "libc/runtime/runtime.h"
+#include "libc/runtime/zipos.internal.h"
 #include "libc/stdio/stdio.h"
 #include "libc/str/str.h"
 #include "libc/sysv/consts/map.h"
@@ -32,6 +34,7 @@
 #include "libc/sysv/consts/prot.h"
 #include "libc/zip.internal.h"
 #include "third_party/getopt/getopt.internal.h"
+#include "tool/build/lib/ziposindex.h"
 
 static int infd;
 static int outfd;
@@ -76,6 +79,11 @@ DESCRIPTION\n\
   exist, e.g. an executable, then any existing content will\n\
   be preserved, including an existing zip archive. That may\n\
   however lead to bloat that's not easy to access.\n\
+\n\
+  The central directory is given an extra record at the end\n\
+  named .zipos holding its names sorted, so the cosmopolitan\n\
+  runtime doesn't need to sort them each time it starts. It's\n\
+  ignored if the archive is modified later on by other tools.\n\
 \n\
 FLAGS\n\
 \n\
@@ -109,12 +117,19 @@ static void GetOpts(int argc, char *argv[]) {
   outpath = argv[optind + 1];
 }
 
+static bool IsZiposIndex(const uint8_t *cfile) {
+  return ZIP_CFILE_NAMESIZE(cfile) == strlen(kZiposIndexName) &&
+         !memcmp(ZIP_CFILE_NAME(cfile), kZiposIndexName,
+                 strlen(kZiposIndexName));
+}
+
 static void CopyZip(void) {
   char *secstrs;
   int rela, recs;
   Elf64_Ehdr *ehdr;
+  size_t idxsize, idxlfsize;
+  unsigned char *ineof, *stop, *eocd, *cdir, *lfile, *cfile, *cbuf, *idx;
   unsigned long ldest, cdest, ltotal, ctotal, length;
-  unsigned char *ineof, *stop, *eocd, *cdir, *lfile, *cfile;
 
   // find zip eocd header
   //
@@ -145,7 +160,7 @@ static void CopyZip(void) {
   cdir = inmap + ZIP_CDIR_OFFSET(eocd);
   stop = cdir + ZIP_CDIR_SIZE(eocd);
   for (cfile = cdir; cfile < stop; cfile += ZIP_CFILE_HDRSIZE(cfile)) {
-    if (++recs >= 65536) {
+    if (++recs >= 65535) {
       Die(inpath, "too many zip files");
     }
     if (cfile < inmap ||                        //
@@ -168,12 +183,13 @@ static void CopyZip(void) {
     if (READ32LE(lfile) != kZipLfileHdrMagic) {
       Die(inpath, "zip local file corrupted");
     }
+    if (IsZiposIndex(cfile)) {
+      --recs;  // we'll be making a new one
+      continue;
+    }
     ctotal += ZIP_CFILE_HDRSIZE(cfile);
     ltotal += ZIP_LFILE_SIZE(lfile);
   }
-  if (outsize + ltotal + ctotal + ZIP_CDIR_HDRSIZE(eocd) > INT_MAX) {
-    Die(outpath, "the time has come to upgrade to zip64");
-  }
 
   // write output
   if ((outfd = open(outpath, O_WRONLY | O_CREAT, 0644)) == -1) {
@@ -182,9 +198,13 @@ static void CopyZip(void) {
   if ((outsize = lseek(outfd, 0, SEEK_END)) == -1) {
     SysDie(outpath, "lseek");
   }
+  if (!(cbuf = malloc(ctotal))) {
+    SysDie(outpath, "malloc");
+  }
   ldest = outsize;
-  cdest = outsize + ltotal;
+  cdest = 0;
   for (cfile = cdir; cfile < stop; cfile += ZIP_CFILE_HDRSIZE(cfile)) {
+    if (IsZiposIndex(cfile)) continue;
     lfile = inmap + ZIP_CFILE_OFFSET(cfile);
     WRITE32LE(cfile + kZipCfileOffsetOffset, ldest);
     // write local file
@@ -193,21 +213,46 @@ static void CopyZip(void) {
       SysDie(outpath, "lfile pwrite");
     }
     ldest += length;
-    // write directory entry
+    // buffer directory entry
     length = ZIP_CFILE_HDRSIZE(cfile);
-    if (pwrite(outfd, cfile, length, cdest) != length) {
-      SysDie(outpath, "lfile pwrite");
-    }
+    memcpy(cbuf + cdest, cfile, length);
     cdest += length;
   }
-  WRITE32LE(eocd + kZipCdirOffsetOffset, outsize + ltotal);
+
+  // write prebuilt index of central directory for zipos, which goes
+  // after the local files and becomes the last central dir record
+  if (!(idx = CreateZiposIndex(cbuf, ctotal, recs, ldest, &idxlfsize,
+                               &idxsize))) {
+    SysDie(outpath, "CreateZiposIndex");
+  }
+  if (outsize + ltotal + ctotal + idxsize + ZIP_CDIR_HDRSIZE(eocd) > INT_MAX) {
+    Die(outpath, "the time has come to upgrade to zip64");
+  }
+  if (pwrite(outfd, idx, idxlfsize, ldest) != idxlfsize) {
+    SysDie(outpath, "lfile pwrite");
+  }
+  cdest = ldest + idxlfsize;
+  if (pwrite(outfd, cbuf, ctotal, cdest) != ctotal) {
+    SysDie(outpath, "cfile pwrite");
+  }
+  length = idxsize - idxlfsize;
+  if (pwrite(outfd, idx + idxlfsize, length, cdest + ctotal) != length) {
+    SysDie(outpath, "cfile pwrite");
+  }
+  WRITE16LE(eocd + kZipCdirRecordsOnDiskOffset, recs + 1);
+  WRITE16LE(eocd + kZipCdirRecordsOffset, recs + 1);
+  WRITE32LE(eocd + kZipCdirSizeOffset, ctotal + length);
+  WRITE32LE(eocd + kZipCdirOffsetOffset, cdest);
   length = ZIP_CDIR_HDRSIZE(eocd);
-  if (pwrite(outfd, eocd, length, cdest) != length) {
+  if (pwrite(outfd, eocd, length, cdest + ctotal + idxsize - idxlfsize) !=
+      length) {
     SysDie(outpath, "eocd pwrite");
   }
   if (close(outfd)) {
     SysDie(outpath, "close");
   }
+  free(cbuf);
+  free(idx);
 }
 
 int main(int argc, char *argv[]) {
@@ -0,0 +1,168 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "libc/calls/calls.h"
+#include "libc/errno.h"
+#include "libc/fmt/conv.h"
+#include "libc/fmt/magnumstrs.internal.h"
+#include "libc/log/log.h"
+#include "libc/mem/mem.h"
+#include "libc/runtime/runtime.h"
+#include "libc/stdio/stdio.h"
+#include "libc/sysv/consts/map.h"
+#include "libc/sysv/consts/o.h"
+#include "libc/sysv/consts/prot.h"
+#include "libc/time/struct/tm.h"
+#include "libc/time/time.h"
+#include "libc/zip.internal.h"
+#include "third_party/getopt/getopt.internal.h"
+#include "tool/build/lib/zipindex.h"
+
+static int gmtoff;
+static bool hasgmtoff;
+static const char *prog;
+static const char *inpath;
+static const char *outpath;
+
+static wontreturn void Die(const char *path, const char *reason) {
+  tinyprint(2, path, ": ", reason, "\n", NULL);
+  exit(1);
+}
+
+static wontreturn void SysDie(const char *path, const char *func) {
+  const char *errstr;
+  if (!(errstr = _strerdoc(errno))) errstr = "EUNKNOWN";
+  tinyprint(2, path, ": ", func, " failed with ", errstr, "\n", NULL);
+  exit(1);
+}
+
+static wontreturn void PrintUsage(int fd, int exitcode) {
+  tinyprint(fd, "\
+NAME\n\
+\n\
+  Cosmopolitan Zip Indexer\n\
+\n\
+SYNOPSIS\n\
+\n\
+  ",
+            prog, " [FLAGS] ZIP OUT\n\
+\n\
+DESCRIPTION\n\
+\n\
+  This tool creates a perfect hash table of the assets in a\n\
+  zip archive, e.g. redbean.com, which the server will use\n\
+  rather than indexing the central directory on startup. It\n\
+  must be added to the archive uncompressed, as its very last\n\
+  entry, and be named .zipindex, otherwise it'll be ignored.\n\
+  The same goes for when the archive changes after indexing,\n\
+  in which case this tool should simply be run again.\n\
+\n\
+FLAGS\n\
+\n\
+  -h            show this help\n\
+  -g SECONDS    timezone offset for msdos timestamps, which\n\
+                must be the same as the server's local time\n\
+                (defaults to the current local time offset)\n\
+\n\
+EXAMPLE\n\
+\n\
+  zipindex redbean.com .zipindex\n\
+  zip -0 redbean.com .zipindex\n\
+\n\
+\n\
+",
+            NULL);
+  exit(exitcode);
+}
+
+static void GetOpts(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "hg:")) != -1) {
+    switch (opt) {
+      case 'g':
+        gmtoff = atoi(optarg);
+        hasgmtoff = true;
+        break;
+      case 'h':
+        PrintUsage(1, 0);
+      default:
+        PrintUsage(2, 1);
+    }
+  }
+  if (optind + 2 != argc) {
+    PrintUsage(2, 1);
+  }
+  inpath = argv[optind + 0];
+  outpath = argv[optind + 1];
+}
+
+int main(int argc, char *argv[]) {
+  int fd;
+  void *idx;
+  struct tm tm;
+  int64_t now;
+  uint8_t *map, *eocd;
+  size_t idxsize;
+  ssize_t size;
+#ifndef NDEBUG
+  ShowCrashReports();
+#endif
+  prog = argv[0];
+  if (!prog) prog = "zipindex";
+  GetOpts(argc, argv);
+  if (!hasgmtoff) {
+    now = time(0);
+    localtime_r(&now, &tm);
+    gmtoff = tm.tm_gmtoff;
+  }
+  if ((fd = open(inpath, O_RDONLY)) == -1) {
+    SysDie(inpath, "open");
+  }
+  if ((size = lseek(fd, 0, SEEK_END)) == -1) {
+    SysDie(inpath, "lseek");
+  }
+  if (!size) {
+    Die(inpath, "file is empty");
+  }
+  if ((map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+    SysDie(inpath, "mmap");
+  }
+  if (!(eocd = GetZipEocd(map, size, 0))) {
+    Die(inpath, "couldn't locate zip central directory");
+  }
+  if (!(idx = CreateZipIndex(map, size, eocd, gmtoff, &idxsize))) {
+    SysDie(inpath, "CreateZipIndex");
+  }
+  if (munmap(map, size)) {
+    SysDie(inpath, "munmap");
+  }
+  if (close(fd)) {
+    SysDie(inpath, "close");
+  }
+  if ((fd = open(outpath, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+    SysDie(outpath, "open");
+  }
+  if (write(fd, idx, idxsize) != idxsize) {
+    SysDie(outpath, "write");
+  }
+  if (close(fd)) {
+    SysDie(outpath, "close");
+  }
+  free(idx);
+  return 0;
+}
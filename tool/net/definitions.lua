@@ -1309,7 +1309,7 @@ function GetUrl() end
 ---@nodiscard
 function GetUser() end
 
----@return integer httpversion the request HTTP protocol version, which can be `9` for `HTTP/0.9`, `10` for `HTTP/1.0`, or `11` for `HTTP/1.1`.
+---@return integer httpversion the request HTTP protocol version, which can be `9` for `HTTP/0.9`, `10` for `HTTP/1.0`, `11` for `HTTP/1.1`, or `20` for `HTTP/2`.
 ---@nodiscard
 function GetHttpVersion() end
 
@@ -1696,7 +1696,9 @@ function ProgramRedirect(code, src, location) end
 
 --- Defaults to `86400` (24 hours). This may be set to `≤0` to disable SSL tickets.
 --- It's a good idea to use these since it increases handshake performance 10x and
---- eliminates a network round trip. This function is not available in unsecure mode.
+--- eliminates a network round trip. This also sets how long session ids are
+--- remembered, in memory shared by all workers, for clients that don't support
+--- tickets. This function is not available in unsecure mode.
 ---@param seconds integer
 function ProgramSslTicketLifetime(seconds) end
 
@@ -1849,6 +1851,40 @@ function ProgramPidPath(str) end
 ---@return boolean
 function ProgramUniprocess(bool) end
 
+--- Same as the `-n` flag if called from `.init.lua`. Instead of forking a fresh
+--- process for each connection, redbean will fork `workers` long-lived processes
+--- at startup, each of which `accept()`s clients on the shared listening sockets
+--- and serves them one at a time. Listening sockets get the `SO_REUSEPORT` option
+--- so other servers may bind the same port. If `connections` is nonzero, then
+--- each worker exits after serving that many connections and is replaced by a
+--- fresh fork. Workers are also replaced after the zip assets are reindexed or
+--- the server is reloaded. `OnWorkerStart` and `OnWorkerStop` get called once
+--- per worker rather than once per connection. Passing `0` restores the default
+--- fork-per-connection behavior. This has no effect in uniprocess mode.
+---@param workers integer
+---@param connections integer?
+function ProgramWorkerPool(workers, connections) end
+
+--- May only be called from `.init.lua`. Sets the size of the shared memory
+--- region used to remember gzip bodies that redbean creates on the fly for
+--- uncompressed assets, so popular files are only deflated once across all
+--- workers and get served with an exact Content-Length. Entries are keyed by
+--- inode and mtime (or zip offset) plus crc32 and the oldest are evicted
+--- first. Assets larger than a quarter of the cache are streamed as before.
+--- The default is 8mb. Passing 0 disables the cache.
+---@param bytes integer
+function ProgramGzipCache(bytes) end
+
+--- Same as the `-I` flag if called from `.init.lua`. When used with
+--- `ProgramWorkerPool`, each worker waits on an epoll set instead of blocking
+--- on a keep-alive client between requests, so it can go back to accept()ing
+--- while up to `count` idle clients are parked. A parked client is resumed as
+--- soon as it sends more data, and is closed once it's been idle longer than
+--- the `-t` timeout. TLS connections are never parked. Passing 0 (the default)
+--- disables parking. This has no effect on systems without epoll.
+---@param count integer
+function ProgramIdleConnections(count) end
+
 --- Reads all data from file the easy way.
 ---
 --- This function reads file data from local file system. Zip file assets can be
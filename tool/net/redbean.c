@@ -30,6 +30,7 @@
 #include "libc/calls/struct/stat.h"
 #include "libc/calls/struct/termios.h"
 #include "libc/calls/struct/timespec.h"
+#include "libc/calls/syscall-sysv.internal.h"
 #include "libc/calls/termios.h"
 #include "libc/dce.h"
 #include "libc/dns/dns.h"
@@ -65,6 +66,7 @@
 #include "libc/runtime/memtrack.internal.h"
 #include "libc/runtime/runtime.h"
 #include "libc/runtime/stack.h"
+#include "libc/sock/epoll.h"
 #include "libc/sock/goodsocket.internal.h"
 #include "libc/sock/sock.h"
 #include "libc/sock/struct/pollfd.h"
@@ -81,14 +83,17 @@
 #include "libc/sysv/consts/clock.h"
 #include "libc/sysv/consts/clone.h"
 #include "libc/sysv/consts/dt.h"
+#include "libc/sysv/consts/epoll.h"
 #include "libc/sysv/consts/ex.h"
 #include "libc/sysv/consts/exit.h"
 #include "libc/sysv/consts/f.h"
 #include "libc/sysv/consts/hwcap.h"
+#include "libc/sysv/consts/in.h"
 #include "libc/sysv/consts/inaddr.h"
 #include "libc/sysv/consts/ipproto.h"
 #include "libc/sysv/consts/madv.h"
 #include "libc/sysv/consts/map.h"
+#include "libc/sysv/consts/msg.h"
 #include "libc/sysv/consts/o.h"
 #include "libc/sysv/consts/poll.h"
 #include "libc/sysv/consts/pr.h"
@@ -97,7 +102,9 @@
 #include "libc/sysv/consts/s.h"
 #include "libc/sysv/consts/sa.h"
 #include "libc/sysv/consts/sig.h"
+#include "libc/sysv/consts/so.h"
 #include "libc/sysv/consts/sock.h"
+#include "libc/sysv/consts/sol.h"
 #include "libc/sysv/consts/termios.h"
 #include "libc/sysv/consts/timer.h"
 #include "libc/sysv/consts/w.h"
@@ -110,6 +117,7 @@
 #include "libc/zip.internal.h"
 #include "net/http/escape.h"
 #include "net/http/http.h"
+#include "net/http/http2.h"
 #include "net/http/ip.h"
 #include "net/http/tokenbucket.h"
 #include "net/http/url.h"
@@ -120,6 +128,7 @@
 #include "third_party/lua/lrepl.h"
 #include "third_party/lua/lualib.h"
 #include "third_party/lua/lunix.h"
+#include "third_party/mbedtls/cipher.h"
 #include "third_party/mbedtls/ctr_drbg.h"
 #include "third_party/mbedtls/debug.h"
 #include "third_party/mbedtls/iana.h"
@@ -127,12 +136,15 @@
 #include "third_party/mbedtls/oid.h"
 #include "third_party/mbedtls/san.h"
 #include "third_party/mbedtls/ssl.h"
+#include "third_party/mbedtls/ssl_ciphersuites.h"
+#include "third_party/mbedtls/ssl_internal.h"
 #include "third_party/mbedtls/ssl_ticket.h"
 #include "third_party/mbedtls/x509.h"
 #include "third_party/mbedtls/x509_crt.h"
 #include "third_party/zlib/zlib.h"
 #include "tool/args/args.h"
 #include "tool/build/lib/case.h"
+#include "tool/build/lib/zipindex.h"
 #include "tool/net/lfinger.h"
 #include "tool/net/lfuncs.h"
 #include "tool/net/ljson.h"
@@ -184,6 +196,13 @@ __static_yoink("ShowCrashReportsEarly");
 #define VERSION          0x020200
 #define HASH_LOAD_FACTOR /* 1. / */ 4
 #define MONITOR_MICROS   150000
+#define STAGE_CACHE_MAX  65536
+#define STAGE_REBUILD_MS 30000  // least time between stage dir reindexes
+#define STAGE_WATCH_MASK                                                 \
+  (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | \
+   IN_MOVE_SELF)
+#define HTTP2_STREAMS    100    // our SETTINGS_MAX_CONCURRENT_STREAMS
+#define HTTP2_FRAGMENTS  32     // most CONTINUATION frames per header block
 #define READ(F, P, N)    readv(F, &(struct iovec){P, N}, 1)
 #define WRITE(F, P, N)   writev(F, &(struct iovec){P, N}, 1)
 #define LockInc(P)       (*(_Atomic(typeof(*(P))) *)(P))++
@@ -219,11 +238,11 @@ __static_yoink("ShowCrashReportsEarly");
     }                       \
   } while (0)
 
-// letters not used: INOQYnoqwxy
+// letters not used: NOQYoqxy
 // digits not used:  0123456789
 // puncts not used:  !"#$&'()+,-./;<=>@[\]^_`{|}~
 #define GETOPTS \
-  "*%BEJSVXZabdfghijkmsuvzA:C:D:F:G:H:K:L:M:P:R:T:U:W:c:e:l:p:r:t:w:"
+  "*%BEJSVXZabdfghijkmsuvzA:C:D:F:G:H:I:K:L:M:P:R:T:U:W:c:e:l:n:p:r:t:w:"
 
 static const uint8_t kGzipHeader[] = {
     0x1F,        // MAGNUM
@@ -250,6 +269,12 @@ static const char *const kAlpn[] = {
     NULL,
 };
 
+static const char *const kAlpnServer[] = {
+    "h2",
+    "http/1.1",
+    NULL,
+};
+
 struct Buffer {
   size_t n, c;
   char *p;
@@ -333,6 +358,19 @@ static struct Certs {
   struct Cert *p;
 } certs;
 
+static struct Idlers {
+  size_t n, c;
+  struct Idler {
+    uint16_t server;  // plus one, or zero if slot isn't parked
+    int messages;
+    struct sockaddr_in addr;
+    struct timespec since;
+    struct timespec start;
+    size_t len;
+    char *buf;  // partial message that arrived while parked
+  } * p;  // indexed by file descriptor
+} idlers;
+
 static struct Redirects {
   size_t n;
   struct Redirect {
@@ -385,6 +423,9 @@ struct Blackhole {
 
 static struct Shared {
   int workers;
+  int poolgen;
+  int nextshard;
+  int stagegen;
   struct timespec nowish;
   struct timespec lastreindex;
   struct timespec lastmeltdown;
@@ -395,10 +436,48 @@ static struct Shared {
 #define C(x) long x;
 #include "tool/net/counters.inc"
 #undef C
-  } c;
+  } forcealign(64) c[64];  // sharded by worker so cache lines don't bounce
   pthread_spinlock_t montermlock;
 } * shared;
 
+static struct Counters *counters;
+
+// compressed responses shared by all workers
+// entries are direct mapped and their bodies live in a ring buffer
+// readers don't lock, and instead check that an entry's sequence was
+// the same before and after copying its body, whereas writers take the
+// lock, but only try to, so a worker dying while holding it only makes
+// the cache read-only rather than hanging the others
+static struct GzipCache {
+  pthread_spinlock_t lock;  // held by the one worker adding an entry
+  size_t size;
+  size_t head;
+  struct GzipCacheEntry {
+    uint64_t ino;  // cf offset if zip asset
+    uint64_t dev;  // -1 if zip asset
+    int64_t mtime;
+    uint32_t crc;
+    uint32_t size;
+    uint32_t seq;  // odd while entry or its body is being changed
+    size_t off;
+    size_t len;  // zero if slot is empty
+  } e[1024];
+  char data[];
+} * gzipcache;
+
+// tls sessions shared by all workers so clients can resume on any
+// entries are direct mapped by session id and striped across locks
+static struct SslCache {
+  pthread_spinlock_t lock[16];
+  struct SslCacheEntry {
+    int64_t expires;
+    uint16_t size;
+    uint8_t idlen;
+    uint8_t id[32];
+    unsigned char data[512];
+  } e[2048];
+} * sslcache;
+
 static const char kCounterNames[] =
 #define C(x) #x "\0"
 #include "tool/net/counters.inc"
@@ -417,8 +496,11 @@ struct ClearedPerMessage {
   int frags;
   int statuscode;
   int isyielding;
+  int sendfd;
   char *outbuf;
   char *content;
+  char *sendbase;
+  size_t sendsize;
   size_t gzipped;
   size_t contentlength;
   char *luaheaderp;
@@ -429,6 +511,39 @@ struct ClearedPerMessage {
   struct HttpMessage msg;
 } cpm;
 
+// http/2 connection state, which lives as long as HandleHttp2() runs
+// streams are served one at a time, in the order they're received,
+// whereas frames for other streams may arrive while one's being sent
+static struct Http2 {
+  bool goaway;
+  bool gotsettings;
+  uint8_t blockflags;   // flags of HEADERS frame being continued
+  uint32_t fragments;   // CONTINUATION frames received for header block
+  uint32_t blockid;     // stream whose header block is being continued
+  uint32_t lastid;      // highest stream id opened by client
+  uint32_t maxframe;    // peer's SETTINGS_MAX_FRAME_SIZE
+  int64_t initwindow;   // peer's SETTINGS_INITIAL_WINDOW_SIZE
+  int64_t window;       // connection-level send window
+  size_t inlen, inc;
+  char *in;             // received bytes not yet parsed as frames
+  char *block;          // header block fragments
+  struct Hpack hpack;
+  struct Http2Stream {
+    uint32_t id;        // zero if slot is empty
+    bool ended;         // client sent END_STREAM
+    bool huge;          // body exceeded maxpayloadsize
+    bool bad;           // malformed header block
+    bool gotfield;      // regular field seen so pseudo ones must end
+    bool hog;           // header list exceeded our max header list size
+    size_t listsize;    // decoded header list size per RFC9113 § 6.5.2
+    int64_t window;     // stream-level send window
+    char *pseudo[4];    // :method :scheme :authority :path
+    char *head;         // regular fields as http/1.1 header lines
+    char *cookie;       // cookie crumbs joined with semicolons
+    char *body;
+  } s[HTTP2_STREAMS];
+} h2;
+
 static bool suiteb;
 static bool killed;
 static bool zombied;
@@ -443,6 +558,7 @@ static bool daemonize;
 static bool logrusage;
 static bool logbodies;
 static bool requiressl;
+static bool usinghttp2;
 static bool sslcliused;
 static bool loglatency;
 static bool terminated;
@@ -456,6 +572,7 @@ static bool selfmodifiable;
 static bool interpretermode;
 static bool sslclientverify;
 static bool connectionclose;
+static bool connectionparked;
 static bool hasonloglatency;
 static bool hasonworkerstop;
 static bool isexitingworker;
@@ -478,6 +595,14 @@ static int sandboxed;
 static int changeuid;
 static int changegid;
 static int maxworkers;
+static int workerpool;
+static int idlelimit;
+static int idleepoll = -1;
+static int zmapfd = -1;
+static int zindexgen;
+static int luapagesgen = -1;
+static long gzipcachesize = 8 * 1024 * 1024;
+static int poolgen;
 static int shutdownsig;
 static int sslpskindex;
 static int oldloglevel;
@@ -492,6 +617,7 @@ static lua_State *GL;
 static lua_State *YL;
 static uint8_t *zmap;
 static uint8_t *zcdir;
+static const uint8_t *zindex;
 static size_t hdrsize;
 static size_t amtread;
 static reader_f reader;
@@ -501,6 +627,8 @@ static const char *zpath;
 static char *serverheader;
 static char gzip_footer[8];
 static long maxpayloadsize;
+static long poolrecycle;
+static long poolconnections;
 static const char *pidpath;
 static const char *logpath;
 static uint32_t *interfaces;
@@ -510,12 +638,31 @@ static int64_t cacheseconds;
 static char *cachedirective;
 static const char *monitortty;
 static struct Strings stagedirs;
+
+// paths in stage dirs, rebuilt by main process when inotify says so
+static struct StageCache {
+  int fd;
+  int gen;
+  bool ok;
+  size_t dirs;
+  struct timespec built;
+  size_t n, c;
+  struct StageEntry {
+    uint32_t hash;
+    uint16_t dir;
+    bool islink;
+    size_t n;
+    char *path;
+  } * p;
+} stagecache = {.fd = -1};
 static struct Strings hidepaths;
 static const char *launchbrowser;
 static const char ctIdx = 'c';  // a pseudo variable to get address of
+static const char pageIdx = 'p';  // registry key of compiled lua pages
 
 static struct spawn replth;
 static struct spawn monitorth;
+static struct spawn stageth;
 static struct Buffer inbuf_actual;
 static struct Buffer inbuf;
 static struct Buffer oldin;
@@ -533,6 +680,7 @@ static struct timespec startserver;
 static struct timespec startrequest;
 static struct timespec lastheartbeat;
 static struct timespec startconnection;
+static struct timespec lastpoolfailure;
 static struct sockaddr_in clientaddr;
 static struct sockaddr_in *serveraddr;
 
@@ -557,6 +705,7 @@ static char *ServeAsset(struct Asset *, const char *, size_t);
 static char *SetStatus(unsigned, const char *);
 
 static void TlsInit(void);
+static void HandleHttp2(void);
 
 static void OnChld(void) {
   zombied = true;
@@ -828,6 +977,19 @@ static void ProgramMaxPayloadSize(long x) {
   maxpayloadsize = MAX(1450, x);
 }
 
+static void ProgramWorkerPool(long workers, long recycle) {
+  workerpool = MAX(0, workers);
+  poolrecycle = MAX(0, recycle);
+}
+
+static void ProgramIdleConnections(long x) {
+  idlelimit = MAX(0, MIN(x, 1000000));
+}
+
+static void ProgramGzipCache(long x) {
+  gzipcachesize = MAX(0, MIN(x, 0x7fffffff));
+}
+
 static void ProgramSslTicketLifetime(long x) {
   sslticketlifetime = x;
 }
@@ -1348,14 +1510,14 @@ static void ReportWorkerExit(int pid, int ws) {
   workers = atomic_fetch_sub(&shared->workers, 1) - 1;
   if (WIFEXITED(ws)) {
     if (WEXITSTATUS(ws)) {
-      LockInc(&shared->c.failedchildren);
+      LockInc(&counters->failedchildren);
       WARNF("(stat) %d exited with %d (%,d workers remain)", pid,
             WEXITSTATUS(ws), workers);
     } else {
       DEBUGF("(stat) %d exited (%,d workers remain)", pid, workers);
     }
   } else {
-    LockInc(&shared->c.terminatedchildren);
+    LockInc(&counters->terminatedchildren);
     WARNF("(stat) %d terminated with %s (%,d workers remain)", pid,
           strsignal(WTERMSIG(ws)), workers);
   }
@@ -1376,7 +1538,7 @@ static void ReportWorkerResources(int pid, struct rusage *ru) {
 }
 
 static void HandleWorkerExit(int pid, int ws, struct rusage *ru) {
-  LockInc(&shared->c.connectionshandled);
+  LockInc(&counters->connectionshandled);
   rusage_add(&shared->children, ru);
   ReportWorkerExit(pid, ws);
   ReportWorkerResources(pid, ru);
@@ -1490,7 +1652,7 @@ static ssize_t WritevAll(int fd, struct iovec *iov, int iovlen) {
       } while (wrote);
     } else if (errno == EINTR) {
       errno = 0;
-      LockInc(&shared->c.writeinterruputs);
+      LockInc(&counters->writeinterruputs);
       if (killed || IsTakingTooLong()) {
         return total ? total : -1;
       }
@@ -1703,7 +1865,7 @@ static void CertsDestroy(void) {
 }
 
 static void WipeServingKeys(void) {
-  if (uniprocess) return;
+  if (uniprocess || workerpool) return;
   mbedtls_ssl_ticket_free(&ssltick);
   mbedtls_ssl_key_cert_free(conf.key_cert), conf.key_cert = 0;
   CertsDestroy();
@@ -1806,7 +1968,7 @@ static bool TlsSetup(void) {
   sslpskindex = 0;
   for (;;) {
     if (!(r = mbedtls_ssl_handshake(&ssl)) && TlsFlush(&g_bio, 0, 0) != -1) {
-      LockInc(&shared->c.sslhandshakes);
+      LockInc(&counters->sslhandshakes);
       g_bio.c = -1;
       usingssl = true;
       reader = SslRead;
@@ -1820,12 +1982,12 @@ static bool TlsSetup(void) {
              _gc(FormatSslClientCiphers(&ssl)));
       return true;
     } else if (r == MBEDTLS_ERR_SSL_WANT_READ) {
-      LockInc(&shared->c.handshakeinterrupts);
+      LockInc(&counters->handshakeinterrupts);
       if (terminated || killed || IsTakingTooLong()) {
         return false;
       }
     } else {
-      LockInc(&shared->c.sslhandshakefails);
+      LockInc(&counters->sslhandshakefails);
       mbedtls_ssl_session_reset(&ssl);
       switch (r) {
         case MBEDTLS_ERR_SSL_CONN_EOF:
@@ -1835,35 +1997,35 @@ static bool TlsSetup(void) {
           DEBUGF("(ssl) %s SSL handshake reset", DescribeClient());
           return false;
         case MBEDTLS_ERR_SSL_TIMEOUT:
-          LockInc(&shared->c.ssltimeouts);
+          LockInc(&counters->ssltimeouts);
           DEBUGF("(ssl) %s %s", DescribeClient(), "ssltimeouts");
           return false;
         case MBEDTLS_ERR_SSL_NO_CIPHER_CHOSEN:
-          LockInc(&shared->c.sslnociphers);
+          LockInc(&counters->sslnociphers);
           WARNF("(ssl) %s %s %s", DescribeClient(), "sslnociphers",
                 _gc(FormatSslClientCiphers(&ssl)));
           return false;
         case MBEDTLS_ERR_SSL_NO_USABLE_CIPHERSUITE:
-          LockInc(&shared->c.sslcantciphers);
+          LockInc(&counters->sslcantciphers);
           WARNF("(ssl) %s %s %s", DescribeClient(), "sslcantciphers",
                 _gc(FormatSslClientCiphers(&ssl)));
           return false;
         case MBEDTLS_ERR_SSL_BAD_HS_PROTOCOL_VERSION:
-          LockInc(&shared->c.sslnoversion);
+          LockInc(&counters->sslnoversion);
           WARNF("(ssl) %s %s %s", DescribeClient(), "sslnoversion",
                 mbedtls_ssl_get_version(&ssl));
           return false;
         case MBEDTLS_ERR_SSL_INVALID_MAC:
-          LockInc(&shared->c.sslshakemacs);
+          LockInc(&counters->sslshakemacs);
           WARNF("(ssl) %s %s", DescribeClient(), "sslshakemacs");
           return false;
         case MBEDTLS_ERR_SSL_NO_CLIENT_CERTIFICATE:
-          LockInc(&shared->c.sslnoclientcert);
+          LockInc(&counters->sslnoclientcert);
           WARNF("(ssl) %s %s", DescribeClient(), "sslnoclientcert");
           NotifyClose();
           return false;
         case MBEDTLS_ERR_X509_CERT_VERIFY_FAILED:
-          LockInc(&shared->c.sslverifyfailed);
+          LockInc(&counters->sslverifyfailed);
           WARNF("(ssl) %s SSL %s", DescribeClient(),
                 _gc(DescribeSslVerifyFailure(
                     ssl.session_negotiate->verify_result)));
@@ -1871,11 +2033,11 @@ static bool TlsSetup(void) {
         case MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE:
           switch (ssl.fatal_alert) {
             case MBEDTLS_SSL_ALERT_MSG_CERT_UNKNOWN:
-              LockInc(&shared->c.sslunknowncert);
+              LockInc(&counters->sslunknowncert);
               DEBUGF("(ssl) %s %s", DescribeClient(), "sslunknowncert");
               return false;
             case MBEDTLS_SSL_ALERT_MSG_UNKNOWN_CA:
-              LockInc(&shared->c.sslunknownca);
+              LockInc(&counters->sslunknownca);
               DEBUGF("(ssl) %s %s", DescribeClient(), "sslunknownca");
               return false;
             default:
@@ -2070,9 +2232,44 @@ static void LoadCertificates(void) {
   WipeSigningKeys();
 }
 
+static int GetAcceptEncoding(const char *coding) {
+  int q;
+  size_t i;
+  if (!HasHeader(kHttpAcceptEncoding)) return -1;
+  q = GetHttpQuality(HeaderData(kHttpAcceptEncoding),
+                     HeaderLength(kHttpAcceptEncoding), coding, -1);
+  for (i = 0; i < cpm.msg.xheaders.n; ++i) {
+    if (GetHttpHeader(inbuf.p + cpm.msg.xheaders.p[i].k.a,
+                      cpm.msg.xheaders.p[i].k.b - cpm.msg.xheaders.p[i].k.a) ==
+        kHttpAcceptEncoding) {
+      q = MAX(q, GetHttpQuality(
+                     inbuf.p + cpm.msg.xheaders.p[i].v.a,
+                     cpm.msg.xheaders.p[i].v.b - cpm.msg.xheaders.p[i].v.a,
+                     coding, -1));
+    }
+  }
+  return q;
+}
+
+static int GetContentCodingQuality(const char *coding, const char *alias) {
+  int q;
+  if ((q = GetAcceptEncoding(coding)) == -1 &&
+      (!alias || (q = GetAcceptEncoding(alias)) == -1)) {
+    q = GetAcceptEncoding("*");  // RFC9110 § 12.5.3
+  }
+  return MAX(0, q);
+}
+
 static bool ClientAcceptsGzip(void) {
   return cpm.msg.version >= 10 && /* RFC1945 § 3.5 */
-         HeaderHas(&cpm.msg, inbuf.p, kHttpAcceptEncoding, "gzip", 4);
+         GetContentCodingQuality("gzip", "x-gzip") > 0;
+}
+
+static bool ClientPrefersZstd(void) {
+  int q;
+  return cpm.msg.version >= 10 &&
+         (q = GetContentCodingQuality("zstd", 0)) > 0 &&
+         q >= GetContentCodingQuality("gzip", "x-gzip");
 }
 
 char *FormatUnixHttpDateTime(char *s, int64_t t) {
@@ -2121,8 +2318,10 @@ static inline unsigned Hash(const void *p, unsigned long n) {
 
 static void FreeAssets(void) {
   size_t i;
-  for (i = 0; i < assets.n; ++i) {
-    Free(&assets.p[i].lastmodifiedstr);
+  if (!zindex) {
+    for (i = 0; i < assets.n; ++i) {
+      Free(&assets.p[i].lastmodifiedstr);
+    }
   }
   Free(&assets.p);
   assets.n = 0;
@@ -2146,8 +2345,18 @@ static void IndexAssets(void) {
   struct Asset *p;
   struct timespec lm;
   uint32_t i, n, m, step, hash;
-  DEBUGF("(zip) indexing assets (inode %#lx)", zst.st_ino);
   FreeAssets();
+  ++zindexgen;
+  // use index from zipindex.com if it's there, in which case the table
+  // gets filled in lazily as assets are requested
+  if ((zindex = GetZipIndex(zmap, zsize, zcdir, gmtoff))) {
+    DEBUGF("(zip) using prebuilt index of %,u assets (inode %#lx)",
+           ZIP_INDEX_SLOTS(zindex), zst.st_ino);
+    assets.n = ZIP_INDEX_SLOTS(zindex);
+    assets.p = xcalloc(MAX(1, assets.n), sizeof(struct Asset));
+    return;
+  }
+  DEBUGF("(zip) indexing assets (inode %#lx)", zst.st_ino);
   CHECK_GE(HASH_LOAD_FACTOR, 2);
   CHECK(READ32LE(zcdir) == kZipCdir64HdrMagic ||
         READ32LE(zcdir) == kZipCdirHdrMagic);
@@ -2202,6 +2411,7 @@ static bool OpenZip(bool force) {
           }
           zmap = m;
           zsize = n;
+          zmapfd = fd;
           zcdir = d;
           DCHECK(IsZipEocd32(zmap, zsize, zcdir - zmap) == kZipOk ||
                  IsZipEocd64(zmap, zsize, zcdir - zmap) == kZipOk);
@@ -2226,9 +2436,34 @@ static bool OpenZip(bool force) {
   return false;
 }
 
+static struct Asset *GetAssetZipIndex(const char *path, size_t pathlen) {
+  int64_t i;
+  uint64_t cf;
+  struct Asset *a;
+  const uint8_t *s;
+  if ((i = FindZipIndexSlot(zindex, path, pathlen)) == -1) return NULL;
+  s = ZIP_INDEX_SLOT(zindex, i);
+  cf = GetZipCdirOffset(zcdir) + ZIP_INDEX_SLOT_CFILE(s);
+  if (pathlen != ZIP_CFILE_NAMESIZE(zmap + cf) ||
+      memcmp(path, ZIP_CFILE_NAME(zmap + cf), pathlen)) {
+    return NULL;
+  }
+  a = assets.p + i;
+  if (!a->hash) {
+    a->hash = ZIP_INDEX_SLOT_HASH(s);
+    a->cf = cf;
+    a->lf = ZIP_INDEX_SLOT_LFILE(s);
+    a->istext = !!(ZIP_INDEX_SLOT_FLAGS(s) & kZipIndexFlagText);
+    a->lastmodified = ZIP_INDEX_SLOT_LASTMODIFIED(s);
+    a->lastmodifiedstr = (char *)ZIP_INDEX_SLOT_DATE(s);
+  }
+  return a;
+}
+
 static struct Asset *GetAssetZip(const char *path, size_t pathlen) {
   uint32_t i, step, hash;
   if (pathlen > 1 && path[0] == '/') ++path, --pathlen;
+  if (zindex) return GetAssetZipIndex(path, pathlen);
   hash = Hash(path, pathlen);
   for (step = 0;; ++step) {
     i = (hash + ((step * (step + 1)) >> 1)) & (assets.n - 1);
@@ -2241,14 +2476,203 @@ static struct Asset *GetAssetZip(const char *path, size_t pathlen) {
   }
 }
 
+static struct StageEntry *FindStageEntry(int dir, const char *path,
+                                         size_t n) {
+  uint32_t i, step, hash;
+  hash = Hash(path, n) ^ dir * 0x9e3779b9;
+  if (!hash) hash = 1;
+  for (step = 0;; ++step) {
+    i = (hash + ((step * (step + 1)) >> 1)) & (stagecache.c - 1);
+    if (!stagecache.p[i].hash) return NULL;
+    if (hash == stagecache.p[i].hash && dir == stagecache.p[i].dir &&
+        n == stagecache.p[i].n && !memcmp(path, stagecache.p[i].path, n)) {
+      return stagecache.p + i;
+    }
+  }
+}
+
+static bool AddStageEntry(int dir, const char *path, size_t n, bool islink) {
+  size_t i, c;
+  uint32_t j, step;
+  struct StageEntry e, *p;
+  if (stagecache.n + 1 > STAGE_CACHE_MAX) return false;
+  if ((stagecache.n + 1) * 2 > stagecache.c) {
+    c = MAX(256, stagecache.c * 2);
+    p = xcalloc(c, sizeof(*p));
+    for (i = 0; i < stagecache.c; ++i) {
+      if (!stagecache.p[i].hash) continue;
+      for (step = 0;; ++step) {
+        j = (stagecache.p[i].hash + ((step * (step + 1)) >> 1)) & (c - 1);
+        if (!p[j].hash) break;
+      }
+      p[j] = stagecache.p[i];
+    }
+    free(stagecache.p);
+    stagecache.p = p;
+    stagecache.c = c;
+  }
+  e.hash = Hash(path, n) ^ dir * 0x9e3779b9;
+  if (!e.hash) e.hash = 1;
+  e.dir = dir;
+  e.islink = islink;
+  e.n = n;
+  e.path = xstrndup(path, n);
+  for (step = 0;; ++step) {
+    j = (e.hash + ((step * (step + 1)) >> 1)) & (stagecache.c - 1);
+    if (!stagecache.p[j].hash) break;
+  }
+  stagecache.p[j] = e;
+  ++stagecache.n;
+  return true;
+}
+
+static void FreeStageCache(void) {
+  size_t i;
+  for (i = 0; i < stagecache.c; ++i) {
+    if (stagecache.p[i].hash) free(stagecache.p[i].path);
+  }
+  free(stagecache.p);
+  stagecache.p = 0;
+  stagecache.n = 0;
+  stagecache.c = 0;
+  stagecache.ok = false;
+}
+
+static bool IndexStageDir(int dir, char *buf, size_t root, size_t len,
+                          int depth) {
+  DIR *d;
+  bool ok;
+  size_t n;
+  int type;
+  struct stat st;
+  struct dirent *e;
+  if (depth > 64) return false;
+  if (sys_inotify_add_watch(stagecache.fd, buf, STAGE_WATCH_MASK) == -1) {
+    return false;
+  }
+  if (!(d = opendir(buf))) return false;
+  ok = true;
+  while (ok && (e = readdir(d))) {
+    if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+    n = strlen(e->d_name);
+    if (len + 1 + n >= PATH_MAX) {
+      ok = false;
+      break;
+    }
+    buf[len] = '/';
+    memcpy(buf + len + 1, e->d_name, n + 1);
+    if ((type = e->d_type) == DT_UNKNOWN) {
+      if (lstat(buf, &st) != -1) {
+        type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISLNK(st.st_mode) ? DT_LNK : 0;
+      }
+    }
+    ok = AddStageEntry(dir, buf + root, len + 1 + n - root, type == DT_LNK);
+    if (ok && type == DT_DIR) {
+      ok = IndexStageDir(dir, buf, root, len + 1 + n, depth + 1);
+    }
+  }
+  buf[len] = 0;
+  closedir(d);
+  return ok;
+}
+
+static void RebuildStageCache(void) {
+  int gen;
+  bool ok;
+  size_t i, n;
+  char buf[PATH_MAX];
+  gen = atomic_load_explicit(&shared->stagegen, memory_order_acquire);
+  FreeStageCache();
+  stagecache.built = timespec_real();
+  for (ok = true, i = 0; ok && i < stagedirs.n; ++i) {
+    n = stagedirs.p[i].n;
+    while (n > 1 && stagedirs.p[i].s[n - 1] == '/') --n;
+    if (!(ok = n + 1 < PATH_MAX)) break;
+    memcpy(buf, stagedirs.p[i].s, n);
+    buf[n] = 0;
+    ok = IndexStageDir(i, buf, n + 1, n, 0);
+  }
+  if (ok) {
+    DEBUGF("(stat) indexed %,zu stage dir paths", stagecache.n);
+    stagecache.ok = true;
+    stagecache.dirs = stagedirs.n;
+    stagecache.gen = gen;
+  } else {
+    VERBOSEF("(stat) won't cache stage dirs: %m");
+    FreeStageCache();
+  }
+}
+
+// returns true if cache proves path doesn't exist in stage dir
+static bool IsStagePathAbsent(int dir, const char *path, size_t n) {
+  size_t i;
+  struct StageEntry *e;
+  if (!stagecache.ok || stagecache.dirs != stagedirs.n ||
+      stagecache.gen !=
+          atomic_load_explicit(&shared->stagegen, memory_order_acquire)) {
+    return false;
+  }
+  while (n && *path == '/') ++path, --n;
+  while (n && path[n - 1] == '/') --n;
+  if (!n || memmem(path, n, "//", 2) || !IsReasonablePath(path, n)) {
+    return false;
+  }
+  if (FindStageEntry(dir, path, n)) return false;
+  for (i = 0; i < n; ++i) {
+    if (path[i] == '/') {
+      if (!(e = FindStageEntry(dir, path, i))) return true;
+      if (e->islink) return false;  // can't see inside
+    }
+  }
+  return true;
+}
+
+static int StageWatcher(void *arg, int tid) {
+  sigset_t ss;
+  char buf[4096];
+  struct pollfd pfd;
+  sigfillset(&ss);
+  sigprocmask(SIG_BLOCK, &ss, 0);
+  pfd.fd = stagecache.fd;
+  pfd.events = POLLIN;
+  while (!terminatemonitor) {
+    if (poll(&pfd, 1, 500) > 0 && read(stagecache.fd, buf, sizeof(buf)) > 0) {
+      LockInc(&shared->stagegen);
+    }
+  }
+  return 0;
+}
+
+static void WatchStageDirs(void) {
+  if (IsTiny() || !IsLinux() || !stagedirs.n) return;
+  if ((stagecache.fd = sys_inotify_init1(O_CLOEXEC)) == -1) {
+    VERBOSEF("(stat) inotify_init1() failed: %m");
+    return;
+  }
+  RebuildStageCache();
+  if (_spawn(StageWatcher, 0, &stageth) == -1) {
+    WARNF("(stat) failed to start stage dir watcher %m");
+    FreeStageCache();
+    close(stagecache.fd);
+    stagecache.fd = -1;
+  }
+}
+
 static struct Asset *GetAssetFile(const char *path, size_t pathlen) {
   size_t i;
   struct Asset *a;
   if (stagedirs.n) {
-    a = FreeLater(xcalloc(1, sizeof(struct Asset)));
-    a->file = FreeLater(xmalloc(sizeof(struct File)));
+    a = 0;
     for (i = 0; i < stagedirs.n; ++i) {
-      LockInc(&shared->c.stats);
+      if (IsStagePathAbsent(i, path, pathlen)) {
+        LockInc(&counters->statcachehits);
+        continue;
+      }
+      if (!a) {
+        a = FreeLater(xcalloc(1, sizeof(struct Asset)));
+        a->file = FreeLater(xmalloc(sizeof(struct File)));
+      }
+      LockInc(&counters->stats);
       a->file->path.s = FreeLater(MergePaths(stagedirs.p[i].s, stagedirs.p[i].n,
                                              path, pathlen, &a->file->path.n));
       if (stat(a->file->path.s, &a->file->st) != -1) {
@@ -2257,7 +2681,7 @@ static struct Asset *GetAssetFile(const char *path, size_t pathlen) {
             (a->lastmodified = a->file->st.st_mtim.tv_sec));
         return a;
       } else {
-        LockInc(&shared->c.statfails);
+        LockInc(&counters->statfails);
       }
     }
   }
@@ -2341,17 +2765,17 @@ static char *AppendContentRange(char *p, long a, long b, long c) {
 }
 
 static bool Inflate(void *dp, size_t dn, const void *sp, size_t sn) {
-  LockInc(&shared->c.inflates);
+  LockInc(&counters->inflates);
   return !__inflate(dp, dn, sp, sn);
 }
 
 static bool Verify(void *data, size_t size, uint32_t crc) {
   uint32_t got;
-  LockInc(&shared->c.verifies);
+  LockInc(&counters->verifies);
   if (crc == (got = crc32_z(0, data, size))) {
     return true;
   } else {
-    LockInc(&shared->c.thiscorruption);
+    LockInc(&counters->thiscorruption);
     WARNF("(zip) corrupt zip file at %`'.*s had crc 0x%08x but expected 0x%08x",
           cpm.msg.uri.b - cpm.msg.uri.a, inbuf.p + cpm.msg.uri.a, got, crc);
     return false;
@@ -2361,7 +2785,7 @@ static bool Verify(void *data, size_t size, uint32_t crc) {
 static void *Deflate(const void *data, size_t size, size_t *out_size) {
   void *res;
   z_stream zs = {0};
-  LockInc(&shared->c.deflates);
+  LockInc(&counters->deflates);
   CHECK_EQ(Z_OK, deflateInit2(&zs, 4, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL,
                               Z_DEFAULT_STRATEGY));
   zs.next_in = data;
@@ -2401,7 +2825,7 @@ static void *LoadAsset(struct Asset *a, size_t *out_size) {
     if (out_size) *out_size = size;
     return data;
   } else {
-    LockInc(&shared->c.slurps);
+    LockInc(&counters->slurps);
     return xslurp(a->file->path.s, out_size);
   }
 }
@@ -2437,27 +2861,70 @@ static void AppendLogo(void) {
   }
 }
 
+static void HandleSendError(void) {
+  if (errno == ECONNRESET) {
+    LockInc(&counters->writeresets);
+    DEBUGF("(rsp) %s write reset", DescribeClient());
+  } else if (errno == EAGAIN) {
+    LockInc(&counters->writetimeouts);
+    WARNF("(rsp) %s write timeout", DescribeClient());
+    errno = 0;
+  } else {
+    LockInc(&counters->writeerrors);
+    if (errno == EBADF) {  // don't warn on close/bad fd
+      DEBUGF("(rsp) %s write badf", DescribeClient());
+    } else {
+      WARNF("(rsp) %s write error: %m", DescribeClient());
+    }
+  }
+  connectionclose = true;
+}
+
 static ssize_t Send(struct iovec *iov, int iovlen) {
   ssize_t rc;
   if ((rc = writer(client, iov, iovlen)) == -1) {
-    if (errno == ECONNRESET) {
-      LockInc(&shared->c.writeresets);
-      DEBUGF("(rsp) %s write reset", DescribeClient());
-    } else if (errno == EAGAIN) {
-      LockInc(&shared->c.writetimeouts);
-      WARNF("(rsp) %s write timeout", DescribeClient());
+    HandleSendError();
+  }
+  return rc;
+}
+
+static bool ShouldSendFile(void) {
+  return !usingssl && cpm.sendbase && cpm.contentlength >= 65536 &&
+         cpm.content >= cpm.sendbase &&
+         cpm.content + cpm.contentlength <= cpm.sendbase + cpm.sendsize;
+}
+
+// sends message body from page cache without copying it into memory
+static ssize_t SendFile(void) {
+  ssize_t rc;
+  int64_t off;
+  size_t sent;
+  struct iovec v;
+  off = cpm.content - cpm.sendbase;
+  for (sent = 0; sent < cpm.contentlength;) {
+    rc = sendfile(client, cpm.sendfd, &off, cpm.contentlength - sent);
+    if (rc > 0) {
+      sent += rc;
+    } else if (rc == -1 && errno == EINTR) {
       errno = 0;
+      LockInc(&counters->writeinterruputs);
+      if (killed || IsTakingTooLong()) break;
+    } else if (rc == -1 && !sent &&
+               (errno == ENOSYS || errno == EINVAL || errno == ESPIPE ||
+                errno == EOPNOTSUPP)) {
+      DEBUGF("(rsp) sendfile() unsupported: %m");
+      errno = 0;
+      v.iov_base = cpm.content;
+      v.iov_len = cpm.contentlength;
+      return Send(&v, 1);
     } else {
-      LockInc(&shared->c.writeerrors);
-      if (errno == EBADF) {  // don't warn on close/bad fd
-        DEBUGF("(rsp) %s write badf", DescribeClient());
-      } else {
-        WARNF("(rsp) %s write error: %m", DescribeClient());
-      }
+      if (rc == -1) HandleSendError();
+      break;
     }
-    connectionclose = true;
   }
-  return rc;
+  if (sent < cpm.contentlength) connectionclose = true;
+  LockInc(&counters->sendfiles);
+  return sent ? sent : -1;
 }
 
 static bool IsSslCompressed(void) {
@@ -2527,7 +2994,7 @@ static char *ServeErrorImpl(unsigned code, const char *reason,
   size_t n;
   char *p, *s;
   struct Asset *a;
-  LockInc(&shared->c.errors);
+  LockInc(&counters->errors);
   DropOutput();
   p = SetStatus(code, reason);
   s = xasprintf("/%d.html", code);
@@ -2536,7 +3003,7 @@ static char *ServeErrorImpl(unsigned code, const char *reason,
   if (!a) {
     return ServeDefaultErrorPage(p, code, reason, details);
   } else if (a->file) {
-    LockInc(&shared->c.slurps);
+    LockInc(&counters->slurps);
     cpm.content = FreeLater(xslurp(a->file->path.s, &cpm.contentlength));
     return AppendContentType(p, "text/html; charset=utf-8");
   } else {
@@ -2697,11 +3164,141 @@ static ssize_t DeflateGenerator(struct iovec v[3]) {
   return v[0].iov_len + v[1].iov_len + v[2].iov_len;
 }
 
+static void GzipCacheInit(void) {
+  if (IsTiny() || !gzipcachesize) return;
+  gzipcache = _mapshared(
+      ROUNDUP(sizeof(struct GzipCache) + gzipcachesize, FRAMESIZE));
+  gzipcache->size = gzipcachesize;
+}
+
+static void GetGzipCacheKey(struct Asset *a, uint32_t crc, size_t size,
+                            struct GzipCacheEntry *k) {
+  if (a->file) {
+    k->ino = a->file->st.st_ino;
+    k->dev = a->file->st.st_dev;
+    k->mtime = timespec_tonanos(a->file->st.st_mtim);
+  } else {
+    k->ino = a->cf;
+    k->dev = -1;
+    k->mtime = a->lastmodified;
+  }
+  k->crc = crc;
+  k->size = size;
+}
+
+static struct GzipCacheEntry *GetGzipCacheSlot(struct GzipCacheEntry *k) {
+  uint64_t h;
+  h = (k->ino ^ k->dev ^ k->mtime) * 0x9e3779b97f4a7c15 ^ k->crc;
+  return gzipcache->e + (h ^ h >> 32) % ARRAYLEN(gzipcache->e);
+}
+
+static bool IsSameGzipCacheKey(struct GzipCacheEntry *x,
+                               struct GzipCacheEntry *y) {
+  return x->ino == y->ino && x->dev == y->dev && x->mtime == y->mtime &&
+         x->crc == y->crc && x->size == y->size;
+}
+
+static char *GetGzipCache(struct GzipCacheEntry *k, size_t *out_len) {
+  char *p;
+  uint32_t seq;
+  size_t off, len;
+  struct GzipCacheEntry *e;
+  e = GetGzipCacheSlot(k);
+  seq = atomic_load_explicit(&e->seq, memory_order_acquire);
+  if (seq & 1) return 0;
+  off = e->off;
+  len = e->len;
+  if (!len || off + len > gzipcache->size || !IsSameGzipCacheKey(e, k) ||
+      !(p = malloc(len))) {
+    return 0;
+  }
+  memcpy(p, gzipcache->data + off, len);
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(&e->seq, memory_order_relaxed) != seq) {
+    free(p);  // entry was evicted while we were copying it
+    return 0;
+  }
+  *out_len = len;
+  return p;
+}
+
+static void BeginGzipCacheWrite(struct GzipCacheEntry *e) {
+  atomic_store_explicit(&e->seq, e->seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static void EndGzipCacheWrite(struct GzipCacheEntry *e) {
+  atomic_store_explicit(&e->seq, e->seq + 1, memory_order_release);
+}
+
+static void PutGzipCache(struct GzipCacheEntry *k, const char *p, size_t n) {
+  size_t i, off;
+  struct GzipCacheEntry *e;
+  if (!n || n > gzipcache->size) return;
+  if (pthread_spin_trylock(&gzipcache->lock)) return;
+  off = gzipcache->head;
+  if (off + n > gzipcache->size) off = 0;
+  for (i = 0; i < ARRAYLEN(gzipcache->e); ++i) {
+    e = gzipcache->e + i;
+    if (e->len && e->off < off + n && off < e->off + e->len) {
+      LockInc(&counters->gzipcacheevictions);
+      BeginGzipCacheWrite(e);
+      e->len = 0;
+      EndGzipCacheWrite(e);
+    }
+  }
+  e = GetGzipCacheSlot(k);
+  if (e->len) LockInc(&counters->gzipcacheevictions);
+  BeginGzipCacheWrite(e);
+  memcpy(gzipcache->data + off, p, n);
+  e->ino = k->ino;
+  e->dev = k->dev;
+  e->mtime = k->mtime;
+  e->crc = k->crc;
+  e->size = k->size;
+  e->off = off;
+  e->len = n;
+  EndGzipCacheWrite(e);
+  gzipcache->head = off + n;
+  pthread_spin_unlock(&gzipcache->lock);
+}
+
+static char *ServeAssetCompressedCached(struct Asset *a) {
+  char *z;
+  size_t n;
+  uint32_t crc;
+  struct GzipCacheEntry k;
+  if (a->file) {
+    crc = crc32_z(0, cpm.content, cpm.contentlength);
+  } else {
+    crc = ZIP_LFILE_CRC32(zmap + a->lf);
+  }
+  GetGzipCacheKey(a, crc, cpm.contentlength, &k);
+  if ((z = FreeLater(GetGzipCache(&k, &n)))) {
+    LockInc(&counters->gzipcachehits);
+    DEBUGF("(srvr) ServeAssetCompressed() cache hit %,zu→%,zu",
+           cpm.contentlength, n);
+  } else {
+    LockInc(&counters->gzipcachemisses);
+    z = FreeLater(Deflate(cpm.content, cpm.contentlength, &n));
+    PutGzipCache(&k, z, n);
+  }
+  WRITE32LE(gzip_footer + 0, crc);
+  WRITE32LE(gzip_footer + 4, cpm.contentlength);
+  cpm.gzipped = cpm.contentlength;
+  cpm.content = z;
+  cpm.contentlength = n;
+  return SetStatus(200, "OK");
+}
+
 static char *ServeAssetCompressed(struct Asset *a) {
   char *p;
-  LockInc(&shared->c.deflates);
-  LockInc(&shared->c.compressedresponses);
+  LockInc(&counters->compressedresponses);
   DEBUGF("(srvr) ServeAssetCompressed()");
+  if (gzipcache && cpm.contentlength <= gzipcache->size / 4) {
+    return ServeAssetCompressedCached(a);
+  }
+  LockInc(&counters->deflates);
   dg.t = 0;
   dg.i = 0;
   dg.c = 0;
@@ -2761,8 +3358,8 @@ static ssize_t InflateGenerator(struct iovec v[3]) {
 static char *ServeAssetDecompressed(struct Asset *a) {
   char *p;
   size_t size;
-  LockInc(&shared->c.inflates);
-  LockInc(&shared->c.decompressedresponses);
+  LockInc(&counters->inflates);
+  LockInc(&counters->decompressedresponses);
   size = GetZipCfileUncompressedSize(zmap + a->cf);
   DEBUGF("(srvr) ServeAssetDecompressed(%ld)→%ld", cpm.contentlength, size);
   if (cpm.msg.method == kHttpHead) {
@@ -2791,7 +3388,7 @@ static char *ServeAssetDecompressed(struct Asset *a) {
 }
 
 static inline char *ServeAssetIdentity(struct Asset *a, const char *ct) {
-  LockInc(&shared->c.identityresponses);
+  LockInc(&counters->identityresponses);
   DEBUGF("(srvr) ServeAssetIdentity(%`'s)", ct);
   return SetStatus(200, "OK");
 }
@@ -2800,7 +3397,7 @@ static inline char *ServeAssetPrecompressed(struct Asset *a) {
   size_t size;
   uint32_t crc;
   DEBUGF("(srvr) ServeAssetPrecompressed()");
-  LockInc(&shared->c.precompressedresponses);
+  LockInc(&counters->precompressedresponses);
   crc = ZIP_CFILE_CRC32(zmap + a->cf);
   size = GetZipCfileUncompressedSize(zmap + a->cf);
   cpm.gzipped = size;
@@ -2817,14 +3414,14 @@ static char *ServeAssetRange(struct Asset *a) {
                      cpm.contentlength, &rangestart, &rangelength) &&
       rangestart >= 0 && rangelength >= 0 && rangestart < cpm.contentlength &&
       rangestart + rangelength <= cpm.contentlength) {
-    LockInc(&shared->c.partialresponses);
+    LockInc(&counters->partialresponses);
     p = SetStatus(206, "Partial Content");
     p = AppendContentRange(p, rangestart, rangelength, cpm.contentlength);
     cpm.content += rangestart;
     cpm.contentlength = rangelength;
     return p;
   } else {
-    LockInc(&shared->c.badranges);
+    LockInc(&counters->badranges);
     WARNF("(client) bad range %`'.*s", HeaderLength(kHttpRange),
           HeaderData(kHttpRange));
     p = SetStatus(416, "Range Not Satisfiable");
@@ -2942,7 +3539,7 @@ static void LaunchBrowser(const char *path) {
 }
 
 static char *BadMethod(void) {
-  LockInc(&shared->c.badmethods);
+  LockInc(&counters->badmethods);
   return stpcpy(ServeError(405, "Method Not Allowed"), "Allow: GET, HEAD\r\n");
 }
 
@@ -2966,6 +3563,18 @@ static const char *DescribeCompressionRatio(char rb[8], uint8_t *zcf) {
   }
 }
 
+static void SumCounters(struct Counters *res) {
+  size_t i, j;
+  const long *c;
+  bzero(res, sizeof(*res));
+  for (i = 0; i < ARRAYLEN(shared->c); ++i) {
+    c = (const long *)(shared->c + i);
+    for (j = 0; j < sizeof(*res) / sizeof(long); ++j) {
+      ((long *)res)[j] += c[j];
+    }
+  }
+}
+
 static char *ServeListing(void) {
   long x;
   ldiv_t y;
@@ -2975,9 +3584,10 @@ static char *ServeListing(void) {
   char *p, *path;
   const char *and;
   struct timespec lastmod;
+  struct Counters sum;
   size_t n, pathlen, rn[6];
   char rb[8], tb[20], *rp[6];
-  LockInc(&shared->c.listingrequests);
+  LockInc(&counters->listingrequests);
   if (cpm.msg.method != kHttpGet && cpm.msg.method != kHttpHead)
     return BadMethod();
   appends(&cpm.outbuf, "\
@@ -3063,7 +3673,8 @@ td { padding-right: 3em; }\r\n\
 <td valign=\"top\">\r\n\
 <a href=\"/statusz\">/statusz</a>\r\n\
 ");
-  if (shared->c.connectionshandled) {
+  SumCounters(&sum);
+  if (sum.connectionshandled) {
     appends(&cpm.outbuf, "says your redbean<br>\r\n");
     AppendResourceReport(&cpm.outbuf, &shared->children, "<br>\r\n");
   }
@@ -3087,9 +3698,9 @@ td { padding-right: 3em; }\r\n\
   }
   appendf(&cpm.outbuf, "%s%,ld second%s of operation<br>\r\n", and, y.rem,
           y.rem == 1 ? "" : "s");
-  x = shared->c.messageshandled;
+  x = sum.messageshandled;
   appendf(&cpm.outbuf, "%,ld message%s handled<br>\r\n", x, x == 1 ? "" : "s");
-  x = shared->c.connectionshandled;
+  x = sum.connectionshandled;
   appendf(&cpm.outbuf, "%,ld connection%s handled<br>\r\n", x,
           x == 1 ? "" : "s");
   x = shared->workers;
@@ -3144,7 +3755,9 @@ static void AppendRusage(const char *a, struct rusage *ru) {
 static void ServeCounters(void) {
   const long *c;
   const char *s;
-  for (c = (const long *)&shared->c, s = kCounterNames; *s;
+  struct Counters sum;
+  SumCounters(&sum);
+  for (c = (const long *)&sum, s = kCounterNames; *s;
        ++c, s += strlen(s) + 1) {
     AppendLong1(s, *c);
   }
@@ -3152,7 +3765,7 @@ static void ServeCounters(void) {
 
 static char *ServeStatusz(void) {
   char *p;
-  LockInc(&shared->c.statuszrequests);
+  LockInc(&counters->statuszrequests);
   if (cpm.msg.method != kHttpGet && cpm.msg.method != kHttpHead) {
     return BadMethod();
   }
@@ -3185,7 +3798,7 @@ static char *ServeStatusz(void) {
 static char *RedirectSlash(void) {
   size_t n, i;
   char *p, *e;
-  LockInc(&shared->c.redirects);
+  LockInc(&counters->redirects);
   p = SetStatus(307, "Temporary Redirect");
   p = stpcpy(p, "Location: ");
   e = EscapePath(url.path.p, url.path.n, &n);
@@ -3250,17 +3863,121 @@ static char *LuaOnHttpRequest(void) {
   }
 }
 
-static char *ServeLua(struct Asset *a, const char *s, size_t n) {
+// compiles zip lua pages in the main process so workers inherit them
+static void LuaCompilePages(void) {
+#ifndef STATIC
+  uint64_t cf;
+  char *code, *path;
+  struct Asset *a;
+  const char *name;
+  lua_State *L = GL;
+  size_t i, n, namelen, codelen, count;
+  lua_pushlightuserdata(L, (void *)&pageIdx);
+  lua_newtable(L);
+  count = 0;
+  n = GetZipCdirRecords(zcdir);
+  cf = GetZipCdirOffset(zcdir);
+  for (i = 0; i < n; ++i, cf += ZIP_CFILE_HDRSIZE(zmap + cf)) {
+    name = ZIP_CFILE_NAME(zmap + cf);
+    namelen = ZIP_CFILE_NAMESIZE(zmap + cf);
+    if (namelen < 5 || name[0] == '.' ||
+        READ32LE(name + namelen - 4) != READ32LE(".lua")) {
+      continue;
+    }
+    path = FreeLater(xasprintf("/%.*s", namelen, name));
+    if (IsHiddenPath(path, namelen + 1) ||
+        !(a = GetAssetZip(path, namelen + 1)) || a->cf != cf ||
+        !(code = FreeLater(LoadAsset(a, &codelen)))) {
+      continue;
+    }
+    if (luaL_loadbuffer(L, code, codelen, FreeLater(xasprintf("@%s", path))) ==
+        LUA_OK) {
+      lua_rawseti(L, -2, cf);
+      ++count;
+    } else {
+      VERBOSEF("(lua) won't precompile %s: %s", path, lua_tostring(L, -1));
+      lua_pop(L, 1);
+    }
+  }
+  lua_rawset(L, LUA_REGISTRYINDEX);  // registry[&pageIdx] = {[cf]=function}
+  luapagesgen = zindexgen;
+  DEBUGF("(lua) precompiled %,zu lua pages", count);
+#endif
+}
+
+static void LuaResetPageEnv(lua_State *L) {
+  lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+  if (!lua_setupvalue(L, -2, 1)) {  // page might have assigned to _ENV
+    lua_pop(L, 1);
+  }
+}
+
+// pushes compiled page, reusing the one from LuaCompilePages() if it
+// is still valid, or otherwise a stage file compiled earlier by this
+// process if its modified time and size haven't changed since then
+static int LuaLoadPage(lua_State *L, struct Asset *a, const char *s,
+                       size_t n) {
   char *code;
   size_t codelen;
+  int top, status;
+  int64_t mtime = 0;
+  bool hit = false;
+  top = lua_gettop(L);
+  if (a->file) {
+    mtime = a->file->st.st_mtim.tv_sec * 1000000000ll +
+            a->file->st.st_mtim.tv_nsec;
+  }
+  lua_pushlightuserdata(L, (void *)&pageIdx);
+  if (lua_rawget(L, LUA_REGISTRYINDEX) == LUA_TTABLE) {
+    if (!a->file) {
+      hit = luapagesgen == zindexgen &&
+            lua_rawgeti(L, top + 1, a->cf) == LUA_TFUNCTION;
+    } else {
+      lua_pushlstring(L, a->file->path.s, a->file->path.n);
+      hit = lua_rawget(L, top + 1) == LUA_TTABLE &&
+            lua_rawgeti(L, top + 2, 2) == LUA_TNUMBER &&
+            lua_tointeger(L, -1) == mtime &&
+            lua_rawgeti(L, top + 2, 3) == LUA_TNUMBER &&
+            lua_tointeger(L, -1) == a->file->st.st_size &&
+            lua_rawgeti(L, top + 2, 1) == LUA_TFUNCTION;
+    }
+  }
+  if (hit) {
+    LockInc(&counters->luacachehits);
+    lua_replace(L, top + 1);
+    lua_settop(L, top + 1);
+    LuaResetPageEnv(L);
+    return LUA_OK;
+  }
+  lua_settop(L, top);
+  if (!(code = FreeLater(LoadAsset(a, &codelen)))) return -1;
+  status = luaL_loadbuffer(
+      L, code, codelen, FreeLater(xasprintf("@%s", FreeLater(strndup(s, n)))));
+  if (status == LUA_OK && a->file) {
+    lua_pushlightuserdata(L, (void *)&pageIdx);
+    if (lua_rawget(L, LUA_REGISTRYINDEX) == LUA_TTABLE) {
+      lua_pushlstring(L, a->file->path.s, a->file->path.n);
+      lua_createtable(L, 3, 0);
+      lua_pushvalue(L, top + 1);
+      lua_rawseti(L, -2, 1);
+      lua_pushinteger(L, mtime);
+      lua_rawseti(L, -2, 2);
+      lua_pushinteger(L, a->file->st.st_size);
+      lua_rawseti(L, -2, 3);
+      lua_rawset(L, top + 2);  // pages[path] = {function, mtime, size}
+    }
+    lua_settop(L, top + 1);
+  }
+  return status;
+}
+
+static char *ServeLua(struct Asset *a, const char *s, size_t n) {
+  int status;
   lua_State *L = GL;
-  LockInc(&shared->c.dynamicrequests);
+  LockInc(&counters->dynamicrequests);
   effectivepath.p = (void *)s;
   effectivepath.n = n;
-  if ((code = FreeLater(LoadAsset(a, &codelen)))) {
-    int status =
-        luaL_loadbuffer(L, code, codelen,
-                        FreeLater(xasprintf("@%s", FreeLater(strndup(s, n)))));
+  if ((status = LuaLoadPage(L, a, s, n)) != -1) {
     if (status == LUA_OK && LuaCallWithYield(L) == LUA_OK) {
       return CommitOutput(GetLuaResponse());
     } else {
@@ -3280,19 +3997,19 @@ static char *HandleRedirect(struct Redirect *r) {
   int code;
   struct Asset *a;
   if (!r->code && (a = GetAsset(r->location.s, r->location.n))) {
-    LockInc(&shared->c.rewrites);
+    LockInc(&counters->rewrites);
     DEBUGF("(rsp) internal redirect to %`'s", r->location.s);
     if (!HasString(&cpm.loops, r->location.s, r->location.n)) {
       AddString(&cpm.loops, r->location.s, r->location.n);
       return RoutePath(r->location.s, r->location.n);
     } else {
-      LockInc(&shared->c.loops);
+      LockInc(&counters->loops);
       return SetStatus(508, "Loop Detected");
     }
   } else if (cpm.msg.version < 10) {
     return ServeError(505, "HTTP Version Not Supported");
   } else {
-    LockInc(&shared->c.redirects);
+    LockInc(&counters->redirects);
     code = r->code;
     if (!code) code = 307;
     DEBUGF("(rsp) %d redirect to %`'s", code, r->location.s);
@@ -3311,7 +4028,7 @@ static char *HandleFolder(const char *path, size_t pathlen) {
   if ((p = ServeIndex(path, pathlen))) {
     return p;
   } else {
-    LockInc(&shared->c.forbiddens);
+    LockInc(&counters->forbiddens);
     WARNF("(srvr) directory %`'.*s lacks index page", pathlen, path);
     return ServeErrorWithPath(403, "Forbidden", path, pathlen);
   }
@@ -3319,7 +4036,8 @@ static char *HandleFolder(const char *path, size_t pathlen) {
 
 static bool Reindex(void) {
   if (OpenZip(false)) {
-    LockInc(&shared->c.reindexes);
+    LockInc(&counters->reindexes);
+    LuaCompilePages();
     return true;
   } else {
     return false;
@@ -4522,6 +5240,22 @@ static int LuaProgramUniprocess(lua_State *L) {
   return 1;
 }
 
+static int LuaProgramWorkerPool(lua_State *L) {
+  OnlyCallFromInitLua(L, "ProgramWorkerPool");
+  ProgramWorkerPool(luaL_checkinteger(L, 1), luaL_optinteger(L, 2, 0));
+  return 0;
+}
+
+static int LuaProgramGzipCache(lua_State *L) {
+  OnlyCallFromInitLua(L, "ProgramGzipCache");
+  return LuaProgramInt(L, ProgramGzipCache);
+}
+
+static int LuaProgramIdleConnections(lua_State *L) {
+  OnlyCallFromInitLua(L, "ProgramIdleConnections");
+  return LuaProgramInt(L, ProgramIdleConnections);
+}
+
 static int LuaProgramHeartbeatInterval(lua_State *L) {
   int64_t millis;
   OnlyCallFromMainProcess(L, "ProgramHeartbeatInterval");
@@ -5094,6 +5828,8 @@ static const char *const kDontAutoComplete[] = {
     "ProgramBrand",              //
     "ProgramCertificate",        // TODO
     "ProgramGid",                //
+    "ProgramGzipCache",          //
+    "ProgramIdleConnections",    //
     "ProgramLogPath",            // TODO
     "ProgramMaxPayloadSize",     // TODO
     "ProgramPidPath",            // TODO
@@ -5105,6 +5841,7 @@ static const char *const kDontAutoComplete[] = {
     "ProgramTimeout",            // TODO
     "ProgramUid",                //
     "ProgramUniprocess",         //
+    "ProgramWorkerPool",         //
     "Respond",                   //
     "Route",                     //
     "RouteHost",                 //
@@ -5235,8 +5972,10 @@ static const luaL_Reg kLuaFuncs[] = {
     {"ProgramContentType", LuaProgramContentType},              //
     {"ProgramDirectory", LuaProgramDirectory},                  //
     {"ProgramGid", LuaProgramGid},                              //
+    {"ProgramGzipCache", LuaProgramGzipCache},                  //
     {"ProgramHeader", LuaProgramHeader},                        //
     {"ProgramHeartbeatInterval", LuaProgramHeartbeatInterval},  //
+    {"ProgramIdleConnections", LuaProgramIdleConnections},      //
     {"ProgramLogBodies", LuaProgramLogBodies},                  //
     {"ProgramLogMessages", LuaProgramLogMessages},              //
     {"ProgramLogPath", LuaProgramLogPath},                      //
@@ -5249,6 +5988,7 @@ static const luaL_Reg kLuaFuncs[] = {
     {"ProgramTrustedIp", LuaProgramTrustedIp},                  // undocumented
     {"ProgramUid", LuaProgramUid},                              //
     {"ProgramUniprocess", LuaProgramUniprocess},                //
+    {"ProgramWorkerPool", LuaProgramWorkerPool},                //
     {"Rand64", LuaRand64},                                      //
     {"Rdrand", LuaRdrand},                                      //
     {"Rdseed", LuaRdseed},                                      //
@@ -5576,7 +6316,7 @@ static const char *DescribeClose(void) {
 
 static void LogClose(const char *reason) {
   if (amtread || meltdown || killed) {
-    LockInc(&shared->c.fumbles);
+    LockInc(&counters->fumbles);
     INFOF("(stat) %s %s with %,ld unprocessed and %,d handled (%,d workers)",
           DescribeClient(), reason, amtread, messageshandled, shared->workers);
   } else {
@@ -5643,76 +6383,76 @@ static void EnterMeltdownMode(void) {
   WARNF("(srvr) server is melting down (%,d workers)", shared->workers);
   LOGIFNEG1(kill(0, SIGUSR2));
   shared->lastmeltdown = timespec_real();
-  ++shared->c.meltdowns;
+  ++counters->meltdowns;
 }
 
 static char *HandlePayloadDisconnect(void) {
-  LockInc(&shared->c.payloaddisconnects);
+  LockInc(&counters->payloaddisconnects);
   LogClose("payload disconnect");
   return ServeFailure(400, "Bad Request"); /* XXX */
 }
 
 static char *HandlePayloadDrop(void) {
-  LockInc(&shared->c.dropped);
+  LockInc(&counters->dropped);
   LogClose(DescribeClose());
   return ServeFailure(503, "Service Unavailable");
 }
 
 static char *HandleBadContentLength(void) {
-  LockInc(&shared->c.badlengths);
+  LockInc(&counters->badlengths);
   return ServeFailure(400, "Bad Content Length");
 }
 
 static char *HandleLengthRequired(void) {
-  LockInc(&shared->c.missinglengths);
+  LockInc(&counters->missinglengths);
   return ServeFailure(411, "Length Required");
 }
 
 static char *HandleVersionNotSupported(void) {
-  LockInc(&shared->c.http12);
+  LockInc(&counters->http12);
   return ServeFailure(505, "HTTP Version Not Supported");
 }
 
 static char *HandleConnectRefused(void) {
-  LockInc(&shared->c.connectsrefused);
+  LockInc(&counters->connectsrefused);
   return ServeFailure(501, "Not Implemented");
 }
 
 static char *HandleExpectFailed(void) {
-  LockInc(&shared->c.expectsrefused);
+  LockInc(&counters->expectsrefused);
   return ServeFailure(417, "Expectation Failed");
 }
 
 static char *HandleHugePayload(void) {
-  LockInc(&shared->c.hugepayloads);
+  LockInc(&counters->hugepayloads);
   return ServeFailure(413, "Payload Too Large");
 }
 
 static char *HandleTransferRefused(void) {
-  LockInc(&shared->c.transfersrefused);
+  LockInc(&counters->transfersrefused);
   return ServeFailure(501, "Not Implemented");
 }
 
 static char *HandleMapFailed(struct Asset *a, int fd) {
-  LockInc(&shared->c.mapfails);
+  LockInc(&counters->mapfails);
   WARNF("(srvr) mmap(%`'s) error: %m", a->file->path);
   close(fd);
   return ServeError(500, "Internal Server Error");
 }
 
 static void LogAcceptError(const char *s) {
-  LockInc(&shared->c.accepterrors);
+  LockInc(&counters->accepterrors);
   WARNF("(srvr) %s accept error: %s", DescribeServer(), s);
 }
 
 static char *HandleOpenFail(struct Asset *a) {
-  LockInc(&shared->c.openfails);
+  LockInc(&counters->openfails);
   WARNF("(srvr) open(%`'s) error: %m", a->file->path);
   if (errno == ENFILE) {
-    LockInc(&shared->c.enfiles);
+    LockInc(&counters->enfiles);
     return ServeError(503, "Service Unavailable");
   } else if (errno == EMFILE) {
-    LockInc(&shared->c.emfiles);
+    LockInc(&counters->emfiles);
     return ServeError(503, "Service Unavailable");
   } else {
     return ServeError(500, "Internal Server Error");
@@ -5721,23 +6461,23 @@ static char *HandleOpenFail(struct Asset *a) {
 
 static char *HandlePayloadReadError(void) {
   if (errno == ECONNRESET) {
-    LockInc(&shared->c.readresets);
+    LockInc(&counters->readresets);
     LogClose("payload reset");
     return ServeFailure(400, "Bad Request"); /* XXX */
   } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-    LockInc(&shared->c.readtimeouts);
+    LockInc(&counters->readtimeouts);
     LogClose("payload read timeout");
     return ServeFailure(408, "Request Timeout");
   } else {
-    LockInc(&shared->c.readerrors);
+    LockInc(&counters->readerrors);
     INFOF("(clnt) %s payload read error: %m", DescribeClient());
     return ServeFailure(500, "Internal Server Error");
   }
 }
 
 static void HandleForkFailure(void) {
-  LockInc(&shared->c.forkerrors);
-  LockInc(&shared->c.dropped);
+  LockInc(&counters->forkerrors);
+  LockInc(&counters->dropped);
   EnterMeltdownMode();
   SendServiceUnavailable();
   close(client);
@@ -5745,21 +6485,43 @@ static void HandleForkFailure(void) {
 }
 
 static void HandleFrag(size_t got) {
-  LockInc(&shared->c.frags);
+  LockInc(&counters->frags);
   DEBUGF("(stat) %s fragged msg added %,ld bytes to %,ld byte buffer",
          DescribeClient(), amtread, got);
 }
 
+// asks pool workers to exit once idle, so they get refreshed by fork
+static void RetireWorkerPool(void) {
+  if (!workerpool || __isworker) return;
+  DEBUGF("(srvr) retiring worker pool generation %d", shared->poolgen);
+  LockInc(&shared->poolgen);
+}
+
 static void HandleReload(void) {
-  LockInc(&shared->c.reloads);
+  LockInc(&counters->reloads);
   LuaOnServerReload(Reindex());
+  RetireWorkerPool();
   invalidated = false;
 }
 
 static void HandleHeartbeat(void) {
   size_t i;
   UpdateCurrentDate(timespec_real());
-  Reindex();
+  if (Reindex()) {
+    RetireWorkerPool();
+  }
+  // a stage dir that's always being written to, e.g. logs or uploads,
+  // would otherwise restart the worker pool on every heartbeat. while
+  // the index is stale, lookups just fall back to stat() so waiting is
+  // safe, so the index and pool are refreshed once per STAGE_REBUILD_MS
+  if (stagecache.fd != -1 &&
+      stagecache.gen !=
+          atomic_load_explicit(&shared->stagegen, memory_order_acquire) &&
+      timespec_cmp(timespec_sub(timespec_real(), stagecache.built),
+                   timespec_frommillis(STAGE_REBUILD_MS)) >= 0) {
+    RebuildStageCache();
+    RetireWorkerPool();
+  }
   getrusage(RUSAGE_SELF, &shared->server);
 #ifndef STATIC
   CallSimpleHookIfDefined("OnServerHeartbeat");
@@ -5788,14 +6550,17 @@ static char *OpenAsset(struct Asset *a) {
       if ((fd = open(a->file->path.s, O_RDONLY)) != -1) {
         data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
         if (data != MAP_FAILED) {
-          LockInc(&shared->c.maps);
+          LockInc(&counters->maps);
           UnmapLater(fd, data, size);
           cpm.content = data;
           cpm.contentlength = size;
+          cpm.sendfd = fd;
+          cpm.sendbase = data;
+          cpm.sendsize = size;
         } else if ((st = _gc(malloc(sizeof(struct stat)))) &&
                    fstat(fd, st) != -1 && (data = malloc(st->st_size))) {
           /* probably empty file or zipos handle */
-          LockInc(&shared->c.slurps);
+          LockInc(&counters->slurps);
           FreeLater(data);
           if (ReadAll(fd, data, st->st_size) != -1) {
             cpm.content = data;
@@ -5823,7 +6588,7 @@ static char *OpenAsset(struct Asset *a) {
 
 static char *ServeServerOptions(void) {
   char *p;
-  LockInc(&shared->c.serveroptions);
+  LockInc(&counters->serveroptions);
   p = SetStatus(200, "OK");
 #ifdef STATIC
   p = stpcpy(p, "Allow: GET, HEAD, OPTIONS\r\n");
@@ -5837,7 +6602,7 @@ static char *ServeServerOptions(void) {
 
 static void SendContinueIfNeeded(void) {
   if (cpm.msg.version >= 11 && HeaderEqualCase(kHttpExpect, "100-continue")) {
-    LockInc(&shared->c.continues);
+    LockInc(&counters->continues);
     SendContinue();
   }
 }
@@ -5845,12 +6610,12 @@ static void SendContinueIfNeeded(void) {
 static char *ReadMore(void) {
   size_t got;
   ssize_t rc;
-  LockInc(&shared->c.frags);
+  LockInc(&counters->frags);
   if ((rc = reader(client, inbuf.p + amtread, inbuf.n - amtread)) != -1) {
     if (!(got = rc)) return HandlePayloadDisconnect();
     amtread += got;
   } else if (errno == EINTR) {
-    LockInc(&shared->c.readinterrupts);
+    LockInc(&counters->readinterrupts);
     if (killed || ((meltdown || terminated) &&
                    timespec_cmp(timespec_sub(timespec_real(), startread),
                                 (struct timespec){1}) >= 0)) {
@@ -5967,11 +6732,13 @@ static bool HasAtMostThisElement(int h, const char *s) {
 static char *HandleRequest(void) {
   char *p;
   if (cpm.msg.version == 11) {
-    LockInc(&shared->c.http11);
+    LockInc(&counters->http11);
+  } else if (cpm.msg.version == 20 && usinghttp2) {
+    LockInc(&counters->http2);
   } else if (cpm.msg.version < 10) {
-    LockInc(&shared->c.http09);
+    LockInc(&counters->http09);
   } else if (cpm.msg.version == 10) {
-    LockInc(&shared->c.http10);
+    LockInc(&counters->http10);
   } else {
     return HandleVersionNotSupported();
   }
@@ -5997,7 +6764,7 @@ static char *HandleRequest(void) {
       !IsAcceptableHost(url.host.p, url.host.n) ||
       !IsAcceptablePort(url.port.p, url.port.n)) {
     free(url.params.p);
-    LockInc(&shared->c.urisrefused);
+    LockInc(&counters->urisrefused);
     return ServeFailure(400, "Bad URI");
   }
   INFOF("(req) received %s HTTP%02d %.*s %s %`'.*s %`'.*s", DescribeClient(),
@@ -6035,7 +6802,7 @@ static char *Route(const char *host, size_t hostlen, const char *path,
   } else if (SlicesEqual(path, pathlen, "/statusz", 8)) {
     return ServeStatusz();
   } else {
-    LockInc(&shared->c.notfounds);
+    LockInc(&counters->notfounds);
     return ServeErrorWithPath(404, "Not Found", path, pathlen);
   }
 }
@@ -6056,7 +6823,7 @@ static char *RoutePath(const char *path, size_t pathlen) {
         return HandleFolder(path, pathlen);
       }
     } else {
-      LockInc(&shared->c.forbiddens);
+      LockInc(&counters->forbiddens);
       WARNF("(srvr) asset %`'.*s %#o isn't readable", pathlen, path, m);
       return ServeErrorWithPath(403, "Forbidden", path, pathlen);
     }
@@ -6113,7 +6880,7 @@ static char *HandleAsset(struct Asset *a, const char *path, size_t pathlen) {
   if (IsLua(a)) return ServeLua(a, path, pathlen);
 #endif
   if (cpm.msg.method == kHttpGet || cpm.msg.method == kHttpHead) {
-    LockInc(&shared->c.staticrequests);
+    LockInc(&counters->staticrequests);
     p = ServeAsset(a, path, pathlen);
     if (!cpm.gotxcontenttypeoptions) {
       p = stpcpy(p, "X-Content-Type-Options: nosniff\r\n");
@@ -6136,6 +6903,43 @@ static const char *GetContentType(struct Asset *a, const char *path, size_t n) {
                    a->istext ? "text/plain" : "application/octet-stream"));
 }
 
+// returns sibling asset with .zst appended to its name if it exists
+static struct Asset *GetAssetZstd(struct Asset *a) {
+  char *s;
+  size_t n;
+  struct Asset *z;
+  if (a->file) {
+    z = FreeLater(xcalloc(1, sizeof(struct Asset)));
+    z->file = FreeLater(xmalloc(sizeof(struct File)));
+    z->file->path.n = a->file->path.n + 4;
+    z->file->path.s = FreeLater(xasprintf("%s.zst", a->file->path.s));
+    LockInc(&counters->stats);
+    if (stat(z->file->path.s, &z->file->st) != -1 &&
+        S_ISREG(z->file->st.st_mode) &&
+        timespec_cmp(z->file->st.st_mtim, a->file->st.st_mtim) >= 0) {
+      return z;
+    }
+  } else {
+    n = ZIP_CFILE_NAMESIZE(zmap + a->cf);
+    s = FreeLater(xmalloc(n + 4));
+    memcpy(mempcpy(s, ZIP_CFILE_NAME(zmap + a->cf), n), ".zst", 4);
+    if ((z = GetAssetZip(s, n + 4)) && !IsCompressed(z)) {
+      return z;
+    }
+  }
+  return NULL;
+}
+
+static void MapZipAsset(struct Asset *a) {
+  cpm.content = (char *)ZIP_LFILE_CONTENT(zmap + a->lf);
+  cpm.contentlength = GetZipCfileCompressedSize(zmap + a->cf);
+  if (zmapfd != -1) {
+    cpm.sendfd = zmapfd;
+    cpm.sendbase = (char *)zmap;
+    cpm.sendsize = zsize;
+  }
+}
+
 static bool IsNotModified(struct Asset *a) {
   if (cpm.msg.version < 10) return false;
   if (!HasHeader(kHttpIfModifiedSince)) return false;
@@ -6146,15 +6950,34 @@ static bool IsNotModified(struct Asset *a) {
 
 static char *ServeAsset(struct Asset *a, const char *path, size_t pathlen) {
   char *p;
+  bool zstd;
+  struct Asset *z;
   const char *ct;
+  zstd = false;
   ct = GetContentType(a, path, pathlen);
   if (IsNotModified(a)) {
-    LockInc(&shared->c.notmodifieds);
+    LockInc(&counters->notmodifieds);
     p = SetStatus(304, "Not Modified");
+  } else if (!HasHeader(kHttpRange) && ClientPrefersZstd() &&
+             (z = GetAssetZstd(a))) {
+    DEBUGF("(srvr) ServeAssetZstd()");
+    if (!z->file) {
+      MapZipAsset(z);
+      if (cpm.msg.method != kHttpHead &&
+          !Verify(cpm.content, cpm.contentlength,
+                  ZIP_LFILE_CRC32(zmap + z->lf))) {
+        return ServeError(500, "Internal Server Error");
+      }
+    } else if ((p = OpenAsset(z))) {
+      return p;
+    }
+    LockInc(&counters->zstdresponses);
+    p = SetStatus(200, "OK");
+    p = stpcpy(p, "Content-Encoding: zstd\r\n");
+    zstd = true;
   } else {
     if (!a->file) {
-      cpm.content = (char *)ZIP_LFILE_CONTENT(zmap + a->lf);
-      cpm.contentlength = GetZipCfileCompressedSize(zmap + a->cf);
+      MapZipAsset(a);
     } else if ((p = OpenAsset(a))) {
       return p;
     }
@@ -6167,7 +6990,7 @@ static char *ServeAsset(struct Asset *a, const char *path, size_t pathlen) {
     } else if (cpm.msg.version >= 11 && HasHeader(kHttpRange)) {
       p = ServeAssetRange(a);
     } else if (!a->file) {
-      LockInc(&shared->c.identityresponses);
+      LockInc(&counters->identityresponses);
       DEBUGF("(zip) ServeAssetZipIdentity(%`'s)", ct);
       if (Verify(cpm.content, cpm.contentlength,
                  ZIP_LFILE_CRC32(zmap + a->lf))) {
@@ -6195,7 +7018,7 @@ static char *ServeAsset(struct Asset *a, const char *path, size_t pathlen) {
     if (!cpm.gotcachecontrol) {
       p = AppendCache(p, cacheseconds, cachedirective);
     }
-    if (!IsCompressed(a)) {
+    if (!IsCompressed(a) && !zstd) {
       p = stpcpy(p, "Accept-Ranges: bytes\r\n");
     }
   }
@@ -6233,9 +7056,11 @@ static inline bool MustNotIncludeMessageBody(void) { /* RFC2616 § 4.4 */
 }
 
 static bool TransmitResponse(char *p) {
-  int iovlen;
+  int i, iovlen, body;
+  ssize_t headlen;
   struct iovec iov[4];
   long actualcontentlength;
+  body = -1;
   if (cpm.msg.version >= 10) {
     actualcontentlength = cpm.contentlength;
     if (cpm.gzipped) {
@@ -6257,6 +7082,7 @@ static bool TransmitResponse(char *p) {
         iov[iovlen].iov_len = sizeof(kGzipHeader);
         ++iovlen;
       }
+      body = iovlen;
       iov[iovlen].iov_base = cpm.content;
       iov[iovlen].iov_len = cpm.contentlength;
       ++iovlen;
@@ -6267,12 +7093,22 @@ static bool TransmitResponse(char *p) {
       }
     }
   } else {
+    body = 0;
     iov[0].iov_base = cpm.content;
     iov[0].iov_len = cpm.contentlength;
     iovlen = 1;
   }
-  Send(iov, iovlen);
-  LockInc(&shared->c.messageshandled);
+  if (body != -1 && ShouldSendFile()) {
+    for (headlen = i = 0; i < body; ++i) headlen += iov[i].iov_len;
+    if (body && Send(iov, body) != headlen) {
+      connectionclose = true;
+    } else if (SendFile() != -1 && !connectionclose && body + 1 < iovlen) {
+      Send(iov + body + 1, iovlen - body - 1);
+    }
+  } else {
+    Send(iov, iovlen);
+  }
+  LockInc(&counters->messageshandled);
   ++messageshandled;
   return true;
 }
@@ -6332,32 +7168,10 @@ static bool StreamResponse(char *p) {
   return true;
 }
 
-static bool HandleMessageActual(void) {
-  int rc;
+// adds headers common to every response, and logs latency
+static char *FinishHeaders(char *p) {
   long reqtime, contime;
-  char *p;
   struct timespec now;
-  if ((rc = ParseHttpMessage(&cpm.msg, inbuf.p, amtread)) != -1) {
-    if (!rc) return false;
-    hdrsize = rc;
-    if (logmessages) {
-      LogMessage("received", inbuf.p, hdrsize);
-    }
-    p = HandleRequest();
-  } else {
-    LockInc(&shared->c.badmessages);
-    connectionclose = true;
-    if ((p = DumpHexc(inbuf.p, MIN(amtread, 256), 0))) {
-      INFOF("(clnt) %s sent garbage %s", DescribeClient(), p);
-    }
-    return true;
-  }
-  if (!cpm.msgsize) {
-    amtread = 0;
-    connectionclose = true;
-    LockInc(&shared->c.synchronizationfailures);
-    DEBUGF("(clnt) could not synchronize message stream");
-  }
   if (cpm.msg.version >= 10) {
     p = AppendCrlf(stpcpy(stpcpy(p, "Date: "), shared->currentdate));
     if (!cpm.branded) p = stpcpy(p, serverheader);
@@ -6388,10 +7202,45 @@ static bool HandleMessageActual(void) {
            cpm.msg.uri.b - cpm.msg.uri.a, inbuf.p + cpm.msg.uri.a, reqtime,
            contime);
   }
-  if (!cpm.generator) {
-    return TransmitResponse(p);
-  } else {
-    return StreamResponse(p);
+  return p;
+}
+
+static bool HandleMessageActual(void) {
+  int rc;
+  char *p;
+  // prior knowledge h2c, or h2 that was negotiated by tls alpn
+  if (!usinghttp2 && amtread >= 3 &&
+      !memcmp(inbuf.p, kHttp2Preface, MIN(amtread, kHttp2PrefaceSize))) {
+    if (amtread < kHttp2PrefaceSize) return false;
+    HandleHttp2();
+    return true;
+  }
+  if ((rc = ParseHttpMessage(&cpm.msg, inbuf.p, amtread)) != -1) {
+    if (!rc) return false;
+    hdrsize = rc;
+    if (logmessages) {
+      LogMessage("received", inbuf.p, hdrsize);
+    }
+    p = HandleRequest();
+  } else {
+    LockInc(&counters->badmessages);
+    connectionclose = true;
+    if ((p = DumpHexc(inbuf.p, MIN(amtread, 256), 0))) {
+      INFOF("(clnt) %s sent garbage %s", DescribeClient(), p);
+    }
+    return true;
+  }
+  if (!cpm.msgsize) {
+    amtread = 0;
+    connectionclose = true;
+    LockInc(&counters->synchronizationfailures);
+    DEBUGF("(clnt) could not synchronize message stream");
+  }
+  p = FinishHeaders(p);
+  if (!cpm.generator) {
+    return TransmitResponse(p);
+  } else {
+    return StreamResponse(p);
   }
 }
 
@@ -6408,6 +7257,678 @@ static void InitRequest(void) {
   bzero(&cpm, sizeof(cpm));
 }
 
+static int SendHttp2(int type, int flags, uint32_t id, const void *p,
+                     size_t n) {
+  char hdr[kHttp2FrameHeader];
+  struct iovec iov[2];
+  AppendHttp2Frame(hdr, n, type, flags, id);
+  iov[0].iov_base = hdr;
+  iov[0].iov_len = sizeof(hdr);
+  iov[1].iov_base = (void *)p;
+  iov[1].iov_len = n;
+  return Send(iov, 2) == -1 ? -1 : 0;
+}
+
+static int SendHttp2Goaway(int err) {
+  char b[8];
+  WRITE32BE(b, h2.lastid);
+  WRITE32BE(b + 4, err);
+  if (err) {
+    INFOF("(clnt) %s http/2 connection error %d", DescribeClient(), err);
+  }
+  SendHttp2(kHttp2Goaway, 0, 0, b, 8);
+  h2.goaway = true;
+  return -1;
+}
+
+static struct Http2Stream *GetHttp2Stream(uint32_t id) {
+  int i;
+  for (i = 0; i < ARRAYLEN(h2.s); ++i) {
+    if (h2.s[i].id == id) {
+      return h2.s + i;
+    }
+  }
+  return 0;
+}
+
+static void FreeHttp2Stream(struct Http2Stream *s) {
+  int i;
+  for (i = 0; i < ARRAYLEN(s->pseudo); ++i) free(s->pseudo[i]);
+  free(s->head);
+  free(s->cookie);
+  free(s->body);
+  bzero(s, sizeof(*s));
+}
+
+static int ResetHttp2Stream(uint32_t id, int err) {
+  char b[4];
+  struct Http2Stream *s;
+  DEBUGF("(clnt) %s resetting http/2 stream %u with %d", DescribeClient(), id,
+         err);
+  if ((s = GetHttp2Stream(id))) FreeHttp2Stream(s);
+  WRITE32BE(b, err);
+  return SendHttp2(kHttp2RstStream, 0, id, b, 4);
+}
+
+// credits flow control windows for bytes of DATA frame we've consumed
+static int SendHttp2WindowUpdate(uint32_t id, uint32_t n) {
+  char b[(kHttp2FrameHeader + 4) * 2], *p = b;
+  p = AppendHttp2Frame(p, 4, kHttp2WindowUpdate, 0, 0);
+  p = WRITE32BE(p, n);
+  if (id) {
+    p = AppendHttp2Frame(p, 4, kHttp2WindowUpdate, 0, id);
+    p = WRITE32BE(p, n);
+  }
+  return Send(&(struct iovec){b, p - b}, 1) == -1 ? -1 : 0;
+}
+
+static bool IsHttp2FieldName(const char *s, size_t n) {
+  size_t i;
+  if (!n) return false;
+  for (i = s[0] == ':'; i < n; ++i) {
+    if (!kHttpToken[s[i] & 255] || isupper(s[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// collects field of request header block, which gets validated as
+// we go, since malformed requests are only a stream error, whereas
+// we must keep decoding so the hpack dynamic table stays in sync
+static int OnHttp2Field(void *arg, const char *k, size_t kn, const char *v,
+                        size_t vn) {
+  int h, i;
+  struct Http2Stream *s = arg;
+  static const char kPseudo[4][11] = {":method", ":scheme", ":authority",
+                                      ":path"};
+  if ((s->listsize += kn + vn + 32) > inbuf.n) s->hog = true;
+  if (s->bad || s->hog) return 0;
+  if (!IsHttp2FieldName(k, kn) || memchr(v, '\0', vn) || memchr(v, '\r', vn) ||
+      memchr(v, '\n', vn)) {
+    s->bad = true;
+    return 0;
+  }
+  if (k[0] == ':') {
+    for (i = 0; i < ARRAYLEN(kPseudo); ++i) {
+      if (SlicesEqual(k, kn, kPseudo[i], strlen(kPseudo[i]))) {
+        break;
+      }
+    }
+    if (s->gotfield || i == ARRAYLEN(kPseudo) || s->pseudo[i] || !vn ||
+        (i != 2 && memchr(v, ' ', vn))) {
+      s->bad = true;
+    } else {
+      s->pseudo[i] = xstrndup(v, vn);
+    }
+    return 0;
+  }
+  s->gotfield = true;
+  switch ((h = GetHttpHeader(k, kn))) {
+    case kHttpConnection:
+    case kHttpKeepAlive:
+    case kHttpProxyConnection:
+    case kHttpTransferEncoding:
+    case kHttpUpgrade:
+      s->bad = true;  // RFC9113 § 8.2.2
+      return 0;
+    case kHttpTe:
+      if (!SlicesEqual(v, vn, "trailers", 8)) s->bad = true;
+      return 0;
+    case kHttpContentLength:
+      return 0;  // we'll compute it ourselves
+    case kHttpHost:
+      if (!s->pseudo[2]) s->pseudo[2] = xstrndup(v, vn);
+      return 0;
+    case kHttpCookie:
+      if (s->cookie) appendw(&s->cookie, READ16LE("; "));
+      appendd(&s->cookie, v, vn);
+      return 0;
+    default:
+      appendd(&s->head, k, kn);
+      appendw(&s->head, READ16LE(": "));
+      appendd(&s->head, v, vn);
+      appendw(&s->head, READ16LE("\r\n"));
+      return 0;
+  }
+}
+
+static int OnHttp2Trailer(void *arg, const char *k, size_t kn, const char *v,
+                          size_t vn) {
+  return 0;
+}
+
+static int OnHttp2HeaderBlock(void) {
+  uint32_t id;
+  struct Http2Stream *s;
+  id = h2.blockid;
+  h2.blockid = 0;
+  if ((s = GetHttp2Stream(id))) {
+    if (s->ended || !(h2.blockflags & kHttp2FlagEndStream)) {
+      return SendHttp2Goaway(kHttp2ProtocolError);
+    }
+    if (DecodeHpack(&h2.hpack, h2.block, appendz(h2.block).i, OnHttp2Trailer,
+                    0) == -1) {
+      return SendHttp2Goaway(kHttp2CompressionError);
+    }
+    s->ended = true;
+    return 0;
+  }
+  if (id <= h2.lastid) {
+    return SendHttp2Goaway(kHttp2StreamClosed);
+  }
+  h2.lastid = id;
+  if (!(s = GetHttp2Stream(0))) {
+    if (DecodeHpack(&h2.hpack, h2.block, appendz(h2.block).i, OnHttp2Trailer,
+                    0) == -1) {
+      return SendHttp2Goaway(kHttp2CompressionError);
+    }
+    return ResetHttp2Stream(id, kHttp2RefusedStream);
+  }
+  s->id = id;
+  s->window = h2.initwindow;
+  s->ended = !!(h2.blockflags & kHttp2FlagEndStream);
+  if (DecodeHpack(&h2.hpack, h2.block, appendz(h2.block).i, OnHttp2Field, s) ==
+      -1) {
+    return SendHttp2Goaway(kHttp2CompressionError);
+  }
+  if (s->hog) {
+    return ResetHttp2Stream(id, kHttp2EnhanceYourCalm);
+  }
+  if (s->bad || !s->pseudo[0] || !s->pseudo[3]) {
+    return ResetHttp2Stream(id, kHttp2ProtocolError);
+  }
+  return 0;
+}
+
+static int OnHttp2HeaderFragment(int flags, const char *p, size_t n) {
+  if (appendz(h2.block).i + n > inbuf.n) {
+    return SendHttp2Goaway(kHttp2EnhanceYourCalm);
+  }
+  appendd(&h2.block, p, n);
+  if (!(flags & kHttp2FlagEndHeaders)) return 0;
+  return OnHttp2HeaderBlock();
+}
+
+// removes padding from DATA or HEADERS payload
+static bool UnpadHttp2(struct Http2Frame *f, const char **p, uint32_t *n) {
+  uint32_t pad;
+  *n = f->size;
+  if (f->flags & kHttp2FlagPadded) {
+    if (!*n || (pad = *(*p)++ & 255) >= *n) return false;
+    *n -= 1 + pad;
+  }
+  return true;
+}
+
+static int OnHttp2Headers(struct Http2Frame *f, const char *p) {
+  uint32_t n;
+  if (!(f->stream & 1) || !UnpadHttp2(f, &p, &n)) {
+    return SendHttp2Goaway(kHttp2ProtocolError);
+  }
+  if (f->flags & kHttp2FlagPriority) {
+    if (n < 5) return SendHttp2Goaway(kHttp2ProtocolError);
+    p += 5, n -= 5;  // we don't prioritize streams
+  }
+  h2.blockid = f->stream;
+  h2.blockflags = f->flags;
+  h2.fragments = 0;
+  appendr(&h2.block, 0);
+  return OnHttp2HeaderFragment(f->flags, p, n);
+}
+
+static int OnHttp2Data(struct Http2Frame *f, const char *p) {
+  uint32_t n;
+  struct Http2Stream *s;
+  if (!f->stream || f->stream > h2.lastid || !UnpadHttp2(f, &p, &n)) {
+    return SendHttp2Goaway(kHttp2ProtocolError);
+  }
+  if (!(s = GetHttp2Stream(f->stream)) || s->ended) {
+    if (f->size && SendHttp2WindowUpdate(0, f->size) == -1) return -1;
+    return ResetHttp2Stream(f->stream, kHttp2StreamClosed);
+  }
+  if (!s->huge && appendz(s->body).i + n > inbuf.n) {
+    s->huge = true;
+    Free(&s->body);
+  }
+  if (!s->huge) {
+    appendd(&s->body, p, n);
+  }
+  if (f->flags & kHttp2FlagEndStream) {
+    s->ended = true;
+    if (f->size) return SendHttp2WindowUpdate(0, f->size);
+  } else if (f->size) {
+    return SendHttp2WindowUpdate(f->stream, f->size);
+  }
+  return 0;
+}
+
+static int OnHttp2Settings(struct Http2Frame *f, const char *p) {
+  int i;
+  int64_t x;
+  uint32_t k, v, n;
+  if (f->stream) return SendHttp2Goaway(kHttp2ProtocolError);
+  if (f->flags & kHttp2FlagAck) {
+    if (f->size) return SendHttp2Goaway(kHttp2FrameSizeError);
+    return 0;
+  }
+  if (f->size % 6) return SendHttp2Goaway(kHttp2FrameSizeError);
+  for (n = f->size; n; p += 6, n -= 6) {
+    k = READ16BE(p);
+    v = READ32BE(p + 2);
+    switch (k) {
+      case kHttp2SettingsEnablePush:
+        if (v > 1) return SendHttp2Goaway(kHttp2ProtocolError);
+        break;
+      case kHttp2SettingsInitialWindowSize:
+        if (v > 0x7fffffff) return SendHttp2Goaway(kHttp2FlowControlError);
+        for (x = v - h2.initwindow, i = 0; i < ARRAYLEN(h2.s); ++i) {
+          h2.s[i].window += x;
+        }
+        h2.initwindow = v;
+        break;
+      case kHttp2SettingsMaxFrameSize:
+        if (v < kHttp2MaxFrame || v > 0xffffff) {
+          return SendHttp2Goaway(kHttp2ProtocolError);
+        }
+        h2.maxframe = v;
+        break;
+      default:
+        break;  // our encoder never uses the dynamic table
+    }
+  }
+  h2.gotsettings = true;
+  return SendHttp2(kHttp2Settings, kHttp2FlagAck, 0, 0, 0);
+}
+
+static int OnHttp2WindowUpdate(struct Http2Frame *f, const char *p) {
+  uint32_t x;
+  struct Http2Stream *s;
+  if (f->size != 4) return SendHttp2Goaway(kHttp2FrameSizeError);
+  x = READ32BE(p) & 0x7fffffff;
+  if (!f->stream) {
+    if (!x) return SendHttp2Goaway(kHttp2ProtocolError);
+    if ((h2.window += x) > 0x7fffffff) {
+      return SendHttp2Goaway(kHttp2FlowControlError);
+    }
+  } else if (f->stream > h2.lastid) {
+    return SendHttp2Goaway(kHttp2ProtocolError);
+  } else if ((s = GetHttp2Stream(f->stream))) {
+    if (!x) return ResetHttp2Stream(f->stream, kHttp2ProtocolError);
+    if ((s->window += x) > 0x7fffffff) {
+      return ResetHttp2Stream(f->stream, kHttp2FlowControlError);
+    }
+  }
+  return 0;
+}
+
+static int OnHttp2Frame(struct Http2Frame *f, const char *p) {
+  struct Http2Stream *s;
+  if (h2.blockid &&
+      (f->type != kHttp2Continuation || f->stream != h2.blockid)) {
+    return SendHttp2Goaway(kHttp2ProtocolError);
+  }
+  if (!h2.gotsettings &&
+      (f->type != kHttp2Settings || (f->flags & kHttp2FlagAck))) {
+    return SendHttp2Goaway(kHttp2ProtocolError);
+  }
+  switch (f->type) {
+    case kHttp2Data:
+      return OnHttp2Data(f, p);
+    case kHttp2Headers:
+      return OnHttp2Headers(f, p);
+    case kHttp2Continuation:
+      if (!h2.blockid) return SendHttp2Goaway(kHttp2ProtocolError);
+      if (++h2.fragments > HTTP2_FRAGMENTS) {
+        return SendHttp2Goaway(kHttp2EnhanceYourCalm);
+      }
+      return OnHttp2HeaderFragment(f->flags, p, f->size);
+    case kHttp2Settings:
+      return OnHttp2Settings(f, p);
+    case kHttp2WindowUpdate:
+      return OnHttp2WindowUpdate(f, p);
+    case kHttp2Priority:
+      if (!f->stream) return SendHttp2Goaway(kHttp2ProtocolError);
+      if (f->size != 5) return ResetHttp2Stream(f->stream, kHttp2FrameSizeError);
+      return 0;
+    case kHttp2RstStream:
+      if (f->size != 4) return SendHttp2Goaway(kHttp2FrameSizeError);
+      if (!f->stream || f->stream > h2.lastid) {
+        return SendHttp2Goaway(kHttp2ProtocolError);
+      }
+      if ((s = GetHttp2Stream(f->stream))) FreeHttp2Stream(s);
+      return 0;
+    case kHttp2Ping:
+      if (f->stream) return SendHttp2Goaway(kHttp2ProtocolError);
+      if (f->size != 8) return SendHttp2Goaway(kHttp2FrameSizeError);
+      if (f->flags & kHttp2FlagAck) return 0;
+      return SendHttp2(kHttp2Ping, kHttp2FlagAck, 0, p, 8);
+    case kHttp2Goaway:
+      if (f->stream) return SendHttp2Goaway(kHttp2ProtocolError);
+      h2.goaway = true;
+      return 0;
+    case kHttp2PushPromise:
+      return SendHttp2Goaway(kHttp2ProtocolError);
+    default:
+      return 0;  // RFC9113 § 4.1 says ignore unknown frame types
+  }
+}
+
+// processes each complete frame that's been read so far
+static int OnHttp2Frames(void) {
+  size_t i;
+  struct Http2Frame f;
+  for (i = 0; h2.inlen - i >= kHttp2FrameHeader;
+       i += kHttp2FrameHeader + f.size) {
+    ParseHttp2Frame(&f, h2.in + i);
+    if (f.size > kHttp2MaxFrame) {
+      return SendHttp2Goaway(kHttp2FrameSizeError);
+    }
+    if (h2.inlen - i < kHttp2FrameHeader + f.size) break;
+    if (OnHttp2Frame(&f, h2.in + i + kHttp2FrameHeader) == -1) return -1;
+  }
+  memmove(h2.in, h2.in + i, h2.inlen - i);
+  h2.inlen -= i;
+  return 0;
+}
+
+static int ReadHttp2(void) {
+  ssize_t rc;
+  for (;;) {
+    if ((rc = reader(client, h2.in + h2.inlen, h2.inc - h2.inlen)) > 0) {
+      h2.inlen += rc;
+      return 0;
+    } else if (!rc) {
+      DEBUGF("(clnt) %s http/2 disconnect", DescribeClient());
+      return -1;
+    } else if (errno == EINTR) {
+      LockInc(&counters->readinterrupts);
+      errno = 0;
+      if (killed || terminated || meltdown) {
+        return SendHttp2Goaway(kHttp2NoError);
+      }
+    } else if (errno == EAGAIN) {
+      LockInc(&counters->readtimeouts);
+      return SendHttp2Goaway(kHttp2NoError);
+    } else {
+      if (errno == ECONNRESET) {
+        LockInc(&counters->readresets);
+      } else {
+        LockInc(&counters->readerrors);
+      }
+      return -1;
+    }
+  }
+}
+
+// sends DATA frames, waiting on the peer's flow control windows, and
+// returns zero without sending everything if the stream gets reset
+static int SendHttp2Data(struct Http2Stream *s, struct iovec *v, int n,
+                         bool end) {
+  int i, j;
+  int64_t w;
+  size_t k, m, rem;
+  uint32_t id = s->id;
+  struct iovec iov[4];
+  char hdr[kHttp2FrameHeader];
+  CHECK_LT(n, ARRAYLEN(iov));
+  for (;;) {
+    for (rem = i = 0; i < n; ++i) rem += v[i].iov_len;
+    if (!rem) {
+      if (!end) return 0;
+      return SendHttp2(kHttp2Data, kHttp2FlagEndStream, id, 0, 0);
+    }
+    while ((w = MIN(h2.window, s->window)) <= 0) {
+      if (ReadHttp2() == -1 || OnHttp2Frames() == -1) return -1;
+      if (s->id != id) return 0;
+    }
+    m = MIN(rem, MIN(w, h2.maxframe));
+    AppendHttp2Frame(hdr, m, kHttp2Data,
+                     end && m == rem ? kHttp2FlagEndStream : 0, id);
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = sizeof(hdr);
+    for (j = 1, k = m, i = 0; k; ++i) {
+      if (!v[i].iov_len) continue;
+      iov[j].iov_base = v[i].iov_base;
+      iov[j].iov_len = MIN(k, v[i].iov_len);
+      v[i].iov_base = (char *)v[i].iov_base + iov[j].iov_len;
+      v[i].iov_len -= iov[j].iov_len;
+      k -= iov[j++].iov_len;
+    }
+    if (Send(iov, j) == -1) return -1;
+    h2.window -= m;
+    s->window -= m;
+    if (m == rem) return 0;
+  }
+}
+
+// translates http/1.1 response header into hpack
+static char *EncodeHttp2Headers(const char *p, size_t *z) {
+  char *b, *e, *k, *q, *v, ibuf[12];
+  b = q = FreeLater(xmalloc((p - hdrbuf.p) * 2 + 16));
+  q = EncodeHpack(q, ":status", 7, ibuf,
+                  FormatInt32(ibuf, cpm.statuscode) - ibuf);
+  for (k = memchr(hdrbuf.p, '\n', p - hdrbuf.p) + 1; k < p; k = e + 2) {
+    e = memchr(k, '\r', p - k);
+    v = memchr(k, ':', e - k);
+    switch (GetHttpHeader(k, v - k)) {
+      case kHttpConnection:
+      case kHttpKeepAlive:
+      case kHttpProxyConnection:
+      case kHttpTransferEncoding:
+      case kHttpUpgrade:
+        continue;
+      default:
+        q = EncodeHpack(q, strntolower(k, v - k), v - k, v + 2, e - (v + 2));
+        break;
+    }
+  }
+  *z = q - b;
+  return b;
+}
+
+// turns stream into the http/1.1 style message redbean understands
+static bool ComposeHttp2Request(struct Http2Stream *s) {
+  char *p, ibuf[21];
+  size_t n, methodlen, pathlen, hostlen, headlen, cookielen, bodylen;
+  methodlen = strlen(s->pseudo[0]);
+  pathlen = strlen(s->pseudo[3]);
+  hostlen = s->pseudo[2] ? strlen(s->pseudo[2]) : 0;
+  headlen = appendz(s->head).i;
+  cookielen = appendz(s->cookie).i;
+  bodylen = appendz(s->body).i;
+  n = methodlen + 1 + pathlen + 11 + 8 + hostlen + headlen + 10 + cookielen +
+      18 + sizeof(ibuf) + 2 + bodylen;
+  if (n > inbuf.n) return false;
+  p = mempcpy(inbuf.p, s->pseudo[0], methodlen);
+  p = mempcpy(stpcpy(p, " "), s->pseudo[3], pathlen);
+  p = stpcpy(p, " HTTP/2.0\r\n");
+  if (s->pseudo[2]) {
+    p = AppendCrlf(mempcpy(stpcpy(p, "Host: "), s->pseudo[2], hostlen));
+  }
+  p = mempcpy(p, s->head, headlen);
+  if (s->cookie) {
+    p = AppendCrlf(mempcpy(stpcpy(p, "Cookie: "), s->cookie, cookielen));
+  }
+  if (!s->huge) {
+    p = stpcpy(p, "Content-Length: ");
+    p = AppendCrlf(mempcpy(p, ibuf, FormatUint64(ibuf, bodylen) - ibuf));
+  }
+  p = AppendCrlf(p);
+  p = mempcpy(p, s->body, bodylen);
+  amtread = p - inbuf.p;
+  return true;
+}
+
+static int SendHttp2Headers(uint32_t id, bool end, const char *p, size_t n) {
+  int type, flags;
+  size_t m;
+  type = kHttp2Headers;
+  flags = end ? kHttp2FlagEndStream : 0;
+  for (;;) {
+    m = MIN(n, h2.maxframe);
+    if (m == n) flags |= kHttp2FlagEndHeaders;
+    if (SendHttp2(type, flags, id, p, m) == -1) return -1;
+    if (!(n -= m)) return 0;
+    p += m;
+    type = kHttp2Continuation;
+    flags = 0;
+  }
+}
+
+static int ServeHttp2Stream(struct Http2Stream *s) {
+  int rc;
+  bool nobody;
+  char *p, *b;
+  size_t n;
+  ssize_t got;
+  uint32_t id;
+  struct iovec iov[3];
+  InitRequest();
+  startrequest = timespec_real();
+  id = s->id;
+  if (!ComposeHttp2Request(s)) {
+    // send 413 if it's the body that doesn't fit, since REFUSED_STREAM
+    // would tell the client it's safe to retry the very same request
+    free(s->body);
+    s->body = 0;
+    s->huge = true;
+    if (!ComposeHttp2Request(s)) {
+      LockInc(&counters->hugepayloads);
+      return ResetHttp2Stream(id, kHttp2EnhanceYourCalm);
+    }
+  }
+  if ((rc = ParseHttpMessage(&cpm.msg, inbuf.p, amtread)) <= 0) {
+    LockInc(&counters->badmessages);
+    return ResetHttp2Stream(id, kHttp2ProtocolError);
+  }
+  hdrsize = rc;
+  if (logmessages) {
+    LogMessage("received", inbuf.p, hdrsize);
+  }
+  p = s->huge ? HandleHugePayload() : HandleRequest();
+  p = FinishHeaders(p);
+  if (!cpm.generator) {
+    n = cpm.contentlength;
+    if (cpm.gzipped) {
+      n += sizeof(kGzipHeader) + sizeof(gzip_footer);
+      p = stpcpy(p, "Content-Encoding: gzip\r\n");
+    }
+    p = AppendContentLength(p, n);
+  }
+  CHECK_LE(p - hdrbuf.p, hdrbuf.n);
+  if (logmessages) {
+    LogMessage("sending", hdrbuf.p, p - hdrbuf.p);
+  }
+  nobody = MustNotIncludeMessageBody();
+  b = EncodeHttp2Headers(p, &n);
+  if ((rc = SendHttp2Headers(id, nobody, b, n)) != -1 && !nobody) {
+    if (!cpm.generator) {
+      iov[0].iov_base = (void *)kGzipHeader;
+      iov[0].iov_len = cpm.gzipped ? sizeof(kGzipHeader) : 0;
+      iov[1].iov_base = cpm.content;
+      iov[1].iov_len = cpm.contentlength;
+      iov[2].iov_base = gzip_footer;
+      iov[2].iov_len = cpm.gzipped ? sizeof(gzip_footer) : 0;
+      rc = SendHttp2Data(s, iov, 3, true);
+    } else {
+      do {
+        bzero(iov, sizeof(iov));
+        if ((got = cpm.generator(iov)) <= 0) break;
+        rc = SendHttp2Data(s, iov, 3, false);
+      } while (rc != -1 && s->id == id);
+      if (rc != -1 && s->id == id) {
+        if (!got) {
+          rc = SendHttp2Data(s, 0, 0, true);
+        } else {
+          rc = ResetHttp2Stream(id, kHttp2InternalError);
+        }
+      }
+    }
+  }
+  LockInc(&counters->messageshandled);
+  ++messageshandled;
+  if (s->id == id) FreeHttp2Stream(s);
+  return rc;
+}
+
+static struct Http2Stream *GetReadyHttp2Stream(void) {
+  int i;
+  struct Http2Stream *s;
+  for (s = 0, i = 0; i < ARRAYLEN(h2.s); ++i) {
+    if (h2.s[i].id && h2.s[i].ended && (!s || h2.s[i].id < s->id)) {
+      s = h2.s + i;
+    }
+  }
+  return s;
+}
+
+// RFC9113 § 9.2 wants tls 1.2+ with an ephemeral key exchange and an
+// aead cipher, which mbedtls may not have negotiated when alpn chose h2
+static bool IsHttp2SecurityAdequate(void) {
+  const mbedtls_cipher_info_t *c;
+  const mbedtls_ssl_ciphersuite_t *s;
+  if (ssl.minor_ver < MBEDTLS_SSL_MINOR_VERSION_3) return false;
+  if (!(s = mbedtls_ssl_ciphersuite_from_id(ssl.session->ciphersuite))) {
+    return false;
+  }
+  if ((s->flags & MBEDTLS_CIPHERSUITE_SHORT_TAG) ||
+      (!mbedtls_ssl_ciphersuite_uses_dhe(s) &&
+       !mbedtls_ssl_ciphersuite_uses_ecdhe(s)) ||
+      !(c = mbedtls_cipher_info_from_type(s->cipher))) {
+    return false;
+  }
+  return c->mode == MBEDTLS_MODE_GCM || c->mode == MBEDTLS_MODE_CCM ||
+         c->mode == MBEDTLS_MODE_CHACHAPOLY;
+}
+
+// speaks http/2 for remainder of connection, which redbean supports
+// with prior knowledge (h2c) or via tls alpn (h2), but not upgrading
+static void HandleHttp2(void) {
+  int i, rc;
+  char b[12];
+  struct Http2Stream *s;
+  DEBUGF("(clnt) %s speaking http/2", DescribeClient());
+  usinghttp2 = true;
+  h2.maxframe = kHttp2MaxFrame;
+  h2.initwindow = h2.window = kHttp2Window;
+  h2.inc = amtread + kHttp2FrameHeader + kHttp2MaxFrame;
+  h2.in = xmalloc(h2.inc);
+  h2.inlen = amtread - kHttp2PrefaceSize;
+  memcpy(h2.in, inbuf.p + kHttp2PrefaceSize, h2.inlen);
+  InitHpack(&h2.hpack, kHpackTableSize);
+  if (usingssl && !IsHttp2SecurityAdequate()) {
+    rc = SendHttp2Goaway(kHttp2InadequateSecurity);
+  } else {
+    WRITE16BE(b, kHttp2SettingsMaxConcurrentStreams);
+    WRITE32BE(b + 2, ARRAYLEN(h2.s));
+    WRITE16BE(b + 6, kHttp2SettingsMaxHeaderListSize);
+    WRITE32BE(b + 8, inbuf.n);
+    rc = SendHttp2(kHttp2Settings, 0, 0, b, 12);
+  }
+  if (rc != -1) rc = OnHttp2Frames();
+  while (rc != -1 && !h2.goaway) {
+    if ((s = GetReadyHttp2Stream())) {
+      rc = ServeHttp2Stream(s);
+      CollectGarbage();
+      if (invalidated) HandleReload();
+      if (rc != -1 && connectionclose) rc = SendHttp2Goaway(kHttp2NoError);
+    } else if ((rc = ReadHttp2()) != -1) {
+      rc = OnHttp2Frames();
+    }
+  }
+  for (i = 0; i < ARRAYLEN(h2.s); ++i) {
+    FreeHttp2Stream(h2.s + i);
+  }
+  DestroyHpack(&h2.hpack);
+  free(h2.block);
+  free(h2.in);
+  bzero(&h2, sizeof(h2));
+  usinghttp2 = false;
+  connectionclose = true;
+  cpm.msgsize = amtread = 0;
+}
+
 static bool IsSsl(unsigned char c) {
   if (c == 22) return true;
   if (!(c & 128)) return false;
@@ -6416,6 +7937,13 @@ static bool IsSsl(unsigned char c) {
   return true;
 }
 
+// keep-alive connections may be handed back to the pool worker event
+// loop between messages, so an idle client doesn't pin a whole process
+static bool ShouldParkConnection(void) {
+  return idleepoll != -1 && !usingssl && !connectionclose && !terminated &&
+         !meltdown && idlers.n < idlelimit;
+}
+
 static void HandleMessages(void) {
   bool once;
   ssize_t rc;
@@ -6466,20 +7994,20 @@ static void HandleMessages(void) {
           return;
         }
       } else if (errno == EINTR) {
-        LockInc(&shared->c.readinterrupts);
+        LockInc(&counters->readinterrupts);
         errno = 0;
       } else if (errno == EAGAIN) {
-        LockInc(&shared->c.readtimeouts);
+        LockInc(&counters->readtimeouts);
         if (amtread) SendTimeout();
         NotifyClose();
         LogClose("read timeout");
         return;
       } else if (errno == ECONNRESET) {
-        LockInc(&shared->c.readresets);
+        LockInc(&counters->readresets);
         LogClose("read reset");
         return;
       } else {
-        LockInc(&shared->c.readerrors);
+        LockInc(&counters->readerrors);
         if (errno == EBADF) {  // don't warn on close/bad fd
           LogClose("read badf");
         } else {
@@ -6492,7 +8020,7 @@ static void HandleMessages(void) {
            (!amtread || timespec_cmp(timespec_sub(timespec_real(), startread),
                                      (struct timespec){1}) >= 0))) {
         if (amtread) {
-          LockInc(&shared->c.dropped);
+          LockInc(&counters->dropped);
           SendServiceUnavailable();
         }
         NotifyClose();
@@ -6512,10 +8040,13 @@ static void HandleMessages(void) {
         NotifyClose();
         LogClose(DescribeClose());
         return;
+      } else if (ShouldParkConnection()) {
+        connectionparked = true;
+        return;
       }
     } else {
       CHECK_LT(cpm.msgsize, amtread);
-      LockInc(&shared->c.pipelinedrequests);
+      LockInc(&counters->pipelinedrequests);
       DEBUGF("(stat) %,ld pipelinedrequest bytes", amtread - cpm.msgsize);
       memmove(inbuf.p, inbuf.p + cpm.msgsize, amtread - cpm.msgsize);
       amtread -= cpm.msgsize;
@@ -6650,7 +8181,9 @@ static int MemoryMonitor(void *arg, int tid) {
         mi[2].flags = 0;
         __mmi_lock();
         if (_mmi.i == intervals - 3) {
-          memcpy(mi + 3, _mmi.p, _mmi.i * sizeof(*mi));
+          for (i = 3, j = __first_memory(&_mmi); j != -1; j = _mmi.p[j].next) {
+            mi[i++] = _mmi.p[j];
+          }
           ok = true;
         } else {
           ok = false;
@@ -6743,13 +8276,178 @@ static void MonitorMemory(void) {
   }
 }
 
+static void StartWorker(void) {
+  if (!IsTiny() && monitortty) {
+    MonitorMemory();
+  }
+  meltdown = false;
+  __isworker = true;
+  counters = shared->c + 1 +
+             atomic_fetch_add_explicit(&shared->nextshard, 1,
+                                       memory_order_relaxed) %
+                 (ARRAYLEN(shared->c) - 1);
+  connectionclose = false;
+  if (!IsTiny() && systrace) {
+    kStartTsc = rdtsc();
+  }
+  TRACE_BEGIN;
+  if (sandboxed) {
+    CHECK_NE(-1, EnableSandbox());
+  }
+  if (hasonworkerstart) {
+    CallSimpleHook("OnWorkerStart");
+  }
+}
+
+static void ForkedWorker(int pid) {
+  LockInc(&shared->workers);
+  ReseedRng(&rng, "parent");
+  if (hasonprocesscreate) {
+    LuaOnProcessCreate(pid);
+  }
+}
+
+static void UnparkConnection(int fd) {
+  LOGIFNEG1(epoll_ctl(idleepoll, EPOLL_CTL_DEL, fd, 0));
+  free(idlers.p[fd].buf);
+  idlers.p[fd].buf = 0;
+  idlers.p[fd].len = 0;
+  idlers.p[fd].server = 0;
+  --idlers.n;
+}
+
+static void ParkConnection(size_t server) {
+  size_t n;
+  struct Idler *p;
+  struct epoll_event ev;
+  if (client >= idlers.c) {
+    n = MAX(client + 1, idlers.c + (idlers.c >> 1));
+    idlers.p = xrealloc(idlers.p, n * sizeof(*idlers.p));
+    bzero(idlers.p + idlers.c, (n - idlers.c) * sizeof(*idlers.p));
+    idlers.c = n;
+  }
+  ev.events = EPOLLIN;
+  ev.data.u64 = client;
+  if (epoll_ctl(idleepoll, EPOLL_CTL_ADD, client, &ev) != -1) {
+    p = idlers.p + client;
+    p->server = server + 1;
+    p->messages = messageshandled;
+    p->addr = clientaddr;
+    p->start = startconnection;
+    p->since = timespec_real();
+    ++idlers.n;
+    LockInc(&counters->idleparks);
+    DEBUGF("(stat) %s parked (%,zu idle)", DescribeClient(), idlers.n);
+  } else {
+    WARNF("(srvr) %s epoll_ctl() error: %m", DescribeClient());
+    close(client);
+  }
+}
+
+// closes client or parks it for the event loop, then resets state
+static void EndConnection(size_t server) {
+  if (connectionparked) {
+    connectionparked = false;
+    ParkConnection(server);
+  } else {
+    DEBUGF("(stat) %s closing after %,ldµs", DescribeClient(),
+           timespec_tomicros(timespec_sub(timespec_real(), startconnection)));
+    close(client);
+  }
+  oldin.p = 0;
+  oldin.n = 0;
+  if (inbuf.c) {
+    inbuf.p -= inbuf.c;
+    inbuf.n += inbuf.c;
+    inbuf.c = 0;
+  }
+#ifndef UNSECURE
+  if (usingssl) {
+    usingssl = false;
+    reader = read;
+    writer = WritevAll;
+    mbedtls_ssl_session_reset(&ssl);
+  }
+#endif
+}
+
+// reads from parked connection without blocking, and returns true once
+// a whole message header is in inbuf, so a client trickling its request
+// a byte at a time stays parked until it's expired by the idle timeout
+static bool ReadParkedConnection(int fd, struct Idler *p) {
+  int rc;
+  ssize_t got;
+  struct HttpMessage msg;
+  if (p->len) memcpy(inbuf.p, p->buf, p->len);
+  amtread = p->len;
+  if ((got = recv(fd, inbuf.p + amtread, inbuf.n - amtread, MSG_DONTWAIT)) <=
+      0) {
+    if (got == -1 && errno == EAGAIN) {
+      errno = 0;
+      amtread = 0;
+      return false;
+    }
+    return true;  // let HandleMessages() log the close
+  }
+  amtread += got;
+  if (amtread == inbuf.n) return true;
+  InitHttpMessage(&msg, kHttpRequest);
+  rc = ParseHttpMessage(&msg, inbuf.p, amtread);
+  DestroyHttpMessage(&msg);
+  if (rc) return true;
+  p->buf = xrealloc(p->buf, amtread);
+  memcpy(p->buf, inbuf.p, amtread);
+  p->len = amtread;
+  amtread = 0;
+  return false;
+}
+
+// serves parked keep-alive connection once its next message arrives
+static void ResumeConnection(int fd) {
+  size_t server;
+  struct Idler *p;
+  p = idlers.p + fd;
+  if (!ReadParkedConnection(fd, p)) return;
+  server = p->server - 1;
+  client = fd;
+  clientaddr = p->addr;
+  startconnection = p->start;
+  messageshandled = p->messages;
+  serveraddr = &servers.p[server].addr;
+  UnparkConnection(fd);
+  LockInc(&counters->idleresumes);
+  ishandlingconnection = true;
+  HandleMessages();
+  EndConnection(server);
+  ishandlingconnection = false;
+  CollectGarbage();
+}
+
+static void ExpireIdleConnections(bool all) {
+  int fd;
+  struct timespec now, limit;
+  if (!idlers.n) return;
+  now = timespec_real();
+  limit = timeval_totimespec(timeout);
+  for (fd = 0; fd < idlers.c; ++fd) {
+    if (!idlers.p[fd].server) continue;
+    if (all || (timeout.tv_sec >= 0 &&
+                timespec_cmp(timespec_sub(now, idlers.p[fd].since), limit) >=
+                    0)) {
+      if (!all) LockInc(&counters->idletimeouts);
+      UnparkConnection(fd);
+      close(fd);
+    }
+  }
+}
+
 static int HandleConnection(size_t i) {
   uint32_t ip;
   int pid, tok, rc = 0;
   clientaddrsize = sizeof(clientaddr);
   if ((client = accept4(servers.p[i].fd, (struct sockaddr *)&clientaddr,
                         &clientaddrsize, SOCK_CLOEXEC)) != -1) {
-    LockInc(&shared->c.accepts);
+    LockInc(&counters->accepts);
     GetClientAddr(&ip, 0);
     if (tokenbucket.cidr && tokenbucket.reject >= 0) {
       if (!IsTrustedIp(ip)) {
@@ -6757,20 +8455,20 @@ static int HandleConnection(size_t i) {
         if (tok <= tokenbucket.ban && tokenbucket.ban >= 0) {
           WARNF("(token) banning %hhu.%hhu.%hhu.%hhu who only has %d tokens",
                 ip >> 24, ip >> 16, ip >> 8, ip, tok);
-          LockInc(&shared->c.bans);
+          LockInc(&counters->bans);
           Blackhole(ip);
           close(client);
           return 0;
         } else if (tok <= tokenbucket.ignore && tokenbucket.ignore >= 0) {
           DEBUGF("(token) ignoring %hhu.%hhu.%hhu.%hhu who only has %d tokens",
                  ip >> 24, ip >> 16, ip >> 8, ip, tok);
-          LockInc(&shared->c.ignores);
+          LockInc(&counters->ignores);
           close(client);
           return 0;
         } else if (tok < tokenbucket.reject) {
           WARNF("(token) rejecting %hhu.%hhu.%hhu.%hhu who only has %d tokens",
                 ip >> 24, ip >> 16, ip >> 8, ip, tok);
-          LockInc(&shared->c.rejects);
+          LockInc(&counters->rejects);
           SendTooManyRequests();
           close(client);
           return 0;
@@ -6786,7 +8484,7 @@ static int HandleConnection(size_t i) {
       DEBUGF("(token) can't acquire accept() token for client");
     }
     startconnection = timespec_real();
-    if (UNLIKELY(maxworkers) && shared->workers >= maxworkers) {
+    if (UNLIKELY(maxworkers) && !workerpool && shared->workers >= maxworkers) {
       EnterMeltdownMode();
       SendServiceUnavailable();
       close(client);
@@ -6801,36 +8499,20 @@ static int HandleConnection(size_t i) {
     if (uniprocess) {
       pid = -1;
       connectionclose = true;
+    } else if (workerpool) {
+      pid = -1;  // already inside a long-lived pool worker
+      ++poolconnections;
     } else {
       switch ((pid = fork())) {
         case 0:
-          if (!IsTiny() && monitortty) {
-            MonitorMemory();
-          }
-          meltdown = false;
-          __isworker = true;
-          connectionclose = false;
-          if (!IsTiny() && systrace) {
-            kStartTsc = rdtsc();
-          }
-          TRACE_BEGIN;
-          if (sandboxed) {
-            CHECK_NE(-1, EnableSandbox());
-          }
-          if (hasonworkerstart) {
-            CallSimpleHook("OnWorkerStart");
-          }
+          StartWorker();
           break;
         case -1:
           HandleForkFailure();
           return 0;
         default:
-          LockInc(&shared->workers);
           close(client);
-          ReseedRng(&rng, "parent");
-          if (hasonprocesscreate) {
-            LuaOnProcessCreate(pid);
-          }
+          ForkedWorker(pid);
           return 0;
       }
     }
@@ -6838,68 +8520,55 @@ static int HandleConnection(size_t i) {
       CloseServerFds();
     }
     HandleMessages();
-    DEBUGF("(stat) %s closing after %,ldµs", DescribeClient(),
-           timespec_tomicros(timespec_sub(timespec_real(), startconnection)));
     if (!pid) {
+      DEBUGF("(stat) %s closing after %,ldµs", DescribeClient(),
+             timespec_tomicros(timespec_sub(timespec_real(), startconnection)));
       if (hasonworkerstop) {
         CallSimpleHook("OnWorkerStop");
       }
       rc = ExitWorker();
     } else {
-      close(client);
-      oldin.p = 0;
-      oldin.n = 0;
-      if (inbuf.c) {
-        inbuf.p -= inbuf.c;
-        inbuf.n += inbuf.c;
-        inbuf.c = 0;
-      }
-#ifndef UNSECURE
-      if (usingssl) {
-        usingssl = false;
-        reader = read;
-        writer = WritevAll;
-        mbedtls_ssl_session_reset(&ssl);
-      }
-#endif
+      EndConnection(i);
     }
     CollectGarbage();
   } else {
-    if (errno == EINTR || errno == EAGAIN) {
-      LockInc(&shared->c.acceptinterrupts);
+    if (errno == EAGAIN && workerpool) {
+      // another pool worker accepted the client first
+    } else if (errno == EINTR || errno == EAGAIN) {
+      LockInc(&counters->acceptinterrupts);
     } else if (errno == ENFILE) {
-      LockInc(&shared->c.enfiles);
+      LockInc(&counters->enfiles);
       LogAcceptError("enfile: too many open files");
       meltdown = true;
     } else if (errno == EMFILE) {
-      LockInc(&shared->c.emfiles);
+      LockInc(&counters->emfiles);
       LogAcceptError("emfile: ran out of open file quota");
       meltdown = true;
     } else if (errno == ENOMEM) {
-      LockInc(&shared->c.enomems);
+      LockInc(&counters->enomems);
       LogAcceptError("enomem: ran out of memory");
       meltdown = true;
     } else if (errno == ENOBUFS) {
-      LockInc(&shared->c.enobufs);
+      LockInc(&counters->enobufs);
       LogAcceptError("enobuf: ran out of buffer");
       meltdown = true;
     } else if (errno == ENONET) {
-      LockInc(&shared->c.enonets);
+      LockInc(&counters->enonets);
       LogAcceptError("enonet: network gone");
       polls[i].fd = -polls[i].fd;
     } else if (errno == ENETDOWN) {
-      LockInc(&shared->c.enetdowns);
+      LockInc(&counters->enetdowns);
       LogAcceptError("enetdown: network down");
       polls[i].fd = -polls[i].fd;
     } else if (errno == ECONNABORTED) {
-      LockInc(&shared->c.accepterrors);
-      LockInc(&shared->c.acceptresets);
+      LockInc(&counters->accepterrors);
+      LockInc(&counters->acceptresets);
       WARNF("(srvr) %S accept error: %s", DescribeServer(),
             "acceptreset: connection reset before accept");
     } else if (errno == ENETUNREACH || errno == EHOSTUNREACH ||
                errno == EOPNOTSUPP || errno == ENOPROTOOPT || errno == EPROTO) {
-      LockInc(&shared->c.accepterrors);
-      LockInc(&shared->c.acceptflakes);
+      LockInc(&counters->accepterrors);
+      LockInc(&counters->acceptflakes);
       WARNF("(srvr) accept error: %s ephemeral accept error: %m",
             DescribeServer());
     } else {
@@ -6910,6 +8579,147 @@ static int HandleConnection(size_t i) {
   return rc;
 }
 
+static bool IsPoolWorkerRetired(void) {
+  return terminated || killed || poolgen != shared->poolgen ||
+         (poolrecycle && poolconnections >= poolrecycle);
+}
+
+// event loop for pool workers, which wakes only one of them for each
+// client that connects, and parks idle keep-alive connections too if
+// the idle limit allows it
+static bool HandleEpollWorker(void) {
+  int i, n;
+  uint64_t id;
+  struct timespec lastexpiry;
+  struct epoll_event ev, evs[64];
+  for (i = 0; i < servers.n; ++i) {
+    // wake only one worker per connection, when kernel supports it
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.u64 = 0x8000000000000000 | i;
+    if (epoll_ctl(idleepoll, EPOLL_CTL_ADD, servers.p[i].fd, &ev) == -1) {
+      ev.events = EPOLLIN;
+      if (epoll_ctl(idleepoll, EPOLL_CTL_ADD, servers.p[i].fd, &ev) == -1) {
+        WARNF("(srvr) epoll_ctl() error: %m");
+        return false;
+      }
+      errno = 0;
+    }
+  }
+  lastexpiry = timespec_real();
+  while (!IsPoolWorkerRetired()) {
+    if ((n = epoll_wait(idleepoll, evs, ARRAYLEN(evs),
+                        timespec_tomillis(heartbeatinterval))) != -1) {
+      for (i = 0; i < n; ++i) {
+        id = evs[i].data.u64;
+        if (id & 0x8000000000000000) {
+          id &= ~0x8000000000000000;
+          serveraddr = &servers.p[id].addr;
+          ishandlingconnection = true;
+          HandleConnection(id);
+          ishandlingconnection = false;
+        } else {
+          ResumeConnection(id);
+        }
+        meltdown = false;
+        if (IsPoolWorkerRetired()) break;
+      }
+      if (timespec_cmp(timespec_sub(timespec_real(), lastexpiry),
+                       heartbeatinterval) >= 0) {
+        ExpireIdleConnections(false);
+        lastexpiry = timespec_real();
+      }
+    } else if (errno == EINTR || errno == EAGAIN) {
+      LockInc(&counters->pollinterrupts);
+      errno = 0;
+    } else {
+      WARNF("(srvr) pool worker epoll error: %m");
+      break;
+    }
+    if (invalidated) {
+      HandleReload();
+    }
+  }
+  ExpireIdleConnections(true);
+  return true;
+}
+
+// runs inside a prefork worker, which accept()s on inherited sockets
+static int HandlePoolWorker(void) {
+  int nfds;
+  size_t i;
+  DEBUGF("(srvr) pool worker %d started", getpid());
+  if ((idleepoll = epoll_create1(EPOLL_CLOEXEC)) != -1) {
+    if (HandleEpollWorker()) {
+      goto Retire;
+    }
+    close(idleepoll);
+    idleepoll = -1;
+  } else {
+    VERBOSEF("(srvr) pool worker can't use epoll: %m");
+    errno = 0;
+  }
+  // every worker polling the same sockets will wake up for each client
+  // but since they're non-blocking, the losers just go back to polling
+  while (!IsPoolWorkerRetired()) {
+    if ((nfds = poll(polls + 1, servers.n,
+                     timespec_tomillis(heartbeatinterval))) != -1) {
+      for (i = 0; nfds && i < servers.n; ++i) {
+        if (!polls[1 + i].revents) continue;
+        if (polls[1 + i].fd < 0) continue;
+        serveraddr = &servers.p[i].addr;
+        ishandlingconnection = true;
+        HandleConnection(i);
+        ishandlingconnection = false;
+        meltdown = false;
+        if (IsPoolWorkerRetired()) break;
+      }
+    } else if (errno == EINTR || errno == EAGAIN) {
+      LockInc(&counters->pollinterrupts);
+      errno = 0;
+    } else {
+      WARNF("(srvr) pool worker poll error: %m");
+      break;
+    }
+    if (invalidated) {
+      HandleReload();
+    }
+  }
+Retire:
+  DEBUGF("(srvr) pool worker %d retiring after %,ld connections", getpid(),
+         poolconnections);
+  if (hasonworkerstop) {
+    CallSimpleHook("OnWorkerStop");
+  }
+  return ExitWorker();
+}
+
+// forks workers until the pool is back to full strength
+static int ReplenishWorkerPool(void) {
+  int pid;
+  poolgen = shared->poolgen;
+  while (shared->workers < workerpool && !terminated) {
+    if ((pid = fork()) > 0) {
+      ForkedWorker(pid);
+    } else if (!pid) {
+      StartWorker();
+      return HandlePoolWorker();
+    } else {
+      LockInc(&counters->forkerrors);
+      lastpoolfailure = timespec_real();
+      WARNF("(srvr) failed to fork pool worker: %m");
+      errno = 0;
+      break;
+    }
+  }
+  return 0;
+}
+
+static bool ShouldReplenishWorkerPool(void) {
+  return workerpool && shared->workers < workerpool &&
+         timespec_cmp(timespec_sub(timespec_real(), lastpoolfailure),
+                      (struct timespec){1}) >= 0;
+}
+
 static void MakeExecutableModifiable(void) {
 #ifdef __x86_64__
   int ft;
@@ -6923,6 +8733,9 @@ static void MakeExecutableModifiable(void) {
   if ((zfd = __open_executable()) == -1) {
     WARNF("(srvr) can't open executable for modification: %m");
   }
+  if (zmapfd != -1 && zmapfd != zfd) {
+    zmapfd = zfd;
+  }
   if (ft > 0) {
     __ftrace = 0;
     ftrace_install();
@@ -6976,11 +8789,13 @@ static int HandleReadline(void) {
 
 static int HandlePoll(int ms) {
   int rc, nfds;
-  size_t pollid, serverid;
-  if ((nfds = poll(polls, 1 + servers.n, ms)) != -1) {
+  size_t pollid, serverid, npolls;
+  // pool workers accept() so the main process only watches the terminal
+  npolls = workerpool ? 1 : 1 + servers.n;
+  if ((nfds = poll(polls, npolls, ms)) != -1) {
     if (nfds) {
       // handle pollid/o events
-      for (pollid = 0; pollid < 1 + servers.n; ++pollid) {
+      for (pollid = 0; pollid < npolls; ++pollid) {
         if (!polls[pollid].revents) continue;
         if (polls[pollid].fd < 0) continue;
         if (polls[pollid].fd) {
@@ -7011,9 +8826,9 @@ static int HandlePoll(int ms) {
     }
   } else {
     if (errno == EINTR || errno == EAGAIN) {
-      LockInc(&shared->c.pollinterrupts);
+      LockInc(&counters->pollinterrupts);
     } else if (errno == ENOMEM) {
-      LockInc(&shared->c.enomems);
+      LockInc(&counters->enomems);
       WARNF("(srvr) poll error: ran out of memory");
       meltdown = true;
     } else {
@@ -7027,6 +8842,7 @@ static int HandlePoll(int ms) {
 static void Listen(void) {
   char ipbuf[16];
   size_t i, j, n;
+  int flags;
   uint32_t ip, port, addrsize, *ifp;
   bool hasonserverlisten = IsHookDefined("OnServerListen");
   if (!ports.n) {
@@ -7060,6 +8876,12 @@ static void Listen(void) {
         n--;  // skip this server instance
         continue;
       }
+      if (workerpool && SO_REUSEPORT &&
+          setsockopt(servers.p[n].fd, SOL_SOCKET, SO_REUSEPORT, &(int){1},
+                     sizeof(int)) == -1) {
+        WARNF("(srvr) setsockopt(SO_REUSEPORT) error: %m");
+        errno = 0;
+      }
 
       if (bind(servers.p[n].fd, (struct sockaddr *)&servers.p[n].addr,
                sizeof(servers.p[n].addr)) == -1) {
@@ -7069,6 +8891,13 @@ static void Listen(void) {
       if (listen(servers.p[n].fd, 10) == -1) {
         DIEF("(srvr) listen error: %m");
       }
+      // pool workers share this socket, and whichever loses the race
+      // to accept() a client needs EAGAIN so it can go back to polling
+      if (workerpool &&
+          ((flags = fcntl(servers.p[n].fd, F_GETFL)) == -1 ||
+           fcntl(servers.p[n].fd, F_SETFL, flags | O_NONBLOCK) == -1)) {
+        DIEF("(srvr) fcntl error: %m");
+      }
       addrsize = sizeof(servers.p[n].addr);
       if (getsockname(servers.p[n].fd, (struct sockaddr *)&servers.p[n].addr,
                       &addrsize) == -1) {
@@ -7114,6 +8943,7 @@ static void HandleShutdown(void) {
 
 // this function coroutines with linenoise
 int EventLoop(int ms) {
+  int rc;
   struct timespec t;
   DEBUGF("(repl) event loop");
   while (!terminated) {
@@ -7135,6 +8965,11 @@ int EventLoop(int ms) {
                             heartbeatinterval) >= 0) {
       lastheartbeat = t;
       HandleHeartbeat();
+    } else if (ShouldReplenishWorkerPool()) {
+      lua_repl_lock();
+      rc = ReplenishWorkerPool();
+      lua_repl_unlock();
+      if (rc == -1) break;
     } else if (HandlePoll(ms) == -1) {
       break;
     }
@@ -7172,6 +9007,67 @@ static void SigInit(void) {
   InstallSignalHandler(SIGPIPE, SIG_IGN);
 }
 
+#ifndef UNSECURE
+static int SslCacheGet(void *data, mbedtls_ssl_session *session) {
+  size_t i, n;
+  struct SslCache *c;
+  mbedtls_ssl_session s;
+  struct SslCacheEntry *e;
+  unsigned char buf[sizeof(e->data)];
+  c = data;
+  n = 0;
+  if (session->id_len > sizeof(e->id)) return 1;
+  i = Hash(session->id, session->id_len) % ARRAYLEN(c->e);
+  e = c->e + i;
+  pthread_spin_lock(c->lock + i % ARRAYLEN(c->lock));
+  if (e->size && e->idlen == session->id_len &&
+      e->expires > timespec_real().tv_sec &&
+      !timingsafe_bcmp(e->id, session->id, e->idlen)) {
+    memcpy(buf, e->data, (n = e->size));
+  }
+  pthread_spin_unlock(c->lock + i % ARRAYLEN(c->lock));
+  if (n) {
+    mbedtls_ssl_session_init(&s);
+    if (mbedtls_ssl_session_load(&s, buf, n) ||
+        s.ciphersuite != session->ciphersuite ||
+        s.compression != session->compression ||
+        mbedtls_ssl_session_copy(session, &s)) {
+      n = 0;
+    }
+    mbedtls_ssl_session_free(&s);
+    mbedtls_platform_zeroize(buf, sizeof(buf));
+  }
+  if (n) {
+    LockInc(&counters->sslcachehits);
+    return 0;
+  } else {
+    LockInc(&counters->sslcachemisses);
+    return 1;
+  }
+}
+
+static int SslCacheSet(void *data, const mbedtls_ssl_session *session) {
+  size_t i, n;
+  struct SslCache *c;
+  struct SslCacheEntry *e;
+  unsigned char buf[sizeof(e->data)];
+  c = data;
+  if (!session->id_len || session->id_len > sizeof(e->id)) return 1;
+  if (mbedtls_ssl_session_save(session, buf, sizeof(buf), &n)) return 1;
+  i = Hash(session->id, session->id_len) % ARRAYLEN(c->e);
+  e = c->e + i;
+  pthread_spin_lock(c->lock + i % ARRAYLEN(c->lock));
+  e->expires = timespec_real().tv_sec + sslticketlifetime;
+  e->size = n;
+  e->idlen = session->id_len;
+  memcpy(e->id, session->id, session->id_len);
+  memcpy(e->data, buf, n);
+  pthread_spin_unlock(c->lock + i % ARRAYLEN(c->lock));
+  mbedtls_platform_zeroize(buf, sizeof(buf));
+  return 0;
+}
+#endif
+
 static void TlsInit(void) {
 #ifndef UNSECURE
   int suite;
@@ -7207,7 +9103,17 @@ static void TlsInit(void) {
                              MBEDTLS_CIPHER_AES_256_GCM, sslticketlifetime);
     mbedtls_ssl_conf_session_tickets_cb(&conf, mbedtls_ssl_ticket_write,
                                         mbedtls_ssl_ticket_parse, &ssltick);
+    if (!sslcache) {
+      sslcache = _mapshared(ROUNDUP(sizeof(struct SslCache), FRAMESIZE));
+    }
+    mbedtls_ssl_conf_session_cache(&conf, sslcache, SslCacheGet, SslCacheSet);
+  } else {
+    mbedtls_ssl_conf_session_cache(&conf, 0, 0, 0);
   }
+  // an http/2 connection is served start to finish by one process, so
+  // it'd pin a pool worker, which can only park idle http/1.1 clients
+  DCHECK_EQ(0, mbedtls_ssl_conf_alpn_protocols(
+                   &conf, (void *)(workerpool ? kAlpn : kAlpnServer)));
 
   if (sslinitialized) return;
   sslinitialized = true;
@@ -7230,7 +9136,6 @@ static void TlsInit(void) {
   }
   mbedtls_ssl_set_bio(&ssl, &g_bio, TlsSend, 0, TlsRecv);
   conf.disable_compression = confcli.disable_compression = true;
-  DCHECK_EQ(0, mbedtls_ssl_conf_alpn_protocols(&conf, (void *)kAlpn));
   DCHECK_EQ(0, mbedtls_ssl_conf_alpn_protocols(&confcli, (void *)kAlpn));
   DCHECK_EQ(0, mbedtls_ssl_setup(&ssl, &conf));
   DCHECK_EQ(0, mbedtls_ssl_setup(&sslcli, &confcli));
@@ -7290,10 +9195,16 @@ static void GetOpts(int argc, char *argv[]) {
         long ret = strtol(optarg, &p, 0);
         ProgramCache(ret, *p ? p + 1 : NULL);  // skip separator, if any
         break;
+      case 'n':;  // accept "workers" or "workers,connections"
+        char *q;
+        long workers = strtol(optarg, &q, 0);
+        ProgramWorkerPool(workers, *q ? ParseInt(q + 1) : 0);
+        break;
         CASE('r', ProgramRedirectArg(307, optarg));
         CASE('t', ProgramTimeout(ParseInt(optarg)));
         CASE('h', PrintUsage(1, EXIT_SUCCESS));
         CASE('M', ProgramMaxPayloadSize(ParseInt(optarg)));
+        CASE('I', ProgramIdleConnections(ParseInt(optarg)));
 #if !IsTiny()
         CASE('W', monitortty = optarg);
       case 'f':
@@ -7364,6 +9275,7 @@ void RedBean(int argc, char *argv[]) {
            (shared = mmap(NULL, ROUNDUP(sizeof(struct Shared), FRAMESIZE),
                           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
                           -1, 0)));
+  counters = shared->c;
   if (daemonize) {
     for (int i = 0; i < 256; ++i) {
       close(i);
@@ -7389,10 +9301,13 @@ void RedBean(int argc, char *argv[]) {
   }
 #endif
   LuaInit();
+  LuaCompilePages();
   oldloglevel = __log_level;
   if (uniprocess) {
     shared->workers = 1;
+    workerpool = 0;
   }
+  GzipCacheInit();
   if (daemonize) {
     if (!logpath) ProgramLogPath("/dev/null");
     dup2(2, 1);
@@ -7428,6 +9343,7 @@ void RedBean(int argc, char *argv[]) {
     if (monitortty) {
       MonitorMemory();
     }
+    WatchStageDirs();
   }
 #ifdef STATIC
   EventLoop(timespec_tomillis(heartbeatinterval));
@@ -7444,6 +9360,7 @@ void RedBean(int argc, char *argv[]) {
     if (!IsTiny()) {
       terminatemonitor = true;
       _join(&monitorth);
+      _join(&stageth);
     }
 #ifndef STATIC
     _join(&replth);